@@ -0,0 +1,127 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <Arduino.h>
+
+// Bytes wanted per slot: the transfer chunk size uploads used before the
+// pool (every slot can hold a whole chunk)
+#ifndef BUFFER_POOL_SLOT_SIZE
+#define BUFFER_POOL_SLOT_SIZE 32768
+#endif
+
+// Share of the largest free heap block the arena may take at boot
+#ifndef BUFFER_POOL_HEAP_SHARE_PERCENT
+#define BUFFER_POOL_HEAP_SHARE_PERCENT 50
+#endif
+
+// Slot size bounds (bytes)
+#ifndef BUFFER_POOL_MIN_SLOT_SIZE
+#define BUFFER_POOL_MIN_SLOT_SIZE 4096
+#endif
+
+#ifndef BUFFER_POOL_MAX_SLOT_SIZE
+#define BUFFER_POOL_MAX_SLOT_SIZE 65536
+#endif
+
+/**
+ * BufferPool - Fixed arena of equal-sized buffers allocated once at boot
+ *
+ * Large transfer buffers used to be malloc'd and freed for every file. Over
+ * a long session on a 320KB ESP32 the free heap splits into pieces until
+ * a 16-32KB allocation fails. The pool takes one contiguous arena early,
+ * before Wi-Fi and the web server have fragmented the heap. It then hands
+ * out fixed slots from that arena, so steady-state uploads allocate nothing.
+ *
+ * Borrowers:
+ * - UploadPipeline ring buffers
+ * - SMB async write slots and header patch buffer
+ * - checksum and tail-hash reads in UploadStateManager
+ * - the streamed web server responses
+ *
+ * acquire() falls back to malloc when the pool is exhausted, was never
+ * started, or the request is larger than a slot. Every fallback is counted,
+ * so a non-zero count in the heap report shows the pool is too small.
+ *
+ * Not thread-safe: all borrowers run on the Arduino loop task (the
+ * pipeline's SD reader task only uses buffers acquired for it).
+ */
+class BufferPool {
+public:
+    static const int MAX_SLOTS = 16;
+
+    static BufferPool& getInstance();
+
+    /**
+     * Allocate the arena: slotCount slots of slotBytes each
+     * Halves the slot size while the arena is larger than
+     * BUFFER_POOL_HEAP_SHARE_PERCENT of the largest free block, or the
+     * allocation fails, but never goes below BUFFER_POOL_MIN_SLOT_SIZE.
+     *
+     * @param slotCount Buffers needed at the same time (clamped to 1..MAX_SLOTS)
+     * @param slotBytes Bytes wanted per slot (rounded down to a power of two)
+     * @param largestFreeBlock Largest allocatable heap block (0 = no bound)
+     * @return true if the arena was allocated
+     */
+    bool begin(int slotCount, size_t slotBytes = BUFFER_POOL_SLOT_SIZE, size_t largestFreeBlock = 0);
+
+    /**
+     * Release the arena (all slots must have been returned)
+     */
+    void end();
+
+    /**
+     * Borrow a buffer of at least size bytes
+     *
+     * @return Pool slot, malloc'd fallback, or nullptr if both failed
+     */
+    uint8_t* acquire(size_t size);
+
+    /**
+     * Return a buffer obtained from acquire() (nullptr is ignored)
+     */
+    void release(uint8_t* buffer);
+
+    bool isActive() const { return arena != nullptr; }
+    size_t getSlotSize() const { return slotSize; }
+    int getSlotCount() const { return slotCount; }
+    int getSlotsInUse() const { return slotsInUse; }
+    int getPeakSlotsInUse() const { return peakSlotsInUse; }
+    unsigned long getAcquireCount() const { return acquireCount; }
+    unsigned long getFallbackCount() const { return fallbackCount; }  // acquire() calls that hit malloc
+
+    /**
+     * Log heap and pool statistics (free heap, low-water mark, largest
+     * block, fragmentation, slot usage and fallbacks)
+     *
+     * @param context Short label for the log line (e.g. "session end")
+     */
+    void logHeapReport(const char* context);
+
+    /**
+     * Heap and pool statistics as a JSON object (for /status)
+     */
+    String getHeapReportJSON();
+
+    /**
+     * Fragmentation in percent: share of free heap not usable as one block
+     */
+    static int fragmentationPercent(size_t freeBytes, size_t largestBlock);
+
+private:
+    BufferPool();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    uint8_t* arena;
+    size_t slotSize;
+    int slotCount;
+    uint16_t usedMask;     // Bit i set = slot i borrowed
+    int slotsInUse;
+    int peakSlotsInUse;
+    unsigned long acquireCount;
+    unsigned long fallbackCount;
+
+    int slotIndexOf(const uint8_t* buffer) const;
+};
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,29 @@
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include <Arduino.h>
+
+/**
+ * Little-endian field access for the binary files kept on the card
+ * (.datalog_index, .upload_state.bin)
+ */
+inline void putLE16(uint8_t* p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+inline void putLE32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+inline uint16_t getLE16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t getLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#endif // BYTE_ORDER_H
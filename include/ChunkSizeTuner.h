@@ -0,0 +1,115 @@
+#ifndef CHUNK_SIZE_TUNER_H
+#define CHUNK_SIZE_TUNER_H
+
+#include <Arduino.h>
+
+// Smallest and largest transfer chunk the tuner will pick (bytes, powers of two)
+#ifndef CHUNK_TUNER_MIN_SIZE
+#define CHUNK_TUNER_MIN_SIZE 4096
+#endif
+
+#ifndef CHUNK_TUNER_MAX_SIZE
+#define CHUNK_TUNER_MAX_SIZE 65536
+#endif
+
+// Starting point before any throughput has been measured
+#ifndef CHUNK_TUNER_DEFAULT_SIZE
+#define CHUNK_TUNER_DEFAULT_SIZE 16384
+#endif
+
+/**
+ * ChunkSizeTuner - Picks the transfer chunk size for uploads
+ *
+ * The ceiling is chosen when a connection is made. It is the largest
+ * power-of-two size that fits both the server's negotiated maximum write
+ * and the buffer that can back each chunk: a BufferPool slot, or a fixed
+ * share of the largest free heap block (split over every buffer the
+ * upload holds at once) when the pool is not available.
+ *
+ * Within that ceiling the size is tuned from measured throughput with a
+ * simple hill climb. Each candidate size collects at least
+ * MIN_SAMPLE_BYTES of transfers. The tuner then moves one step in the
+ * current direction. It keeps going while throughput improves by more
+ * than HYSTERESIS_PERCENT, and otherwise settles on the best size seen.
+ * Once settled, it forgets the other sizes every REPROBE_INTERVAL decisions
+ * and climbs again, so it can follow a link that changes over time.
+ *
+ * Every decision is logged with the "[ChunkTuner]" prefix.
+ */
+class ChunkSizeTuner {
+public:
+    static const int NUM_SIZES = 5;                        // 4, 8, 16, 32, 64 KB
+    static const unsigned long MIN_SAMPLE_BYTES = 256 * 1024;
+    static const int HYSTERESIS_PERCENT = 5;
+    static const int HEAP_SHARE_PERCENT = 50;              // Of the largest free block
+    static const int REPROBE_INTERVAL = 8;
+
+    ChunkSizeTuner();
+
+    /**
+     * Choose the ceiling and starting size for a new connection
+     * Measurements from a previous connection are kept if the ceiling allows.
+     *
+     * @param maxWriteSize Server's negotiated maximum write size (0 = unknown)
+     * @param largestFreeBlock Largest allocatable heap block in bytes
+     * @param buffersPerUpload Chunk-sized buffers held at once during an upload
+     */
+    void begin(uint32_t maxWriteSize, size_t largestFreeBlock, int buffersPerUpload);
+
+    /**
+     * Choose the ceiling when buffers come from a fixed pool
+     *
+     * @param maxWriteSize Server's negotiated maximum write size (0 = unknown)
+     * @param bufferLimit Largest buffer available per chunk (pool slot size)
+     */
+    void begin(uint32_t maxWriteSize, size_t bufferLimit);
+
+    /**
+     * Chunk size to use for the next upload
+     */
+    size_t getChunkSize() const { return sizes[currentIndex]; }
+
+    /**
+     * Largest chunk size allowed on the current connection
+     */
+    size_t getCeiling() const { return sizes[ceilingIndex]; }
+
+    /**
+     * Feed back one finished transfer
+     * Samples for a size other than the current one are ignored.
+     *
+     * @param chunkSize Chunk size the transfer used
+     * @param bytes Bytes transferred
+     * @param elapsedMs Time the transfer took
+     * @return true if the chunk size changed
+     */
+    bool recordTransfer(size_t chunkSize, unsigned long bytes, unsigned long elapsedMs);
+
+    /**
+     * Measured throughput for a size in bytes/second (0 = not measured yet)
+     */
+    unsigned long getMeasuredRate(size_t chunkSize) const;
+
+    bool isSettled() const { return settled; }
+
+private:
+    static const size_t sizes[NUM_SIZES];
+
+    int currentIndex;
+    int ceilingIndex;
+    int direction;             // +1 = probing larger sizes, -1 = smaller
+    bool settled;
+    int decisionsSinceSettle;
+
+    unsigned long rate[NUM_SIZES];         // Bytes/second per size (0 = unknown)
+    unsigned long sampleBytes[NUM_SIZES];  // Pending sample for the current size
+    unsigned long sampleMs[NUM_SIZES];
+
+    int indexOf(size_t chunkSize) const;
+    int largestIndexAtMost(size_t limit) const;
+    void applyCeiling(uint32_t maxWriteSize, size_t bufferLimit);
+    void moveTo(int index, const char* reason);
+    void decide();
+};
+
+#endif // CHUNK_SIZE_TUNER_H
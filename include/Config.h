@@ -11,6 +11,17 @@
     #include <Preferences.h>
 #endif
 
+/**
+ * One upload destination: the ENDPOINT_* keys, or MIRROR_ENDPOINT_* for
+ * the second destination every file is also sent to
+ */
+struct EndpointConfig {
+    String type;      // SMB, WEBDAV, SLEEPHQ (empty = not configured)
+    String url;
+    String user;
+    String password;
+};
+
 class Config {
 private:
     String wifiSSID;
@@ -20,6 +31,10 @@ private:
     String endpointType;  // SMB, WEBDAV, SLEEPHQ
     String endpointUser;
     String endpointPassword;
+    String mirrorEndpoint;          // Second destination (fan-out), same meaning
+    String mirrorEndpointType;      // as the ENDPOINT_* keys; empty type = none
+    String mirrorEndpointUser;
+    String mirrorEndpointPassword;
     int uploadHour;
     int sessionDurationSeconds;
     int maxRetryAttempts;
@@ -27,6 +42,13 @@ private:
     int bootDelaySeconds;
     int sdReleaseIntervalSeconds;
     int sdReleaseWaitMs;
+    int smbWriteWindow;  // Outstanding SMB writes per file (1 = synchronous)
+    int smbKeepaliveSeconds;    // Echo interval for an idle SMB session (0 = disabled)
+    int smbIdleTimeoutSeconds;  // Close SMB session after this long without uploads (0 = never)
+    bool datalogArchive;        // Upload each DATALOG folder as one .tar stream
+    bool webdavTlsInsecure;     // Accept any WebDAV server certificate (self-signed)
+    bool compressUploads;       // Gzip DATALOG files on the fly (.gz on the server)
+    String compressionCodec;    // GZIP, or EDF for the EDF signal codec (.edz)
     bool isValid;
     
     // Credential storage mode flags
@@ -40,6 +62,7 @@ private:
     static const char* PREFS_NAMESPACE;
     static const char* PREFS_KEY_WIFI_PASS;
     static const char* PREFS_KEY_ENDPOINT_PASS;
+    static const char* PREFS_KEY_MIRROR_PASS;
     static const char* CENSORED_VALUE;
     
     // Preferences initialization and cleanup methods
@@ -70,6 +93,9 @@ public:
     const String& getEndpointType() const;
     const String& getEndpointUser() const;
     const String& getEndpointPassword() const;
+    EndpointConfig getPrimaryEndpoint() const;
+    EndpointConfig getMirrorEndpoint() const;  // type empty if no mirror
+    bool hasMirrorEndpoint() const;
     int getUploadHour() const;
     int getSessionDurationSeconds() const;
     int getMaxRetryAttempts() const;
@@ -77,6 +103,13 @@ public:
     int getBootDelaySeconds() const;
     int getSdReleaseIntervalSeconds() const;
     int getSdReleaseWaitMs() const;
+    int getSmbWriteWindow() const;
+    int getSmbKeepaliveSeconds() const;
+    int getSmbIdleTimeoutSeconds() const;
+    bool isDatalogArchiveEnabled() const;
+    bool isWebdavTlsInsecure() const;
+    bool isCompressionEnabled() const;
+    const String& getCompressionCodec() const;
     bool valid() const;
     
     // Credential storage mode getters
@@ -0,0 +1,41 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <Arduino.h>
+
+#ifndef UNIT_TEST
+#include "esp32/rom/crc.h"
+#endif
+
+/**
+ * Crc32 - Incremental CRC-32 (IEEE 802.3, as used by gzip and zlib)
+ *
+ * Uses the ESP32 ROM routine on the device and a small table-driven
+ * version in native tests. Both give the same value as zlib's crc32().
+ */
+class Crc32 {
+public:
+    Crc32() : crc(0) {}
+
+    void begin() { crc = 0; }
+
+    void update(const uint8_t* data, size_t len) {
+#ifdef UNIT_TEST
+        crc = compute(crc, data, len);
+#else
+        crc = crc32_le(crc, data, len);
+#endif
+    }
+
+    uint32_t getValue() const { return crc; }
+
+    /**
+     * Continue a CRC over more data (start with crc = 0)
+     */
+    static uint32_t compute(uint32_t crc, const uint8_t* data, size_t len);
+
+private:
+    uint32_t crc;
+};
+
+#endif // CRC32_H
@@ -0,0 +1,157 @@
+#ifndef DATALOG_INDEX_H
+#define DATALOG_INDEX_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ctime>
+#include <vector>
+
+// New folders are found by checking the dates after the newest indexed
+// folder; a longer gap (CPAP unused, device switched off) walks /DATALOG
+#ifndef DATALOG_INDEX_PROBE_DAYS
+#define DATALOG_INDEX_PROBE_DAYS 31
+#endif
+
+// Safety net for folders the date checks cannot find (a CPAP clock far off
+// the NTP time): /DATALOG is walked again after this many days
+#ifndef DATALOG_INDEX_RESCAN_DAYS
+#define DATALOG_INDEX_RESCAN_DAYS 7
+#endif
+
+/**
+ * DatalogIndex - Persisted list of the DATALOG folders on the SD card
+ *
+ * Lets a session find the folders on the card without walking /DATALOG,
+ * which holds one YYYYMMDD folder per night (thousands after a few years,
+ * each costing a directory entry lookup). The CPAP only ever adds the
+ * folder of the current day, so once the index is built only the dates
+ * after its newest folder have to be checked. Each record also keeps what
+ * the last listing of the folder found (.edf count and bytes), so a folder
+ * is listed at most once per session however many targets ask about it.
+ *
+ * The index lives on the card it describes (/.datalog_index). Its header
+ * carries a random id that is compared on every refresh: a card that was
+ * swapped brings its own index, or none, and a missing or damaged index is
+ * rebuilt by the next walk of /DATALOG rather than up front.
+ *
+ * File format (little-endian): "DLIX", u16 version, u16 record size,
+ * u32 index id, u32 last walk time, u32 record count, records sorted by
+ * date { u32 date, u32 bytes, u16 entries, u8 state, u8 reserved },
+ * u32 CRC-32 of everything before it.
+ */
+class DatalogIndex {
+public:
+    static const uint16_t FORMAT_VERSION = 1;
+
+    enum FolderState {
+        FOLDER_NEW = 0,       // Found on the card, never listed
+        FOLDER_EMPTY = 1,     // No .edf files at the last listing
+        FOLDER_HAS_FILES = 2  // .edf files at the last listing
+    };
+
+    struct Entry {
+        uint32_t date;        // YYYYMMDD, the folder name
+        uint32_t bytes;       // Size of the .edf files at the last listing
+        uint16_t entries;     // Number of .edf files at the last listing
+        uint8_t state;        // FolderState
+        bool listed;          // Listed since the last refresh (not saved)
+    };
+
+private:
+    String indexFilePath;
+    std::vector<Entry> folders;  // Sorted by date
+    uint32_t indexId;            // 0 = nothing loaded (or built) yet
+    uint32_t lastWalkTime;       // When /DATALOG was last walked (0 = never)
+    bool dirty;                  // Changed since load/save
+    std::vector<Entry> walkPrevious;  // Records before the walk in progress
+    bool walking;
+
+    static const size_t HEADER_SIZE = 20;
+    static const size_t RECORD_SIZE = 12;
+
+    bool readHeader(fs::File& file, uint32_t& id, uint32_t& walkTime, uint32_t& count);
+
+public:
+    DatalogIndex(const String& filePath = "/.datalog_index");
+
+    /**
+     * Make the in-memory index the one of the card in the slot
+     * Reloads it when the card's index id differs from the loaded one
+     * (card swapped); starts an empty index to be rebuilt when the card
+     * has none or it is damaged.
+     *
+     * @return true if a walk of /DATALOG is needed to (re)build it
+     */
+    bool attach(fs::FS &sd);
+
+    bool load(fs::FS &sd);
+    bool save(fs::FS &sd);
+
+    /**
+     * Forget every folder; the next refresh walks /DATALOG
+     */
+    void clear();
+
+    bool isDirty() const { return dirty; }
+    bool isBuilt() const { return lastWalkTime != 0; }
+    uint32_t getIndexId() const { return indexId; }
+    uint32_t getLastWalkTime() const { return lastWalkTime; }
+
+    /**
+     * Whether the folders can be brought up to date by checking dates
+     * (see getProbeDates()) instead of walking /DATALOG
+     *
+     * @param now Current time (a clock before 2001 is treated as unset)
+     */
+    bool canProbe(time_t now) const;
+
+    /**
+     * Folder dates that may have appeared since the newest indexed one:
+     * the day after it up to tomorrow (CPAP and NTP clocks disagree by a
+     * few hours). Only valid if canProbe(now).
+     */
+    std::vector<uint32_t> getProbeDates(time_t now) const;
+
+    /**
+     * Start a walk of /DATALOG: folders not reported through addFolder()
+     * before finishWalk() are dropped
+     */
+    void beginWalk();
+    void finishWalk(time_t now);
+
+    /**
+     * Record a folder found on the card
+     *
+     * @return true if it was not indexed yet
+     */
+    bool addFolder(uint32_t date);
+
+    /**
+     * Record what a listing of the folder found
+     */
+    void recordListing(uint32_t date, size_t entries, unsigned long bytes);
+
+    /**
+     * Clear the listed flags; the next session lists folders again
+     */
+    void resetListed();
+
+    Entry* find(uint32_t date);
+    const std::vector<Entry>& getFolders() const { return folders; }
+    size_t getFolderCount() const { return folders.size(); }
+    uint32_t getNewestDate() const { return folders.empty() ? 0 : folders.back().date; }
+
+    /**
+     * Date of a YYYYMMDD folder name, 0 for any other name
+     */
+    static uint32_t parseFolderName(const String& name);
+    static String folderName(uint32_t date);
+
+    /**
+     * date plus a number of days (calendar arithmetic)
+     */
+    static uint32_t addDays(uint32_t date, int days);
+    static uint32_t dateOf(time_t time);  // Local date
+};
+
+#endif // DATALOG_INDEX_H
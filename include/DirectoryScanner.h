@@ -0,0 +1,59 @@
+#ifndef DIRECTORY_SCANNER_H
+#define DIRECTORY_SCANNER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+#include "SDCardManager.h"
+
+/**
+ * One directory entry as returned by DirectoryScanner
+ */
+struct DirEntry {
+    String name;       // Entry name without its path
+    uint32_t size;     // File size (0 for directories, or without WITH_STAT)
+    time_t lastWrite;  // Last write time (0 if unknown, or without WITH_STAT)
+    bool isDirectory;
+};
+
+/**
+ * DirectoryScanner - Lists a card directory without opening its entries
+ *
+ * File::openNextFile() opens every entry as a file (a FAT lookup, a
+ * stat() and a FILE or DIR handle each) only for the caller to read its
+ * name and close it again. The scanner reads the directory with
+ * opendir()/readdir() instead: names and types come from the directory
+ * entries in one pass, and stat() runs only for the files whose size is
+ * wanted, after the name filter. The records carry what the upload needs
+ * (size for planning, last write time for archives), so the files are not
+ * opened again until their data is read.
+ *
+ * In native tests the same calls go to MockFS (readDir() and stat()),
+ * which counts them so scans can be compared and benchmarked.
+ */
+class DirectoryScanner {
+public:
+    enum Options {
+        WITH_STAT = 1,         // stat() each accepted file for size and last write time
+        FILES_ONLY = 2,        // Skip subdirectories
+        DIRECTORIES_ONLY = 4   // Skip files
+    };
+
+    // Entries whose name it rejects are skipped before any stat()
+    typedef bool (*NameFilter)(const String& name);
+
+    /**
+     * Read a directory in one pass
+     *
+     * @param sd The card (mounted at SD_MOUNT_POINT on the device)
+     * @param path Directory path on the card, e.g. /DATALOG
+     * @param entries Receives the accepted entries, in directory order
+     * @param options Options flags
+     * @param filter Optional name filter
+     * @return false if the path cannot be opened as a directory
+     */
+    static bool scan(fs::FS &sd, const String& path, std::vector<DirEntry>& entries,
+                     int options = 0, NameFilter filter = nullptr);
+};
+
+#endif // DIRECTORY_SCANNER_H
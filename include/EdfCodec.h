@@ -0,0 +1,132 @@
+#ifndef EDF_CODEC_H
+#define EDF_CODEC_H
+
+#include <Arduino.h>
+#include <vector>
+#include "UploadPipeline.h"
+#include "Crc32.h"
+
+// Largest EDF header the encoder buffers (signals beyond this are sent verbatim)
+#ifndef EDF_CODEC_MAX_SIGNALS
+#define EDF_CODEC_MAX_SIGNALS 32
+#endif
+
+/**
+ * EdfCodec - Lossless EDF signal coder streamed on the fly
+ *
+ * EDF data records are int16 sample arrays, and neighbouring samples of
+ * one signal are strongly correlated. After the header is parsed, each
+ * sample is predicted from the same signal's history, either the previous
+ * sample or a straight line through the last two, whichever has been more
+ * accurate lately. The prediction error is zigzag-mapped and written as a
+ * varint, so a smooth signal costs about one byte per sample instead of
+ * two. Runs of exact predictions (set pressures, flat trends, ramps)
+ * collapse to a single token. This takes a few operations per sample, far
+ * less CPU than LZ77 matching.
+ *
+ * Stream layout (integers little endian):
+ *   "EDZ1"  u32 raw size  u32 header length H  u16 signal count N
+ *   N x { u8 mode, u16 samples per record }
+ *   H header bytes, verbatim
+ *   complete data records, coded signal by signal
+ *   remaining bytes (partial record being written), verbatim
+ *   u32 CRC-32 of the raw file
+ *
+ * Per-signal mode RAW sends samples as stored (EDF+ annotations, CRC
+ * signals). In DELTA mode each token is a varint v: (v & 1) == 0 is one
+ * sample with prediction error zigzag(v >> 1); (v & 1) == 1 is (v >> 1) + 2
+ * samples that equal their predictions. The predictor state continues
+ * across records; runs do not cross signal blocks. Input that is not a
+ * usable EDF file is sent with N = 0, i.e. verbatim.
+ *
+ * EdfCodec::decode() restores the file (native tests and tools);
+ * tools/datalog_unpack decodes .edz files on the server.
+ */
+class EdfCodec : public UploadSource {
+public:
+    enum SignalMode {
+        MODE_RAW = 0,
+        MODE_DELTA = 1
+    };
+
+    /**
+     * @param input Raw EDF file data
+     * @param inputSize Exact number of bytes to take from input
+     */
+    EdfCodec(UploadSource& input, size_t inputSize);
+
+    /**
+     * Coded bytes (returns 0 once the trailer has been produced)
+     */
+    size_t read(uint8_t* buffer, size_t len) override;
+
+    /**
+     * True if the input ended early
+     */
+    bool hasFailed() const { return failed; }
+
+    // Statistics
+    size_t getInputBytes() const { return inputConsumed; }   // Raw bytes coded so far
+    size_t getOutputBytes() const { return outputProduced; } // Coded bytes returned so far
+    int getSignalCount() const { return signals.size(); }     // 0 = sent verbatim
+
+    /**
+     * Restore the raw file from a coded stream
+     *
+     * @return false if the stream is malformed or fails its CRC
+     */
+    static bool decode(const uint8_t* data, size_t len, std::vector<uint8_t>& out);
+
+private:
+    static const size_t INPUT_CHUNK = 512;   // Raw bytes coded per step
+    static const size_t OUTPUT_TARGET = 1024;
+
+    enum Stage {
+        STAGE_START,
+        STAGE_RECORDS,
+        STAGE_TAIL,
+        STAGE_TRAILER,
+        STAGE_DONE
+    };
+
+    struct Signal {
+        uint8_t mode;
+        uint16_t samples;     // Per data record
+        int16_t previous;     // Last two samples, for prediction
+        int16_t previous2;
+        uint32_t cost1;       // Recent error of "same as previous"
+        uint32_t cost2;       // Recent error of "continue the line"
+    };
+
+    static int32_t predict(const Signal& signal);
+    static void advance(Signal& signal, int16_t sample);
+    static void resetSignal(Signal& signal);
+
+    UploadSource& input;
+    size_t inputSize;
+    size_t inputConsumed;
+    size_t outputProduced;
+    Crc32 crc;
+    bool failed;
+
+    Stage stage;
+    std::vector<Signal> signals;
+    size_t recordBytesLeft;   // Raw bytes of complete records not yet coded
+    size_t signalIndex;       // Position inside the current record
+    size_t sampleIndex;
+    unsigned long zeroRun;    // Unchanged samples waiting to be written
+
+    std::vector<uint8_t> out; // Coded bytes waiting for read()
+    size_t outOffset;
+
+    bool readInput(uint8_t* buffer, size_t len);
+    void start();
+    bool parseHeader(const std::vector<uint8_t>& header);
+    void codeRecords();
+    void codeSample(int16_t sample);
+    void flushZeroRun();
+    void putVarint(uint32_t value);
+    void putLE(uint32_t value, int bytes);
+};
+
+#endif // EDF_CODEC_H
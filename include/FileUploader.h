@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <FS.h>
+#include <set>
 #include <vector>
 #include "Config.h"
 #include "UploadStateManager.h"
@@ -10,24 +11,16 @@
 #include "ScheduleManager.h"
 #include "WiFiManager.h"
 #include "SDCardManager.h"
+#include "DatalogIndex.h"
+#include "DirectoryScanner.h"
 
 // Forward declaration to avoid circular dependency
 #ifdef ENABLE_TEST_WEBSERVER
 class TestWebServer;
 #endif
 
-// Include uploader implementations based on feature flags
-#ifdef ENABLE_SMB_UPLOAD
-#include "SMBUploader.h"
-#endif
-
-#ifdef ENABLE_WEBDAV_UPLOAD
-#include "WebDAVUploader.h"
-#endif
-
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-#include "SleepHQUploader.h"
-#endif
+// Backends are compiled in by feature flags and created by endpoint type
+#include "UploadBackend.h"
 
 class FileUploader {
 private:
@@ -47,26 +40,72 @@ private:
     // Helper method for periodic SD card release
     bool checkAndReleaseSD(class SDCardManager* sdManager);
     
-    // Uploader instances (only compiled if feature flag is enabled)
-#ifdef ENABLE_SMB_UPLOAD
-    SMBUploader* smbUploader;
-#endif
-#ifdef ENABLE_WEBDAV_UPLOAD
-    WebDAVUploader* webdavUploader;
-#endif
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-    SleepHQUploader* sleephqUploader;
-#endif
+    // Upload destinations: ENDPOINT first, then MIRROR_ENDPOINT if set.
+    // Each target keeps its own state file, so one that fails or runs
+    // behind does not hold back the others.
+    struct UploadTarget {
+        UploadBackend* backend;
+        UploadStateManager* state;
+        bool active;  // Usable for the rest of this session
+    };
+    std::vector<UploadTarget> targets;
+    
+    // Target the single-target upload code works on (see selectTarget())
+    UploadBackend* backend;
+    
+    void selectTarget(size_t index);
+    bool canShareRead(size_t index);
+    void dropTarget(fs::FS &sd, size_t index);
+    
+    // DATALOG folders on the card, refreshed once per session
+    DatalogIndex datalogIndex;
+    bool datalogIndexFresh;
+    bool refreshDatalogIndex(fs::FS &sd);
     
     // File scanning
     std::vector<String> scanDatalogFolders(fs::FS &sd);
-    std::vector<String> scanFolderFiles(fs::FS &sd, const String& folderPath);
+    bool scanFolderFiles(fs::FS &sd, const String& folderPath, std::vector<DirEntry>& files);
     std::vector<String> scanRootAndSettingsFiles(fs::FS &sd);
     
     // Upload logic
-    bool uploadDatalogFolder(class SDCardManager* sdManager, const String& folderName);
+    bool uploadDatalogFolder(class SDCardManager* sdManager, const String& folderName,
+                             const std::set<String>* sentFiles = nullptr);
+    bool uploadFolderArchive(fs::FS &sd, const String& folderName, class TarArchiveSource& archive);
+    bool uploadCompressedFile(fs::FS &sd, const String& localPath, const String& remotePath,
+                              unsigned long fileSize, unsigned long& bytesSent);
+    static bool isSignalEdfFile(const String& filePath);
     bool uploadSingleFile(class SDCardManager* sdManager, const String& filePath);
     
+    // Fan-out: one SD read of a file feeds several targets
+    bool pushFile(fs::FS &sd, const String& localPath, unsigned long fileSize,
+                  const std::vector<size_t>& receivers, std::vector<bool>& delivered,
+                  class Md5Digest* digest);
+    bool uploadDatalogFolderFanOut(class SDCardManager* sdManager, const String& folderName,
+                                   const std::vector<size_t>& group);
+    bool uploadSingleFileFanOut(class SDCardManager* sdManager, const String& filePath,
+                                const std::vector<size_t>& group);
+    
+    // Append-only uploads for growing files
+    bool isNightOpen(uint32_t date) const;
+    bool isAppendOnlyFile(const String& filePath) const;
+    bool hasRootFileChanged(fs::FS &sd, const String& filePath);
+    bool planStartOffset(fs::FS &sd, const String& filePath, unsigned long fileSize,
+                         unsigned long& startOffset, unsigned long& appendOffset);
+    unsigned long readEdfHeaderLength(fs::FS &sd, const String& filePath);
+    bool refreshAppendedHeader(fs::FS &sd, const String& localPath,
+                               const String& remotePath, unsigned long appendOffset);
+    
+    // Resumable uploads
+    static const unsigned long MIN_PARTIAL_UPLOAD_BYTES = 64 * 1024;  // Smallest budget-limited slice
+    bool supportsResume() const;
+    unsigned long planUploadBytes(unsigned long remainingBytes);
+    bool updateUploadCheckpoint(const String& filePath, unsigned long fileSize,
+                                unsigned long resumeOffset, unsigned long bytesTransferred,
+                                bool uploadSuccess);
+    
+    // Matching DATALOG folders against the server after the state was lost
+    bool reconcileWithRemote(class SDCardManager* sdManager, std::vector<String>& folders);
+    
     // Session management
     bool startUploadSession(fs::FS &sd);
     void endUploadSession(fs::FS &sd);
@@ -79,9 +118,11 @@ public:
     bool shouldUpload();
     bool uploadNewFiles(class SDCardManager* sdManager, bool forceUpload = false);
     bool scanPendingFolders(class SDCardManager* sdManager);  // Scan SD card without uploading
+    bool resetState(fs::FS &sd);  // Clear upload state, keeping uploader connections
+    void maintainConnections();   // Keepalive/idle handling for persistent sessions
     
     // Getters for internal components (for web interface access)
-    UploadStateManager* getStateManager() { return stateManager; }
+    UploadStateManager* getStateManager() { return targets.empty() ? nullptr : targets[0].state; }
     TimeBudgetManager* getBudgetManager() { return budgetManager; }
     ScheduleManager* getScheduleManager() { return scheduleManager; }
     
@@ -0,0 +1,116 @@
+#ifndef GZIP_SOURCE_H
+#define GZIP_SOURCE_H
+
+#include <Arduino.h>
+#include "UploadPipeline.h"
+#include "Crc32.h"
+
+// LZ77 window = 2^GZIP_WINDOW_BITS bytes. The compressor needs about
+// 6x the window in RAM (sliding buffer, hash heads and chain links):
+// 12 bits = 4KB window, ~24KB of heap while a file is compressed.
+#ifndef GZIP_WINDOW_BITS
+#define GZIP_WINDOW_BITS 12
+#endif
+
+// Match candidates tried per position. Higher finds longer matches at
+// more CPU per byte.
+#ifndef GZIP_MAX_CHAIN
+#define GZIP_MAX_CHAIN 16
+#endif
+
+/**
+ * GzipSource - Compresses another UploadSource into a gzip stream on the fly
+ *
+ * Sits between the SD read and the network write: the upload pipeline
+ * reads compressed bytes from here while this class pulls raw bytes from
+ * the wrapped source. Output is a single-member gzip file (RFC 1952)
+ * holding one deflate block with the fixed Huffman codes (RFC 1951),
+ * readable by gzip, zlib and Python.
+ *
+ * Matching is greedy LZ77 over a small window with hash chains, which
+ * keeps RAM and CPU low enough for the pico32. EDF signal data repeats
+ * sample patterns within a few KB, so most of the gain of full deflate
+ * remains.
+ *
+ * The compressed size is only known at the end: stream it with
+ * UploadPipeline::STREAM_TO_END.
+ */
+class GzipSource : public UploadSource {
+public:
+    static const size_t WINDOW_SIZE = (size_t)1 << GZIP_WINDOW_BITS;
+    static const size_t MIN_MATCH = 3;
+    static const size_t MAX_MATCH = 258;
+
+    /**
+     * @param input Raw data to compress
+     * @param inputSize Exact number of bytes to take from input
+     */
+    GzipSource(UploadSource& input, size_t inputSize);
+    ~GzipSource();
+
+    /**
+     * Allocate the compressor state
+     *
+     * @return false on low memory
+     */
+    bool begin();
+
+    /**
+     * Compressed bytes (returns 0 once the gzip trailer has been produced)
+     */
+    size_t read(uint8_t* buffer, size_t len) override;
+
+    /**
+     * True if the input ended early or begin() was not called
+     */
+    bool hasFailed() const { return failed; }
+
+    // Statistics
+    size_t getInputBytes() const { return inputConsumed; }   // Raw bytes compressed so far
+    size_t getOutputBytes() const { return outputProduced; } // Compressed bytes returned so far
+    uint32_t getInputCrc() const { return crc.getValue(); }  // CRC-32 of the raw data
+
+private:
+    static const size_t PENDING_SIZE = 512;
+    static const uint16_t NIL = 0xFFFF;
+
+    UploadSource& input;
+    size_t inputSize;
+    size_t inputConsumed;
+    size_t outputProduced;
+    Crc32 crc;
+
+    // Sliding window: the current position (strstart) always has at least
+    // MAX_MATCH bytes of lookahead until the input runs out
+    uint8_t* window;      // 2 * WINDOW_SIZE
+    uint16_t* head;       // Hash -> most recent position
+    uint16_t* prev;       // Position -> previous position with the same hash
+    size_t strstart;
+    size_t lookahead;
+
+    // Bit and byte output
+    uint32_t bitBuffer;
+    int bitCount;
+    uint8_t pending[PENDING_SIZE];
+    size_t pendingLength;
+    size_t pendingOffset;
+
+    bool headerWritten;
+    bool finished;
+    bool failed;
+
+    void fillWindow();
+    void insertHash(size_t pos);
+    size_t longestMatch(uint16_t candidate, size_t& matchDistance);
+    void compressStep();
+    void finish();
+
+    void putByte(uint8_t value);
+    void putBits(uint32_t value, int count);
+    void putReversed(uint32_t code, int length);
+    void putLiteral(uint8_t value);
+    void putMatch(size_t length, size_t distance);
+    void flushBits();
+};
+
+#endif // GZIP_SOURCE_H
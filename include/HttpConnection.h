@@ -0,0 +1,208 @@
+#ifndef HTTP_CONNECTION_H
+#define HTTP_CONNECTION_H
+
+#include <Arduino.h>
+#include "UploadPipeline.h"
+
+// Conditionally include the Arduino Client interface or the test mock
+#ifdef UNIT_TEST
+    #include "MockClient.h"
+#else
+    #include <Client.h>
+#endif
+
+// Receive buffer for status lines, headers and response bodies
+#ifndef HTTP_READ_BUFFER_SIZE
+#define HTTP_READ_BUFFER_SIZE 512
+#endif
+
+/**
+ * HttpConnection - Persistent HTTP/1.1 client connection for upload backends
+ *
+ * Keeps one keep-alive connection (plain TCP or TLS) open for a whole
+ * upload session, so the TCP and TLS handshakes are paid once instead of
+ * per request. Request bodies are written as they are produced (fixed
+ * Content-Length or chunked transfer encoding) and response bodies are
+ * handed to a callback as they arrive, so neither side is buffered whole.
+ *
+ * Request paths are absolute paths on the server (callers prepend
+ * getBasePath() where needed) and are percent-encoded here. Only Basic
+ * authentication is supported (Nextcloud and most WebDAV servers accept it
+ * with an app password).
+ *
+ * TLS server certificates are checked against the root CA bundle embedded
+ * in the firmware (data/cert/x509_crt_bundle.bin, see scripts/cert_bundle.py)
+ * unless the caller opts out with setInsecure().
+ */
+class HttpConnection {
+public:
+    // Pass as contentLength for a chunked request body
+    static const long CHUNKED = -1;
+
+    // Receives response body bytes as they arrive
+    typedef void (*BodyHandler)(const uint8_t* data, size_t len, void* context);
+
+    HttpConnection();
+    ~HttpConnection();
+
+    /**
+     * Set the server from a URL: http[s]://host[:port][/base/path]
+     *
+     * @return false if the URL cannot be parsed
+     */
+    bool setUrl(const String& url);
+
+    void setBasicAuth(const String& user, const String& password);
+    void setBearerToken(const String& token) { authorization = String("Bearer ") + token; }
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+    /**
+     * Skip the server certificate check (encrypted, but open to a
+     * man-in-the-middle; for self-signed servers on the home network)
+     */
+    void setInsecure(bool skipVerify) { insecure = skipVerify; }
+    bool isInsecure() const { return insecure; }
+
+    /**
+     * Use this transport instead of creating a WiFiClient/WiFiClientSecure
+     * (not owned; for tests)
+     */
+    void setClient(Client* transport);
+
+    const String& getHost() const { return host; }
+    uint16_t getPort() const { return port; }
+    bool isSecure() const { return secure; }
+    const String& getBasePath() const { return basePath; }
+
+    /**
+     * Absolute URL of a server path (for headers such as Destination)
+     */
+    String urlFor(const String& path) const;
+
+    /**
+     * Open the connection, or keep using the open one
+     *
+     * @return true if connected
+     */
+    bool connect();
+
+    /**
+     * True if the last connect() kept an already open connection (a
+     * request that fails on it may just have hit a server-side close)
+     */
+    bool wasReused() const { return reused; }
+
+    bool isOpen();
+    void close();
+
+    /**
+     * Send the request line and headers
+     *
+     * @param method HTTP method (PUT, MKCOL, PROPFIND, ...)
+     * @param path Absolute path on the server, not encoded (e.g. "/dav/DATALOG/x.edf")
+     * @param contentLength Body length, 0 for none, or CHUNKED
+     * @param headers Extra header lines, each ending in "\r\n"
+     * @return false if the connection failed (it is closed)
+     */
+    bool beginRequest(const char* method, const String& path, long contentLength,
+                      const String& headers = "");
+
+    /**
+     * Write request body bytes (framed as one chunk for chunked requests)
+     */
+    bool writeBody(const uint8_t* data, size_t len);
+
+    /**
+     * Finish the request body (writes the last chunk for chunked requests)
+     */
+    bool endRequest();
+
+    /**
+     * Read the response to the request just sent
+     * Skips interim 1xx responses. The connection is closed afterwards if
+     * the server asked for it or the response could not be read.
+     *
+     * @param handler Receives the body (nullptr = discard)
+     * @return HTTP status code, or -1 if no complete response arrived
+     */
+    int readResponse(BodyHandler handler = nullptr, void* context = nullptr);
+
+    /**
+     * Send a request with an in-memory body and read the response
+     * Retried once on a fresh connection if a reused one turns out closed.
+     *
+     * @return HTTP status code, or -1 on connection failure
+     */
+    int request(const char* method, const String& path, const String& headers = "",
+                const String& body = "", BodyHandler handler = nullptr, void* context = nullptr);
+
+    /**
+     * Keep the value of this response header (lowercase name) from the
+     * following responses; nullptr stops capturing
+     */
+    void captureHeader(const char* name) { capturedName = name; capturedValue = ""; }
+    const String& getCapturedHeader() const { return capturedValue; }
+
+    // Statistics (cumulative since construction)
+    unsigned long getConnectCount() const { return connectCount; }
+    unsigned long getRequestCount() const { return requestCount; }
+
+    /**
+     * Percent-encode a path (keeps '/' and RFC 3986 unreserved characters)
+     */
+    static String encodePath(const String& path);
+
+    static String base64Encode(const String& text);
+
+private:
+    Client* client;
+    bool ownsClient;
+    String host;
+    uint16_t port;
+    bool secure;
+    bool insecure;            // TLS without certificate check
+    String basePath;          // From the URL, no trailing slash ("" for the root)
+    String authorization;     // "Basic ..." or empty
+    unsigned long timeoutMs;
+    bool chunkedRequest;
+    bool reused;
+    const char* capturedName;
+    String capturedValue;
+
+    uint8_t readBuffer[HTTP_READ_BUFFER_SIZE];
+    size_t readPos;
+    size_t readLen;
+
+    unsigned long connectCount;
+    unsigned long requestCount;
+
+    bool writeAll(const uint8_t* data, size_t len);
+    bool fillBuffer();
+    bool readLine(String& line);
+    bool readBody(long length, HttpConnection::BodyHandler handler, void* context);
+    bool readChunkedBody(HttpConnection::BodyHandler handler, void* context);
+};
+
+/**
+ * HttpBodySink - Pipeline sink writing an HTTP request body
+ */
+class HttpBodySink : public UploadSink {
+public:
+    explicit HttpBodySink(HttpConnection& http) : http(http), written(0) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        if (!http.writeBody(data, len)) {
+            return false;
+        }
+        written += len;
+        return true;
+    }
+
+    unsigned long getWritten() const { return written; }
+
+private:
+    HttpConnection& http;
+    unsigned long written;
+};
+
+#endif // HTTP_CONNECTION_H
@@ -0,0 +1,83 @@
+#ifndef LOCAL_DIR_UPLOADER_H
+#define LOCAL_DIR_UPLOADER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "UploadBackend.h"
+
+#ifdef ENABLE_LOCAL_UPLOAD
+
+#include <stdio.h>
+
+class LocalFileSink;
+
+/**
+ * LocalDirUploader - Writes uploads into a directory of the host filesystem
+ *
+ * ENDPOINT_TYPE "LOCAL" with ENDPOINT set to a directory path. Meant for
+ * the native build: a whole FileUploader session runs on Linux against a
+ * plain directory, through the same UploadPipeline, resume, append,
+ * archive and compression paths the SMB backend takes, so end-to-end
+ * throughput can be measured without a share or a network.
+ *
+ * Uses POSIX file calls only; remote paths map to <ENDPOINT><remotePath>.
+ */
+class LocalDirUploader : public UploadBackend {
+public:
+    explicit LocalDirUploader(const String& directory);
+    ~LocalDirUploader();
+
+    static UploadBackend* create(const Config& config, const EndpointConfig& endpoint);  // ENDPOINT_TYPE "LOCAL"
+
+    const char* getName() const override { return "Local"; }
+    bool supportsResume() const override { return true; }
+    bool supportsStreams() const override { return true; }
+    bool supportsListing() const override { return true; }
+    bool supportsPush() const override { return true; }
+
+    /**
+     * Create the target directory if needed
+     */
+    bool ensureConnected() override;
+    bool isConnected() const override { return connected; }
+    void end() override;
+
+    bool uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                    const String& remotePath, unsigned long& bytesTransferred,
+                    unsigned long startOffset = 0, unsigned long maxBytes = 0) override;
+    bool uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                      unsigned long& bytesTransferred) override;
+    UploadSink* beginFile(const String& remotePath, size_t totalBytes) override;
+    bool finishFile(bool complete) override;
+    bool patchRange(const String& localPath, const String& remotePath, fs::FS &sd,
+                    unsigned long offset, unsigned long length) override;
+    bool listDirectory(const String& path, std::map<String, unsigned long>& files,
+                       std::set<String>* subdirs = nullptr) override;
+
+    String getLastChecksum() const override { return lastChecksum; }
+    void logSessionStats() override;
+
+    // Statistics (cumulative since construction)
+    unsigned long getFilesWritten() const { return filesWritten; }
+    unsigned long getBytesWritten() const { return bytesWritten; }
+
+private:
+    String baseDir;
+    bool connected;
+    String lastChecksum;
+    unsigned long filesWritten;
+    unsigned long bytesWritten;
+
+    // File pushed through beginFile()/finishFile() (nullptr = none)
+    FILE* pushFile;
+    LocalFileSink* pushSink;
+    size_t pushSize;
+    String pushTarget;
+
+    String buildPath(const String& remotePath) const;
+    bool createParentDirectories(const String& path);
+};
+
+#endif // ENABLE_LOCAL_UPLOAD
+
+#endif // LOCAL_DIR_UPLOADER_H
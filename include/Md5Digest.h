@@ -0,0 +1,49 @@
+#ifndef MD5_DIGEST_H
+#define MD5_DIGEST_H
+
+#include <Arduino.h>
+
+#ifdef UNIT_TEST
+#include "MockMD5.h"
+#else
+#include "esp32/rom/md5_hash.h"
+#endif
+
+/**
+ * Md5Digest - Incremental MD5 over a byte stream
+ *
+ * Thin wrapper around the ESP32 ROM MD5 routines so the same hash can be
+ * computed in a standalone read loop (UploadStateManager) or inline while
+ * a file is streamed to the network (UploadPipeline).
+ */
+class Md5Digest {
+public:
+    Md5Digest() { begin(); }
+
+    void begin() {
+        MD5Init(&ctx);
+        bytes = 0;
+    }
+
+    void update(const uint8_t* data, size_t len) {
+        MD5Update(&ctx, data, len);
+        bytes += len;
+    }
+
+    /**
+     * Bytes hashed since begin()
+     */
+    unsigned long getBytes() const { return bytes; }
+
+    /**
+     * Finish the hash and return it as 32 lowercase hex characters
+     * The digest must be restarted with begin() before reuse.
+     */
+    String finishHex();
+
+private:
+    struct MD5Context ctx;
+    unsigned long bytes;
+};
+
+#endif // MD5_DIGEST_H
@@ -4,6 +4,11 @@
 #include <Arduino.h>
 #include <FS.h>
 
+// VFS path the card is mounted at; POSIX calls on card paths use it as prefix
+#ifndef SD_MOUNT_POINT
+#define SD_MOUNT_POINT "/sdcard"
+#endif
+
 class SDCardManager {
 private:
     bool initialized;
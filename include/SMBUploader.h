@@ -3,12 +3,30 @@
 
 #include <Arduino.h>
 #include <FS.h>
+#include <map>
+#include <set>
+#include "ChunkSizeTuner.h"
+#include "UploadBackend.h"
+
+class UploadSource;
+class Md5Digest;
 
 #ifdef ENABLE_SMB_UPLOAD
 
+// Upper bound for the async write window (each slot holds one pipeline chunk)
+#define SMB_MAX_WRITE_WINDOW 8
+
+// Files up to this size are sent as one CREATE+WRITE+CLOSE compound request,
+// one round trip instead of three or more (0 = never)
+#ifndef SMB_COMPOUND_MAX_SIZE
+#define SMB_COMPOUND_MAX_SIZE 65536
+#endif
+
 // Forward declarations for libsmb2 types to avoid including headers here
 struct smb2_context;
 struct smb2fh;
+class SMBWriteSink;
+class SMBAsyncWriteSink;
 
 /**
  * SMBUploader - Handles file uploads to SMB/CIFS shares
@@ -31,7 +49,7 @@ struct smb2fh;
  * 
  * Requirements: 10.1, 10.2, 10.3
  */
-class SMBUploader {
+class SMBUploader : public UploadBackend {
 private:
     String smbServer;      // Server hostname or IP
     String smbShare;       // Share name
@@ -41,6 +59,33 @@ private:
     
     struct smb2_context* smb2;  // libsmb2 context
     bool connected;
+    int writeWindow;            // Outstanding async writes per file (1 = synchronous)
+    ChunkSizeTuner chunkTuner;  // Transfer chunk size (ceiling set on connect, tuned per upload)
+    String lastChecksum;        // MD5 of the last whole-file upload (empty otherwise)
+    
+    // Session reuse
+    unsigned long keepaliveIntervalMs;  // Echo after this much silence (0 = disabled)
+    unsigned long idleTimeoutMs;        // Close after this long without uploads (0 = never)
+    unsigned long lastTrafficTime;      // Last request of any kind (including echo)
+    unsigned long lastActivityTime;     // Last upload or directory operation
+    unsigned long reconnectCount;       // Sessions re-established after a failed echo
+    
+    // Remote directories confirmed to exist on the current connection
+    // (paths relative to share root, no leading slash). Cleared on connect,
+    // disconnect and whenever the server reports a missing path.
+    std::set<String> knownDirectories;
+    unsigned long dirCacheHits;
+    unsigned long dirCacheMisses;
+    
+    // Small files sent as one compound request (see SMB_COMPOUND_MAX_SIZE)
+    bool compoundEnabled;              // Cleared for the session if the server refuses one
+    unsigned long compoundUploads;
+    
+    // File pushed through beginFile()/finishFile() (nullptr = none)
+    struct smb2fh* pushFile;
+    SMBWriteSink* pushSink;
+    SMBAsyncWriteSink* pushAsyncSink;
+    size_t pushSize;
     
     /**
      * Parse SMB endpoint string into server and share components
@@ -66,6 +111,87 @@ private:
      * Close SMB connection and cleanup resources
      */
     void disconnect();
+    
+    /**
+     * Map a share-relative path to the libsmb2 path (base path, no leading slash)
+     */
+    String buildRemotePath(const String& remotePath) const;
+    
+    /**
+     * Open a remote file, creating its parent directories first
+     * Retries once with a cleared directory cache if the parent vanished.
+     * 
+     * @param fullRemotePath Path from buildRemotePath()
+     * @param flags smb2_open flags
+     * @return File handle, or nullptr on error (logged)
+     */
+    struct smb2fh* openRemoteFile(const String& fullRemotePath, int flags);
+    
+    /**
+     * Outcome of uploadSmallFile()
+     */
+    enum SmallFileResult {
+        SMALL_FILE_SENT,      // Written and closed
+        SMALL_FILE_FAILED,    // Local read error or connection lost
+        SMALL_FILE_FALLBACK   // Not sent, use the regular open/write/close path
+    };
+    
+    /**
+     * Largest file upload() sends with uploadSmallFile() (0 = none)
+     * Bounded by the server's max write size and a buffer pool slot.
+     */
+    size_t compoundLimit() const;
+    
+    /**
+     * Create (truncating), write and close a remote file with one SMB2
+     * compound request. A broken connection is dropped.
+     * 
+     * @param fullRemotePath Path from buildRemotePath()
+     * @param ntStatus Output: first failing NT status (0 = success)
+     * @return true if the server accepted all three commands
+     */
+    bool writeCompound(const String& fullRemotePath, const uint8_t* data, size_t len,
+                       uint32_t& ntStatus);
+    
+    /**
+     * Read a whole small file from the SD card and send it with
+     * writeCompound(), creating parent directories first
+     * Retries once with a cleared directory cache if the parent vanished.
+     * 
+     * @param digest Output: MD5 of the file
+     */
+    SmallFileResult uploadSmallFile(fs::File& localFile, const String& fullRemotePath, size_t fileSize,
+                                    Md5Digest& digest);
+    
+    /**
+     * Stream bytes from a source into an open remote file through the
+     * upload pipeline, with async writes when the window allows, and feed
+     * the measured throughput to the chunk size tuner.
+     * If the connection breaks the session is torn down, which also
+     * releases remoteFile; otherwise the caller closes it.
+     * 
+     * @param fileSize Final size of the remote file (0 = unknown, for progress logs)
+     * @param startOffset Remote offset of the first byte (file already positioned)
+     * @param digest Hash of the bytes read (nullptr = none)
+     * @param connectionBroken Output: session was dropped
+     * @return true if all bytesToSend bytes were written
+     */
+    bool writeStream(UploadSource& source, struct smb2fh* remoteFile, uint64_t fileSize,
+                     unsigned long startOffset, size_t bytesToSend, Md5Digest* digest,
+                     unsigned long& bytesTransferred, unsigned long& elapsedMs,
+                     bool& connectionBroken);
+    
+    /**
+     * Send an SMB2 ECHO to check the session is still alive
+     * 
+     * @return true if the server answered, false if the session is dead
+     */
+    bool sendKeepalive();
+    
+    /**
+     * Record real work on the session (resets the idle timeout)
+     */
+    void markActivity();
 
 public:
     /**
@@ -82,6 +208,18 @@ public:
      */
     ~SMBUploader();
     
+    /**
+     * Factory for UploadBackendRegistry (ENDPOINT_TYPE "SMB")
+     * The session is not opened here; WiFi may not be up yet.
+     */
+    static UploadBackend* create(const Config& config, const EndpointConfig& endpoint);
+    
+    const char* getName() const override { return "SMB"; }
+    bool supportsResume() const override { return true; }
+    bool supportsStreams() const override { return true; }
+    bool supportsListing() const override { return true; }
+    bool supportsPush() const override { return true; }
+    
     /**
      * Initialize SMB uploader and establish connection
      * 
@@ -89,6 +227,33 @@ public:
      */
     bool begin();
     
+    /**
+     * Make sure a usable session exists before an upload
+     * Reuses the current session when possible. If the session has been
+     * silent longer than the keepalive interval it is probed with an echo
+     * first, and re-established transparently if the echo fails.
+     * 
+     * @return true if connected, false if the share is unreachable
+     */
+    bool ensureConnected() override;
+    
+    /**
+     * Idle housekeeping, call periodically from the main loop
+     * Sends a keepalive echo when the session has been silent for the
+     * keepalive interval and closes it once the idle timeout expires.
+     * A failed echo drops the session; the next ensureConnected()
+     * reconnects.
+     */
+    void maintain() override;
+    
+    /**
+     * Configure session reuse
+     * 
+     * @param keepaliveSeconds Echo interval while idle (0 = disabled)
+     * @param idleTimeoutSeconds Close session after this long without uploads (0 = never)
+     */
+    void setKeepalive(unsigned long keepaliveSeconds, unsigned long idleTimeoutSeconds);
+    
     /**
      * Create directory on SMB share (creates parent directories as needed)
      * 
@@ -97,6 +262,18 @@ public:
      */
     bool createDirectory(const String& path);
     
+    /**
+     * List a remote directory with one SMB2 QUERY_DIRECTORY exchange
+     * A directory that does not exist is reported as empty, not as an error.
+     * 
+     * @param path Directory path (e.g., "/DATALOG/20241101")
+     * @param files Output: file name -> size in bytes
+     * @param subdirs Output: subdirectory names (nullptr = not needed)
+     * @return true if listed (or absent), false on connection or server error
+     */
+    bool listDirectory(const String& path, std::map<String, unsigned long>& files,
+                       std::set<String>* subdirs = nullptr) override;
+    
     /**
      * Upload a file from SD card to SMB share
      * Automatically creates parent directories if needed
@@ -104,23 +281,101 @@ public:
      * @param localPath Path to file on SD card (e.g., "/DATALOG/20241101/file.edf")
      * @param remotePath Path on SMB share (e.g., "/DATALOG/20241101/file.edf")
      * @param sd Reference to SD card filesystem
-     * @param bytesTransferred Output parameter for bytes transferred (for rate calculation)
-     * @return true if upload successful, false otherwise
+     * @param bytesTransferred Output parameter for bytes transferred (for rate calculation).
+     *        On failure this is the contiguous prefix the server acknowledged, so
+     *        startOffset + bytesTransferred is a safe resume point.
+     * @param startOffset Resume at this byte offset. The remote file is opened
+     *        without truncation and must already be at least this long,
+     *        otherwise the upload restarts from 0.
+     * @param maxBytes Send at most this many bytes (0 = rest of file), for
+     *        budget-limited partial uploads
+     * @return true if the requested range was written, false otherwise
+     */
+    bool uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                    const String& remotePath, unsigned long& bytesTransferred,
+                    unsigned long startOffset = 0, unsigned long maxBytes = 0) override;
+    
+    /**
+     * Upload a generated byte stream (e.g. a folder archive) as one remote file
+     * The remote file is always rewritten from the start.
+     * 
+     * @param source Stream to send
+     * @param totalBytes Exact number of bytes the source produces, or
+     *        UploadPipeline::STREAM_TO_END if only the source knows (e.g. gzip)
+     * @param remotePath Path on SMB share (e.g., "/DATALOG/20241101.tar")
+     * @param bytesTransferred Output: bytes written
+     * @return true if the whole stream was written
+     */
+    bool uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                      unsigned long& bytesTransferred) override;
+    
+    /**
+     * Open a remote file (truncated) for data pushed by the caller
+     * Writes go through the async window like upload().
+     * 
+     * @return Sink for exactly totalBytes, or nullptr if the file cannot be opened
+     */
+    UploadSink* beginFile(const String& remotePath, size_t totalBytes) override;
+    bool finishFile(bool complete) override;
+    
+    /**
+     * Overwrite a byte range of an existing remote file with local data
+     * Used to refresh headers that change in place when a file is appended
+     * to (e.g. the EDF record count). Never creates or truncates the file.
+     * 
+     * @param localPath Path to file on SD card
+     * @param remotePath Path on SMB share
+     * @param sd Reference to SD card filesystem
+     * @param offset First byte to rewrite
+     * @param length Number of bytes to rewrite
+     * @return true if the range was written, false if the remote file is
+     *         missing or too short (caller should fall back to a full upload)
+     */
+    bool patchRange(const String& localPath, const String& remotePath, fs::FS &sd,
+                    unsigned long offset, unsigned long length) override;
+    
+    /**
+     * Set the number of writes kept in flight per file
+     * 1 uses synchronous smb2_write; larger values pipeline writes with
+     * smb2_pwrite_async so the link round trip is not paid per chunk.
+     * 
+     * @param window Outstanding writes (clamped to 1..SMB_MAX_WRITE_WINDOW)
      */
-    bool upload(const String& localPath, const String& remotePath, 
-                fs::FS &sd, unsigned long& bytesTransferred);
+    void setWriteWindow(int window);
     
     /**
      * Cleanup and disconnect
      */
-    void end();
+    void end() override;
+    
+    /**
+     * Directory cache statistics (cumulative since construction)
+     * A hit is a createDirectory() call answered without a round trip.
+     */
+    unsigned long getDirCacheHits() const { return dirCacheHits; }
+    unsigned long getDirCacheMisses() const { return dirCacheMisses; }
+    void logSessionStats() override;
+    
+    /**
+     * Chunk size the next upload will use (bytes)
+     */
+    size_t getChunkSize() const { return chunkTuner.getChunkSize(); }
+    
+    /**
+     * MD5 of the file sent by the last upload() call, hashed inline from
+     * the same reads that fed the network
+     * 
+     * @return 32 hex characters, or empty if the last upload failed or
+     *         only sent part of the file (resume, append, budget limit)
+     */
+    String getLastChecksum() const override { return lastChecksum; }
     
     /**
      * Check if currently connected to SMB share
      * 
      * @return true if connected, false otherwise
      */
-    bool isConnected() const;
+    bool isConnected() const override;
 };
 
 #endif // ENABLE_SMB_UPLOAD
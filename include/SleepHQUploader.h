@@ -3,49 +3,134 @@
 
 #include <Arduino.h>
 #include <FS.h>
+#include "UploadBackend.h"
+#include "HttpConnection.h"
 
 #ifdef ENABLE_SLEEPHQ_UPLOAD
 
+class SleepHQFileSink;
+
+// API host used when ENDPOINT is empty
+#define SLEEPHQ_DEFAULT_ENDPOINT "https://sleephq.com"
+
 /**
  * SleepHQUploader - Handles direct file uploads to SleepHQ service
- * 
- * TODO: Implementation pending
- * 
- * This uploader will support direct upload to the SleepHQ cloud service
- * for CPAP data analysis and tracking.
- * 
- * Planned features:
- * - HTTPS API integration
- * - OAuth or API key authentication
- * - Automatic file format detection
- * - Metadata extraction and submission
- * - Upload progress tracking
- * - Retry logic for failed uploads
- * 
+ *
+ * Sends CPAP data straight to the SleepHQ import API, where it is
+ * analysed like a card uploaded from the web site.
+ *
+ * - OAuth client credentials: ENDPOINT_USER is the client ID and
+ *   ENDPOINT_PASS the client secret from the SleepHQ account settings
+ * - One import per night: the files of a DATALOG folder are added to one
+ *   import, which is processed when the folder is done (commitBatch()).
+ *   Root and SETTINGS files go in one import at the end of the session.
+ * - Each file is one multipart POST whose body is streamed from the SD
+ *   card through the UploadPipeline (never buffered whole)
+ * - All requests of a session share one keep-alive TLS connection, so the
+ *   handshake (slow RSA/ECDHE on the ESP32) is paid once per session
+ *
+ * ENDPOINT overrides the API host (e.g. a local mock server, see
+ * tools/sleephq_mock). The server certificate is not verified.
+ *
  * Requirements: 10.7
  */
-class SleepHQUploader {
+class SleepHQUploader : public UploadBackend {
 private:
-    String apiEndpoint;    // SleepHQ API endpoint
-    String apiKey;         // API key or OAuth token
-    String userId;         // User ID for SleepHQ account
-    bool authenticated;
-    
-    bool parseEndpoint(const String& endpoint);
+    HttpConnection http;
+    String clientId;
+    String clientSecret;
+    bool configured;             // ENDPOINT parsed
+    bool authenticated;          // Token and team known
+    String teamId;
+    unsigned long tokenTime;     // millis() when the token was issued
+    unsigned long tokenLifetimeMs;
+
+    String importId;             // Open import (empty = none)
+    unsigned long importFiles;   // Files added to the open import
+    String lastChecksum;         // MD5 of the last uploaded file
+
+    // File POST in progress (beginPost() to finishPost())
+    SleepHQFileSink* pushSink;
+    size_t pushSize;
+    String pushName;
+    String pushPath;
+
+    // Statistics (cumulative since construction)
+    unsigned long importCount;
+    unsigned long fileCount;
+
+    String apiPath(const String& path) const { return http.getBasePath() + path; }
+
     bool authenticate();
-    void disconnect();
+    bool ensureToken();
+
+    /**
+     * Create the import files are added to, unless one is open
+     */
+    bool ensureImport();
+
+    /**
+     * Start the multipart POST of one file to the open import: send the
+     * headers and the form fields before the file data
+     *
+     * @return false if the request could not be started
+     */
+    bool beginPost(const String& remotePath, size_t fileSize);
+
+    /**
+     * Send the content hash after the file data and read the response
+     *
+     * @param complete All file data went into pushSink (false = abandon)
+     * @return HTTP status, or -1 if the request failed
+     */
+    int finishPost(bool complete);
+
+    /**
+     * POST one file to the open import as a streamed multipart body
+     *
+     * @return HTTP status, or -1 if the request failed
+     */
+    int postFile(fs::File& file, size_t fileSize, const String& remotePath,
+                 unsigned long& bytesTransferred);
+
+    /**
+     * Count an added file, or drop the import that misses it
+     */
+    bool recordPost(int status, const String& remotePath, size_t fileSize);
 
 public:
     SleepHQUploader(const String& endpoint, const String& user, const String& apiKey);
     ~SleepHQUploader();
-    
+
+    static UploadBackend* create(const Config& config, const EndpointConfig& endpoint);  // ENDPOINT_TYPE "SLEEPHQ"
+    const char* getName() const override { return "SleepHQ"; }
+    bool supportsBatches() const override { return true; }
+    bool supportsPush() const override { return true; }
+
+    /**
+     * Connect, obtain an access token and look up the account's team
+     */
     bool begin();
-    bool upload(const String& localPath, const String& remotePath, 
-                fs::FS &sd, unsigned long& bytesTransferred);
-    void end();
-    bool isConnected() const;
-    
-    // Note: SleepHQ may not need createDirectory as it manages its own structure
+    bool ensureConnected() override;
+    bool uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                    const String& remotePath, unsigned long& bytesTransferred,
+                    unsigned long startOffset = 0, unsigned long maxBytes = 0) override;
+    UploadSink* beginFile(const String& remotePath, size_t totalBytes) override;
+    bool finishFile(bool complete) override;
+    bool commitBatch() override;
+    void end() override;
+    bool isConnected() const override;
+
+    String getLastChecksum() const override { return lastChecksum; }
+    void logSessionStats() override;
+
+    /**
+     * Use this transport instead of WiFiClientSecure (for tests)
+     */
+    void setClient(Client* transport) { http.setClient(transport); }
+
+    unsigned long getConnectCount() const { return http.getConnectCount(); }
+    unsigned long getImportCount() const { return importCount; }
 };
 
 #endif // ENABLE_SLEEPHQ_UPLOAD
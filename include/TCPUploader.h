@@ -0,0 +1,193 @@
+#ifndef TCP_UPLOADER_H
+#define TCP_UPLOADER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <deque>
+#include "UploadBackend.h"
+#include "Crc32.h"
+
+// Conditionally include the Arduino Client interface or the test mock
+#ifdef UNIT_TEST
+    #include "MockClient.h"
+#else
+    #include <Client.h>
+#endif
+
+#ifdef ENABLE_TCP_UPLOAD
+
+class TCPFrameSink;
+
+// Port used when ENDPOINT has none (tools/tcp_receiver default)
+#ifndef TCP_DEFAULT_PORT
+#define TCP_DEFAULT_PORT 7878
+#endif
+
+// Files sent whose acknowledgement has not been read yet. When the window
+// is full the next file waits for the oldest ack.
+#ifndef TCP_UPLOAD_WINDOW
+#define TCP_UPLOAD_WINDOW 8
+#endif
+
+// Data chunks written per frame; larger writes are split
+#ifndef TCP_MAX_CHUNK
+#define TCP_MAX_CHUNK 16384
+#endif
+
+/**
+ * TCPUploader - Uploads over the framed CPAP TCP protocol
+ *
+ * For setups that can run tools/tcp_receiver on a Linux machine. The
+ * protocol has none of the per-file overhead of SMB or HTTP: a file is one
+ * header frame, its data in length-prefixed chunks and a CRC-32 trailer,
+ * and the receiver answers with one ack per file. All integers are
+ * little-endian.
+ *
+ *   hello   C->S  "CPAP" u8 version, u16 token length, token
+ *           S->C  "CPAP" u8 version, u8 status (0 ok, 1 bad token)
+ *   file    C->S  'F' u32 seq, u16 path length, path, u64 size (~0 = unknown)
+ *                 { u32 length, data }... u32 0, u32 crc32 of the data
+ *   ack     S->C  'A' u32 seq, u8 status (TCPAckStatus), u64 bytes written
+ *
+ * - One connection carries the whole session
+ * - Files are pipelined: upload() returns once the file is on the wire
+ *   and up to TCP_UPLOAD_WINDOW files may wait for their ack, so there is
+ *   no round trip per file. commitBatch() collects the outstanding acks;
+ *   a folder only counts as uploaded once every file in it was acked.
+ * - Any failure (nack, timeout, closed connection) drops the connection
+ *   and every unacked file with it; the next ensureConnected() starts a
+ *   fresh session
+ *
+ * ENDPOINT is host[:port] (tcp:// prefix optional), ENDPOINT_PASS the
+ * token the receiver was started with. Nothing is encrypted: use it on a
+ * trusted network only.
+ */
+class TCPUploader : public UploadBackend {
+    friend class TCPFrameSink;
+
+public:
+    static const uint8_t PROTOCOL_VERSION = 1;
+
+    enum TCPAckStatus {
+        ACK_OK = 0,
+        ACK_CRC_MISMATCH = 1,
+        ACK_WRITE_ERROR = 2,
+        ACK_BAD_REQUEST = 3    // Path rejected or size mismatch
+    };
+
+private:
+    Client* client;
+    bool ownsClient;
+    String host;
+    uint16_t port;
+    String token;
+    bool configured;           // ENDPOINT parsed
+    bool connected;            // Hello accepted
+    unsigned long timeoutMs;
+
+    uint32_t nextSeq;
+    std::deque<uint32_t> unacked;  // Sequence numbers sent, oldest first
+    bool batchFailed;              // A file since the last commit was lost or refused
+
+    String lastChecksum;           // MD5 of the last whole-file upload
+
+    // File whose data the caller pushes (beginFile() to finishFile())
+    TCPFrameSink* pushSink;
+    size_t pushSize;
+
+    // Statistics (cumulative since construction)
+    unsigned long connectCount;
+    unsigned long fileCount;
+    unsigned long long byteCount;
+    size_t maxUnacked;
+
+    bool writeAll(const uint8_t* data, size_t len);
+    bool readExact(uint8_t* data, size_t len);
+
+    /**
+     * Drop the connection and every file still waiting for its ack
+     */
+    void disconnect();
+
+    /**
+     * Read one ack (blocking up to timeoutMs)
+     *
+     * @return false if no valid ack arrived (the connection is dropped)
+     */
+    bool readAck();
+
+    /**
+     * Read the acks that have already arrived, without waiting
+     */
+    bool pollAcks();
+
+    /**
+     * Read acks until at most `limit` files are outstanding
+     *
+     * @return false on a nack or a transport failure
+     */
+    bool drainAcks(size_t limit);
+
+    /**
+     * Wait for window space and send the header frame of a file
+     *
+     * @param totalBytes File size, or UploadPipeline::STREAM_TO_END
+     * @return Sink for the file data, or nullptr on failure
+     */
+    TCPFrameSink* beginFrame(const String& remotePath, size_t totalBytes);
+
+    /**
+     * Send the end marker and CRC trailer of the open frame
+     *
+     * @param complete All data went into the sink (false = abandon the file)
+     */
+    bool finishFrame(TCPFrameSink* sink, size_t totalBytes, bool complete);
+
+public:
+    TCPUploader(const String& endpoint, const String& token);
+    ~TCPUploader();
+
+    static UploadBackend* create(const Config& config, const EndpointConfig& endpoint);  // ENDPOINT_TYPE "TCP"
+    const char* getName() const override { return "TCP"; }
+    bool supportsStreams() const override { return true; }
+    bool supportsPush() const override { return true; }
+    bool supportsBatches() const override { return true; }
+
+    /**
+     * Connect and exchange the hello
+     */
+    bool begin();
+    bool ensureConnected() override;
+    void end() override;
+    bool isConnected() const override;
+
+    bool uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                    const String& remotePath, unsigned long& bytesTransferred,
+                    unsigned long startOffset = 0, unsigned long maxBytes = 0) override;
+    bool uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                      unsigned long& bytesTransferred) override;
+    UploadSink* beginFile(const String& remotePath, size_t totalBytes) override;
+    bool finishFile(bool complete) override;
+    bool commitBatch() override;
+
+    String getLastChecksum() const override { return lastChecksum; }
+    void logSessionStats() override;
+
+    /**
+     * Use this transport instead of a WiFiClient (not owned; for tests)
+     */
+    void setClient(Client* transport);
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+    const String& getHost() const { return host; }
+    uint16_t getPort() const { return port; }
+    size_t getUnackedCount() const { return unacked.size(); }
+
+    unsigned long getConnectCount() const { return connectCount; }
+    unsigned long getFileCount() const { return fileCount; }
+    size_t getMaxUnacked() const { return maxUnacked; }  // Peak files in flight
+};
+
+#endif // ENABLE_TCP_UPLOAD
+
+#endif // TCP_UPLOADER_H
@@ -0,0 +1,118 @@
+#ifndef TAR_ARCHIVE_SOURCE_H
+#define TAR_ARCHIVE_SOURCE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+#include "UploadPipeline.h"
+
+/**
+ * TarArchiveSource - Streams a set of SD card files as one ustar archive
+ *
+ * The archive is built while it is read. Each 512-byte header is formatted
+ * just before its file, and file data is read straight from the SD card
+ * into the caller's buffer. Nothing is staged on the card or held in RAM
+ * beyond one header block, so a whole DATALOG night folder can go out as
+ * one remote file. This costs one SMB open/close instead of one per file.
+ *
+ * Layout (POSIX ustar, readable by tar, 7-Zip and Python's tarfile):
+ *   for each file: 512-byte header, data, zero padding to 512 bytes
+ *   end of archive: two 512-byte zero blocks
+ *
+ * The archive size is fixed when files are added, so the sizes recorded
+ * then are the sizes streamed. A file that grows in the meantime is cut
+ * at the recorded size. A file that shrinks makes read() fail.
+ */
+class TarArchiveSource : public UploadSource {
+public:
+    static const size_t BLOCK_SIZE = 512;
+    static const size_t MAX_NAME_LENGTH = 99;  // ustar name field, NUL-terminated
+
+    /**
+     * @param sd File system holding the files
+     * @param folderPath Folder on the SD card (e.g. "/DATALOG/20241101")
+     * @param archiveDir Directory name stored in the archive (e.g. "20241101")
+     */
+    TarArchiveSource(fs::FS &sd, const String& folderPath, const String& archiveDir);
+    ~TarArchiveSource();
+
+    /**
+     * Add a file from the folder and record its size and timestamp
+     *
+     * @param fileName File name inside the folder
+     * @return false if the file cannot be opened or its name is too long
+     */
+    bool addFile(const String& fileName);
+
+    /**
+     * Add a file whose size and timestamp the caller already has (from a
+     * directory scan), without opening it
+     *
+     * @return false if the name is too long
+     */
+    bool addFile(const String& fileName, unsigned long size, time_t lastWrite);
+
+    int getFileCount() const { return entries.size(); }
+    unsigned long getDataBytes() const { return dataBytes; }  // File content only
+
+    /**
+     * Total archive size in bytes (headers, data, padding and end blocks)
+     */
+    size_t getArchiveSize() const;
+
+    /**
+     * Archive size for files of the given sizes (without opening anything)
+     */
+    static size_t archiveSizeFor(const std::vector<unsigned long>& fileSizes);
+
+    size_t read(uint8_t* buffer, size_t len) override;
+
+    /**
+     * True once a file could not be opened or returned fewer bytes than recorded
+     */
+    bool hasFailed() const { return failed; }
+
+    /**
+     * Write a ustar header block for one regular file
+     *
+     * @param block Destination, BLOCK_SIZE bytes
+     * @return false if the name does not fit
+     */
+    static bool formatHeader(uint8_t* block, const char* name, unsigned long size, time_t lastWrite);
+
+private:
+    struct Entry {
+        String name;          // File name inside the folder
+        unsigned long size;
+        time_t lastWrite;
+    };
+
+    enum Phase {
+        PHASE_HEADER,
+        PHASE_DATA,
+        PHASE_PADDING,
+        PHASE_TRAILER,
+        PHASE_DONE
+    };
+
+    fs::FS& sd;
+    String folderPath;
+    String archiveDir;
+    std::vector<Entry> entries;
+    unsigned long dataBytes;
+
+    // Stream position
+    size_t entryIndex;
+    Phase phase;
+    size_t phaseOffset;   // Bytes of the current phase already produced
+    size_t phaseLength;   // Bytes the current phase produces
+    uint8_t header[BLOCK_SIZE];
+    fs::File current;
+    bool failed;
+
+    static size_t paddingFor(unsigned long size);
+    void enterEntry();
+    void closeCurrent();
+};
+
+#endif // TAR_ARCHIVE_SOURCE_H
@@ -40,7 +40,6 @@ private:
     String getCurrentTimeString();
     int getPendingFilesCount();
     int getPendingFoldersCount();
-    String escapeJson(const String& str);
 
 public:
     TestWebServer(Config* cfg, UploadStateManager* state, 
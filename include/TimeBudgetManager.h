@@ -27,8 +27,16 @@ private:
     int rateHistoryIndex;
     int rateHistoryCount;
     
+    // Effective rate of compressed uploads in raw (uncompressed) bytes per
+    // second. It folds in both the compression ratio and the CPU cost of
+    // compressing, so budget checks can keep using file sizes from the SD card.
+    unsigned long compressedRateHistory[RATE_HISTORY_SIZE];
+    int compressedRateIndex;
+    int compressedRateCount;
+    
     void updateTransmissionRate(unsigned long bytesTransferred, unsigned long elapsedMs);
     unsigned long calculateAverageRate();
+    static unsigned long estimateTimeMs(unsigned long bytes, unsigned long rateBytesPerSec);
 
 public:
     TimeBudgetManager();
@@ -49,11 +57,18 @@ public:
     // Upload time estimation
     unsigned long estimateUploadTimeMs(unsigned long fileSize);
     bool canUploadFile(unsigned long fileSize);
+    unsigned long estimateBytesInRemainingBudget();  // Bytes that fit in the remaining budget
     
     // Transmission rate tracking
     void recordUpload(unsigned long fileSize, unsigned long elapsedMs);
     unsigned long getTransmissionRate();  // Get current rate in bytes/sec
     
+    // Compressed uploads (sizes are raw bytes read from the SD card)
+    void recordCompressedUpload(unsigned long rawBytes, unsigned long elapsedMs);
+    unsigned long getCompressedRate();  // Raw bytes/sec; link rate until measured
+    unsigned long estimateCompressedUploadTimeMs(unsigned long fileSize);
+    bool canUploadCompressed(unsigned long fileSize);
+    
     // Wait time calculation
     unsigned long getWaitTimeMs();
 };
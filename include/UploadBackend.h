@@ -0,0 +1,242 @@
+#ifndef UPLOAD_BACKEND_H
+#define UPLOAD_BACKEND_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <map>
+#include <set>
+#include <vector>
+
+class Config;
+struct EndpointConfig;
+class UploadSource;
+class UploadSink;
+
+/**
+ * UploadBackend - Destination for uploaded files (SMB share, WebDAV, ...)
+ *
+ * FileUploader drives every backend through this interface and asks the
+ * capability methods before using an optional feature, so it carries no
+ * per-backend code. A backend only overrides what it supports; the
+ * defaults describe a simple whole-file uploader.
+ */
+class UploadBackend {
+public:
+    virtual ~UploadBackend() {}
+
+    /**
+     * Short name for logs (e.g. "SMB")
+     */
+    virtual const char* getName() const = 0;
+
+    /**
+     * Make sure a usable connection exists before an upload
+     * Reuses the current connection when possible.
+     *
+     * @return true if connected, false if the endpoint is unreachable
+     */
+    virtual bool ensureConnected() = 0;
+
+    virtual bool isConnected() const = 0;
+
+    /**
+     * Close the connection (the next ensureConnected() reopens it)
+     */
+    virtual void end() = 0;
+
+    /**
+     * Idle housekeeping between sessions (keepalives, idle timeouts)
+     */
+    virtual void maintain() {}
+
+    /**
+     * Upload a file from the SD card
+     *
+     * @param localPath Path to file on SD card (e.g., "/DATALOG/20241101/file.edf")
+     * @param remotePath Path on the endpoint (e.g., "/DATALOG/20241101/file.edf")
+     * @param sd Reference to SD card filesystem
+     * @param bytesTransferred Output: bytes sent. On failure this is the
+     *        contiguous prefix the endpoint acknowledged, so
+     *        startOffset + bytesTransferred is a safe resume point.
+     * @param startOffset Resume at this byte offset (only if supportsResume())
+     * @param maxBytes Send at most this many bytes (0 = rest of file, only
+     *        if supportsResume())
+     * @return true if the requested range was written
+     */
+    bool upload(const String& localPath, const String& remotePath,
+                fs::FS &sd, unsigned long& bytesTransferred,
+                unsigned long startOffset = 0, unsigned long maxBytes = 0);
+
+    /**
+     * Upload a file the caller has already opened
+     * Same contract as upload(). The caller owns the handle (positioned at
+     * 0) and closes it; fileSize comes from the caller's directory scan, so
+     * the backend neither reopens nor stats the file.
+     *
+     * @param file Open file on the SD card
+     * @param fileSize Size of the file in bytes
+     * @param localPath Path of the file on the SD card (logs, change checks)
+     */
+    virtual bool uploadFile(fs::File& file, size_t fileSize, const String& localPath,
+                            const String& remotePath, unsigned long& bytesTransferred,
+                            unsigned long startOffset = 0, unsigned long maxBytes = 0) = 0;
+
+    /**
+     * True if upload() honours startOffset/maxBytes, so files can be sent
+     * in budget-limited slices and continue after an interruption
+     * (a capability of the protocol, answered without connecting)
+     */
+    virtual bool supportsResume() const { return false; }
+
+    /**
+     * True if upload() can also continue a file that is already complete
+     * on the server and patchRange() works, so growing files are appended to
+     * (may depend on the server: false until a connection has shown it)
+     */
+    virtual bool supportsAppend() const { return supportsResume(); }
+
+    /**
+     * True if uploadStream() works (folder archives, compressed uploads)
+     */
+    virtual bool supportsStreams() const { return false; }
+
+    /**
+     * Upload a generated byte stream as one remote file
+     *
+     * @param totalBytes Exact stream length, or UploadPipeline::STREAM_TO_END
+     * @return true if the whole stream was written
+     */
+    virtual bool uploadStream(UploadSource& /*source*/, size_t /*totalBytes*/, const String& /*remotePath*/,
+                              unsigned long& bytesTransferred) {
+        bytesTransferred = 0;
+        return false;
+    }
+
+    /**
+     * True if beginFile()/finishFile() work: the caller pushes the data of
+     * a remote file, so one SD read can feed several backends (fan-out)
+     */
+    virtual bool supportsPush() const { return false; }
+
+    /**
+     * Start a whole remote file whose data the caller writes into the
+     * returned sink, in order, up to exactly totalBytes
+     *
+     * @return Sink owned by the backend until finishFile(), or nullptr
+     */
+    virtual UploadSink* beginFile(const String& /*remotePath*/, size_t /*totalBytes*/) {
+        return nullptr;
+    }
+
+    /**
+     * Close the file started by beginFile()
+     *
+     * @param complete All totalBytes were written to the sink (false = abandon)
+     * @return true if the server holds the whole file
+     */
+    virtual bool finishFile(bool /*complete*/) { return false; }
+
+    /**
+     * Overwrite a byte range of an existing remote file with local data
+     * (EDF headers that change in place as records are appended)
+     *
+     * @return false if the remote file is missing or too short
+     */
+    virtual bool patchRange(const String& /*localPath*/, const String& /*remotePath*/, fs::FS& /*sd*/,
+                            unsigned long /*offset*/, unsigned long /*length*/) {
+        return false;
+    }
+
+    /**
+     * True if listDirectory() works (reconciling state with the server)
+     */
+    virtual bool supportsListing() const { return false; }
+
+    /**
+     * List a remote directory; a missing directory is reported as empty
+     *
+     * @param files Output: file name -> size in bytes
+     * @param subdirs Output: subdirectory names (nullptr = not needed)
+     * @return true if listed (or absent), false on connection or server error
+     */
+    virtual bool listDirectory(const String& /*path*/, std::map<String, unsigned long>& /*files*/,
+                               std::set<String>* /*subdirs*/ = nullptr) {
+        return false;
+    }
+
+    /**
+     * True if uploads only count once commitBatch() accepts them, so the
+     * files of a DATALOG folder are recorded as uploaded after the commit
+     */
+    virtual bool supportsBatches() const { return false; }
+
+    /**
+     * Finish the files uploaded since the last commit as one unit
+     * (SleepHQ: one import, processed as one night). Called when a DATALOG
+     * folder is done and after the root and SETTINGS files.
+     *
+     * @return false if the batch was not accepted (its files go again)
+     */
+    virtual bool commitBatch() { return true; }
+
+    /**
+     * MD5 of the file sent by the last upload() call, hashed while sending
+     *
+     * @return 32 hex characters, or empty if not available (the caller
+     *         then hashes the file itself)
+     */
+    virtual String getLastChecksum() const { return ""; }
+
+    /**
+     * Log backend statistics at the end of an upload session
+     */
+    virtual void logSessionStats() {}
+};
+
+/**
+ * UploadBackendRegistry - Maps ENDPOINT_TYPE values to backend factories
+ *
+ * The backends compiled in by feature flags register themselves when the
+ * registry is first used; tests and tools can add their own.
+ */
+class UploadBackendRegistry {
+public:
+    typedef UploadBackend* (*Factory)(const Config& config, const EndpointConfig& endpoint);
+
+    static UploadBackendRegistry& getInstance();
+
+    /**
+     * Register a backend for an endpoint type (e.g. "SMB")
+     *
+     * @return false if the type is already registered
+     */
+    bool registerBackend(const char* type, Factory factory);
+
+    /**
+     * Create the backend for an endpoint (ENDPOINT_* or MIRROR_ENDPOINT_* keys)
+     *
+     * @return New backend owned by the caller, or nullptr if the type is
+     *         unknown or not compiled in
+     */
+    UploadBackend* create(const EndpointConfig& endpoint, const Config& config) const;
+
+    bool isRegistered(const String& type) const;
+
+    /**
+     * Registered endpoint types, comma separated (for error messages)
+     */
+    String getTypes() const;
+
+private:
+    struct Entry {
+        const char* type;
+        Factory factory;
+    };
+    std::vector<Entry> entries;
+
+    UploadBackendRegistry();
+    UploadBackendRegistry(const UploadBackendRegistry&) = delete;
+    UploadBackendRegistry& operator=(const UploadBackendRegistry&) = delete;
+};
+
+#endif // UPLOAD_BACKEND_H
@@ -0,0 +1,253 @@
+#ifndef UPLOAD_PIPELINE_H
+#define UPLOAD_PIPELINE_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+class Md5Digest;
+
+#ifndef UNIT_TEST
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#endif
+
+// Size of each ring buffer slot (bytes). Two 16KB slots keep the total
+// footprint equal to the previous single 32KB upload buffer.
+#ifndef UPLOAD_PIPELINE_BUFFER_SIZE
+#define UPLOAD_PIPELINE_BUFFER_SIZE 16384
+#endif
+
+// Number of ring buffer slots (2 = double buffering)
+#ifndef UPLOAD_PIPELINE_BUFFER_COUNT
+#define UPLOAD_PIPELINE_BUFFER_COUNT 2
+#endif
+
+// Core the SD reader task is pinned to. The Arduino loop (network writer)
+// runs on core 1, so the reader gets core 0.
+#ifndef UPLOAD_PIPELINE_READER_CORE
+#define UPLOAD_PIPELINE_READER_CORE 0
+#endif
+
+/**
+ * UploadSink - Destination for data streamed by UploadPipeline
+ *
+ * Upload backends implement this to push chunks onto the network.
+ * write() is always called from the task that called UploadPipeline::run(),
+ * in file order, one chunk at a time.
+ */
+class UploadSink {
+public:
+    virtual ~UploadSink() {}
+
+    /**
+     * Write one chunk to the destination
+     *
+     * @param data Chunk data (only valid for the duration of the call)
+     * @param len Chunk length in bytes
+     * @return true to continue, false to abort the transfer
+     */
+    virtual bool write(const uint8_t* data, size_t len) = 0;
+};
+
+/**
+ * UploadSource - Byte stream consumed by UploadPipeline
+ *
+ * read() is called from the reader side (the SD reader task on the ESP32)
+ * and must fill the buffer sequentially. Returning 0 before the expected
+ * length has been delivered is treated as a read error.
+ */
+class UploadSource {
+public:
+    virtual ~UploadSource() {}
+
+    /**
+     * Read the next bytes of the stream
+     *
+     * @param buffer Destination
+     * @param len Maximum bytes to read
+     * @return Bytes read (0 = error or end of stream)
+     */
+    virtual size_t read(uint8_t* buffer, size_t len) = 0;
+};
+
+/**
+ * FileUploadSource - UploadSource over an open SD card file
+ */
+class FileUploadSource : public UploadSource {
+public:
+    explicit FileUploadSource(fs::File& file) : file(file) {}
+
+    size_t read(uint8_t* buffer, size_t len) override {
+        return file.read(buffer, len);
+    }
+
+private:
+    fs::File& file;
+};
+
+/**
+ * FanOutSink - Hands every chunk to several sinks
+ *
+ * Lets one pass over an SD card file feed several destinations. A sink
+ * whose write() fails is dropped and gets no more data while the others
+ * carry on; the transfer continues as long as one sink takes data.
+ */
+class FanOutSink : public UploadSink {
+public:
+    static const int MAX_SINKS = 4;
+
+    FanOutSink() : count(0) {}
+
+    /**
+     * Add a destination (nullptr counts as already failed)
+     *
+     * @return Index for isActive(), or -1 if MAX_SINKS are in use
+     */
+    int add(UploadSink* sink) {
+        if (count >= MAX_SINKS) {
+            return -1;
+        }
+        sinks[count] = sink;
+        active[count] = (sink != nullptr);
+        return count++;
+    }
+
+    bool write(const uint8_t* data, size_t len) override {
+        bool any = false;
+        for (int i = 0; i < count; i++) {
+            if (active[i]) {
+                active[i] = sinks[i]->write(data, len);
+                any = any || active[i];
+            }
+        }
+        return any;
+    }
+
+    /**
+     * True if the sink took every chunk written so far
+     */
+    bool isActive(int index) const { return index >= 0 && index < count && active[index]; }
+
+private:
+    UploadSink* sinks[MAX_SINKS];
+    bool active[MAX_SINKS];
+    int count;
+};
+
+/**
+ * UploadPipeline - Overlaps SD card reads with network writes
+ *
+ * A ring of N buffers is shared between a producer that fills buffers from
+ * the SD card and a consumer that drains them into an UploadSink. On the
+ * ESP32 the producer is a FreeRTOS task pinned to UPLOAD_PIPELINE_READER_CORE
+ * while the caller's task acts as the consumer, so SD time and Wi-Fi time
+ * overlap instead of adding up.
+ *
+ * Backpressure: the producer can never be more than N buffers ahead of the
+ * consumer. When every buffer is filled it blocks until the sink has
+ * drained one.
+ *
+ * In native unit tests (UNIT_TEST) the same ring is driven cooperatively on
+ * a single thread: the producer runs until the ring is full or the file
+ * ends, then the consumer drains one buffer. Ordering and backpressure
+ * behave exactly as on the device.
+ */
+class UploadPipeline {
+public:
+    static const int MAX_BUFFERS = 8;
+
+    // bytesToRead for sources that end the stream themselves (read() == 0)
+    static const size_t STREAM_TO_END = (size_t)-1;
+
+    /**
+     * Constructor
+     *
+     * @param bufferSize Size of each ring slot in bytes
+     * @param bufferCount Number of ring slots (clamped to 1..MAX_BUFFERS)
+     */
+    UploadPipeline(size_t bufferSize = UPLOAD_PIPELINE_BUFFER_SIZE,
+                   int bufferCount = UPLOAD_PIPELINE_BUFFER_COUNT);
+    ~UploadPipeline();
+
+    /**
+     * Borrow ring buffers from the BufferPool
+     *
+     * @return true if all buffers were allocated, false on low memory
+     */
+    bool begin();
+
+    /**
+     * Return ring buffers to the BufferPool
+     */
+    void end();
+
+    /**
+     * Stream bytes from an open file into a sink
+     *
+     * @param source Open file positioned at the first byte to send
+     * @param bytesToRead Number of bytes expected from the file
+     * @param sink Destination for the data
+     * @param bytesTransferred Output: bytes accepted by the sink
+     * @return true if all bytes were read and accepted, false otherwise
+     */
+    bool run(fs::File& source, size_t bytesToRead, UploadSink& sink,
+             unsigned long& bytesTransferred);
+
+    /**
+     * Stream bytes from any source into a sink (same contract as above)
+     * With bytesToRead = STREAM_TO_END the transfer ends at the first
+     * read() that returns 0; the source reports its own errors.
+     */
+    bool run(UploadSource& source, size_t bytesToRead, UploadSink& sink,
+             unsigned long& bytesTransferred);
+
+    /**
+     * Hash every byte read by run() into a digest (nullptr = no hashing)
+     * The digest is fed on the reader side in file order and is not reset
+     * by run(); call begin() on it before the transfer and read it after
+     * run() returns.
+     */
+    void setDigest(Md5Digest* target) { digest = target; }
+
+    // Statistics for the last run() (for diagnostics and tests)
+    unsigned long getReaderStalls() const { return readerStalls; }  // Reader waited for a free buffer
+    unsigned long getWriterStalls() const { return writerStalls; }  // Writer waited for data
+    int getMaxBuffersInFlight() const { return maxInFlight; }       // Peak filled-but-unsent buffers
+    size_t getBufferSize() const { return bufferSize; }
+    int getBufferCount() const { return bufferCount; }
+
+private:
+    size_t bufferSize;
+    int bufferCount;
+    uint8_t* buffers[MAX_BUFFERS];
+
+    unsigned long readerStalls;
+    unsigned long writerStalls;
+    int maxInFlight;
+    Md5Digest* digest;
+
+    // Chunk descriptor passed from reader to writer
+    struct Chunk {
+        int16_t index;   // Buffer slot, or -1 for end of stream
+        int32_t length;  // Bytes in slot; for end of stream: 0 = EOF, -1 = read error
+    };
+
+    void resetStats();
+
+#ifndef UNIT_TEST
+    // Shared state for the reader task
+    UploadSource* readerSource;
+    size_t readerRemaining;
+    volatile bool abortRequested;
+    QueueHandle_t freeQueue;
+    QueueHandle_t filledQueue;
+    SemaphoreHandle_t readerDone;
+
+    static void readerTask(void* arg);
+    void readerLoop();
+#endif
+};
+
+#endif // UPLOAD_PIPELINE_H
@@ -5,33 +5,145 @@
 #include <FS.h>
 #include <map>
 #include <set>
+#include <vector>
 
+// Superseded records tolerated in the state file before save() rewrites it
+// (it is rewritten once it holds more than twice the live records plus this)
+#ifndef UPLOAD_STATE_COMPACT_SLACK
+#define UPLOAD_STATE_COMPACT_SLACK 256
+#endif
+
+/**
+ * UploadStateManager - What has been uploaded, persisted on the SD card
+ *
+ * The state file is a binary journal: a versioned header followed by
+ * fixed-width records, each with its own CRC. A record holds the current
+ * value of one key (a file, a growing file, a DATALOG folder, the retry
+ * and checkpoint fields). Loading replays the records in one streaming
+ * pass, later records replacing earlier ones; save() appends a record per
+ * key changed since the last save, and rewrites the file only when
+ * superseded records outnumber live ones. A save that was cut off leaves
+ * a record that fails its CRC; loading stops there and the next save
+ * rewrites the file.
+ *
+ * A JSON state file written by earlier firmware (version 1) is migrated
+ * by begin() and then removed.
+ */
 class UploadStateManager {
 private:
     String stateFilePath;
+    String legacyFilePath;  // JSON state of earlier firmware
     unsigned long lastUploadTimestamp;
     std::map<String, String> fileChecksums;
-    std::set<String> completedDatalogFolders;
-    std::map<String, unsigned long> pendingDatalogFolders;  // folderName -> firstSeenTimestamp
+    std::map<String, String> fileStats;             // "size:lastWrite" when the checksum was recorded
+    std::map<String, unsigned long> appendLengths;  // Growing files: bytes already on the server
+    std::map<String, String> appendTails;           // Growing files: hash of the tail window at that length
+    
+    // DATALOG folders as packed YYYYMMDD numbers in sorted vectors (binary
+    // search): 4 bytes a completed night, 8 a pending one, no node or
+    // String allocation per folder
+    struct PendingFolder {
+        uint32_t date;
+        uint32_t firstSeen;  // Timestamp when the folder was first seen empty
+        bool operator<(uint32_t other) const { return date < other; }  // For lower_bound
+    };
+    std::vector<uint32_t> completedDatalogFolders;
+    std::vector<PendingFolder> pendingDatalogFolders;
     String currentRetryFolder;
     int currentRetryCount;
     int totalFoldersCount;  // Total DATALOG folders found (for progress tracking)
     
+    // Resume checkpoint for the file that was in flight when a session ended
+    String checkpointPath;
+    unsigned long checkpointSize;       // Local file size when the checkpoint was taken
+    unsigned long checkpointCommitted;  // Bytes confirmed written on the remote side
+    
+    // Set when the state was lost or reset: folders already on the server
+    // still have to be matched against a remote listing
+    bool reconcilePending;
+    
     static const unsigned long PENDING_FOLDER_TIMEOUT_SECONDS = 7 * 24 * 60 * 60;  // 604800 seconds
+    static const uint32_t MAX_FOLDER_DATE = 99991231;  // Largest packed YYYYMMDD name
     
-    String calculateChecksum(fs::FS &sd, const String& filePath);
-    bool loadState(fs::FS &sd);
+    // Changes since the last save, appended by the next one
+    std::set<String> dirtyFiles;         // fileChecksums / fileStats keys
+    std::set<String> dirtyAppends;       // appendLengths / appendTails keys
+    std::vector<uint32_t> dirtyFolders;  // Completed or pending status changed
+    std::set<uint32_t> openFolders;      // Open nights sent this session (not persisted)
+    uint32_t savedSessionCrc;            // CRC of the session record last written
+    uint32_t savedCheckpointCrc;         // CRC of the checkpoint record last written
+    uint32_t journalRecords;             // Records in the state file, live or superseded
+    bool rewriteNeeded;                  // No usable state file: the next save writes it whole
+    
+    // Read size for hashing when the BufferPool is not available
+    static const size_t CHECKSUM_READ_SIZE = 512;
+    
+    // Borrow a hashing buffer (pool slot, or CHECKSUM_READ_SIZE bytes); release via BufferPool
+    uint8_t* acquireReadBuffer(size_t& size);
+    String calculateTailHash(fs::FS &sd, const String& filePath, unsigned long length);
+    static String formatStat(unsigned long size, time_t lastWrite);
+    
+    // "YYYYMMDD" <-> packed folder key (0 = not an 8-digit folder name)
+    static uint32_t packFolderName(const String& folderName);
+    static bool isFolderDate(uint32_t date) { return date != 0 && date <= MAX_FOLDER_DATE; }
+    static bool formatFolderName(uint32_t date, char* name);  // name: 9 bytes; false if not a folder date
+    void insertCompletedFolder(uint32_t date);
+    std::vector<PendingFolder>::iterator findPendingFolder(uint32_t date);
+    void clearState();
+    bool loadState(fs::FS &sd);        // Binary state file
+    bool loadLegacyState(fs::FS &sd);  // JSON state file (version 1)
     bool saveState(fs::FS &sd);
+    bool writeStateFile(fs::FS &sd);     // Whole state to a new file
+    bool appendStateChanges(fs::FS &sd);  // Changed keys to the end of the file
+    uint32_t countLiveRecords() const;
+    
+    // Fixed-width state records (false if a path or hash does not fit)
+    void encodeSession(uint8_t* record) const;
+    void encodeFolder(uint32_t date, uint8_t* record) const;
+    bool encodeCheckpoint(uint8_t* record) const;
+    bool encodeFile(const String& path, uint8_t* record) const;
+    bool encodeAppend(const String& path, uint8_t* record) const;
+    void applyRecord(const uint8_t* record);
+    void setFolderState(uint32_t date, uint8_t state, uint32_t firstSeen);
 
 public:
-    UploadStateManager();
+    // Bytes hashed at the end of the uploaded prefix to detect in-place rewrites
+    static const unsigned long APPEND_TAIL_WINDOW = 4096;
+    
+    // Result of comparing a growing file against its last uploaded length
+    enum AppendStatus {
+        APPEND_UNCHANGED,  // Same length, tail intact - nothing to send
+        APPEND_GROWN,      // Prefix intact, new bytes after the recorded length
+        APPEND_REPLACED    // Unknown, shrunk or rewritten - send the whole file
+    };
+    
+    /**
+     * @param path State file on the SD card (one per upload target); the
+     *        JSON file of earlier firmware has the same name ending in .json
+     */
+    explicit UploadStateManager(const String& path = "/.upload_state.bin");
     
     bool begin(fs::FS &sd);
     
     // Checksum-based tracking for root/SETTINGS files
-    bool hasFileChanged(fs::FS &sd, const String& filePath);
+    String calculateChecksum(fs::FS &sd, const String& filePath);
+    bool hasFileChanged(fs::FS &sd, const String& filePath);  // Reads and hashes the whole file
     void markFileUploaded(const String& filePath, const String& checksum);
     
+    // Stat-based change check: compares size and last-write time with the
+    // values recorded at upload (no data read). Falls back to the checksum
+    // when the file system has no timestamp.
+    bool hasFileChangedQuick(fs::FS &sd, const String& filePath);
+    void markFileUploaded(const String& filePath, const String& checksum,
+                          unsigned long size, time_t lastWrite);
+    
+    // Append-only tracking for growing files (STR.edf, in-progress night's EDFs)
+    AppendStatus checkAppend(fs::FS &sd, const String& filePath, unsigned long currentSize,
+                             unsigned long& appendOffset);
+    void recordUploadedLength(fs::FS &sd, const String& filePath, unsigned long length);
+    void clearUploadedLength(const String& filePath);  // Next upload sends the whole file
+    bool hasUploadedLength(const String& filePath) const { return appendLengths.count(filePath) > 0; }
+    
     // Folder-based tracking for DATALOG
     bool isFolderCompleted(const String& folderName);
     void markFolderCompleted(const String& folderName);
@@ -39,6 +151,11 @@ public:
     int getIncompleteFoldersCount() const;
     void setTotalFoldersCount(int count);
     
+    // A night the machine may still be recording is not completed; once sent
+    // it counts as done for the session and keeps its append records
+    void markFolderOpen(const String& folderName);
+    void clearOpenFolders();
+    
     // Pending folder tracking for empty folders
     bool isPendingFolder(const String& folderName);
     void markFolderPending(const String& folderName, unsigned long timestamp);
@@ -46,6 +163,7 @@ public:
     bool shouldPromotePendingToCompleted(const String& folderName, unsigned long currentTime);
     void promotePendingToCompleted(const String& folderName);
     int getPendingFoldersCount() const;
+    size_t getFolderMemoryUsage() const;  // Heap held by the folder records
     
     // Retry tracking (only for current folder)
     int getCurrentRetryCount();
@@ -54,12 +172,24 @@ public:
     void incrementCurrentRetryCount();
     void clearCurrentRetry();
     
+    // Byte-offset resume for interrupted files (one file at a time)
+    void setUploadCheckpoint(const String& filePath, unsigned long fileSize, unsigned long bytesCommitted);
+    unsigned long getResumeOffset(const String& filePath, unsigned long fileSize) const;
+    void clearUploadCheckpoint();
+    bool hasUploadCheckpoint() const;
+    String getCheckpointPath() const;
+    
+    // Remote reconcile after a lost or reset state (persisted until it completes)
+    bool isReconcilePending() const;
+    void setReconcilePending(bool pending);
+    
     // Timestamp tracking
     unsigned long getLastUploadTimestamp();
     void setLastUploadTimestamp(unsigned long timestamp);
     
     // Persistence
     bool save(fs::FS &sd);
+    bool reset(fs::FS &sd);  // Clear all state in memory and delete the state file
 };
 
 #endif // UPLOAD_STATE_MANAGER_H
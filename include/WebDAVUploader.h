@@ -3,47 +3,206 @@
 
 #include <Arduino.h>
 #include <FS.h>
+#include <map>
+#include <set>
+#include "UploadBackend.h"
+#include "HttpConnection.h"
 
 #ifdef ENABLE_WEBDAV_UPLOAD
 
+// A keep-alive connection idle longer than this is reopened before a
+// streamed request body, which cannot be replayed if the server had
+// already dropped it (Apache closes idle connections after 5 s)
+#ifndef WEBDAV_IDLE_REUSE_MS
+#define WEBDAV_IDLE_REUSE_MS 4000
+#endif
+
+// Large files go out in requests of this size when the server can resume,
+// so an interrupted upload keeps every acknowledged piece
+#ifndef WEBDAV_RESUME_PIECE_SIZE
+#define WEBDAV_RESUME_PIECE_SIZE (512 * 1024)
+#endif
+
 /**
  * WebDAVUploader - Handles file uploads to WebDAV servers
- * 
- * TODO: Implementation pending
- * 
- * This uploader will support uploading files to WebDAV-compatible servers
- * such as Nextcloud, ownCloud, or standard WebDAV shares.
- * 
- * Planned features:
- * - HTTP/HTTPS support
- * - Basic and Digest authentication
- * - Automatic directory creation
- * - Chunked upload for large files
- * - Resume capability for interrupted uploads
- * 
+ *
+ * Uploads to Nextcloud, ownCloud, Apache mod_dav, nginx dav or any other
+ * WebDAV share. ENDPOINT is the collection URL, e.g.
+ * https://cloud.example.com/remote.php/dav/files/user/CPAP
+ *
+ * - One HTTP/1.1 keep-alive connection (TLS for https) carries the whole
+ *   upload session; it is reopened transparently when the server closes it
+ * - PUT bodies are streamed from the SD card through the UploadPipeline,
+ *   hashed on the way, never buffered whole; generated streams (archives,
+ *   compressed files) use chunked transfer encoding
+ * - MKCOL results are cached per directory for the session, so each
+ *   directory costs one request at most
+ * - PROPFIND Depth:1 listings let FileUploader skip files already on the
+ *   server (reconcile after a state reset, retried folders)
+ * - Interrupted and budget-limited uploads resume where the server stopped
+ *   acknowledging, if the server supports one of the partial-write methods
+ *   probed on the first connect (see ResumeMethod)
+ *
+ * Basic authentication only (use a Nextcloud app password). The server
+ * certificate is not verified for https.
+ *
  * Requirements: 10.6
  */
-class WebDAVUploader {
+class WebDAVUploader : public UploadBackend {
+public:
+    /**
+     * How the server accepts a file in pieces
+     */
+    enum ResumeMethod {
+        RESUME_NONE,            // Whole-file PUT only
+        RESUME_CONTENT_RANGE,   // PUT with Content-Range (Apache mod_dav)
+        RESUME_PATCH,           // PATCH with X-Update-Range (sabre/dav partial update)
+        RESUME_CHUNKED_UPLOAD   // Nextcloud chunked upload: pieces assembled with MOVE
+    };
+
 private:
-    String webdavUrl;      // Full WebDAV URL (e.g., https://cloud.example.com/remote.php/dav/files/user/)
-    String webdavUser;     // Username for authentication
-    String webdavPassword; // Password for authentication
-    bool connected;
-    
-    bool parseEndpoint(const String& endpoint);
-    bool connect();
-    void disconnect();
+    HttpConnection http;
+    bool configured;                // ENDPOINT parsed
+    bool connected;                 // Session established (server and credentials checked)
+    String lastChecksum;            // MD5 of the last whole-file upload (empty otherwise)
+    unsigned long lastRequestTime;  // For WEBDAV_IDLE_REUSE_MS
+    ResumeMethod resumeMethod;
+    bool resumeProbed;              // Probe once per boot, not per connect
+    String uploadsPath;             // Nextcloud uploads collection (RESUME_CHUNKED_UPLOAD)
+
+    // Collections known to exist (paths below the endpoint, no trailing
+    // slash). Cleared at session end and whenever a PUT reports a missing parent.
+    std::set<String> knownDirectories;
+    unsigned long dirCacheHits;
+    unsigned long dirCacheMisses;
+
+    // PUT whose body the caller pushes (beginFile() to finishFile())
+    HttpBodySink* pushSink;
+    size_t pushSize;
+    String pushPath;
+
+    /**
+     * Create every missing parent collection of a remote file path
+     */
+    bool ensureParentDirectories(const String& remotePath);
+
+    /**
+     * Reopen the connection if it sat idle long enough for the server to
+     * have closed it
+     */
+    void refreshIdleConnection();
+
+    /**
+     * Server path of a path below the endpoint
+     */
+    String davPath(const String& path) const { return http.getBasePath() + path; }
+
+    /**
+     * Send a request whose body comes from a source
+     *
+     * @param totalBytes Body length, or UploadPipeline::STREAM_TO_END (chunked)
+     * @param digest Hash of the bytes sent (nullptr = none)
+     * @return HTTP status, or -1 if the request failed
+     */
+    int sendStream(const char* method, const String& serverPath, const String& headers,
+                   UploadSource& source, size_t totalBytes, Md5Digest* digest,
+                   unsigned long& bytesTransferred);
+
+    /**
+     * Write one byte range of a local file to the server
+     * Retried once if the keep-alive connection turns out closed or a
+     * parent collection is missing.
+     *
+     * @param create Plain PUT of the range as the whole new file (offset 0)
+     * @return HTTP status, or -1 if the request failed
+     */
+    int writeRange(fs::File& file, const String& remotePath, size_t fileSize,
+                   unsigned long offset, unsigned long length, bool create, Md5Digest* digest);
+
+    /**
+     * Detect the server's resume method (see ResumeMethod)
+     */
+    void probeResume();
+    bool probeContentRange();
+
+    /**
+     * Where a resumed upload can continue: the confirmed prefix on the
+     * server if it reaches startOffset, 0 if the upload must start over
+     */
+    unsigned long findResumePoint(const String& remotePath, size_t fileSize, unsigned long startOffset);
+
+    /**
+     * PROPFIND Depth:1 listing of a server path
+     *
+     * @return 207 if listed, 404 if missing, other = failed (outputs empty)
+     */
+    int listCollection(const String& serverPath, std::map<String, unsigned long>& files,
+                       std::set<String>* subdirs);
+
+    // RESUME_CHUNKED_UPLOAD: per-file upload collection and piece names
+    String transferPath(const String& remotePath, size_t fileSize) const;
+    static String pieceName(unsigned long offset);
+    bool assembleChunks(const String& remotePath, size_t fileSize);
 
 public:
-    WebDAVUploader(const String& endpoint, const String& user, const String& password);
+    WebDAVUploader(const String& endpoint, const String& user, const String& password,
+                   bool insecureTls = false);
     ~WebDAVUploader();
-    
+
+    static UploadBackend* create(const Config& config, const EndpointConfig& endpoint);  // ENDPOINT_TYPE "WEBDAV"
+    const char* getName() const override { return "WebDAV"; }
+    bool supportsStreams() const override { return true; }
+    bool supportsListing() const override { return true; }
+    bool supportsPush() const override { return true; }
+    // A server without partial writes gets the whole file instead (upload()
+    // then starts at 0 and reports every byte), so the checkpoint stays true
+    bool supportsResume() const override { return true; }
+    // Chunked uploads always create the whole file: growing files are resent
+    bool supportsAppend() const override {
+        return resumeMethod == RESUME_CONTENT_RANGE || resumeMethod == RESUME_PATCH;
+    }
+
+    /**
+     * Connect and check the endpoint collection and credentials
+     * (PROPFIND Depth:0 on the endpoint)
+     */
     bool begin();
+    bool ensureConnected() override;
+    void end() override;
+    bool isConnected() const override;
+
+    /**
+     * Create a collection (MKCOL); an existing one counts as success
+     */
     bool createDirectory(const String& path);
-    bool upload(const String& localPath, const String& remotePath, 
-                fs::FS &sd, unsigned long& bytesTransferred);
-    void end();
-    bool isConnected() const;
+
+    bool uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                    const String& remotePath, unsigned long& bytesTransferred,
+                    unsigned long startOffset = 0, unsigned long maxBytes = 0) override;
+    bool uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                      unsigned long& bytesTransferred) override;
+    UploadSink* beginFile(const String& remotePath, size_t totalBytes) override;
+    bool finishFile(bool complete) override;
+    bool patchRange(const String& localPath, const String& remotePath, fs::FS &sd,
+                    unsigned long offset, unsigned long length) override;
+    bool listDirectory(const String& path, std::map<String, unsigned long>& files,
+                       std::set<String>* subdirs = nullptr) override;
+
+    String getLastChecksum() const override { return lastChecksum; }
+    void logSessionStats() override;
+
+    /**
+     * Use this transport instead of WiFiClient/WiFiClientSecure (for tests)
+     */
+    void setClient(Client* transport) { http.setClient(transport); }
+
+    ResumeMethod getResumeMethod() const { return resumeMethod; }
+
+    // Statistics (cumulative since construction)
+    unsigned long getConnectCount() const { return http.getConnectCount(); }
+    unsigned long getRequestCount() const { return http.getRequestCount(); }
+    unsigned long getDirCacheHits() const { return dirCacheHits; }
+    unsigned long getDirCacheMisses() const { return dirCacheMisses; }
 };
 
 #endif // ENABLE_WEBDAV_UPLOAD
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Build the root CA bundle the firmware checks TLS servers against.
+
+Writes data/cert/x509_crt_bundle.bin in the ESP-IDF certificate bundle
+format read by WiFiClientSecure::setCACertBundle(): a big-endian 16-bit
+certificate count, then per certificate (sorted by subject) the 16-bit
+lengths of the DER subject name and public key, followed by both.
+
+Runs before each pico32 build (extra_scripts in platformio.ini) and only
+rewrites the bundle when it is missing. The CA list is Mozilla's, from the
+certifi package PlatformIO already installs, or the system store. Run it
+by hand to refresh the bundle or to use another PEM file:
+
+    python3 scripts/cert_bundle.py [cacert.pem]
+"""
+
+import base64
+import os
+import re
+import struct
+import sys
+
+SYSTEM_BUNDLES = [
+    "/etc/ssl/certs/ca-certificates.crt",  # Debian, Ubuntu
+    "/etc/pki/tls/certs/ca-bundle.crt",    # Fedora
+    "/etc/ssl/cert.pem",                   # macOS, Alpine
+]
+
+
+def read_tlv(data, pos):
+    """DER element at pos: (tag, start of element, end of element)"""
+    tag = data[pos]
+    length = data[pos + 1]
+    header = 2
+    if length & 0x80:
+        count = length & 0x7F
+        length = int.from_bytes(data[pos + 2:pos + 2 + count], "big")
+        header += count
+    return tag, pos, pos + header + length, pos + header
+
+
+def subject_and_key(der):
+    """Raw DER of the subject Name and SubjectPublicKeyInfo of a certificate"""
+    _, _, _, cert_body = read_tlv(der, 0)
+    _, _, _, pos = read_tlv(der, cert_body)  # tbsCertificate contents
+    fields = []
+    while len(fields) < 7:
+        tag, start, end, _ = read_tlv(der, pos)
+        if not fields and tag == 0xA0:
+            pos = end  # Explicit version
+            continue
+        fields.append(der[start:end])
+        pos = end
+    # serialNumber, signature, issuer, validity, subject, subjectPublicKeyInfo
+    return fields[4], fields[5]
+
+
+def pem_certificates(text):
+    pattern = r"-----BEGIN CERTIFICATE-----(.+?)-----END CERTIFICATE-----"
+    for body in re.findall(pattern, text, re.S):
+        yield base64.b64decode("".join(body.split()))
+
+
+def build_bundle(pem_text):
+    entries = sorted(subject_and_key(der) for der in pem_certificates(pem_text))
+    bundle = struct.pack(">H", len(entries))
+    for name, key in entries:
+        bundle += struct.pack(">HH", len(name), len(key)) + name + key
+    return bundle, len(entries)
+
+
+def find_source():
+    try:
+        import certifi
+        return certifi.where()
+    except ImportError:
+        pass
+    for path in SYSTEM_BUNDLES:
+        if os.path.exists(path):
+            return path
+    return None
+
+
+def generate(project_dir, source=None, force=False):
+    output = os.path.join(project_dir, "data", "cert", "x509_crt_bundle.bin")
+    if os.path.exists(output) and not force:
+        return True
+
+    source = source or find_source()
+    if source is None:
+        print("cert_bundle: no CA list found; install certifi or pass a PEM file")
+        return False
+
+    with open(source, encoding="ascii", errors="ignore") as pem:
+        bundle, count = build_bundle(pem.read())
+    os.makedirs(os.path.dirname(output), exist_ok=True)
+    with open(output, "wb") as out:
+        out.write(bundle)
+    print("cert_bundle: %d root certificates from %s -> %s (%d bytes)"
+          % (count, source, os.path.relpath(output, project_dir), len(bundle)))
+    return True
+
+
+if __name__ == "__main__":
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    sys.exit(0 if generate(root, sys.argv[1] if len(sys.argv) > 1 else None, force=True) else 1)
+else:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    if not generate(env.subst("$PROJECT_DIR")):  # noqa: F821
+        env.Exit(1)  # noqa: F821
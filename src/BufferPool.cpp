@@ -0,0 +1,172 @@
+#include "BufferPool.h"
+#include "Logger.h"
+
+BufferPool& BufferPool::getInstance() {
+    static BufferPool instance;
+    return instance;
+}
+
+BufferPool::BufferPool()
+    : arena(nullptr),
+      slotSize(0),
+      slotCount(0),
+      usedMask(0),
+      slotsInUse(0),
+      peakSlotsInUse(0),
+      acquireCount(0),
+      fallbackCount(0) {
+}
+
+bool BufferPool::begin(int count, size_t slotBytes, size_t largestFreeBlock) {
+    if (arena != nullptr) {
+        return true;  // Already allocated at boot
+    }
+
+    if (count < 1) count = 1;
+    if (count > MAX_SLOTS) count = MAX_SLOTS;
+
+    // Largest power of two up to the wanted slot size
+    size_t size = BUFFER_POOL_MIN_SLOT_SIZE;
+    while (size * 2 <= BUFFER_POOL_MAX_SLOT_SIZE && size * 2 <= slotBytes) {
+        size *= 2;
+    }
+
+    // Leave the rest of the heap to Wi-Fi, TLS and the web server
+    size_t heapLimit = largestFreeBlock / 100 * BUFFER_POOL_HEAP_SHARE_PERCENT;
+    while (largestFreeBlock != 0 && size > BUFFER_POOL_MIN_SLOT_SIZE && size * count > heapLimit) {
+        size /= 2;
+    }
+
+    while (true) {
+        arena = (uint8_t*)malloc(size * count);
+        if (arena != nullptr || size <= BUFFER_POOL_MIN_SLOT_SIZE) {
+            break;
+        }
+        size /= 2;  // Heap already too fragmented for this arena, try smaller slots
+    }
+
+    if (arena == nullptr) {
+        LOGF("[BufferPool] ERROR: Failed to allocate %d x %u byte arena", count, size);
+        LOG("[BufferPool] Transfers will fall back to per-file allocation");
+        slotSize = 0;
+        slotCount = 0;
+        return false;
+    }
+
+    slotSize = size;
+    slotCount = count;
+    usedMask = 0;
+    slotsInUse = 0;
+    LOGF("[BufferPool] Reserved %d x %u KB (%u bytes)", slotCount, slotSize / 1024,
+         slotSize * slotCount);
+    return true;
+}
+
+void BufferPool::end() {
+    if (arena == nullptr) {
+        return;
+    }
+    if (slotsInUse > 0) {
+        LOGF("[BufferPool] WARNING: Releasing arena with %d slot(s) still borrowed", slotsInUse);
+    }
+    free(arena);
+    arena = nullptr;
+    slotSize = 0;
+    slotCount = 0;
+    usedMask = 0;
+    slotsInUse = 0;
+}
+
+int BufferPool::slotIndexOf(const uint8_t* buffer) const {
+    if (arena == nullptr || buffer < arena || buffer >= arena + slotSize * slotCount) {
+        return -1;
+    }
+    return (buffer - arena) / slotSize;
+}
+
+uint8_t* BufferPool::acquire(size_t size) {
+    acquireCount++;
+
+    if (arena != nullptr && size <= slotSize) {
+        for (int i = 0; i < slotCount; i++) {
+            if ((usedMask & (1u << i)) == 0) {
+                usedMask |= (1u << i);
+                slotsInUse++;
+                if (slotsInUse > peakSlotsInUse) {
+                    peakSlotsInUse = slotsInUse;
+                }
+                return arena + i * slotSize;
+            }
+        }
+    }
+
+    // Pool inactive, exhausted or request too large
+    fallbackCount++;
+    if (arena != nullptr) {
+        LOG_DEBUGF("[BufferPool] Fallback allocation of %u bytes (%d/%d slots in use, slot %u bytes)",
+                   size, slotsInUse, slotCount, slotSize);
+    }
+    return (uint8_t*)malloc(size);
+}
+
+void BufferPool::release(uint8_t* buffer) {
+    if (buffer == nullptr) {
+        return;
+    }
+
+    int index = slotIndexOf(buffer);
+    if (index < 0) {
+        free(buffer);  // Fallback allocation
+        return;
+    }
+
+    if ((usedMask & (1u << index)) == 0) {
+        LOGF("[BufferPool] WARNING: Slot %d released twice", index);
+        return;
+    }
+    usedMask &= ~(1u << index);
+    slotsInUse--;
+}
+
+int BufferPool::fragmentationPercent(size_t freeBytes, size_t largestBlock) {
+    if (freeBytes == 0 || largestBlock >= freeBytes) {
+        return 0;
+    }
+    return 100 - (int)((uint64_t)largestBlock * 100 / freeBytes);
+}
+
+#ifdef UNIT_TEST
+// No heap introspection on the host
+static size_t heapFree() { return 0; }
+static size_t heapMinFree() { return 0; }
+static size_t heapLargestBlock() { return 0; }
+#else
+static size_t heapFree() { return ESP.getFreeHeap(); }
+static size_t heapMinFree() { return ESP.getMinFreeHeap(); }
+static size_t heapLargestBlock() { return ESP.getMaxAllocHeap(); }
+#endif
+
+void BufferPool::logHeapReport(const char* context) {
+    size_t freeBytes = heapFree();
+    size_t largest = heapLargestBlock();
+    LOGF("[Heap] %s: free %u, low-water %u, largest block %u, fragmentation %d%%",
+         context, freeBytes, heapMinFree(), largest, fragmentationPercent(freeBytes, largest));
+    LOGF("[Heap] Pool: %d/%d slots in use (peak %d), %lu acquisitions, %lu fallback allocations",
+         slotsInUse, slotCount, peakSlotsInUse, acquireCount, fallbackCount);
+}
+
+String BufferPool::getHeapReportJSON() {
+    size_t freeBytes = heapFree();
+    size_t largest = heapLargestBlock();
+
+    // Formatted in one go to avoid a chain of temporary Strings
+    char json[320];
+    snprintf(json, sizeof(json),
+             "{\"free\":%u,\"min_free\":%u,\"largest_block\":%u,\"fragmentation_percent\":%d,"
+             "\"pool_slot_size\":%u,\"pool_slots\":%d,\"pool_in_use\":%d,\"pool_peak_in_use\":%d,"
+             "\"pool_acquisitions\":%lu,\"pool_fallbacks\":%lu}",
+             (unsigned)freeBytes, (unsigned)heapMinFree(), (unsigned)largest,
+             fragmentationPercent(freeBytes, largest), (unsigned)slotSize, slotCount,
+             slotsInUse, peakSlotsInUse, acquireCount, fallbackCount);
+    return String(json);
+}
@@ -0,0 +1,166 @@
+#include "ChunkSizeTuner.h"
+#include "Logger.h"
+
+const size_t ChunkSizeTuner::sizes[ChunkSizeTuner::NUM_SIZES] = {
+    4096, 8192, 16384, 32768, 65536
+};
+
+ChunkSizeTuner::ChunkSizeTuner()
+    : currentIndex(0),
+      ceilingIndex(NUM_SIZES - 1),
+      direction(1),
+      settled(false),
+      decisionsSinceSettle(0) {
+    for (int i = 0; i < NUM_SIZES; i++) {
+        rate[i] = 0;
+        sampleBytes[i] = 0;
+        sampleMs[i] = 0;
+    }
+    currentIndex = largestIndexAtMost(CHUNK_TUNER_DEFAULT_SIZE);
+}
+
+int ChunkSizeTuner::indexOf(size_t chunkSize) const {
+    for (int i = 0; i < NUM_SIZES; i++) {
+        if (sizes[i] == chunkSize) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ChunkSizeTuner::largestIndexAtMost(size_t limit) const {
+    int index = 0;  // Never go below the smallest size
+    for (int i = 0; i < NUM_SIZES; i++) {
+        if (sizes[i] >= CHUNK_TUNER_MIN_SIZE && sizes[i] <= CHUNK_TUNER_MAX_SIZE &&
+            sizes[i] <= limit) {
+            index = i;
+        }
+    }
+    return index;
+}
+
+void ChunkSizeTuner::begin(uint32_t maxWriteSize, size_t largestFreeBlock, int buffersPerUpload) {
+    if (buffersPerUpload < 1) {
+        buffersPerUpload = 1;
+    }
+
+    size_t heapLimit = (largestFreeBlock / 100 * HEAP_SHARE_PERCENT) / buffersPerUpload;
+    LOGF("[ChunkTuner] Largest heap block %u, %d buffers per upload", largestFreeBlock,
+         buffersPerUpload);
+    applyCeiling(maxWriteSize, heapLimit);
+}
+
+void ChunkSizeTuner::begin(uint32_t maxWriteSize, size_t bufferLimit) {
+    applyCeiling(maxWriteSize, bufferLimit);
+}
+
+void ChunkSizeTuner::applyCeiling(uint32_t maxWriteSize, size_t bufferLimit) {
+    size_t limit = bufferLimit;
+    if (maxWriteSize > 0 && maxWriteSize < limit) {
+        limit = maxWriteSize;
+    }
+
+    ceilingIndex = largestIndexAtMost(limit);
+
+    LOGF("[ChunkTuner] Ceiling %u KB (server max write %lu, buffer limit %u)",
+         sizes[ceilingIndex] / 1024, (unsigned long)maxWriteSize, bufferLimit);
+
+    if (currentIndex > ceilingIndex) {
+        moveTo(ceilingIndex, "above new ceiling");
+    } else {
+        LOGF("[ChunkTuner] Using %u KB chunks", sizes[currentIndex] / 1024);
+    }
+}
+
+bool ChunkSizeTuner::recordTransfer(size_t chunkSize, unsigned long bytes, unsigned long elapsedMs) {
+    int index = indexOf(chunkSize);
+    if (index != currentIndex || bytes == 0) {
+        return false;  // Stale sample from before a change
+    }
+
+    sampleBytes[index] += bytes;
+    sampleMs[index] += elapsedMs;
+    if (sampleBytes[index] < MIN_SAMPLE_BYTES) {
+        return false;
+    }
+
+    unsigned long ms = sampleMs[index] > 0 ? sampleMs[index] : 1;
+    unsigned long measured = (unsigned long)((uint64_t)sampleBytes[index] * 1000 / ms);
+    rate[index] = rate[index] == 0 ? measured : (rate[index] + measured) / 2;
+    sampleBytes[index] = 0;
+    sampleMs[index] = 0;
+
+    LOG_DEBUGF("[ChunkTuner] %u KB chunks: %lu KB/s", sizes[index] / 1024, rate[index] / 1024);
+
+    int before = currentIndex;
+    decide();
+    return currentIndex != before;
+}
+
+unsigned long ChunkSizeTuner::getMeasuredRate(size_t chunkSize) const {
+    int index = indexOf(chunkSize);
+    return index >= 0 ? rate[index] : 0;
+}
+
+void ChunkSizeTuner::moveTo(int index, const char* reason) {
+    LOGF("[ChunkTuner] %u KB -> %u KB (%s)", sizes[currentIndex] / 1024, sizes[index] / 1024,
+         reason);
+    currentIndex = index;
+    sampleBytes[index] = 0;
+    sampleMs[index] = 0;
+}
+
+void ChunkSizeTuner::decide() {
+    int up = currentIndex + 1;
+    int down = currentIndex - 1;
+    bool hasUp = up <= ceilingIndex;
+    bool hasDown = down >= 0;
+
+    if (settled) {
+        if (++decisionsSinceSettle < REPROBE_INTERVAL) {
+            return;
+        }
+        // Forget the other sizes so a changed link gets re-measured
+        for (int i = 0; i < NUM_SIZES; i++) {
+            if (i != currentIndex) {
+                rate[i] = 0;
+            }
+        }
+        settled = false;
+        decisionsSinceSettle = 0;
+        LOG_DEBUG("[ChunkTuner] Re-probing chunk sizes");
+    }
+
+    // Move to a measured neighbour that is clearly faster
+    unsigned long threshold = rate[currentIndex] + rate[currentIndex] / 100 * HYSTERESIS_PERCENT;
+    int best = -1;
+    if (hasUp && rate[up] > threshold) {
+        best = up;
+    }
+    if (hasDown && rate[down] > threshold && (best < 0 || rate[down] > rate[best])) {
+        best = down;
+    }
+    if (best >= 0) {
+        direction = best > currentIndex ? 1 : -1;
+        moveTo(best, "faster");
+        return;
+    }
+
+    // Probe unmeasured neighbours, current direction first
+    int next = currentIndex + direction;
+    if (next >= 0 && next <= ceilingIndex && rate[next] == 0) {
+        moveTo(next, "probing");
+        return;
+    }
+    int prev = currentIndex - direction;
+    if (prev >= 0 && prev <= ceilingIndex && rate[prev] == 0) {
+        direction = -direction;
+        moveTo(prev, "probing");
+        return;
+    }
+
+    settled = true;
+    decisionsSinceSettle = 0;
+    LOGF("[ChunkTuner] Settled on %u KB chunks (%lu KB/s)", sizes[currentIndex] / 1024,
+         rate[currentIndex] / 1024);
+}
@@ -6,6 +6,7 @@
 const char* Config::PREFS_NAMESPACE = "cpap_creds";
 const char* Config::PREFS_KEY_WIFI_PASS = "wifi_pass";
 const char* Config::PREFS_KEY_ENDPOINT_PASS = "endpoint_pass";
+const char* Config::PREFS_KEY_MIRROR_PASS = "mirror_pass";
 const char* Config::CENSORED_VALUE = "***STORED_IN_FLASH***";
 
 Config::Config() : 
@@ -16,6 +17,13 @@ Config::Config() :
     bootDelaySeconds(30),  // Default: 30 seconds
     sdReleaseIntervalSeconds(2),  // Default: 2 seconds
     sdReleaseWaitMs(500),  // Default: 500ms
+    smbWriteWindow(1),  // Default: synchronous writes
+    smbKeepaliveSeconds(60),  // Default: 1 minute
+    smbIdleTimeoutSeconds(900),  // Default: 15 minutes
+    datalogArchive(false),  // Default: one remote file per SD file
+    webdavTlsInsecure(false),  // Default: server certificates are verified
+    compressUploads(false),  // Default: files sent as stored on the SD card
+    compressionCodec("GZIP"),  // Default: readable with stock gzip
     isValid(false),
     storePlainText(false),  // Default: secure mode
     credentialsInFlash(false)  // Will be set during loadFromSD
@@ -113,6 +121,9 @@ bool Config::censorConfigFile(fs::FS &sd) {
     // Update credential fields with censored values
     doc["WIFI_PASS"] = CENSORED_VALUE;
     doc["ENDPOINT_PASS"] = CENSORED_VALUE;
+    if (!mirrorEndpointPassword.isEmpty()) {
+        doc["MIRROR_ENDPOINT_PASS"] = CENSORED_VALUE;
+    }
     
     LOG_DEBUG("Credential fields updated with censored values");
     
@@ -192,6 +203,16 @@ bool Config::migrateToSecureStorage(fs::FS &sd) {
         endpointStored = true;  // Skip if empty
     }
     
+    // Step 3b: Store MIRROR_ENDPOINT_PASS in Preferences (mirror configured)
+    if (!mirrorEndpointPassword.isEmpty()) {
+        LOG_DEBUG("Storing mirror endpoint password in Preferences...");
+        if (!storeCredential(PREFS_KEY_MIRROR_PASS, mirrorEndpointPassword)) {
+            LOG_ERROR("Failed to store mirror endpoint password in Preferences");
+            LOG("Migration aborted - keeping plain text credentials");
+            return false;
+        }
+    }
+    
     // Step 4: Verify credentials were stored correctly by reading back
     LOG_DEBUG("Verifying stored credentials...");
     bool verificationPassed = true;
@@ -216,6 +237,12 @@ bool Config::migrateToSecureStorage(fs::FS &sd) {
         }
     }
     
+    if (!mirrorEndpointPassword.isEmpty() &&
+        loadCredential(PREFS_KEY_MIRROR_PASS, "") != mirrorEndpointPassword) {
+        LOG_ERROR("Mirror endpoint password verification failed - stored value does not match");
+        verificationPassed = false;
+    }
+    
     if (!verificationPassed) {
         LOG_ERROR("Credential verification failed");
         LOG("Migration aborted - keeping plain text credentials");
@@ -295,6 +322,11 @@ bool Config::loadFromSD(fs::FS &sd) {
     endpointType = doc["ENDPOINT_TYPE"] | "";
     endpointUser = doc["ENDPOINT_USER"] | "";
     
+    // Optional second destination: every file also goes there (fan-out)
+    mirrorEndpointType = doc["MIRROR_ENDPOINT_TYPE"] | "";
+    mirrorEndpoint = doc["MIRROR_ENDPOINT"] | "";
+    mirrorEndpointUser = doc["MIRROR_ENDPOINT_USER"] | "";
+    
     // Parse new configuration fields with defaults
     uploadHour = doc["UPLOAD_HOUR"] | 12;
     sessionDurationSeconds = doc["SESSION_DURATION_SECONDS"] | 30;
@@ -304,12 +336,45 @@ bool Config::loadFromSD(fs::FS &sd) {
     sdReleaseIntervalSeconds = doc["SD_RELEASE_INTERVAL_SECONDS"] | 2;
     sdReleaseWaitMs = doc["SD_RELEASE_WAIT_MS"] | 500;
     
+    // Number of SMB writes kept in flight per file (1 = synchronous, max 8)
+    smbWriteWindow = doc["SMB_WRITE_WINDOW"] | 1;
+    if (smbWriteWindow < 1 || smbWriteWindow > 8) {
+        LOGF("WARNING: SMB_WRITE_WINDOW %d out of range (1-8), clamping", smbWriteWindow);
+        smbWriteWindow = smbWriteWindow < 1 ? 1 : 8;
+    }
+    
+    // SMB session reuse: keepalive echo interval and idle teardown
+    smbKeepaliveSeconds = doc["SMB_KEEPALIVE_SECONDS"] | 60;
+    smbIdleTimeoutSeconds = doc["SMB_IDLE_TIMEOUT_SECONDS"] | 900;
+    if (smbKeepaliveSeconds < 0) {
+        smbKeepaliveSeconds = 0;
+    }
+    if (smbIdleTimeoutSeconds < 0) {
+        smbIdleTimeoutSeconds = 0;
+    }
+    
+    // Bundle each DATALOG night folder into one .tar on the server
+    datalogArchive = doc["DATALOG_ARCHIVE"] | false;
+    
+    // Self-signed WebDAV server on the home network: skip the certificate check
+    webdavTlsInsecure = doc["WEBDAV_TLS_INSECURE"] | false;
+    
+    // Gzip DATALOG data on the way out (saves airtime on a busy link)
+    compressUploads = doc["COMPRESS_UPLOADS"] | false;
+    compressionCodec = doc["COMPRESSION_CODEC"] | "GZIP";
+    compressionCodec.toUpperCase();
+    if (compressionCodec != "GZIP" && compressionCodec != "EDF") {
+        LOGF("WARNING: Unknown COMPRESSION_CODEC '%s', using GZIP", compressionCodec.c_str());
+        compressionCodec = "GZIP";
+    }
+    
     // Step 4: Load credentials based on storage mode
     if (storePlainText) {
         // Plain text mode: Load credentials directly from config.json
         LOG_DEBUG("Loading credentials from config.json (plain text mode)");
         wifiPassword = doc["WIFI_PASS"] | "";
         endpointPassword = doc["ENDPOINT_PASS"] | "";
+        mirrorEndpointPassword = doc["MIRROR_ENDPOINT_PASS"] | "";
         credentialsInFlash = false;
         
         LOG_DEBUG("Credentials loaded from config.json");
@@ -324,6 +389,7 @@ bool Config::loadFromSD(fs::FS &sd) {
             LOG("Falling back to plain text mode for this session");
             wifiPassword = doc["WIFI_PASS"] | "";
             endpointPassword = doc["ENDPOINT_PASS"] | "";
+            mirrorEndpointPassword = doc["MIRROR_ENDPOINT_PASS"] | "";
             credentialsInFlash = false;
             storePlainText = true;  // Force plain text mode due to Preferences failure
         } else {
@@ -366,14 +432,25 @@ bool Config::loadFromSD(fs::FS &sd) {
                 endpointPassword = "";
             }
             
+            // Handle mirror endpoint password (absent without a mirror)
+            String configMirrorPass = doc["MIRROR_ENDPOINT_PASS"] | "";
+            bool mirrorCensored = isCensored(configMirrorPass);
+            if (mirrorCensored) {
+                LOG("Loading mirror endpoint password from flash memory (censored in config)");
+                mirrorEndpointPassword = loadCredential(PREFS_KEY_MIRROR_PASS, "");
+            } else {
+                mirrorEndpointPassword = configMirrorPass;
+            }
+            
             // Determine if we have any credentials in flash
-            credentialsInFlash = (wifiCensored || endpointCensored);
+            credentialsInFlash = (wifiCensored || endpointCensored || mirrorCensored);
             
             // Check if user provided any new credentials that need migration
             bool hasNewWifiCred = (!wifiCensored && !configWifiPass.isEmpty());
             bool hasNewEndpointCred = (!endpointCensored && !configEndpointPass.isEmpty());
+            bool hasNewMirrorCred = (!mirrorCensored && !configMirrorPass.isEmpty());
             
-            if (hasNewWifiCred || hasNewEndpointCred) {
+            if (hasNewWifiCred || hasNewEndpointCred || hasNewMirrorCred) {
                 // Attempt migration of new credentials
                 if (migrateToSecureStorage(sd)) {
                     LOG("New credentials migrated to secure storage successfully");
@@ -412,6 +489,18 @@ const String& Config::getEndpoint() const { return endpoint; }
 const String& Config::getEndpointType() const { return endpointType; }
 const String& Config::getEndpointUser() const { return endpointUser; }
 const String& Config::getEndpointPassword() const { return endpointPassword; }
+
+EndpointConfig Config::getPrimaryEndpoint() const {
+    EndpointConfig endpointConfig = {endpointType, endpoint, endpointUser, endpointPassword};
+    return endpointConfig;
+}
+
+EndpointConfig Config::getMirrorEndpoint() const {
+    EndpointConfig endpointConfig = {mirrorEndpointType, mirrorEndpoint, mirrorEndpointUser, mirrorEndpointPassword};
+    return endpointConfig;
+}
+
+bool Config::hasMirrorEndpoint() const { return !mirrorEndpointType.isEmpty(); }
 int Config::getUploadHour() const { return uploadHour; }
 int Config::getSessionDurationSeconds() const { return sessionDurationSeconds; }
 int Config::getMaxRetryAttempts() const { return maxRetryAttempts; }
@@ -419,6 +508,13 @@ int Config::getGmtOffsetHours() const { return gmtOffsetHours; }
 int Config::getBootDelaySeconds() const { return bootDelaySeconds; }
 int Config::getSdReleaseIntervalSeconds() const { return sdReleaseIntervalSeconds; }
 int Config::getSdReleaseWaitMs() const { return sdReleaseWaitMs; }
+int Config::getSmbWriteWindow() const { return smbWriteWindow; }
+int Config::getSmbKeepaliveSeconds() const { return smbKeepaliveSeconds; }
+int Config::getSmbIdleTimeoutSeconds() const { return smbIdleTimeoutSeconds; }
+bool Config::isDatalogArchiveEnabled() const { return datalogArchive; }
+bool Config::isWebdavTlsInsecure() const { return webdavTlsInsecure; }
+bool Config::isCompressionEnabled() const { return compressUploads; }
+const String& Config::getCompressionCodec() const { return compressionCodec; }
 bool Config::valid() const { return isValid; }
 
 // Credential storage mode getters
@@ -0,0 +1,350 @@
+#include "DatalogIndex.h"
+#include "Logger.h"
+#include "Crc32.h"
+#include "ByteOrder.h"
+#include <algorithm>
+
+static const uint8_t INDEX_MAGIC[4] = {'D', 'L', 'I', 'X'};
+
+// Days since 1970-01-01 of a calendar date and back (proleptic Gregorian)
+static long daysFromCivil(long y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long)doe - 719468;
+}
+
+static uint32_t civilFromDays(long z) {
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long y = (long)yoe + era * 400;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    unsigned m = mp + (mp < 10 ? 3 : -9);
+    y += m <= 2;
+    return (uint32_t)(y * 10000 + m * 100 + d);
+}
+
+static bool entryBefore(const DatalogIndex::Entry& entry, uint32_t date) {
+    return entry.date < date;
+}
+
+DatalogIndex::DatalogIndex(const String& filePath)
+    : indexFilePath(filePath),
+      indexId(0),
+      lastWalkTime(0),
+      dirty(false),
+      walking(false) {
+}
+
+bool DatalogIndex::readHeader(fs::File& file, uint32_t& id, uint32_t& walkTime, uint32_t& count) {
+    uint8_t header[HEADER_SIZE];
+    if (file.read(header, HEADER_SIZE) != HEADER_SIZE ||
+        memcmp(header, INDEX_MAGIC, 4) != 0 ||
+        getLE16(header + 4) != FORMAT_VERSION ||
+        getLE16(header + 6) != RECORD_SIZE) {
+        return false;
+    }
+    id = getLE32(header + 8);
+    walkTime = getLE32(header + 12);
+    count = getLE32(header + 16);
+    return id != 0 && file.size() == HEADER_SIZE + count * RECORD_SIZE + 4;
+}
+
+bool DatalogIndex::attach(fs::FS &sd) {
+    uint32_t id = 0;
+    uint32_t walkTime = 0;
+    uint32_t count = 0;
+    File file = sd.open(indexFilePath, FILE_READ);
+    bool valid = file && readHeader(file, id, walkTime, count);
+    if (file) {
+        file.close();
+    }
+
+    if (valid && id == indexId) {
+        return !isBuilt();  // The card the index was loaded from
+    }
+    if (valid && load(sd)) {
+        return !isBuilt();
+    }
+
+    if (indexId != 0) {
+        LOG("[DatalogIndex] Card has no matching index (swapped or removed), rebuilding");
+    } else {
+        LOG("[DatalogIndex] No usable index on the card, building it");
+    }
+    clear();
+    return true;
+}
+
+bool DatalogIndex::load(fs::FS &sd) {
+    File file = sd.open(indexFilePath, FILE_READ);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t id = 0;
+    uint32_t walkTime = 0;
+    uint32_t count = 0;
+    if (!readHeader(file, id, walkTime, count)) {
+        LOG_WARN("[DatalogIndex] Index file damaged or from another version, ignoring it");
+        file.close();
+        return false;
+    }
+
+    Crc32 crc;
+    uint8_t header[HEADER_SIZE];
+    memcpy(header, INDEX_MAGIC, 4);
+    putLE16(header + 4, FORMAT_VERSION);
+    putLE16(header + 6, RECORD_SIZE);
+    putLE32(header + 8, id);
+    putLE32(header + 12, walkTime);
+    putLE32(header + 16, count);
+    crc.update(header, HEADER_SIZE);
+
+    std::vector<Entry> records;
+    records.reserve(count);
+    uint8_t record[RECORD_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        if (file.read(record, RECORD_SIZE) != RECORD_SIZE) {
+            break;
+        }
+        crc.update(record, RECORD_SIZE);
+        Entry entry;
+        entry.date = getLE32(record);
+        entry.bytes = getLE32(record + 4);
+        entry.entries = getLE16(record + 8);
+        entry.state = record[10];
+        entry.listed = false;
+        if (!records.empty() && entry.date <= records.back().date) {
+            break;  // Out of order: not written by save()
+        }
+        records.push_back(entry);
+    }
+
+    uint8_t trailer[4];
+    bool intact = records.size() == count && file.read(trailer, 4) == 4 &&
+                  getLE32(trailer) == crc.getValue();
+    file.close();
+    if (!intact) {
+        LOG_WARN("[DatalogIndex] Index file failed its CRC check, ignoring it");
+        return false;
+    }
+
+    folders.swap(records);
+    indexId = id;
+    lastWalkTime = walkTime;
+    dirty = false;
+    walking = false;
+    LOG_DEBUGF("[DatalogIndex] Loaded index of %u DATALOG folders", folders.size());
+    return true;
+}
+
+bool DatalogIndex::save(fs::FS &sd) {
+    String tempFilePath = indexFilePath + ".tmp";
+    File file = sd.open(tempFilePath, FILE_WRITE);
+    if (!file) {
+        LOGF("[DatalogIndex] ERROR: Failed to open index file for writing: %s", tempFilePath.c_str());
+        return false;
+    }
+
+    Crc32 crc;
+    size_t written = 0;
+    uint8_t header[HEADER_SIZE];
+    memcpy(header, INDEX_MAGIC, 4);
+    putLE16(header + 4, FORMAT_VERSION);
+    putLE16(header + 6, RECORD_SIZE);
+    putLE32(header + 8, indexId);
+    putLE32(header + 12, lastWalkTime);
+    putLE32(header + 16, folders.size());
+    crc.update(header, HEADER_SIZE);
+    written += file.write(header, HEADER_SIZE);
+
+    uint8_t record[RECORD_SIZE];
+    for (const Entry& entry : folders) {
+        putLE32(record, entry.date);
+        putLE32(record + 4, entry.bytes);
+        putLE16(record + 8, entry.entries);
+        record[10] = entry.state;
+        record[11] = 0;
+        crc.update(record, RECORD_SIZE);
+        written += file.write(record, RECORD_SIZE);
+    }
+
+    uint8_t trailer[4];
+    putLE32(trailer, crc.getValue());
+    written += file.write(trailer, 4);
+    file.close();
+
+    if (written != HEADER_SIZE + folders.size() * RECORD_SIZE + 4) {
+        LOG("[DatalogIndex] ERROR: Failed to write index file");
+        sd.remove(tempFilePath);
+        return false;
+    }
+
+    if (sd.exists(indexFilePath)) {
+        sd.remove(indexFilePath);
+    }
+    if (!sd.rename(tempFilePath, indexFilePath)) {
+        LOG("[DatalogIndex] ERROR: Failed to rename temp index file");
+        sd.remove(tempFilePath);
+        return false;
+    }
+
+    dirty = false;
+    LOG_DEBUGF("[DatalogIndex] Index saved (%u folders, %u bytes)", folders.size(), written);
+    return true;
+}
+
+void DatalogIndex::clear() {
+    folders.clear();
+    walkPrevious.clear();
+    walking = false;
+    lastWalkTime = 0;
+    // A new id, so another card's index is never taken for this one
+    do {
+        indexId = (uint32_t)random(1, 0x7fffffff) ^ (uint32_t)time(NULL);
+    } while (indexId == 0);
+    dirty = true;
+}
+
+bool DatalogIndex::canProbe(time_t now) const {
+    if (now < 1000000000 || !isBuilt() || folders.empty()) {
+        return false;  // Clock unset, or nothing to count from
+    }
+    if ((uint32_t)now < lastWalkTime ||
+        (uint32_t)now - lastWalkTime >= (uint32_t)DATALOG_INDEX_RESCAN_DAYS * 86400) {
+        return false;
+    }
+    uint32_t tomorrow = addDays(dateOf(now), 1);
+    return addDays(getNewestDate(), DATALOG_INDEX_PROBE_DAYS) >= tomorrow;
+}
+
+std::vector<uint32_t> DatalogIndex::getProbeDates(time_t now) const {
+    std::vector<uint32_t> dates;
+    uint32_t tomorrow = addDays(dateOf(now), 1);
+    for (uint32_t date = addDays(getNewestDate(), 1);
+         date <= tomorrow && dates.size() < DATALOG_INDEX_PROBE_DAYS;
+         date = addDays(date, 1)) {
+        dates.push_back(date);
+    }
+    return dates;
+}
+
+void DatalogIndex::beginWalk() {
+    walkPrevious.swap(folders);
+    folders.clear();
+    walking = true;
+}
+
+void DatalogIndex::finishWalk(time_t now) {
+    if (!walking) {
+        return;
+    }
+    std::sort(folders.begin(), folders.end(), [](const Entry& a, const Entry& b) {
+        return a.date < b.date;
+    });
+    walkPrevious.clear();
+    walking = false;
+    lastWalkTime = now >= 1000000000 ? (uint32_t)now : 1;  // 1 = built, time unknown
+    dirty = true;
+}
+
+bool DatalogIndex::addFolder(uint32_t date) {
+    if (walking) {
+        // Keep what the previous listing found; appended, sorted at the end
+        auto it = std::lower_bound(walkPrevious.begin(), walkPrevious.end(), date, entryBefore);
+        if (it != walkPrevious.end() && it->date == date) {
+            folders.push_back(*it);
+            return false;
+        }
+        Entry entry = {date, 0, 0, FOLDER_NEW, false};
+        folders.push_back(entry);
+        return true;
+    }
+
+    auto it = std::lower_bound(folders.begin(), folders.end(), date, entryBefore);
+    if (it != folders.end() && it->date == date) {
+        return false;
+    }
+    Entry entry = {date, 0, 0, FOLDER_NEW, false};
+    folders.insert(it, entry);
+    dirty = true;
+    return true;
+}
+
+void DatalogIndex::recordListing(uint32_t date, size_t entries, unsigned long bytes) {
+    Entry* entry = find(date);
+    if (!entry) {
+        return;  // Not a folder of this card's index (yet)
+    }
+    uint8_t state = entries > 0 ? FOLDER_HAS_FILES : FOLDER_EMPTY;
+    uint16_t count = entries > 0xffff ? 0xffff : (uint16_t)entries;
+    if (entry->state != state || entry->entries != count || entry->bytes != (uint32_t)bytes) {
+        entry->state = state;
+        entry->entries = count;
+        entry->bytes = (uint32_t)bytes;
+        dirty = true;
+    }
+    entry->listed = true;
+}
+
+void DatalogIndex::resetListed() {
+    for (Entry& entry : folders) {
+        entry.listed = false;
+    }
+}
+
+DatalogIndex::Entry* DatalogIndex::find(uint32_t date) {
+    if (walking) {
+        return nullptr;
+    }
+    auto it = std::lower_bound(folders.begin(), folders.end(), date, entryBefore);
+    return (it != folders.end() && it->date == date) ? &*it : nullptr;
+}
+
+uint32_t DatalogIndex::parseFolderName(const String& name) {
+    if (name.length() != 8) {
+        return 0;
+    }
+    uint32_t date = 0;
+    for (int i = 0; i < 8; i++) {
+        char c = name.c_str()[i];
+        if (c < '0' || c > '9') {
+            return 0;
+        }
+        date = date * 10 + (c - '0');
+    }
+    uint32_t month = (date / 100) % 100;
+    uint32_t day = date % 100;
+    if (month < 1 || month > 12 || day < 1 || day > 31) {
+        return 0;
+    }
+    return date;
+}
+
+String DatalogIndex::folderName(uint32_t date) {
+    char name[12];
+    snprintf(name, sizeof(name), "%08lu", (unsigned long)date);
+    return String(name);
+}
+
+uint32_t DatalogIndex::addDays(uint32_t date, int days) {
+    long y = date / 10000;
+    unsigned m = (date / 100) % 100;
+    unsigned d = date % 100;
+    return civilFromDays(daysFromCivil(y, m, d) + days);
+}
+
+uint32_t DatalogIndex::dateOf(time_t time) {
+    struct tm timeinfo;
+    if (!localtime_r(&time, &timeinfo)) {
+        return 0;
+    }
+    return (uint32_t)((timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday);
+}
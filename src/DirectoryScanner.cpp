@@ -0,0 +1,99 @@
+#include "DirectoryScanner.h"
+
+#ifndef UNIT_TEST
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef UNIT_TEST
+
+bool DirectoryScanner::scan(fs::FS &sd, const String& path, std::vector<DirEntry>& entries,
+                            int options, NameFilter filter) {
+    std::vector<MockFS::DirRecord> records;
+    if (!sd.readDir(path, records)) {
+        return false;
+    }
+
+    String prefix = path.endsWith("/") ? path : path + "/";
+    for (const MockFS::DirRecord& record : records) {
+        if (((options & FILES_ONLY) && record.isDirectory) ||
+            ((options & DIRECTORIES_ONLY) && !record.isDirectory) ||
+            (filter && !filter(record.name))) {
+            continue;
+        }
+
+        DirEntry entry;
+        entry.name = record.name;
+        entry.size = 0;
+        entry.lastWrite = 0;
+        entry.isDirectory = record.isDirectory;
+        if ((options & WITH_STAT) && !record.isDirectory) {
+            size_t size = 0;
+            time_t lastWrite = 0;
+            if (sd.stat(prefix + record.name, size, lastWrite)) {
+                entry.size = size;
+                entry.lastWrite = lastWrite;
+            }
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+#else
+
+bool DirectoryScanner::scan(fs::FS &sd, const String& path, std::vector<DirEntry>& entries,
+                            int options, NameFilter filter) {
+    (void)sd;  // Reached through the VFS at SD_MOUNT_POINT
+    String dirPath = String(SD_MOUNT_POINT) + path;
+    DIR* dir = opendir(dirPath.c_str());
+    if (!dir) {
+        return false;
+    }
+
+    String prefix = dirPath.endsWith("/") ? dirPath : dirPath + "/";
+    struct dirent* de;
+    while ((de = readdir(dir)) != nullptr) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+
+        DirEntry entry;
+        entry.name = de->d_name;
+        entry.size = 0;
+        entry.lastWrite = 0;
+
+        // FAT fills in d_type; stat() only if a driver leaves it unknown
+        struct stat st;
+        bool haveStat = false;
+        if (de->d_type == DT_DIR) {
+            entry.isDirectory = true;
+        } else if (de->d_type == DT_REG) {
+            entry.isDirectory = false;
+        } else {
+            haveStat = stat((prefix + entry.name).c_str(), &st) == 0;
+            entry.isDirectory = haveStat && S_ISDIR(st.st_mode);
+        }
+
+        if (((options & FILES_ONLY) && entry.isDirectory) ||
+            ((options & DIRECTORIES_ONLY) && !entry.isDirectory) ||
+            (filter && !filter(entry.name))) {
+            continue;
+        }
+
+        if ((options & WITH_STAT) && !entry.isDirectory) {
+            if (!haveStat) {
+                haveStat = stat((prefix + entry.name).c_str(), &st) == 0;
+            }
+            if (haveStat) {
+                entry.size = st.st_size;
+                entry.lastWrite = st.st_mtime;
+            }
+        }
+        entries.push_back(entry);
+    }
+    closedir(dir);
+    return true;
+}
+
+#endif
@@ -0,0 +1,391 @@
+#include "EdfCodec.h"
+#include "Logger.h"
+
+static const uint8_t EDZ_MAGIC[4] = {'E', 'D', 'Z', '1'};
+static const size_t EDF_FIXED_HEADER = 256;
+
+// Zigzag keeps small negative deltas small: 0, -1, 1, -2, 2 -> 0, 1, 2, 3, 4
+static inline uint32_t zigzag(int32_t value) {
+    return value >= 0 ? (uint32_t)value << 1 : (((uint32_t)(-value)) << 1) - 1;
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return (value & 1) ? -(int32_t)((value + 1) >> 1) : (int32_t)(value >> 1);
+}
+
+// Linear prediction once it has been the better guess lately
+int32_t EdfCodec::predict(const Signal& signal) {
+    if (signal.cost2 < signal.cost1) {
+        return 2 * (int32_t)signal.previous - signal.previous2;
+    }
+    return signal.previous;
+}
+
+// Update the predictor history with the actual sample (encoder and decoder alike)
+void EdfCodec::advance(Signal& signal, int16_t sample) {
+    int32_t error1 = (int32_t)sample - signal.previous;
+    int32_t error2 = (int32_t)sample - (2 * (int32_t)signal.previous - signal.previous2);
+    // Exponential average over roughly the last 16 samples
+    signal.cost1 = signal.cost1 - (signal.cost1 >> 4) + (uint32_t)(error1 < 0 ? -error1 : error1);
+    signal.cost2 = signal.cost2 - (signal.cost2 >> 4) + (uint32_t)(error2 < 0 ? -error2 : error2);
+    signal.previous2 = signal.previous;
+    signal.previous = sample;
+}
+
+void EdfCodec::resetSignal(Signal& signal) {
+    signal.previous = 0;
+    signal.previous2 = 0;
+    signal.cost1 = 0;
+    signal.cost2 = 0;
+}
+
+// Parse a space-padded ASCII number field of an EDF header
+static unsigned long parseField(const uint8_t* field, size_t width) {
+    char text[17];
+    size_t n = width < sizeof(text) - 1 ? width : sizeof(text) - 1;
+    memcpy(text, field, n);
+    text[n] = '\0';
+    return strtoul(text, nullptr, 10);
+}
+
+EdfCodec::EdfCodec(UploadSource& input, size_t inputSize)
+    : input(input),
+      inputSize(inputSize),
+      inputConsumed(0),
+      outputProduced(0),
+      failed(false),
+      stage(STAGE_START),
+      recordBytesLeft(0),
+      signalIndex(0),
+      sampleIndex(0),
+      zeroRun(0),
+      outOffset(0) {
+}
+
+bool EdfCodec::readInput(uint8_t* buffer, size_t len) {
+    while (len > 0) {
+        size_t bytesRead = input.read(buffer, len);
+        if (bytesRead == 0) {
+            LOGF("[EdfCodec] ERROR: Input ended after %u of %u bytes",
+                 (unsigned)inputConsumed, (unsigned)inputSize);
+            failed = true;
+            return false;
+        }
+        crc.update(buffer, bytesRead);
+        inputConsumed += bytesRead;
+        buffer += bytesRead;
+        len -= bytesRead;
+    }
+    return true;
+}
+
+// Signal table from a complete EDF header
+bool EdfCodec::parseHeader(const std::vector<uint8_t>& header) {
+    size_t count = (header.size() - EDF_FIXED_HEADER) / EDF_FIXED_HEADER;
+    unsigned long samplesPerRecord = 0;
+
+    signals.clear();
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* label = header.data() + EDF_FIXED_HEADER + i * 16;
+        unsigned long samples = parseField(header.data() + EDF_FIXED_HEADER + count * 216 + i * 8, 8);
+        if (samples > 0xFFFF) {
+            return false;
+        }
+
+        Signal signal;
+        bool text = memcmp(label, "EDF Annotations", 15) == 0 || memcmp(label, "Crc16", 5) == 0;
+        signal.mode = text ? MODE_RAW : MODE_DELTA;  // Deltas only help on sampled signals
+        signal.samples = samples;
+        resetSignal(signal);
+        signals.push_back(signal);
+        samplesPerRecord += samples;
+    }
+    return samplesPerRecord > 0;
+}
+
+// Read and parse the header, then queue the stream preamble
+void EdfCodec::start() {
+    std::vector<uint8_t> header(inputSize < EDF_FIXED_HEADER ? inputSize : EDF_FIXED_HEADER);
+    if (!readInput(header.data(), header.size())) {
+        return;
+    }
+
+    bool edf = false;
+    if (header.size() == EDF_FIXED_HEADER) {
+        unsigned long headerBytes = parseField(header.data() + 184, 8);
+        unsigned long count = parseField(header.data() + 252, 4);
+        if (count >= 1 && count <= EDF_CODEC_MAX_SIGNALS &&
+            headerBytes == EDF_FIXED_HEADER * (count + 1) && headerBytes <= inputSize) {
+            header.resize(headerBytes);
+            if (!readInput(header.data() + EDF_FIXED_HEADER, headerBytes - EDF_FIXED_HEADER)) {
+                return;
+            }
+            edf = parseHeader(header);
+        }
+    }
+    if (!edf) {
+        signals.clear();  // Verbatim
+    }
+
+    out.insert(out.end(), EDZ_MAGIC, EDZ_MAGIC + sizeof(EDZ_MAGIC));
+    putLE(inputSize, 4);
+    putLE(header.size(), 4);
+    putLE(signals.size(), 2);
+    size_t recordBytes = 0;
+    for (const Signal& signal : signals) {
+        out.push_back(signal.mode);
+        putLE(signal.samples, 2);
+        recordBytes += 2 * signal.samples;
+    }
+    out.insert(out.end(), header.begin(), header.end());
+
+    // Only complete records are coded; a record still being written goes verbatim
+    if (recordBytes > 0) {
+        recordBytesLeft = (inputSize - header.size()) / recordBytes * recordBytes;
+    }
+    stage = recordBytesLeft > 0 ? STAGE_RECORDS : STAGE_TAIL;
+
+    LOG_DEBUGF("[EdfCodec] %u signals, %u header bytes, %u record bytes",
+               (unsigned)signals.size(), (unsigned)header.size(), (unsigned)recordBytes);
+}
+
+void EdfCodec::codeRecords() {
+    uint8_t chunk[INPUT_CHUNK];
+
+    while (out.size() < OUTPUT_TARGET && recordBytesLeft > 0) {
+        // Record sizes are even, so a chunk never splits a sample
+        size_t n = recordBytesLeft < INPUT_CHUNK ? recordBytesLeft : INPUT_CHUNK;
+        if (!readInput(chunk, n)) {
+            return;
+        }
+        recordBytesLeft -= n;
+        for (size_t i = 0; i < n; i += 2) {
+            codeSample((int16_t)(chunk[i] | (chunk[i + 1] << 8)));
+        }
+    }
+
+    if (recordBytesLeft == 0) {
+        stage = STAGE_TAIL;
+    }
+}
+
+void EdfCodec::codeSample(int16_t sample) {
+    while (signals[signalIndex].samples == 0) {
+        signalIndex = (signalIndex + 1) % signals.size();
+    }
+    Signal& signal = signals[signalIndex];
+
+    if (signal.mode == MODE_RAW) {
+        out.push_back((uint16_t)sample & 0xFF);
+        out.push_back((uint16_t)sample >> 8);
+    } else {
+        int32_t error = (int32_t)sample - predict(signal);
+        if (error == 0) {
+            zeroRun++;
+        } else {
+            flushZeroRun();
+            putVarint(zigzag(error) << 1);
+        }
+        advance(signal, sample);
+    }
+
+    // End of this signal's block in the record
+    if (++sampleIndex == signal.samples) {
+        flushZeroRun();
+        sampleIndex = 0;
+        signalIndex = (signalIndex + 1) % signals.size();
+    }
+}
+
+void EdfCodec::flushZeroRun() {
+    if (zeroRun == 1) {
+        putVarint(0);  // Single exact prediction
+    } else if (zeroRun >= 2) {
+        putVarint(((zeroRun - 2) << 1) | 1);
+    }
+    zeroRun = 0;
+}
+
+void EdfCodec::putVarint(uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+void EdfCodec::putLE(uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+size_t EdfCodec::read(uint8_t* buffer, size_t len) {
+    size_t produced = 0;
+    while (produced < len) {
+        if (outOffset < out.size()) {
+            size_t available = out.size() - outOffset;
+            size_t n = (len - produced) < available ? (len - produced) : available;
+            memcpy(buffer + produced, out.data() + outOffset, n);
+            outOffset += n;
+            produced += n;
+            continue;
+        }
+        if (failed || stage == STAGE_DONE) {
+            break;
+        }
+
+        out.clear();
+        outOffset = 0;
+
+        switch (stage) {
+            case STAGE_START:
+                start();
+                break;
+
+            case STAGE_RECORDS:
+                codeRecords();
+                break;
+
+            case STAGE_TAIL: {
+                size_t left = inputSize - inputConsumed;
+                size_t n = left < OUTPUT_TARGET ? left : OUTPUT_TARGET;
+                if (n == 0) {
+                    stage = STAGE_TRAILER;
+                    break;
+                }
+                out.resize(n);
+                if (!readInput(out.data(), n)) {
+                    out.clear();
+                }
+                break;
+            }
+
+            case STAGE_TRAILER:
+                putLE(crc.getValue(), 4);
+                stage = STAGE_DONE;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    outputProduced += produced;
+    return produced;
+}
+
+// Bounds-checked reader for decode()
+struct EdzReader {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    bool ok;
+
+    uint32_t le(int bytes) {
+        uint32_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= (uint32_t)byte() << (8 * i);
+        }
+        return value;
+    }
+
+    uint8_t byte() {
+        if (pos >= len) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    uint32_t varint() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 32; shift += 7) {
+            uint8_t b = byte();
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+bool EdfCodec::decode(const uint8_t* data, size_t len, std::vector<uint8_t>& out) {
+    out.clear();
+    EdzReader in = {data, len, 0, true};
+
+    if (len < 14 || memcmp(data, EDZ_MAGIC, sizeof(EDZ_MAGIC)) != 0) {
+        return false;
+    }
+    in.pos = sizeof(EDZ_MAGIC);
+    size_t rawSize = in.le(4);
+    size_t headerLength = in.le(4);
+    size_t count = in.le(2);
+
+    std::vector<Signal> table(count);
+    size_t recordBytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        table[i].mode = in.byte();
+        table[i].samples = in.le(2);
+        resetSignal(table[i]);
+        if (table[i].mode > MODE_DELTA) {
+            return false;
+        }
+        recordBytes += 2 * table[i].samples;
+    }
+    if (!in.ok || headerLength > rawSize || headerLength > len - in.pos || (count > 0 && recordBytes == 0)) {
+        return false;
+    }
+
+    out.reserve(rawSize);
+    out.insert(out.end(), data + in.pos, data + in.pos + headerLength);
+    in.pos += headerLength;
+
+    size_t records = count > 0 ? (rawSize - headerLength) / recordBytes : 0;
+    for (size_t r = 0; r < records && in.ok; r++) {
+        for (Signal& signal : table) {
+            size_t done = 0;
+            while (done < signal.samples && in.ok) {
+                if (signal.mode == MODE_RAW) {
+                    out.push_back(in.byte());
+                    out.push_back(in.byte());
+                    done++;
+                    continue;
+                }
+
+                uint32_t token = in.varint();
+                size_t repeat = 1;
+                int32_t error = 0;
+                if (token & 1) {
+                    repeat = (token >> 1) + 2;  // Run of exact predictions
+                } else {
+                    error = unzigzag(token >> 1);
+                }
+                if (done + repeat > signal.samples) {
+                    return false;
+                }
+                for (size_t k = 0; k < repeat; k++) {
+                    int16_t sample = (int16_t)(predict(signal) + error);
+                    out.push_back((uint16_t)sample & 0xFF);
+                    out.push_back((uint16_t)sample >> 8);
+                    advance(signal, sample);
+                }
+                done += repeat;
+            }
+        }
+    }
+    if (!in.ok || out.size() > rawSize) {
+        return false;
+    }
+
+    // Verbatim tail, then the CRC
+    size_t tail = rawSize - out.size();
+    if (in.pos + tail + 4 != len) {
+        return false;
+    }
+    out.insert(out.end(), data + in.pos, data + in.pos + tail);
+    in.pos += tail;
+    return in.le(4) == Crc32::compute(0, out.data(), out.size());
+}
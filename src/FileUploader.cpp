@@ -1,6 +1,13 @@
 #include "FileUploader.h"
 #include "Logger.h"
-#include <SD_MMC.h>
+#include "BufferPool.h"
+#include "TarArchiveSource.h"
+#include "GzipSource.h"
+#include "EdfCodec.h"
+#include "UploadPipeline.h"
+#include "Md5Digest.h"
+#include "DirectoryScanner.h"
+#include <algorithm>
 
 #ifdef ENABLE_TEST_WEBSERVER
 #include "TestWebServer.h"
@@ -16,33 +23,20 @@ FileUploader::FileUploader(Config* cfg, WiFiManager* wifi)
 #ifdef ENABLE_TEST_WEBSERVER
       webServer(nullptr),
 #endif
-      lastSdReleaseTime(0)
-#ifdef ENABLE_SMB_UPLOAD
-      , smbUploader(nullptr)
-#endif
-#ifdef ENABLE_WEBDAV_UPLOAD
-      , webdavUploader(nullptr)
-#endif
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-      , sleephqUploader(nullptr)
-#endif
+      lastSdReleaseTime(0),
+      backend(nullptr),
+      datalogIndexFresh(false)
 {
 }
 
 // Destructor
 FileUploader::~FileUploader() {
-    if (stateManager) delete stateManager;
+    for (const UploadTarget& target : targets) {
+        if (target.backend) delete target.backend;
+        if (target.state) delete target.state;
+    }
     if (budgetManager) delete budgetManager;
     if (scheduleManager) delete scheduleManager;
-#ifdef ENABLE_SMB_UPLOAD
-    if (smbUploader) delete smbUploader;
-#endif
-#ifdef ENABLE_WEBDAV_UPLOAD
-    if (webdavUploader) delete webdavUploader;
-#endif
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-    if (sleephqUploader) delete sleephqUploader;
-#endif
 }
 
 // Initialize all components and load upload state
@@ -55,6 +49,8 @@ bool FileUploader::begin(fs::FS &sd) {
         LOG("[FileUploader] WARNING: Failed to load upload state, starting fresh");
         // Continue anyway - stateManager will work with empty state
     }
+    UploadTarget primary = {nullptr, stateManager, true};
+    targets.push_back(primary);
     
     // Initialize TimeBudgetManager
     budgetManager = new TimeBudgetManager();
@@ -71,70 +67,273 @@ bool FileUploader::begin(fs::FS &sd) {
     // Restore last upload timestamp from state
     scheduleManager->setLastUploadTimestamp(stateManager->getLastUploadTimestamp());
     
-    // Initialize appropriate uploader based on endpoint type and build flags
+    // Initialize the backend for the endpoint type (available types depend on build flags)
     String endpointType = config->getEndpointType();
     LOGF("[FileUploader] Endpoint type: %s", endpointType.c_str());
     
-#ifdef ENABLE_SMB_UPLOAD
-    if (endpointType == "SMB") {
-        smbUploader = new SMBUploader(
-            config->getEndpoint(),
-            config->getEndpointUser(),
-            config->getEndpointPassword()
-        );
-        
-        // Note: We don't call begin() here because we may not have WiFi yet
-        // Connection will be established when needed during upload
-        LOG("[FileUploader] SMBUploader created (will connect during upload)");
-    } else
-#endif
-#ifdef ENABLE_WEBDAV_UPLOAD
-    if (endpointType == "WEBDAV") {
-        webdavUploader = new WebDAVUploader(
-            config->getEndpoint(),
-            config->getEndpointUser(),
-            config->getEndpointPassword()
-        );
-        
-        LOG("[FileUploader] WebDAVUploader created (will connect during upload)");
-    } else
-#endif
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-    if (endpointType == "SLEEPHQ") {
-        sleephqUploader = new SleepHQUploader(
-            config->getEndpoint(),
-            config->getEndpointUser(),
-            config->getEndpointPassword()
-        );
-        
-        LOG("[FileUploader] SleepHQUploader created (will connect during upload)");
-    } else
-#endif
-    {
+    UploadBackendRegistry& registry = UploadBackendRegistry::getInstance();
+    backend = registry.create(config->getPrimaryEndpoint(), *config);
+    if (!backend) {
         LOGF("[FileUploader] ERROR: Unsupported or disabled endpoint type: %s", endpointType.c_str());
-        LOG("[FileUploader] Supported types (based on build flags):");
-#ifdef ENABLE_SMB_UPLOAD
-        LOG("[FileUploader]   - SMB (enabled)");
-#else
-        LOG("[FileUploader]   - SMB (disabled - compile with -DENABLE_SMB_UPLOAD)");
-#endif
-#ifdef ENABLE_WEBDAV_UPLOAD
-        LOG("[FileUploader]   - WEBDAV (enabled)");
-#else
-        LOG("[FileUploader]   - WEBDAV (disabled - compile with -DENABLE_WEBDAV_UPLOAD)");
-#endif
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-        LOG("[FileUploader]   - SLEEPHQ (enabled)");
-#else
-        LOG("[FileUploader]   - SLEEPHQ (disabled - compile with -DENABLE_SLEEPHQ_UPLOAD)");
-#endif
+        LOGF("[FileUploader] Supported types (based on build flags): %s", registry.getTypes().c_str());
+        LOG("[FileUploader] Enable others with -DENABLE_SMB_UPLOAD, -DENABLE_WEBDAV_UPLOAD, -DENABLE_SLEEPHQ_UPLOAD or -DENABLE_TCP_UPLOAD");
         return false;
     }
+    targets[0].backend = backend;
+    
+    // Note: We don't connect here because we may not have WiFi yet
+    // Connection will be established when needed during upload
+    LOGF("[FileUploader] %s backend created (will connect during upload)", backend->getName());
+    
+    // Optional mirror: same files, own backend and own upload state
+    if (config->hasMirrorEndpoint()) {
+        EndpointConfig mirror = config->getMirrorEndpoint();
+        UploadTarget target = {registry.create(mirror, *config), new UploadStateManager("/.upload_state_mirror.bin"), true};
+        targets.push_back(target);
+        if (!target.backend) {
+            LOGF("[FileUploader] ERROR: Unsupported or disabled mirror endpoint type: %s", mirror.type.c_str());
+            LOGF("[FileUploader] Supported types (based on build flags): %s", registry.getTypes().c_str());
+            return false;
+        }
+        if (!target.state->begin(sd)) {
+            LOG("[FileUploader] WARNING: Failed to load mirror upload state, starting fresh");
+        }
+        LOGF("[FileUploader] %s mirror backend created, files are read once for both endpoints",
+             target.backend->getName());
+    }
     
     LOG("[FileUploader] Initialization complete");
     return true;
 }
 
+// Clear upload state without tearing down uploaders (keeps network sessions alive)
+bool FileUploader::resetState(fs::FS &sd) {
+    if (targets.empty()) {
+        return false;
+    }
+    
+    bool success = true;
+    for (const UploadTarget& target : targets) {
+        if (!target.state->reset(sd)) {
+            success = false;
+        }
+    }
+    scheduleManager->setLastUploadTimestamp(targets[0].state->getLastUploadTimestamp());
+    return success;
+}
+
+// Point the single-target upload code (backend, stateManager) at a target
+void FileUploader::selectTarget(size_t index) {
+    backend = targets[index].backend;
+    stateManager = targets[index].state;
+}
+
+// True if a target can take its DATALOG files from a shared read: whole
+// files pushed as they are. Archive and compression modes generate their
+// own streams, so such targets read the SD card on their own.
+bool FileUploader::canShareRead(size_t index) {
+    UploadBackend* target = targets[index].backend;
+    if (!target->supportsPush()) {
+        return false;
+    }
+    bool transformed = config->isDatalogArchiveEnabled() || config->isCompressionEnabled();
+    return !(transformed && target->supportsStreams());
+}
+
+// Leave a failed target out of the rest of the session; its folder is
+// retried next session, the other targets carry on
+void FileUploader::dropTarget(fs::FS &sd, size_t index) {
+    UploadTarget& target = targets[index];
+    target.state->incrementCurrentRetryCount();
+    if (!target.state->save(sd)) {
+        LOG_WARN("[FileUploader] Failed to save state after upload error");
+    }
+    target.active = false;
+    LOGF("[FileUploader] %s endpoint skipped for the rest of this session", target.backend->getName());
+}
+
+// True if the active backend can continue a file from a byte offset
+// (planning only: the upload itself connects)
+bool FileUploader::supportsResume() const {
+    return backend && backend->supportsResume();
+}
+
+// True while the machine may still be recording a DATALOG night: the newest
+// folder, or yesterday's or today's. Such a folder stays open (not marked
+// completed) and is looked at again each session until a newer night exists.
+bool FileUploader::isNightOpen(uint32_t date) const {
+    if (date == 0) {
+        return false;
+    }
+    if (date >= datalogIndex.getNewestDate()) {
+        return true;
+    }
+    time_t now = time(NULL);
+    return now >= 1000000000 && date >= DatalogIndex::addDays(DatalogIndex::dateOf(now), -1);
+}
+
+// Growing EDF files only ever get records appended, so they are uploaded in
+// append mode: STR.edf, and the DATALOG files of an open night. A closed
+// night's files are final and need no length and tail record.
+bool FileUploader::isAppendOnlyFile(const String& filePath) const {
+    if (!filePath.startsWith("/DATALOG/")) {
+        return filePath == "/STR.edf" || filePath == "/STR.EDF";
+    }
+    if (!filePath.endsWith(".edf") && !filePath.endsWith(".EDF")) {
+        return false;
+    }
+    return isNightOpen(DatalogIndex::parseFolderName(filePath.substring(9, 17)));
+}
+
+// Change check for root files: tail check for growing files, size and
+// timestamp otherwise (the checksum was recorded when the file was sent)
+bool FileUploader::hasRootFileChanged(fs::FS &sd, const String& filePath) {
+    if (!isAppendOnlyFile(filePath)) {
+        return stateManager->hasFileChangedQuick(sd, filePath);
+    }
+    
+    File file = sd.open(filePath);
+    if (!file) {
+        return false;
+    }
+    unsigned long fileSize = file.size();
+    file.close();
+    
+    unsigned long appendOffset = 0;
+    return stateManager->checkAppend(sd, filePath, fileSize, appendOffset) != UploadStateManager::APPEND_UNCHANGED;
+}
+
+// Decide where a file's upload starts in this session
+// Growing files continue after the bytes already on the server (appendOffset),
+// any file continues from an interrupted-upload checkpoint. startOffset is the
+// later of the two. Returns false if a growing file is unchanged.
+bool FileUploader::planStartOffset(fs::FS &sd, const String& filePath, unsigned long fileSize,
+                                   unsigned long& startOffset, unsigned long& appendOffset) {
+    startOffset = 0;
+    appendOffset = 0;
+    
+    // A file sent while its night was open keeps its record until the folder
+    // is closed, so what is already on the server is not sent again
+    if (isAppendOnlyFile(filePath) || stateManager->hasUploadedLength(filePath)) {
+        UploadStateManager::AppendStatus status = stateManager->checkAppend(sd, filePath, fileSize, appendOffset);
+        if (status == UploadStateManager::APPEND_UNCHANGED) {
+            return false;
+        }
+        if (!supportsResume() || !backend->supportsAppend()) {
+            appendOffset = 0;  // Backend can only rewrite whole files
+        }
+        if (appendOffset > 0) {
+            LOGF("[FileUploader] Appending %lu new bytes to %s (%lu already uploaded)",
+                 fileSize - appendOffset, filePath.c_str(), appendOffset);
+        }
+    }
+    
+    unsigned long resumeOffset = supportsResume() ? stateManager->getResumeOffset(filePath, fileSize) : 0;
+    startOffset = resumeOffset > appendOffset ? resumeOffset : appendOffset;
+    return true;
+}
+
+// Read the header length of an EDF file (bytes 184-191, ASCII)
+// Returns 0 if the file does not carry a valid EDF header
+unsigned long FileUploader::readEdfHeaderLength(fs::FS &sd, const String& filePath) {
+    File file = sd.open(filePath, FILE_READ);
+    if (!file) {
+        return 0;
+    }
+    
+    char field[9] = {0};
+    bool ok = file.seek(184) && file.read((uint8_t*)field, 8) == 8;
+    file.close();
+    if (!ok) {
+        return 0;
+    }
+    
+    unsigned long headerBytes = strtoul(field, nullptr, 10);
+    
+    // 256-byte fixed header plus 256 bytes per signal
+    if (headerBytes < 256 || headerBytes % 256 != 0) {
+        return 0;
+    }
+    return headerBytes;
+}
+
+// After appending, rewrite the EDF header in place (its record count changes
+// as records are added). If the remote copy cannot be patched, the append
+// record is dropped so the next session sends the whole file.
+bool FileUploader::refreshAppendedHeader(fs::FS &sd, const String& localPath,
+                                         const String& remotePath, unsigned long appendOffset) {
+    unsigned long headerBytes = readEdfHeaderLength(sd, localPath);
+    if (headerBytes == 0 || headerBytes > appendOffset) {
+        return true;  // No header inside the already-uploaded prefix
+    }
+    
+    if (backend && backend->patchRange(localPath, remotePath, sd, 0, headerBytes)) {
+        return true;
+    }
+    
+    LOG_WARNF("[FileUploader] Could not refresh header of %s, will upload whole file next time",
+              localPath.c_str());
+    stateManager->clearUploadedLength(localPath);
+    return false;
+}
+
+// Decide how many bytes of a file to send in this session
+// Returns the whole remainder if it fits the budget, a budget-sized slice if the
+// backend can resume later, or 0 if the file has to wait for the next session
+unsigned long FileUploader::planUploadBytes(unsigned long remainingBytes) {
+    if (budgetManager->canUploadFile(remainingBytes)) {
+        return remainingBytes;
+    }
+    
+    if (!supportsResume()) {
+        return 0;
+    }
+    
+    // Too small a slice costs more in session setup than it moves
+    unsigned long budgetBytes = budgetManager->estimateBytesInRemainingBudget();
+    if (budgetBytes < MIN_PARTIAL_UPLOAD_BYTES) {
+        return 0;
+    }
+    
+    LOGF("[FileUploader] Budget allows %lu of %lu remaining bytes - sending partial file",
+         budgetBytes, remainingBytes);
+    return budgetBytes;
+}
+
+// Record how far an upload got so the next attempt can resume there
+// Returns true if the whole file is now on the server
+bool FileUploader::updateUploadCheckpoint(const String& filePath, unsigned long fileSize,
+                                          unsigned long resumeOffset, unsigned long bytesTransferred,
+                                          bool uploadSuccess) {
+    unsigned long committed = resumeOffset + bytesTransferred;
+    
+    if (uploadSuccess && committed >= fileSize) {
+        if (stateManager->getCheckpointPath() == filePath) {
+            stateManager->clearUploadCheckpoint();
+        }
+        return true;
+    }
+    
+    if (supportsResume() && committed > 0) {
+        stateManager->setUploadCheckpoint(filePath, fileSize, committed);
+    }
+    return false;
+}
+
+// Keep idle network sessions healthy between upload sessions
+void FileUploader::maintainConnections() {
+    for (const UploadTarget& target : targets) {
+        if (target.backend && target.backend->isConnected()) {
+            if (!wifiManager || !wifiManager->isConnected()) {
+                LOGF("[FileUploader] WiFi lost, closing %s session", target.backend->getName());
+                target.backend->end();
+                continue;
+            }
+            target.backend->maintain();
+        }
+    }
+}
+
 // Check if it's time to upload
 bool FileUploader::shouldUpload() {
     if (!scheduleManager) {
@@ -214,8 +413,17 @@ bool FileUploader::uploadNewFiles(SDCardManager* sdManager, bool forceUpload) {
         return false;
     }
     
+    if (!backend) {
+        LOG_ERROR("[FileUploader] No uploader available for configured endpoint type");
+        LOG_ERROR("[FileUploader] Check ENDPOINT_TYPE in config.json and build flags");
+        return false;
+    }
+    
     // Check if it's time to upload (unless forced or retrying incomplete folders)
-    bool hasIncompleteFolders = (stateManager->getIncompleteFoldersCount() > 0);
+    bool hasIncompleteFolders = false;
+    for (const UploadTarget& target : targets) {
+        hasIncompleteFolders = hasIncompleteFolders || target.state->getIncompleteFoldersCount() > 0;
+    }
     if (!forceUpload && !hasIncompleteFolders && !shouldUpload()) {
         unsigned long secondsUntilNext = scheduleManager->getSecondsUntilNextUpload();
         LOG_DEBUGF("[FileUploader] Not upload time yet. Next upload in %lu hours", secondsUntilNext / 3600);
@@ -241,10 +449,33 @@ bool FileUploader::uploadNewFiles(SDCardManager* sdManager, bool forceUpload) {
     
     // Phase 1: Process DATALOG folders (newest first)
     LOG("[FileUploader] Phase 1: Processing DATALOG folders");
-    std::vector<String> datalogFolders = scanDatalogFolders(sd);
-    
-    // Update total folders count for progress tracking
-    stateManager->setTotalFoldersCount(datalogFolders.size() + stateManager->getCompletedFoldersCount() + stateManager->getPendingFoldersCount());
+    std::vector<std::set<String>> targetFolders(targets.size());
+    std::vector<String> datalogFolders;
+    datalogIndexFresh = false;
+    for (size_t t = 0; t < targets.size(); t++) {
+        selectTarget(t);
+        targets[t].active = true;
+        std::vector<String> folders = scanDatalogFolders(sd);
+        stateManager->clearOpenFolders();  // Open nights count as done once sent again
+        
+        // After a lost or reset state, skip folders the server already holds
+        if (stateManager->isReconcilePending()) {
+            reconcileWithRemote(sdManager, folders);
+        }
+        
+        // Update total folders count for progress tracking
+        stateManager->setTotalFoldersCount(folders.size() + stateManager->getCompletedFoldersCount() + stateManager->getPendingFoldersCount());
+        
+        for (const String& folderName : folders) {
+            if (targetFolders[t].insert(folderName).second &&
+                std::find(datalogFolders.begin(), datalogFolders.end(), folderName) == datalogFolders.end()) {
+                datalogFolders.push_back(folderName);
+            }
+        }
+    }
+    std::sort(datalogFolders.begin(), datalogFolders.end(), [](const String& a, const String& b) {
+        return a > b;  // Newest first across all targets
+    });
     
     for (const String& folderName : datalogFolders) {
         // Check if we still have budget
@@ -259,13 +490,51 @@ bool FileUploader::uploadNewFiles(SDCardManager* sdManager, bool forceUpload) {
             break;
         }
         
-        // Upload the folder
-        if (uploadDatalogFolder(sdManager, folderName)) {
+        // Targets still missing this folder; those that take pushed whole
+        // files share one read of it, the others read it on their own
+        std::vector<size_t> shared;
+        std::vector<size_t> separate;
+        for (size_t t = 0; t < targets.size(); t++) {
+            if (targets[t].active && targetFolders[t].count(folderName) > 0) {
+                (canShareRead(t) ? shared : separate).push_back(t);
+            }
+        }
+        if (shared.size() < 2) {
+            separate.insert(separate.end(), shared.begin(), shared.end());
+            shared.clear();
+        }
+        
+        bool folderDone = false;
+        bool interrupted = false;
+        if (!shared.empty()) {
+            folderDone = uploadDatalogFolderFanOut(sdManager, folderName, shared);
+            interrupted = !folderDone;
+        }
+        for (size_t t : separate) {
+            selectTarget(t);
+            if (uploadDatalogFolder(sdManager, folderName)) {
+                folderDone = true;
+            } else {
+                // Budget exhausted or error - stop sending to this target
+                targets[t].active = false;
+                interrupted = true;
+            }
+        }
+        selectTarget(0);
+        
+        if (folderDone && !interrupted) {
             anyUploaded = true;
             LOGF("[FileUploader] Completed folder: %s", folderName.c_str());
         } else {
+            anyUploaded = anyUploaded || folderDone;
             LOGF("[FileUploader] Folder upload interrupted: %s", folderName.c_str());
-            // Budget exhausted or error - stop processing
+        }
+        
+        bool anyActive = false;
+        for (const UploadTarget& target : targets) {
+            anyActive = anyActive || target.active;
+        }
+        if (!anyActive) {
             break;
         }
         
@@ -280,7 +549,17 @@ bool FileUploader::uploadNewFiles(SDCardManager* sdManager, bool forceUpload) {
     // Phase 2: Process root and SETTINGS files (if budget remains)
     if (budgetManager->hasBudget()) {
         LOG("[FileUploader] Phase 2: Processing root and SETTINGS files");
-        std::vector<String> rootSettingsFiles = scanRootAndSettingsFiles(sd);
+        std::vector<std::vector<String>> targetFiles(targets.size());
+        std::vector<String> rootSettingsFiles;
+        for (size_t t = 0; t < targets.size(); t++) {
+            selectTarget(t);
+            targetFiles[t] = scanRootAndSettingsFiles(sd);
+            for (const String& filePath : targetFiles[t]) {
+                if (std::find(rootSettingsFiles.begin(), rootSettingsFiles.end(), filePath) == rootSettingsFiles.end()) {
+                    rootSettingsFiles.push_back(filePath);
+                }
+            }
+        }
         
         for (const String& filePath : rootSettingsFiles) {
             // Check if we still have budget
@@ -295,10 +574,31 @@ bool FileUploader::uploadNewFiles(SDCardManager* sdManager, bool forceUpload) {
                 break;
             }
             
+            // Root files always go whole, so every pushing target shares the read
+            std::vector<size_t> shared;
+            std::vector<size_t> separate;
+            for (size_t t = 0; t < targets.size(); t++) {
+                const std::vector<String>& changed = targetFiles[t];
+                if (std::find(changed.begin(), changed.end(), filePath) != changed.end()) {
+                    (targets[t].backend->supportsPush() ? shared : separate).push_back(t);
+                }
+            }
+            if (shared.size() < 2) {
+                separate.insert(separate.end(), shared.begin(), shared.end());
+                shared.clear();
+            }
+            
             // Upload the file
-            if (uploadSingleFile(sdManager, filePath)) {
+            if (!shared.empty() && uploadSingleFileFanOut(sdManager, filePath, shared)) {
                 anyUploaded = true;
             }
+            for (size_t t : separate) {
+                selectTarget(t);
+                if (uploadSingleFile(sdManager, filePath)) {
+                    anyUploaded = true;
+                }
+            }
+            selectTarget(0);
             
 #ifdef ENABLE_TEST_WEBSERVER
             // Handle web requests between file uploads
@@ -307,6 +607,13 @@ bool FileUploader::uploadNewFiles(SDCardManager* sdManager, bool forceUpload) {
             }
 #endif
         }
+        
+        for (const UploadTarget& target : targets) {
+            if (!target.backend->commitBatch()) {
+                LOG_WARNF("[FileUploader] %s endpoint did not accept the root and SETTINGS files",
+                          target.backend->getName());
+            }
+        }
     } else {
         LOG("[FileUploader] Skipping root/SETTINGS files - no budget remaining");
     }
@@ -314,8 +621,11 @@ bool FileUploader::uploadNewFiles(SDCardManager* sdManager, bool forceUpload) {
     // End upload session and save state
     endUploadSession(sd);
     
-    // Return true only if all folders are completed
-    bool allComplete = (stateManager->getIncompleteFoldersCount() == 0);
+    // Return true only if all folders are completed (on every target)
+    bool allComplete = true;
+    for (const UploadTarget& target : targets) {
+        allComplete = allComplete && target.state->getIncompleteFoldersCount() == 0;
+    }
     LOG_DEBUGF("[FileUploader] Upload session complete. All folders done: %s", allComplete ? "Yes" : "No");
     
     return allComplete;
@@ -326,93 +636,257 @@ bool FileUploader::scanPendingFolders(SDCardManager* sdManager) {
     LOG("[FileUploader] Scanning SD card for pending folders...");
     
     fs::FS &sd = sdManager->getFS();
+    datalogIndexFresh = false;
     
-    // Scan DATALOG folders
-    std::vector<String> datalogFolders = scanDatalogFolders(sd);
-    
-    // Update total folders count for progress tracking
-    stateManager->setTotalFoldersCount(datalogFolders.size() + stateManager->getCompletedFoldersCount() + stateManager->getPendingFoldersCount());
+    for (size_t t = 0; t < targets.size(); t++) {
+        selectTarget(t);
+        
+        // Scan DATALOG folders
+        std::vector<String> datalogFolders = scanDatalogFolders(sd);
+        
+        // Update total folders count for progress tracking
+        stateManager->setTotalFoldersCount(datalogFolders.size() + stateManager->getCompletedFoldersCount() + stateManager->getPendingFoldersCount());
+        
+        LOG_DEBUGF("[FileUploader] %s: found %d incomplete folders", backend->getName(), datalogFolders.size());
+        LOG_DEBUGF("[FileUploader] Total folders: %d (completed: %d, incomplete: %d, pending: %d)", 
+             stateManager->getCompletedFoldersCount() + datalogFolders.size() + stateManager->getPendingFoldersCount(),
+             stateManager->getCompletedFoldersCount(),
+             datalogFolders.size(),
+             stateManager->getPendingFoldersCount());
+    }
+    selectTarget(0);
     
-    LOG_DEBUGF("[FileUploader] Found %d incomplete folders", datalogFolders.size());
-    LOG_DEBUGF("[FileUploader] Total folders: %d (completed: %d, incomplete: %d, pending: %d)", 
-         stateManager->getCompletedFoldersCount() + datalogFolders.size() + stateManager->getPendingFoldersCount(),
-         stateManager->getCompletedFoldersCount(),
-         datalogFolders.size(),
-         stateManager->getPendingFoldersCount());
+    if (datalogIndex.isDirty()) {
+        datalogIndex.save(sd);
+    }
     
     return true;
 }
 
-// Scan DATALOG folders and sort by date (newest first)
-std::vector<String> FileUploader::scanDatalogFolders(fs::FS &sd) {
-    std::vector<String> folders;
+// Mark DATALOG folders whose files are all on the server with the same size
+// (as separate files, or as a folder archive of the matching size) as
+// completed. One listing of /DATALOG plus one per folder replaces a full
+// re-upload. Folders that match are removed from the list; the reconcile
+// stays pending (and continues next session) if the budget runs out.
+bool FileUploader::reconcileWithRemote(SDCardManager* sdManager, std::vector<String>& folders) {
+    fs::FS &sd = sdManager->getFS();
+    
+    // Backends without directory listing have nothing to reconcile against
+    if (!backend || !backend->supportsListing()) {
+        LOG_DEBUG("[FileUploader] Endpoint cannot list remote folders, skipping reconcile");
+        stateManager->setReconcilePending(false);
+        return true;
+    }
+    
+    if (!backend->ensureConnected()) {
+        LOG_WARNF("[FileUploader] Reconcile skipped: cannot connect to %s endpoint", backend->getName());
+        return false;
+    }
+    
+    LOGF("[FileUploader] Reconciling %d DATALOG folders with the server", folders.size());
+    unsigned long startTime = millis();
+    
+    // The DATALOG listing shows per-file folders and archive-mode .tar files
+    std::map<String, unsigned long> remoteArchives;
+    std::set<String> remoteFolders;
+    if (!backend->listDirectory("/DATALOG", remoteArchives, &remoteFolders)) {
+        LOG_WARN("[FileUploader] Reconcile failed: cannot list remote DATALOG");
+        return false;
+    }
+    
+    int listings = 1;
+    int matched = 0;
+    bool finished = true;
+    std::vector<String> remaining;
+    std::map<String, unsigned long> remoteFiles;
+    
+    for (size_t i = 0; i < folders.size(); i++) {
+        const String& folderName = folders[i];
+        auto archive = remoteArchives.find(folderName + ".tar");
+        bool hasFolder = remoteFolders.count(folderName) > 0;
+        
+        if (!hasFolder && archive == remoteArchives.end()) {
+            remaining.push_back(folderName);
+            continue;
+        }
+        
+        if (!budgetManager->hasBudget() || !checkAndReleaseSD(sdManager)) {
+            // Keep the unchecked folders; the reconcile resumes next session
+            remaining.insert(remaining.end(), folders.begin() + i, folders.end());
+            finished = false;
+            break;
+        }
+        
+        // Local file sizes (no data read)
+        String folderPath = "/DATALOG/" + folderName;
+        std::vector<DirEntry> localFiles;
+        std::vector<unsigned long> localSizes;
+        bool complete = scanFolderFiles(sd, folderPath, localFiles) && !localFiles.empty();
+        for (const DirEntry& file : localFiles) {
+            localSizes.push_back(file.size);
+        }
+        
+        if (complete && archive != remoteArchives.end() &&
+            archive->second == TarArchiveSource::archiveSizeFor(localSizes)) {
+            // An archive of exactly these file sizes is already there
+        } else if (complete && hasFolder) {
+            if (!backend->listDirectory(folderPath, remoteFiles)) {
+                remaining.insert(remaining.end(), folders.begin() + i, folders.end());
+                finished = false;
+                break;
+            }
+            listings++;
+            
+            // Every local file must be on the server with the same size
+            for (size_t f = 0; f < localFiles.size(); f++) {
+                auto it = remoteFiles.find(localFiles[f].name);
+                if (it == remoteFiles.end() || it->second != localFiles[f].size) {
+                    complete = false;
+                    break;
+                }
+            }
+        } else {
+            complete = false;
+        }
+        
+        if (complete && isNightOpen(DatalogIndex::parseFolderName(folderName))) {
+            // Still growing: record what the server holds so only new records follow
+            for (const DirEntry& file : localFiles) {
+                stateManager->recordUploadedLength(sd, folderPath + "/" + file.name, file.size);
+            }
+            stateManager->markFolderOpen(folderName);
+            matched++;
+        } else if (complete) {
+            stateManager->markFolderCompleted(folderName);
+            matched++;
+            LOG_DEBUGF("[FileUploader] Already on server: %s (%d files)",
+                       folderName.c_str(), localFiles.size());
+        } else {
+            remaining.push_back(folderName);
+        }
+    }
+    
+    folders = remaining;
+    if (finished) {
+        stateManager->setReconcilePending(false);
+    }
+    stateManager->save(sd);
+    
+    LOGF("[FileUploader] Reconcile %s: %d folders already on server, %d listings in %lu ms",
+         finished ? "complete" : "paused", matched, listings, millis() - startTime);
+    return finished;
+}
+
+// Bring the DATALOG index in line with the card, once per session
+// /DATALOG is only walked to build the index (new or swapped card, clock
+// unset, long gap, weekly safety net); otherwise the dates after the newest
+// indexed folder are checked. Returns false if /DATALOG cannot be read.
+bool FileUploader::refreshDatalogIndex(fs::FS &sd) {
+    if (datalogIndexFresh) {
+        return true;
+    }
+    
+    unsigned long startTime = millis();
+    time_t now = time(NULL);
+    bool rebuild = datalogIndex.attach(sd);
+    datalogIndex.resetListed();
+    
+    if (!rebuild && datalogIndex.canProbe(now)) {
+        std::vector<uint32_t> dates = datalogIndex.getProbeDates(now);
+        int found = 0;
+        for (uint32_t date : dates) {
+            String folderName = DatalogIndex::folderName(date);
+            if (sd.exists("/DATALOG/" + folderName)) {
+                datalogIndex.addFolder(date);
+                found++;
+                LOG_DEBUGF("[FileUploader] New DATALOG folder: %s", folderName.c_str());
+            }
+        }
+        LOG_DEBUGF("[FileUploader] DATALOG index: %d folders, %d new (%d dates checked) in %lu ms",
+                   datalogIndex.getFolderCount(), found, dates.size(), millis() - startTime);
+        datalogIndexFresh = true;
+        return true;
+    }
     
-    File root = sd.open("/DATALOG");
-    if (!root) {
+    // Walk every folder (the CPAP names them YYYYMMDD): names only, no entry is opened
+    std::vector<DirEntry> entries;
+    if (!DirectoryScanner::scan(sd, "/DATALOG", entries, DirectoryScanner::DIRECTORIES_ONLY)) {
         LOG_ERROR("[FileUploader] Cannot open /DATALOG folder");
         LOG_ERROR("[FileUploader] SD card may be in use by CPAP or not properly mounted");
         LOG_ERROR("[FileUploader] If DATALOG exists, this scan will be retried");
-        return folders;  // Return empty - indicates scan failure
+        return false;
     }
     
-    if (!root.isDirectory()) {
-        LOG_ERROR("[FileUploader] /DATALOG exists but is not a directory");
-        root.close();
-        return folders;
+    datalogIndex.beginWalk();
+    for (const DirEntry& entry : entries) {
+        uint32_t date = DatalogIndex::parseFolderName(entry.name);
+        if (date != 0) {
+            datalogIndex.addFolder(date);
+        } else {
+            LOG_DEBUGF("[FileUploader] Ignoring DATALOG folder without a date name: %s", entry.name.c_str());
+        }
     }
+    datalogIndex.finishWalk(now);
     
-    // Scan for folders
-    File file = root.openNextFile();
-    while (file) {
-        if (file.isDirectory()) {
-            String folderName = String(file.name());
-            
-            // Extract just the folder name (remove path prefix if present)
-            int lastSlash = folderName.lastIndexOf('/');
-            if (lastSlash >= 0) {
-                folderName = folderName.substring(lastSlash + 1);
+    LOGF("[FileUploader] Indexed %d DATALOG folders in %lu ms",
+         datalogIndex.getFolderCount(), millis() - startTime);
+    
+    // Saved right away: a walk is what the index exists to avoid
+    datalogIndex.save(sd);
+    datalogIndexFresh = true;
+    return true;
+}
+
+// Scan DATALOG folders and sort by date (newest first)
+std::vector<String> FileUploader::scanDatalogFolders(fs::FS &sd) {
+    std::vector<String> folders;
+    
+    if (!refreshDatalogIndex(sd)) {
+        return folders;  // Return empty - indicates scan failure
+    }
+    
+    // The index is sorted by date: newest first is back to front
+    const std::vector<DatalogIndex::Entry>& indexed = datalogIndex.getFolders();
+    int completed = 0;
+    for (auto it = indexed.rbegin(); it != indexed.rend(); ++it) {
+        const DatalogIndex::Entry& entry = *it;
+        String folderName = DatalogIndex::folderName(entry.date);
+        
+        // Check if folder is already completed
+        if (stateManager->isFolderCompleted(folderName)) {
+            completed++;
+        } else if (stateManager->isPendingFolder(folderName)) {
+            // Check if pending folder now has files (was empty but now has content).
+            // Listed once per session; other targets reuse the index record.
+            if (!entry.listed) {
+                std::vector<DirEntry> files;
+                scanFolderFiles(sd, "/DATALOG/" + folderName, files);
             }
             
-            // Check if folder is already completed
-            if (stateManager->isFolderCompleted(folderName)) {
-                LOG_DEBUGF("[FileUploader] Skipping completed folder: %s", folderName.c_str());
-            } else if (stateManager->isPendingFolder(folderName)) {
-                // Check if pending folder now has files (was empty but now has content)
-                String folderPath = "/DATALOG/" + folderName;
-                std::vector<String> folderFiles = scanFolderFiles(sd, folderPath);
-                
-                if (!folderFiles.empty()) {
-                    // Folder now has files - remove from pending state immediately and process normally
-                    LOG_DEBUGF("[FileUploader] Pending folder now has files, removing from pending: %s", folderName.c_str());
-                    stateManager->removeFolderFromPending(folderName);
+            if (entry.state == DatalogIndex::FOLDER_HAS_FILES) {
+                // Folder now has files - remove from pending state immediately and process normally
+                LOG_DEBUGF("[FileUploader] Pending folder now has files, removing from pending: %s", folderName.c_str());
+                stateManager->removeFolderFromPending(folderName);
+                folders.push_back(folderName);
+            } else {
+                // Still empty - check if pending folder has timed out
+                unsigned long currentTime = time(NULL);
+                if (currentTime >= 1000000000 && stateManager->shouldPromotePendingToCompleted(folderName, currentTime)) {
+                    // Timed out pending folder - include in scan for promotion
                     folders.push_back(folderName);
+                    LOG_DEBUGF("[FileUploader] Found timed-out pending folder: %s", folderName.c_str());
                 } else {
-                    // Still empty - check if pending folder has timed out
-                    unsigned long currentTime = time(NULL);
-                    if (currentTime >= 1000000000 && stateManager->shouldPromotePendingToCompleted(folderName, currentTime)) {
-                        // Timed out pending folder - include in scan for promotion
-                        folders.push_back(folderName);
-                        LOG_DEBUGF("[FileUploader] Found timed-out pending folder: %s", folderName.c_str());
-                    } else {
-                        // Still pending, skip for now
-                        LOG_DEBUGF("[FileUploader] Skipping pending folder (within 7-day window): %s", folderName.c_str());
-                    }
+                    // Still pending, skip for now
+                    LOG_DEBUGF("[FileUploader] Skipping pending folder (within 7-day window): %s", folderName.c_str());
                 }
-            } else {
-                // Regular incomplete folder
-                folders.push_back(folderName);
-                LOG_DEBUGF("[FileUploader] Found incomplete DATALOG folder: %s", folderName.c_str());
             }
+        } else {
+            // Regular incomplete folder
+            folders.push_back(folderName);
+            LOG_DEBUGF("[FileUploader] Found incomplete DATALOG folder: %s", folderName.c_str());
         }
-        file.close();
-        file = root.openNextFile();
     }
-    root.close();
-    
-    // Sort folders by date (newest first) - folders are in YYYYMMDD format
-    std::sort(folders.begin(), folders.end(), [](const String& a, const String& b) {
-        return a > b;  // Descending order (newest first)
-    });
+    LOG_DEBUGF("[FileUploader] Skipped %d completed folders", completed);
     
     if (folders.empty()) {
         LOG("[FileUploader] No incomplete DATALOG folders found");
@@ -424,50 +898,39 @@ std::vector<String> FileUploader::scanDatalogFolders(fs::FS &sd) {
     return folders;
 }
 
-// Scan files in a specific folder
-// Returns empty vector on error - caller must check if scan was successful
-std::vector<String> FileUploader::scanFolderFiles(fs::FS &sd, const String& folderPath) {
-    std::vector<String> files;
-    
-    File folder = sd.open(folderPath);
-    if (!folder) {
+// .edf files are the only DATALOG content that is uploaded
+static bool isEdfName(const String& name) {
+    return name.endsWith(".edf") || name.endsWith(".EDF");
+}
+
+// Scan the .edf files of a folder with their size and last write time
+// Returns false if the folder cannot be read (an empty folder is not an error)
+bool FileUploader::scanFolderFiles(fs::FS &sd, const String& folderPath, std::vector<DirEntry>& files) {
+    files.clear();
+    
+    // One pass over the directory; a stat() per .edf file, nothing opened
+    if (!DirectoryScanner::scan(sd, folderPath, files,
+                                DirectoryScanner::FILES_ONLY | DirectoryScanner::WITH_STAT, isEdfName)) {
         LOG_ERRORF("[FileUploader] Failed to open folder: %s", folderPath.c_str());
         LOG_ERROR("[FileUploader] SD card may be in use by CPAP or experiencing read errors");
         LOG_ERROR("[FileUploader] This folder will be retried in the next upload session");
-        return files;  // Return empty - caller should treat as error
+        return false;
     }
     
-    if (!folder.isDirectory()) {
-        LOG_ERRORF("[FileUploader] Path exists but is not a directory: %s", folderPath.c_str());
-        folder.close();
-        return files;
+    unsigned long totalBytes = 0;
+    for (const DirEntry& entry : files) {
+        totalBytes += entry.size;
     }
     
-    // Scan for .edf files
-    File file = folder.openNextFile();
-    while (file) {
-        if (!file.isDirectory()) {
-            String fileName = String(file.name());
-            
-            // Extract just the file name (remove path prefix if present)
-            int lastSlash = fileName.lastIndexOf('/');
-            if (lastSlash >= 0) {
-                fileName = fileName.substring(lastSlash + 1);
-            }
-            
-            // Check if it's an .edf file
-            if (fileName.endsWith(".edf") || fileName.endsWith(".EDF")) {
-                files.push_back(fileName);
-            }
-        }
-        file.close();
-        file = folder.openNextFile();
+    // Keep the index record of a DATALOG folder in line with the listing
+    if (folderPath.startsWith("/DATALOG/")) {
+        datalogIndex.recordListing(DatalogIndex::parseFolderName(folderPath.substring(9)),
+                                   files.size(), totalBytes);
     }
-    folder.close();
     
     LOG_DEBUGF("[FileUploader] Found %d .edf files in %s", files.size(), folderPath.c_str());
     
-    return files;
+    return true;
 }
 
 // Scan root and SETTINGS files that need tracking
@@ -483,10 +946,11 @@ std::vector<String> FileUploader::scanRootAndSettingsFiles(fs::FS &sd) {
         "/journal.jnl"
     };
     
-    for (int i = 0; i < 3; i++) {
+    const int rootFileCount = sizeof(rootFiles) / sizeof(rootFiles[0]);
+    for (int i = 0; i < rootFileCount; i++) {
         if (sd.exists(rootFiles[i])) {
             // Check if file has changed
-            if (stateManager->hasFileChanged(sd, rootFiles[i])) {
+            if (hasRootFileChanged(sd, rootFiles[i])) {
                 files.push_back(String(rootFiles[i]));
                 LOG_DEBUGF("[FileUploader] Root file changed: %s", rootFiles[i]);
             }
@@ -502,7 +966,7 @@ std::vector<String> FileUploader::scanRootAndSettingsFiles(fs::FS &sd) {
     for (int i = 0; i < 2; i++) {
         if (sd.exists(settingsFiles[i])) {
             // Check if file has changed
-            if (stateManager->hasFileChanged(sd, settingsFiles[i])) {
+            if (stateManager->hasFileChangedQuick(sd, settingsFiles[i])) {
                 files.push_back(String(settingsFiles[i]));
                 LOG_DEBUGF("[FileUploader] SETTINGS file changed: %s", settingsFiles[i]);
             }
@@ -521,8 +985,13 @@ bool FileUploader::startUploadSession(fs::FS &sd) {
     // Get session duration from config
     unsigned long sessionDuration = config->getSessionDurationSeconds();
     
-    // Check if we need to apply retry multiplier
-    int retryCount = stateManager->getCurrentRetryCount();
+    // Check if we need to apply retry multiplier (the target furthest behind sets it)
+    int retryCount = 0;
+    for (const UploadTarget& target : targets) {
+        if (target.state->getCurrentRetryCount() > retryCount) {
+            retryCount = target.state->getCurrentRetryCount();
+        }
+    }
     
     // Apply multiplier for any retry attempt to increase budget
     if (retryCount > 0) {
@@ -546,38 +1015,61 @@ bool FileUploader::startUploadSession(fs::FS &sd) {
 void FileUploader::endUploadSession(fs::FS &sd) {
     LOG("[FileUploader] Ending upload session");
     
+    // Folder listings made during the session
+    if (datalogIndex.isDirty() && !datalogIndex.save(sd)) {
+        LOG_WARN("[FileUploader] Failed to save DATALOG index");
+    }
+    
     // Save upload state
-    if (!stateManager->save(sd)) {
-        LOG_ERROR("[FileUploader] Failed to save upload state");
-        LOG_WARN("[FileUploader] Upload progress may be lost - will retry from last saved state");
+    bool hasIncompleteFolders = false;
+    for (const UploadTarget& target : targets) {
+        if (!target.state->save(sd)) {
+            LOG_ERROR("[FileUploader] Failed to save upload state");
+            LOG_WARN("[FileUploader] Upload progress may be lost - will retry from last saved state");
+        }
+        hasIncompleteFolders = hasIncompleteFolders || target.state->getIncompleteFoldersCount() > 0;
     }
     
-    // Only mark upload as completed if there are no incomplete folders
-    bool hasIncompleteFolders = (stateManager->getIncompleteFoldersCount() > 0);
+    // Only mark upload as completed if no target has incomplete folders
     if (!hasIncompleteFolders) {
         // Update last upload timestamp
         time_t now;
         time(&now);
-        stateManager->setLastUploadTimestamp((unsigned long)now);
+        for (const UploadTarget& target : targets) {
+            target.state->setLastUploadTimestamp((unsigned long)now);
+        }
         scheduleManager->markUploadCompleted();
         LOG("[FileUploader] All folders completed - upload session marked as done");
     } else {
         LOG("[FileUploader] Incomplete folders remain - upload will retry");
     }
     
+    for (const UploadTarget& target : targets) {
+        if (target.backend) {
+            target.backend->logSessionStats();
+        }
+    }
+    
+    // Fallback allocations here mean transfers escaped the boot-time pool
+    BufferPool::getInstance().logHeapReport("Session end");
+    
     // Calculate wait time
     unsigned long waitTimeMs = budgetManager->getWaitTimeMs();
     LOG_DEBUGF("[FileUploader] Wait time before next session: %lu seconds", waitTimeMs / 1000);
     
     // Save state again with updated timestamp
-    if (!stateManager->save(sd)) {
-        LOG_ERROR("[FileUploader] Failed to save final state with timestamp");
-        LOG_WARN("[FileUploader] Next upload may occur sooner than scheduled");
+    for (const UploadTarget& target : targets) {
+        if (!target.state->save(sd)) {
+            LOG_ERROR("[FileUploader] Failed to save final state with timestamp");
+            LOG_WARN("[FileUploader] Next upload may occur sooner than scheduled");
+        }
     }
 }
 
-// Upload all files in a DATALOG folder
-bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& folderName) {
+// Upload all files in a DATALOG folder (sentFiles: names already delivered
+// to this target by a fan-out that handed the rest of the folder over)
+bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& folderName,
+                                       const std::set<String>* sentFiles) {
     fs::FS &sd = sdManager->getFS();
     
     // Get retry count BEFORE setting current folder (in case it's a different folder)
@@ -597,9 +1089,9 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
     // Build folder path
     String folderPath = "/DATALOG/" + folderName;
     
-    // Verify folder exists before scanning
-    File folderCheck = sd.open(folderPath);
-    if (!folderCheck) {
+    // Scan the folder: names, sizes and times in one directory pass
+    std::vector<DirEntry> files;
+    if (!scanFolderFiles(sd, folderPath, files)) {
         LOG_ERRORF("[FileUploader] Cannot access folder: %s", folderPath.c_str());
         LOG_ERROR("[FileUploader] SD card may be in use by CPAP machine");
         LOG_ERROR("[FileUploader] Folder will be retried in next upload session");
@@ -608,18 +1100,6 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
         return false;  // Treat as error, not completion
     }
     
-    if (!folderCheck.isDirectory()) {
-        LOG_ERRORF("[FileUploader] Path is not a directory: %s", folderPath.c_str());
-        folderCheck.close();
-        stateManager->incrementCurrentRetryCount();
-        stateManager->save(sd);
-        return false;
-    }
-    folderCheck.close();
-    
-    // Scan for files in the folder
-    std::vector<String> files = scanFolderFiles(sd, folderPath);
-    
     // If this was a pending folder but now has files, remove it from pending state
     if (stateManager->isPendingFolder(folderName) && !files.empty()) {
         LOG_DEBUGF("[FileUploader] Removing folder from pending state (now has files): %s", folderName.c_str());
@@ -627,19 +1107,6 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
     }
     
     if (files.empty()) {
-        // Need to distinguish between "truly empty" and "scan failed"
-        // Try to open the folder again to verify it's accessible
-        File verifyFolder = sd.open(folderPath);
-        if (!verifyFolder) {
-            LOG_ERROR("[FileUploader] Folder scan returned empty but folder is not accessible");
-            LOG_ERROR("[FileUploader] This indicates SD card read error or CPAP interference");
-            LOG_ERROR("[FileUploader] Folder will be retried in next upload session");
-            stateManager->incrementCurrentRetryCount();
-            stateManager->save(sd);
-            return false;  // Treat as error
-        }
-        verifyFolder.close();
-        
         // Folder is accessible but truly empty - handle with pending state
         LOG_WARN("[FileUploader] No .edf files found in folder (folder is empty)");
         
@@ -678,9 +1145,50 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
         }
     }
     
-    // Upload each file
-    int uploadedCount = 0;
-    for (const String& fileName : files) {
+    // Archive mode: the whole folder as one .tar stream. A folder with a
+    // per-file resume checkpoint, or an open night that is appended to,
+    // goes file by file.
+    if (config->isDatalogArchiveEnabled() && backend->supportsStreams() &&
+        !isNightOpen(DatalogIndex::parseFolderName(folderName)) &&
+        !stateManager->getCheckpointPath().startsWith(folderPath + "/")) {
+        TarArchiveSource archive(sd, folderPath, folderName);
+        for (const DirEntry& entry : files) {
+            if (!archive.addFile(entry.name, entry.size, entry.lastWrite)) {
+                LOG_ERROR("[FileUploader] Cannot read folder for archive, will retry next session");
+                stateManager->incrementCurrentRetryCount();
+                stateManager->save(sd);
+                return false;
+            }
+        }
+        
+        bool fits = config->isCompressionEnabled()
+                        ? budgetManager->canUploadCompressed(archive.getArchiveSize())
+                        : budgetManager->canUploadFile(archive.getArchiveSize());
+        if (fits) {
+            return uploadFolderArchive(sd, folderName, archive);
+        }
+        LOGF("[FileUploader] Archive of %s (%u bytes) exceeds the remaining budget, sending files individually",
+             folderName.c_str(), archive.getArchiveSize());
+    }
+    
+    // A retried folder may already be partly on the server (the previous
+    // session ended before its state was saved): list it once and skip
+    // files that are there whole
+    std::map<String, unsigned long> remoteFiles;
+    if (retryCount > 0 && backend->supportsListing() && backend->ensureConnected() &&
+        !backend->listDirectory(folderPath, remoteFiles)) {
+        remoteFiles.clear();
+    }
+    
+    // Batching backends only accept the folder as a whole at commit, so
+    // growing files are recorded as uploaded after that
+    std::vector<std::pair<String, unsigned long>> batchedLengths;
+    
+    // Upload each file
+    int uploadedCount = 0;
+    for (const DirEntry& entry : files) {
+        const String& fileName = entry.name;
+        
         // Check for periodic SD card release before each file
         if (!checkAndReleaseSD(sdManager)) {
             LOG_ERROR("[FileUploader] Failed to retake SD card control during folder upload");
@@ -692,28 +1200,48 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
         // Check time budget before uploading
         String localPath = folderPath + "/" + fileName;
         
-        // Get file size
-        File file = sd.open(localPath);
-        if (!file) {
-            LOG_ERRORF("[FileUploader] Cannot open file for reading: %s", localPath.c_str());
-            LOG_ERROR("[FileUploader] File may be corrupted or SD card has read errors");
-            LOG_WARN("[FileUploader] Skipping this file and continuing with next file");
-            continue;  // Skip this file but continue with others
-        }
-        
-        unsigned long fileSize = file.size();
+        // Size from the folder scan; the file is opened once, to send it
+        unsigned long fileSize = entry.size;
         
         // Sanity check file size
         if (fileSize == 0) {
             LOG_WARNF("[FileUploader] File is empty: %s", localPath.c_str());
-            file.close();
             continue;  // Skip empty files
         }
         
-        file.close();
+        if (sentFiles && sentFiles->count(fileName) > 0) {
+            uploadedCount++;
+            continue;
+        }
         
-        // Check if we have budget for this file
-        if (!budgetManager->canUploadFile(fileSize)) {
+        auto remoteFile = remoteFiles.find(fileName);
+        if (remoteFile != remoteFiles.end() && remoteFile->second == fileSize) {
+            LOG_DEBUGF("[FileUploader] Already on the server, skipping: %s", fileName.c_str());
+            updateUploadCheckpoint(localPath, fileSize, 0, fileSize, true);
+            if (isAppendOnlyFile(localPath)) {
+                stateManager->recordUploadedLength(sd, localPath, fileSize);
+            }
+            uploadedCount++;
+            continue;
+        }
+        
+        // Skip unchanged growing files; resume or append where possible
+        unsigned long startOffset = 0;
+        unsigned long appendOffset = 0;
+        if (!planStartOffset(sd, localPath, fileSize, startOffset, appendOffset)) {
+            LOG_DEBUGF("[FileUploader] Unchanged since last upload, skipping: %s", fileName.c_str());
+            uploadedCount++;
+            continue;
+        }
+        
+        // Compressed files always go whole. A resume checkpoint, or a file too
+        // large for the budget even compressed, continues uncompressed.
+        bool compress = config->isCompressionEnabled() && backend->supportsStreams() &&
+                        startOffset == appendOffset && budgetManager->canUploadCompressed(fileSize);
+        
+        // Check if we have budget for this file (or at least a useful slice of it)
+        unsigned long maxBytes = compress ? fileSize : planUploadBytes(fileSize - startOffset);
+        if (maxBytes == 0) {
             LOG("[FileUploader] Insufficient time budget for remaining files");
             LOGF("[FileUploader] Successfully uploaded %d of %d files before budget exhaustion", uploadedCount, files.size());
             LOG("[FileUploader] This is normal - upload will resume in next session");
@@ -742,71 +1270,44 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
         
         bool uploadSuccess = false;
         
-        // Use the appropriate uploader based on configuration
-#ifdef ENABLE_SMB_UPLOAD
-        if (smbUploader && config->getEndpointType() == "SMB") {
-            // Ensure SMB connection is established
-            if (!smbUploader->isConnected()) {
-                LOG_DEBUG("[FileUploader] SMB not connected, attempting to connect...");
-                if (!smbUploader->begin()) {
-                    LOG_ERROR("[FileUploader] Failed to connect to SMB share");
-                    LOG_ERROR("[FileUploader] Check network connectivity and SMB credentials");
-                    stateManager->incrementCurrentRetryCount();
-                    stateManager->save(sd);
-                    return false;
-                }
-            }
-            
-            uploadSuccess = smbUploader->upload(localPath, remotePath, sd, bytesTransferred);
-        } else
-#endif
-#ifdef ENABLE_WEBDAV_UPLOAD
-        if (webdavUploader && config->getEndpointType() == "WEBDAV") {
-            // Ensure WebDAV connection is established
-            if (!webdavUploader->isConnected()) {
-                LOG_DEBUG("[FileUploader] WebDAV not connected, attempting to connect...");
-                if (!webdavUploader->begin()) {
-                    LOG_ERROR("[FileUploader] Failed to connect to WebDAV server");
-                    LOG_ERROR("[FileUploader] Check network connectivity and WebDAV credentials");
-                    stateManager->incrementCurrentRetryCount();
-                    stateManager->save(sd);
-                    return false;
-                }
-            }
-            
-            uploadSuccess = webdavUploader->upload(localPath, remotePath, sd, bytesTransferred);
-        } else
-#endif
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-        if (sleephqUploader && config->getEndpointType() == "SLEEPHQ") {
-            // Ensure SleepHQ connection is established
-            if (!sleephqUploader->isConnected()) {
-                LOG_DEBUG("[FileUploader] SleepHQ not connected, attempting to connect...");
-                if (!sleephqUploader->begin()) {
-                    LOG_ERROR("[FileUploader] Failed to connect to SleepHQ service");
-                    LOG_ERROR("[FileUploader] Check network connectivity and API credentials");
-                    stateManager->incrementCurrentRetryCount();
-                    stateManager->save(sd);
-                    return false;
-                }
-            }
-            
-            uploadSuccess = sleephqUploader->upload(localPath, remotePath, sd, bytesTransferred);
-        } else
-#endif
-        {
-            LOG_ERROR("[FileUploader] No uploader available for configured endpoint type");
-            LOG_ERROR("[FileUploader] Check ENDPOINT_TYPE in config.json and build flags");
+        // Reuse the existing session (reconnects if it went stale)
+        if (!backend->ensureConnected()) {
+            LOG_ERRORF("[FileUploader] Failed to connect to %s endpoint", backend->getName());
+            LOG_ERROR("[FileUploader] Check network connectivity and endpoint credentials");
             stateManager->incrementCurrentRetryCount();
             stateManager->save(sd);
             return false;
         }
         
+        if (compress) {
+            unsigned long compressedBytes = 0;
+            uploadSuccess = uploadCompressedFile(sd, localPath, remotePath, fileSize, compressedBytes);
+            startOffset = 0;
+            bytesTransferred = uploadSuccess ? fileSize : 0;  // Raw bytes now on the server
+        } else {
+            File file = sd.open(localPath, FILE_READ);
+            if (!file) {
+                LOG_ERRORF("[FileUploader] Cannot open file for reading: %s", localPath.c_str());
+                LOG_ERROR("[FileUploader] File may be corrupted or SD card has read errors");
+                LOG_WARN("[FileUploader] Skipping this file and continuing with next file");
+                continue;  // Skip this file but continue with others
+            }
+            uploadSuccess = backend->uploadFile(file, fileSize, localPath, remotePath, bytesTransferred,
+                                                startOffset, maxBytes);
+            file.close();
+            if (uploadSuccess && appendOffset > 0 && startOffset + bytesTransferred >= fileSize) {
+                uploadSuccess = refreshAppendedHeader(sd, localPath, remotePath, appendOffset);
+            }
+        }
+        
+        bool fileComplete = updateUploadCheckpoint(localPath, fileSize, startOffset,
+                                                   bytesTransferred, uploadSuccess);
+        
         if (!uploadSuccess) {
             LOG_ERRORF("[FileUploader] Failed to upload file: %s", localPath.c_str());
             LOG_ERROR("[FileUploader] This may be due to:");
             LOG_ERROR("[FileUploader]   - Network connectivity issues");
-            LOG_ERROR("[FileUploader]   - SMB server unavailable or overloaded");
+            LOG_ERROR("[FileUploader]   - Server unavailable or overloaded");
             LOG_ERROR("[FileUploader]   - Insufficient permissions on remote share");
             LOG_ERROR("[FileUploader]   - Disk space issues on remote server");
             LOG_WARNF("[FileUploader] Successfully uploaded %d files before failure", uploadedCount);
@@ -820,11 +1321,30 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
         }
         
         // Record upload for transmission rate calculation (skip small files < 5KB)
+        // Compressed uploads feed their own rate in uploadCompressedFile()
         unsigned long uploadTime = millis() - uploadStartTime;
-        if (bytesTransferred >= 5120) {  // 5KB minimum for rate calculation
+        if (!compress && bytesTransferred >= 5120) {  // 5KB minimum for rate calculation
             budgetManager->recordUpload(bytesTransferred, uploadTime);
         }
         
+        if (!fileComplete) {
+            // Budget-limited slice sent; the rest follows next session. This
+            // is progress, not a failed attempt: the retry count stays as is.
+            LOGF("[FileUploader] Partial upload of %s, will resume next session", fileName.c_str());
+            if (!stateManager->save(sd)) {
+                LOG("[FileUploader] WARNING: Failed to save state after partial upload");
+            }
+            return false;
+        }
+        
+        if (isAppendOnlyFile(localPath)) {
+            if (backend->supportsBatches()) {
+                batchedLengths.push_back(std::make_pair(localPath, fileSize));
+            } else {
+                stateManager->recordUploadedLength(sd, localPath, fileSize);
+            }
+        }
+        
         uploadedCount++;
         LOGF("[FileUploader] Uploaded: %s (%lu bytes)", fileName.c_str(), bytesTransferred);
         LOG_DEBUGF("[FileUploader] Budget remaining: %lu ms", budgetManager->getRemainingBudgetMs());
@@ -833,8 +1353,25 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
     // All files uploaded successfully
     LOGF("[FileUploader] Successfully uploaded all %d files in folder", uploadedCount);
     
-    // Mark folder as completed
-    stateManager->markFolderCompleted(folderName);
+    if (!backend->commitBatch()) {
+        LOG_ERRORF("[FileUploader] %s endpoint did not accept folder %s, will retry next session",
+                   backend->getName(), folderName.c_str());
+        stateManager->incrementCurrentRetryCount();
+        stateManager->save(sd);
+        return false;
+    }
+    for (const auto& uploaded : batchedLengths) {
+        stateManager->recordUploadedLength(sd, uploaded.first, uploaded.second);
+    }
+    
+    // Mark folder as completed, unless its night may still grow: then its
+    // append records are kept and the next session sends only new records
+    if (isNightOpen(DatalogIndex::parseFolderName(folderName))) {
+        LOGF("[FileUploader] Folder %s stays open while its night may still be recorded", folderName.c_str());
+        stateManager->markFolderOpen(folderName);
+    } else {
+        stateManager->markFolderCompleted(folderName);
+    }
     
     // Reset retry count for this folder
     stateManager->clearCurrentRetry();
@@ -845,6 +1382,340 @@ bool FileUploader::uploadDatalogFolder(SDCardManager* sdManager, const String& f
     return true;
 }
 
+// Read a file from the SD card once and push it whole to several targets
+// A target that fails drops out of the shared read; the others carry on.
+// delivered[i] tells whether receivers[i] now holds the whole file.
+bool FileUploader::pushFile(fs::FS &sd, const String& localPath, unsigned long fileSize,
+                            const std::vector<size_t>& receivers, std::vector<bool>& delivered,
+                            Md5Digest* digest) {
+    delivered.assign(receivers.size(), false);
+    
+    File file = sd.open(localPath, FILE_READ);
+    if (!file) {
+        LOG_ERRORF("[FileUploader] Cannot open file for reading: %s", localPath.c_str());
+        return false;
+    }
+    
+    FanOutSink fanOut;
+    std::vector<int> slots;
+    for (size_t t : receivers) {
+        UploadSink* sink = targets[t].backend->beginFile(localPath, fileSize);
+        slots.push_back(sink ? fanOut.add(sink) : -1);
+    }
+    
+    unsigned long bytesRead = 0;
+    UploadPipeline pipeline;
+    bool readAll = pipeline.begin();
+    if (readAll) {
+        pipeline.setDigest(digest);
+        readAll = pipeline.run(file, fileSize, fanOut, bytesRead) && bytesRead == fileSize;
+        pipeline.end();
+    } else {
+        LOG_ERROR("[FileUploader] Failed to allocate upload buffers");
+    }
+    file.close();
+    
+    bool any = false;
+    for (size_t i = 0; i < receivers.size(); i++) {
+        if (slots[i] < 0) {
+            continue;  // beginFile() failed, nothing to finish
+        }
+        bool complete = readAll && fanOut.isActive(slots[i]);
+        delivered[i] = targets[receivers[i]].backend->finishFile(complete) && complete;
+        any = any || delivered[i];
+    }
+    return any;
+}
+
+// Upload a DATALOG folder to several targets with one read of each file
+// Files go whole (no budget-limited slices, no appends): the pushed data
+// cannot be replayed for a single target. A file the budget cannot take
+// whole hands the rest of the folder to the per-target path, which slices
+// and resumes. Returns true if every target completed the folder; a target
+// that fails is dropped for the session.
+bool FileUploader::uploadDatalogFolderFanOut(SDCardManager* sdManager, const String& folderName,
+                                             const std::vector<size_t>& group) {
+    fs::FS &sd = sdManager->getFS();
+    String folderPath = "/DATALOG/" + folderName;
+    std::vector<DirEntry> files;
+    scanFolderFiles(sd, folderPath, files);
+    
+    // No data to share: empty or unreadable folders take the per-target
+    // path, with its pending-folder and retry handling
+    if (files.empty()) {
+        bool allDone = true;
+        for (size_t t : group) {
+            selectTarget(t);
+            if (!uploadDatalogFolder(sdManager, folderName)) {
+                targets[t].active = false;
+                allDone = false;
+            }
+        }
+        return allDone;
+    }
+    
+    LOGF("[FileUploader] Uploading DATALOG folder: %s (%d endpoints, one read)", folderName.c_str(), group.size());
+    std::vector<size_t> live;
+    for (size_t t : group) {
+        UploadStateManager* state = targets[t].state;
+        state->setCurrentRetryFolder(folderName);
+        if (state->isPendingFolder(folderName)) {
+            state->removeFolderFromPending(folderName);
+        }
+        if (!targets[t].backend->ensureConnected()) {
+            LOG_ERRORF("[FileUploader] Failed to connect to %s endpoint", targets[t].backend->getName());
+            dropTarget(sd, t);
+            continue;
+        }
+        live.push_back(t);
+    }
+    
+    // Growing files of batching targets count once the folder is committed
+    std::map<size_t, std::vector<std::pair<String, unsigned long>>> batchedLengths;
+    
+    // Files every live target holds, for a hand-over to the per-target path
+    std::set<String> sentFiles;
+    
+    int uploadedCount = 0;
+    for (const DirEntry& entry : files) {
+        const String& fileName = entry.name;
+        if (live.empty()) {
+            return false;
+        }
+        
+        if (!checkAndReleaseSD(sdManager)) {
+            LOG_ERROR("[FileUploader] Failed to retake SD card control during folder upload");
+            for (size_t t : live) {
+                dropTarget(sd, t);
+            }
+            return false;
+        }
+        
+        String localPath = folderPath + "/" + fileName;
+        unsigned long fileSize = entry.size;  // From the scan; pushFile() opens the file once
+        if (fileSize == 0) {
+            LOG_WARNF("[FileUploader] File is empty: %s", localPath.c_str());
+            continue;
+        }
+        
+        // Only the targets whose copy is out of date receive the file; a
+        // closed night's file without a record has not been sent yet
+        bool appendOnly = isAppendOnlyFile(localPath);
+        std::vector<size_t> receivers;
+        for (size_t t : live) {
+            UploadStateManager* state = targets[t].state;
+            unsigned long appendOffset = 0;
+            if ((!appendOnly && !state->hasUploadedLength(localPath)) ||
+                state->checkAppend(sd, localPath, fileSize, appendOffset) != UploadStateManager::APPEND_UNCHANGED) {
+                receivers.push_back(t);
+            }
+        }
+        if (receivers.empty()) {
+            LOG_DEBUGF("[FileUploader] Unchanged since last upload, skipping: %s", fileName.c_str());
+            sentFiles.insert(fileName);
+            uploadedCount++;
+            continue;
+        }
+        
+        if (!budgetManager->canUploadFile(fileSize)) {
+            LOGF("[FileUploader] %s (%lu bytes) exceeds the remaining budget, finishing folder per endpoint",
+                 fileName.c_str(), fileSize);
+            bool allDone = live.size() == group.size();
+            for (size_t t : live) {
+                selectTarget(t);
+                if (!uploadDatalogFolder(sdManager, folderName, &sentFiles)) {
+                    targets[t].active = false;
+                    allDone = false;
+                    continue;
+                }
+                for (const auto& uploaded : batchedLengths[t]) {
+                    targets[t].state->recordUploadedLength(sd, uploaded.first, uploaded.second);
+                }
+            }
+            return allDone;
+        }
+        
+        LOGF("[FileUploader] Uploading file: %s (%lu bytes) to %d endpoints", fileName.c_str(), fileSize, receivers.size());
+        unsigned long uploadStartTime = millis();
+        std::vector<bool> delivered;
+        bool any = pushFile(sd, localPath, fileSize, receivers, delivered, nullptr);
+        
+        unsigned long uploadTime = millis() - uploadStartTime;
+        if (any && fileSize >= 5120) {  // 5KB minimum for rate calculation
+            budgetManager->recordUpload(fileSize, uploadTime);
+        }
+        
+        for (size_t i = 0; i < receivers.size(); i++) {
+            size_t t = receivers[i];
+            UploadStateManager* state = targets[t].state;
+            if (!delivered[i]) {
+                LOG_ERRORF("[FileUploader] Failed to upload %s to %s endpoint", localPath.c_str(),
+                           targets[t].backend->getName());
+                dropTarget(sd, t);
+                live.erase(std::find(live.begin(), live.end(), t));
+                continue;
+            }
+            // Sent whole: a resume checkpoint from a single-target session is obsolete
+            if (state->getCheckpointPath() == localPath) {
+                state->clearUploadCheckpoint();
+            }
+            if (!appendOnly) {
+                continue;
+            }
+            if (targets[t].backend->supportsBatches()) {
+                batchedLengths[t].push_back(std::make_pair(localPath, fileSize));
+            } else {
+                state->recordUploadedLength(sd, localPath, fileSize);
+            }
+        }
+        sentFiles.insert(fileName);
+        uploadedCount++;
+        LOG_DEBUGF("[FileUploader] Budget remaining: %lu ms", budgetManager->getRemainingBudgetMs());
+    }
+    
+    size_t completed = 0;
+    for (size_t t : live) {
+        UploadStateManager* state = targets[t].state;
+        if (!targets[t].backend->commitBatch()) {
+            LOG_ERRORF("[FileUploader] %s endpoint did not accept folder %s, will retry next session",
+                       targets[t].backend->getName(), folderName.c_str());
+            dropTarget(sd, t);
+            continue;
+        }
+        completed++;
+        for (const auto& uploaded : batchedLengths[t]) {
+            state->recordUploadedLength(sd, uploaded.first, uploaded.second);
+        }
+        if (isNightOpen(DatalogIndex::parseFolderName(folderName))) {
+            state->markFolderOpen(folderName);  // Keeps its append records
+        } else {
+            state->markFolderCompleted(folderName);
+        }
+        state->clearCurrentRetry();
+        state->save(sd);
+    }
+    LOGF("[FileUploader] Folder %s (%d files) completed on %d of %d endpoints", folderName.c_str(),
+         uploadedCount, completed, group.size());
+    return completed == group.size();
+}
+
+// Upload a DATALOG folder as "/DATALOG/<folder>.tar" (one remote file
+// instead of one per SD file; tools/datalog_unpack/unpack_datalog_archives.py restores
+// the folder layout on the server side)
+bool FileUploader::uploadFolderArchive(fs::FS &sd, const String& folderName,
+                                       TarArchiveSource& archive) {
+    if (!backend->ensureConnected()) {
+        LOG_ERRORF("[FileUploader] Failed to connect to %s endpoint", backend->getName());
+        LOG_ERROR("[FileUploader] Check network connectivity and endpoint credentials");
+        stateManager->incrementCurrentRetryCount();
+        stateManager->save(sd);
+        return false;
+    }
+    
+    size_t archiveSize = archive.getArchiveSize();
+    LOGF("[FileUploader] Uploading %s as archive: %d files, %lu data bytes, %u archive bytes",
+         folderName.c_str(), archive.getFileCount(), archive.getDataBytes(), archiveSize);
+    
+    bool compress = config->isCompressionEnabled();
+    String remotePath = "/DATALOG/" + folderName + (compress ? ".tar.gz" : ".tar");
+    unsigned long bytesTransferred = 0;
+    unsigned long uploadStartTime = millis();
+    bool uploadSuccess;
+    if (compress) {
+        GzipSource gzip(archive, archiveSize);
+        uploadSuccess = gzip.begin() &&
+                        backend->uploadStream(gzip, UploadPipeline::STREAM_TO_END, remotePath,
+                                              bytesTransferred) &&
+                        !gzip.hasFailed();
+        if (uploadSuccess) {
+            LOGF("[FileUploader] Archive compressed to %lu bytes (%lu%%)", bytesTransferred,
+                 archiveSize > 0 ? (bytesTransferred * 100UL) / archiveSize : 0UL);
+        }
+    } else {
+        uploadSuccess = backend->uploadStream(archive, archiveSize, remotePath, bytesTransferred);
+    }
+    
+    if (!uploadSuccess || archive.hasFailed()) {
+        LOG_ERRORF("[FileUploader] Failed to upload archive of folder: %s", folderName.c_str());
+        LOG_ERROR("[FileUploader] Folder will be retried in next upload session");
+        stateManager->incrementCurrentRetryCount();
+        if (!stateManager->save(sd)) {
+            LOG_WARN("[FileUploader] Failed to save state after upload error");
+        }
+        return false;
+    }
+    
+    // Record upload for transmission rate calculation
+    unsigned long uploadTime = millis() - uploadStartTime;
+    if (compress) {
+        if (archiveSize >= 5120) {
+            budgetManager->recordCompressedUpload(archiveSize, uploadTime);
+        }
+    } else if (bytesTransferred >= 5120) {  // 5KB minimum for rate calculation
+        budgetManager->recordUpload(bytesTransferred, uploadTime);
+    }
+    
+    LOGF("[FileUploader] Successfully uploaded archive of %d files", archive.getFileCount());
+    
+    stateManager->markFolderCompleted(folderName);
+    stateManager->clearCurrentRetry();
+    stateManager->save(sd);
+    
+    return true;
+}
+
+// EDF files with sampled signals, the ones EdfCodec shrinks. EVE and CSL
+// files hold only EDF+ annotation text, which deflate handles better.
+bool FileUploader::isSignalEdfFile(const String& filePath) {
+    String name = filePath;
+    name.toUpperCase();
+    return name.endsWith(".EDF") && !name.endsWith("_EVE.EDF") && !name.endsWith("_CSL.EDF");
+}
+
+// Upload one file compressed as "<remotePath>.gz", or "<remotePath>.edz" for
+// EDF signal files when COMPRESSION_CODEC is EDF
+// Always the whole file: a compressed stream cannot be resumed or appended to
+bool FileUploader::uploadCompressedFile(fs::FS &sd, const String& localPath, const String& remotePath,
+                                        unsigned long fileSize, unsigned long& bytesSent) {
+    bytesSent = 0;
+    
+    File file = sd.open(localPath, FILE_READ);
+    if (!file) {
+        LOG_ERRORF("[FileUploader] Cannot open file for reading: %s", localPath.c_str());
+        return false;
+    }
+    
+    FileUploadSource fileSource(file);
+    unsigned long startTime = millis();
+    bool success;
+    if (config->getCompressionCodec() == "EDF" && isSignalEdfFile(localPath)) {
+        EdfCodec codec(fileSource, fileSize);
+        success = backend->uploadStream(codec, UploadPipeline::STREAM_TO_END, remotePath + ".edz",
+                                        bytesSent) && !codec.hasFailed();
+    } else {
+        GzipSource gzip(fileSource, fileSize);
+        if (!gzip.begin()) {
+            file.close();
+            return false;
+        }
+        success = backend->uploadStream(gzip, UploadPipeline::STREAM_TO_END, remotePath + ".gz",
+                                        bytesSent) && !gzip.hasFailed();
+    }
+    file.close();
+    
+    if (!success) {
+        return false;
+    }
+    
+    unsigned long elapsed = millis() - startTime;
+    if (fileSize >= 5120) {  // 5KB minimum for rate calculation
+        budgetManager->recordCompressedUpload(fileSize, elapsed);
+    }
+    LOGF("[FileUploader] Compressed %lu to %lu bytes (%lu%%)", fileSize, bytesSent,
+         (bytesSent * 100UL) / fileSize);
+    return true;
+}
+
 // Upload a single file (for root and SETTINGS files)
 bool FileUploader::uploadSingleFile(SDCardManager* sdManager, const String& filePath) {
     fs::FS &sd = sdManager->getFS();
@@ -866,6 +1737,7 @@ bool FileUploader::uploadSingleFile(SDCardManager* sdManager, const String& file
     }
     
     unsigned long fileSize = file.size();
+    time_t lastWrite = file.getLastWrite();
     
     // Sanity check file size
     if (fileSize == 0) {
@@ -876,80 +1748,55 @@ bool FileUploader::uploadSingleFile(SDCardManager* sdManager, const String& file
     
     file.close();
     
-    // Check if we have budget for this file
-    if (!budgetManager->canUploadFile(fileSize)) {
+    // Skip unchanged growing files; resume or append where possible
+    unsigned long startOffset = 0;
+    unsigned long appendOffset = 0;
+    if (!planStartOffset(sd, filePath, fileSize, startOffset, appendOffset)) {
+        LOG_DEBUG("[FileUploader] File unchanged, skipping upload");
+        return true;
+    }
+    
+    // Check if we have budget for this file (or at least a useful slice of it)
+    unsigned long maxBytes = planUploadBytes(fileSize - startOffset);
+    if (maxBytes == 0) {
         LOGF("[FileUploader] Insufficient time budget for file: %s", filePath.c_str());
         LOG("[FileUploader] File will be uploaded in next session");
         return false;  // Not an error, just out of budget
     }
     
-    // Check if file has changed (checksum comparison)
-    if (!stateManager->hasFileChanged(sd, filePath)) {
-        LOG_DEBUG("[FileUploader] File unchanged, skipping upload");
-        return true;  // Not an error, just no need to upload
-    }
+    // Other files were already found changed by the scan, so no checksum
+    // pass here: the uploader hashes the data as it sends it
     
     // Upload the file
     unsigned long bytesTransferred = 0;
     unsigned long uploadStartTime = millis();
     
-    bool uploadSuccess = false;
-    
-    // Use the appropriate uploader based on configuration
-#ifdef ENABLE_SMB_UPLOAD
-    if (smbUploader && config->getEndpointType() == "SMB") {
-        // Ensure SMB connection is established
-        if (!smbUploader->isConnected()) {
-            LOG_DEBUG("[FileUploader] SMB not connected, attempting to connect...");
-            if (!smbUploader->begin()) {
-                LOG_ERROR("[FileUploader] Failed to connect to SMB share");
-                LOG_ERROR("[FileUploader] Check network connectivity and SMB credentials");
-                return false;
-            }
-        }
-        
-        uploadSuccess = smbUploader->upload(filePath, filePath, sd, bytesTransferred);
-    } else
-#endif
-#ifdef ENABLE_WEBDAV_UPLOAD
-    if (webdavUploader && config->getEndpointType() == "WEBDAV") {
-        // Ensure WebDAV connection is established
-        if (!webdavUploader->isConnected()) {
-            LOG_DEBUG("[FileUploader] WebDAV not connected, attempting to connect...");
-            if (!webdavUploader->begin()) {
-                LOG_ERROR("[FileUploader] Failed to connect to WebDAV server");
-                LOG_ERROR("[FileUploader] Check network connectivity and WebDAV credentials");
-                return false;
-            }
-        }
-        
-        uploadSuccess = webdavUploader->upload(filePath, filePath, sd, bytesTransferred);
-    } else
-#endif
-#ifdef ENABLE_SLEEPHQ_UPLOAD
-    if (sleephqUploader && config->getEndpointType() == "SLEEPHQ") {
-        // Ensure SleepHQ connection is established
-        if (!sleephqUploader->isConnected()) {
-            LOG_DEBUG("[FileUploader] SleepHQ not connected, attempting to connect...");
-            if (!sleephqUploader->begin()) {
-                LOG_ERROR("[FileUploader] Failed to connect to SleepHQ service");
-                LOG_ERROR("[FileUploader] Check network connectivity and API credentials");
-                return false;
-            }
-        }
-        
-        uploadSuccess = sleephqUploader->upload(filePath, filePath, sd, bytesTransferred);
-    } else
-#endif
-    {
-        LOG_ERROR("[FileUploader] No uploader available for configured endpoint type");
-        LOG_ERROR("[FileUploader] Check ENDPOINT_TYPE in config.json and build flags");
+    // Reuse the existing session (reconnects if it went stale)
+    if (!backend->ensureConnected()) {
+        LOG_ERRORF("[FileUploader] Failed to connect to %s endpoint", backend->getName());
+        LOG_ERROR("[FileUploader] Check network connectivity and endpoint credentials");
         return false;
     }
     
+    bool uploadSuccess = backend->upload(filePath, filePath, sd, bytesTransferred,
+                                         startOffset, maxBytes);
+    if (uploadSuccess && appendOffset > 0 && startOffset + bytesTransferred >= fileSize) {
+        uploadSuccess = refreshAppendedHeader(sd, filePath, filePath, appendOffset);
+    }
+    
+    bool fileComplete = updateUploadCheckpoint(filePath, fileSize, startOffset,
+                                               bytesTransferred, uploadSuccess);
+    
     if (!uploadSuccess) {
         LOG_ERROR("[FileUploader] Failed to upload file");
-        LOG_ERROR("[FileUploader] This may be due to network issues or SMB server problems");
+        LOG_ERROR("[FileUploader] This may be due to network issues or server problems");
+        stateManager->save(sd);  // Keep the resume checkpoint
+        return false;
+    }
+    
+    if (!fileComplete) {
+        LOGF("[FileUploader] Partial upload of %s, will resume next session", filePath.c_str());
+        stateManager->save(sd);
         return false;
     }
     
@@ -959,23 +1806,98 @@ bool FileUploader::uploadSingleFile(SDCardManager* sdManager, const String& file
         budgetManager->recordUpload(bytesTransferred, uploadTime);
     }
     
-    // Calculate and store new checksum
-    // The hasFileChanged method already calculated it, but we need to mark it as uploaded
-    // We'll recalculate to ensure consistency
-    File checksumFile = sd.open(filePath);
-    if (checksumFile) {
-        // Calculate checksum (simplified - actual implementation in UploadStateManager)
-        String checksum = "";  // Will be calculated by markFileUploaded
-        checksumFile.close();
-        
-        // Mark file as uploaded with its checksum
+    // Store the checksum hashed while sending, with the size and timestamp
+    // seen at open so the next scan can skip the file without reading it
+    String checksum = backend->getLastChecksum();
+    if (isAppendOnlyFile(filePath)) {
         stateManager->markFileUploaded(filePath, checksum);
-        
-        // Save state
-        stateManager->save(sd);
+        stateManager->recordUploadedLength(sd, filePath, fileSize);
+    } else {
+        if (checksum.isEmpty()) {
+            // Resumed or sent by a backend without inline hashing
+            checksum = stateManager->calculateChecksum(sd, filePath);
+        }
+        stateManager->markFileUploaded(filePath, checksum, fileSize, lastWrite);
     }
     
+    // Save state
+    stateManager->save(sd);
+    
     LOGF("[FileUploader] Successfully uploaded: %s (%lu bytes)", filePath.c_str(), bytesTransferred);
     
     return true;
 }
+
+// Upload a root or SETTINGS file to several targets with one read
+bool FileUploader::uploadSingleFileFanOut(SDCardManager* sdManager, const String& filePath,
+                                          const std::vector<size_t>& group) {
+    fs::FS &sd = sdManager->getFS();
+    LOGF("[FileUploader] Uploading single file: %s (%d endpoints, one read)", filePath.c_str(), group.size());
+    
+    File file = sd.open(filePath);
+    if (!file) {
+        LOG_ERRORF("[FileUploader] Cannot open file for reading: %s", filePath.c_str());
+        LOG_ERROR("[FileUploader] File may be corrupted or SD card has read errors");
+        return false;
+    }
+    unsigned long fileSize = file.size();
+    time_t lastWrite = file.getLastWrite();
+    file.close();
+    if (fileSize == 0) {
+        LOG_WARNF("[FileUploader] File is empty: %s", filePath.c_str());
+        return true;  // Consider empty file as "uploaded" (skip it)
+    }
+    
+    if (!budgetManager->canUploadFile(fileSize)) {
+        LOGF("[FileUploader] Insufficient time budget for file: %s", filePath.c_str());
+        LOG("[FileUploader] File will be uploaded in next session");
+        return false;
+    }
+    
+    std::vector<size_t> receivers;
+    for (size_t t : group) {
+        if (targets[t].backend->ensureConnected()) {
+            receivers.push_back(t);
+        } else {
+            LOG_ERRORF("[FileUploader] Failed to connect to %s endpoint", targets[t].backend->getName());
+        }
+    }
+    if (receivers.empty()) {
+        return false;
+    }
+    
+    // The checksum is hashed on the shared read, once for every target
+    Md5Digest digest;
+    std::vector<bool> delivered;
+    unsigned long uploadStartTime = millis();
+    bool any = pushFile(sd, filePath, fileSize, receivers, delivered, &digest);
+    String checksum = (digest.getBytes() == fileSize) ? digest.finishHex() : String("");
+    
+    unsigned long uploadTime = millis() - uploadStartTime;
+    if (any && fileSize >= 5120) {  // 5KB minimum for rate calculation
+        budgetManager->recordUpload(fileSize, uploadTime);
+    }
+    
+    for (size_t i = 0; i < receivers.size(); i++) {
+        UploadTarget& target = targets[receivers[i]];
+        if (!delivered[i]) {
+            LOG_ERRORF("[FileUploader] Failed to upload %s to %s endpoint", filePath.c_str(), target.backend->getName());
+            continue;
+        }
+        if (target.state->getCheckpointPath() == filePath) {
+            target.state->clearUploadCheckpoint();
+        }
+        if (isAppendOnlyFile(filePath)) {
+            target.state->markFileUploaded(filePath, checksum);
+            target.state->recordUploadedLength(sd, filePath, fileSize);
+        } else {
+            target.state->markFileUploaded(filePath, checksum, fileSize, lastWrite);
+        }
+        target.state->save(sd);
+    }
+    
+    if (any) {
+        LOGF("[FileUploader] Successfully uploaded: %s (%lu bytes)", filePath.c_str(), fileSize);
+    }
+    return any;
+}
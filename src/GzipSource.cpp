@@ -0,0 +1,347 @@
+#include "GzipSource.h"
+#include "Logger.h"
+
+#if GZIP_WINDOW_BITS < 10 || GZIP_WINDOW_BITS > 14
+#error "GZIP_WINDOW_BITS must be between 10 and 14"
+#endif
+
+// Refill the window when fewer bytes than this are ahead of the current
+// position, so a full-length match can always be compared
+static const size_t MIN_LOOKAHEAD = GzipSource::MAX_MATCH + GzipSource::MIN_MATCH + 1;
+
+// Positions inside matches up to this length are added to the hash chains.
+// Longer matches are skipped over (run-length data, cheap either way).
+static const size_t MAX_INSERT_LENGTH = 16;
+
+static const size_t WINDOW_MASK = GzipSource::WINDOW_SIZE - 1;
+
+// RFC 1951 3.2.5: match length and distance code tables
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+GzipSource::GzipSource(UploadSource& input, size_t inputSize)
+    : input(input),
+      inputSize(inputSize),
+      inputConsumed(0),
+      outputProduced(0),
+      window(nullptr),
+      head(nullptr),
+      prev(nullptr),
+      strstart(0),
+      lookahead(0),
+      bitBuffer(0),
+      bitCount(0),
+      pendingLength(0),
+      pendingOffset(0),
+      headerWritten(false),
+      finished(false),
+      failed(false) {
+}
+
+GzipSource::~GzipSource() {
+    free(window);
+    free(head);
+    free(prev);
+}
+
+bool GzipSource::begin() {
+    if (window == nullptr) {
+        window = (uint8_t*)malloc(2 * WINDOW_SIZE);
+        head = (uint16_t*)malloc(WINDOW_SIZE * sizeof(uint16_t));
+        prev = (uint16_t*)malloc(WINDOW_SIZE * sizeof(uint16_t));
+    }
+    if (window == nullptr || head == nullptr || prev == nullptr) {
+        LOGF("[Gzip] ERROR: Failed to allocate compressor state (%u bytes)",
+             (unsigned)(6 * WINDOW_SIZE));
+        LOG("[Gzip] System may be low on memory");
+        free(window);
+        free(head);
+        free(prev);
+        window = nullptr;
+        head = nullptr;
+        prev = nullptr;
+        return false;
+    }
+
+    memset(head, 0xFF, WINDOW_SIZE * sizeof(uint16_t));  // All NIL
+    crc.begin();
+    inputConsumed = 0;
+    outputProduced = 0;
+    strstart = 0;
+    lookahead = 0;
+    bitBuffer = 0;
+    bitCount = 0;
+    pendingLength = 0;
+    pendingOffset = 0;
+    headerWritten = false;
+    finished = false;
+    failed = false;
+    return true;
+}
+
+// 3-byte hash of the bytes at pos (multiplicative, top bits)
+static inline uint32_t hashAt(const uint8_t* p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - GZIP_WINDOW_BITS);
+}
+
+void GzipSource::fillWindow() {
+    // Slide the upper half down once the position nears the end of the buffer
+    if (strstart >= 2 * WINDOW_SIZE - MIN_LOOKAHEAD) {
+        memmove(window, window + WINDOW_SIZE, WINDOW_SIZE);
+        strstart -= WINDOW_SIZE;
+        for (size_t i = 0; i < WINDOW_SIZE; i++) {
+            head[i] = (head[i] != NIL && head[i] >= WINDOW_SIZE) ? head[i] - WINDOW_SIZE : NIL;
+            prev[i] = (prev[i] != NIL && prev[i] >= WINDOW_SIZE) ? prev[i] - WINDOW_SIZE : NIL;
+        }
+    }
+
+    size_t end = strstart + lookahead;
+    size_t space = 2 * WINDOW_SIZE - end;
+    size_t left = inputSize - inputConsumed;
+    size_t wanted = left < space ? left : space;
+
+    while (wanted > 0) {
+        size_t bytesRead = input.read(window + end, wanted);
+        if (bytesRead == 0) {
+            LOGF("[Gzip] ERROR: Input ended after %u of %u bytes",
+                 (unsigned)inputConsumed, (unsigned)inputSize);
+            failed = true;
+            return;
+        }
+        crc.update(window + end, bytesRead);
+        inputConsumed += bytesRead;
+        lookahead += bytesRead;
+        end += bytesRead;
+        wanted -= bytesRead;
+    }
+}
+
+void GzipSource::insertHash(size_t pos) {
+    if (pos + MIN_MATCH > strstart + lookahead) {
+        return;  // Not enough data left to hash
+    }
+    uint32_t h = hashAt(window + pos);
+    prev[pos & WINDOW_MASK] = head[h];
+    head[h] = pos;
+}
+
+// Walk the hash chain for the longest match at strstart
+size_t GzipSource::longestMatch(uint16_t candidate, size_t& matchDistance) {
+    size_t maxLength = lookahead < MAX_MATCH ? lookahead : MAX_MATCH;
+    const uint8_t* scan = window + strstart;
+    size_t best = 0;
+    int chain = GZIP_MAX_CHAIN;
+
+    // prev[] only describes the last WINDOW_SIZE positions
+    size_t cur = candidate;
+    while (cur < strstart && strstart - cur < WINDOW_SIZE && chain-- > 0) {
+        const uint8_t* match = window + cur;
+        if (match[best] == scan[best] && match[0] == scan[0] && match[1] == scan[1]) {
+            size_t length = 0;
+            while (length < maxLength && match[length] == scan[length]) {
+                length++;
+            }
+            if (length > best) {
+                best = length;
+                matchDistance = strstart - cur;
+                if (best >= maxLength) {
+                    break;
+                }
+            }
+        }
+
+        uint16_t next = prev[cur & WINDOW_MASK];
+        if (next == NIL || next >= cur) {
+            break;
+        }
+        cur = next;
+    }
+    return best;
+}
+
+void GzipSource::compressStep() {
+    if (lookahead < MIN_LOOKAHEAD && inputConsumed < inputSize) {
+        fillWindow();
+        if (failed) {
+            return;
+        }
+    }
+
+    if (lookahead == 0) {
+        finish();
+        return;
+    }
+
+    size_t matchLength = 0;
+    size_t matchDistance = 0;
+    if (lookahead >= MIN_MATCH) {
+        uint32_t h = hashAt(window + strstart);
+        uint16_t candidate = head[h];
+        prev[strstart & WINDOW_MASK] = candidate;
+        head[h] = strstart;
+        if (candidate != NIL) {
+            matchLength = longestMatch(candidate, matchDistance);
+        }
+    }
+
+    if (matchLength >= MIN_MATCH) {
+        putMatch(matchLength, matchDistance);
+        if (matchLength <= MAX_INSERT_LENGTH) {
+            for (size_t i = 1; i < matchLength; i++) {
+                insertHash(strstart + i);
+            }
+        }
+        strstart += matchLength;
+        lookahead -= matchLength;
+    } else {
+        putLiteral(window[strstart]);
+        strstart++;
+        lookahead--;
+    }
+}
+
+// End-of-block code, then the gzip trailer: CRC-32 and size of the raw data
+void GzipSource::finish() {
+    putReversed(0, 7);  // Symbol 256
+    flushBits();
+
+    uint32_t value = crc.getValue();
+    for (int i = 0; i < 4; i++) {
+        putByte((value >> (8 * i)) & 0xFF);
+    }
+    uint32_t size = (uint32_t)inputSize;
+    for (int i = 0; i < 4; i++) {
+        putByte((size >> (8 * i)) & 0xFF);
+    }
+    finished = true;
+}
+
+void GzipSource::putByte(uint8_t value) {
+    pending[pendingLength++] = value;
+}
+
+// Deflate packs bits LSB first
+void GzipSource::putBits(uint32_t value, int count) {
+    bitBuffer |= value << bitCount;
+    bitCount += count;
+    while (bitCount >= 8) {
+        putByte(bitBuffer & 0xFF);
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+// Huffman codes are defined MSB first, so they go out bit-reversed
+void GzipSource::putReversed(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    putBits(reversed, length);
+}
+
+void GzipSource::flushBits() {
+    if (bitCount > 0) {
+        putByte(bitBuffer & 0xFF);
+    }
+    bitBuffer = 0;
+    bitCount = 0;
+}
+
+// Fixed Huffman literal codes: 0-143 are 8 bits, 144-255 are 9 bits
+void GzipSource::putLiteral(uint8_t value) {
+    if (value < 144) {
+        putReversed(0x30 + value, 8);
+    } else {
+        putReversed(0x190 + (value - 144), 9);
+    }
+}
+
+void GzipSource::putMatch(size_t length, size_t distance) {
+    int code = 28;
+    while (LENGTH_BASE[code] > length) {
+        code--;
+    }
+    int symbol = 257 + code;
+    if (symbol <= 279) {
+        putReversed(symbol - 256, 7);
+    } else {
+        putReversed(0xC0 + (symbol - 280), 8);
+    }
+    if (LENGTH_EXTRA[code] > 0) {
+        putBits(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+    }
+
+    int dcode = 29;
+    while (DISTANCE_BASE[dcode] > distance) {
+        dcode--;
+    }
+    putReversed(dcode, 5);
+    if (DISTANCE_EXTRA[dcode] > 0) {
+        putBits(distance - DISTANCE_BASE[dcode], DISTANCE_EXTRA[dcode]);
+    }
+}
+
+size_t GzipSource::read(uint8_t* buffer, size_t len) {
+    if (failed) {
+        return 0;
+    }
+    if (window == nullptr) {
+        LOG("[Gzip] ERROR: read() called before begin()");
+        failed = true;
+        return 0;
+    }
+
+    size_t produced = 0;
+    while (produced < len) {
+        if (pendingOffset < pendingLength) {
+            size_t available = pendingLength - pendingOffset;
+            size_t n = (len - produced) < available ? (len - produced) : available;
+            memcpy(buffer + produced, pending + pendingOffset, n);
+            pendingOffset += n;
+            produced += n;
+            continue;
+        }
+        if (finished || failed) {
+            break;
+        }
+
+        pendingLength = 0;
+        pendingOffset = 0;
+
+        if (!headerWritten) {
+            // Member header: magic, deflate, no flags, no mtime, OS unknown
+            static const uint8_t GZIP_HEADER[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+            for (size_t i = 0; i < sizeof(GZIP_HEADER); i++) {
+                putByte(GZIP_HEADER[i]);
+            }
+            putBits(1, 1);  // BFINAL: the only block
+            putBits(1, 2);  // BTYPE 01: fixed Huffman codes
+            headerWritten = true;
+        }
+
+        // One step emits at most 4 bytes, the trailer 10
+        while (!finished && !failed && pendingLength + 16 <= PENDING_SIZE) {
+            compressStep();
+        }
+    }
+
+    outputProduced += produced;
+    return produced;
+}
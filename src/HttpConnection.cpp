@@ -0,0 +1,442 @@
+#include "HttpConnection.h"
+#include "Logger.h"
+#include <string>
+
+#ifndef UNIT_TEST
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+
+// Root CA bundle embedded by board_build.embed_files (platformio.ini)
+extern const uint8_t rootca_crt_bundle_start[] asm("_binary_data_cert_x509_crt_bundle_bin_start");
+#endif
+
+HttpConnection::HttpConnection()
+    : client(nullptr),
+      ownsClient(false),
+      port(80),
+      secure(false),
+      insecure(false),
+      timeoutMs(10000),
+      chunkedRequest(false),
+      reused(false),
+      capturedName(nullptr),
+      readPos(0),
+      readLen(0),
+      connectCount(0),
+      requestCount(0) {
+}
+
+HttpConnection::~HttpConnection() {
+    close();
+    if (ownsClient) {
+        delete client;
+    }
+}
+
+bool HttpConnection::setUrl(const String& url) {
+    std::string text(url.c_str());
+    size_t hostStart;
+    if (text.compare(0, 8, "https://") == 0) {
+        secure = true;
+        port = 443;
+        hostStart = 8;
+    } else if (text.compare(0, 7, "http://") == 0) {
+        secure = false;
+        port = 80;
+        hostStart = 7;
+    } else {
+        LOGF("[HTTP] ERROR: URL must start with http:// or https://: %s", url.c_str());
+        return false;
+    }
+
+    size_t pathStart = text.find('/', hostStart);
+    std::string authority = text.substr(hostStart, pathStart == std::string::npos
+                                                       ? std::string::npos : pathStart - hostStart);
+    size_t colon = authority.find(':');
+    if (colon != std::string::npos) {
+        int parsedPort = atoi(authority.c_str() + colon + 1);
+        if (parsedPort <= 0 || parsedPort > 65535) {
+            LOGF("[HTTP] ERROR: Invalid port in URL: %s", url.c_str());
+            return false;
+        }
+        port = (uint16_t)parsedPort;
+        authority = authority.substr(0, colon);
+    }
+    if (authority.empty()) {
+        LOGF("[HTTP] ERROR: No host in URL: %s", url.c_str());
+        return false;
+    }
+    host = String(authority.c_str());
+
+    std::string path = pathStart == std::string::npos ? "" : text.substr(pathStart);
+    while (!path.empty() && path[path.length() - 1] == '/') {
+        path.erase(path.length() - 1);
+    }
+    basePath = String(path.c_str());
+    return true;
+}
+
+void HttpConnection::setBasicAuth(const String& user, const String& password) {
+    if (user.isEmpty()) {
+        authorization = "";
+        return;
+    }
+    authorization = String("Basic ") + base64Encode(user + ":" + password);
+}
+
+void HttpConnection::setClient(Client* transport) {
+    close();
+    if (ownsClient) {
+        delete client;
+    }
+    client = transport;
+    ownsClient = false;
+}
+
+bool HttpConnection::connect() {
+    if (client && client->connected()) {
+        reused = true;
+        return true;
+    }
+    reused = false;
+    readPos = readLen = 0;
+
+#ifndef UNIT_TEST
+    if (client == nullptr) {
+        if (secure) {
+            WiFiClientSecure* tls = new WiFiClientSecure();
+            if (insecure) {
+                LOG_WARNF("[HTTP] Certificate of %s is not verified (insecure TLS enabled)", host.c_str());
+                tls->setInsecure();
+            } else {
+                tls->setCACertBundle(rootca_crt_bundle_start);
+            }
+            client = tls;
+        } else {
+            client = new WiFiClient();
+        }
+        ownsClient = true;
+    }
+#endif
+    if (client == nullptr) {
+        return false;
+    }
+
+    if (!client->connect(host.c_str(), port)) {
+        LOGF("[HTTP] ERROR: Cannot connect to %s:%u", host.c_str(), port);
+        if (secure && !insecure) {
+            LOG("[HTTP] A self-signed server certificate is rejected (see WEBDAV_TLS_INSECURE)");
+        }
+        return false;
+    }
+    connectCount++;
+    LOG_DEBUGF("[HTTP] Connected to %s:%u%s", host.c_str(), port, secure ? " (TLS)" : "");
+    return true;
+}
+
+bool HttpConnection::isOpen() {
+    return client && client->connected();
+}
+
+void HttpConnection::close() {
+    if (client) {
+        client->stop();
+    }
+    readPos = readLen = 0;
+}
+
+bool HttpConnection::writeAll(const uint8_t* data, size_t len) {
+    unsigned long lastProgress = millis();
+    while (len > 0) {
+        size_t written = client->write(data, len);
+        if (written > 0) {
+            data += written;
+            len -= written;
+            lastProgress = millis();
+        } else if (!client->connected() || millis() - lastProgress > timeoutMs) {
+            LOG_ERROR("[HTTP] Write failed, closing connection");
+            close();
+            return false;
+        } else {
+            delay(1);
+        }
+    }
+    return true;
+}
+
+bool HttpConnection::beginRequest(const char* method, const String& path, long contentLength,
+                                  const String& headers) {
+    if (!connect()) {
+        return false;
+    }
+    requestCount++;
+    chunkedRequest = (contentLength == CHUNKED);
+
+    // Request line and headers go out in one write (one TCP segment)
+    std::string head;
+    head.reserve(256 + headers.length());
+    head += method;
+    head += " ";
+    head += encodePath(path).c_str();
+    head += " HTTP/1.1\r\nHost: ";
+    head += host.c_str();
+    if (port != (secure ? 443 : 80)) {
+        head += ":" + std::to_string(port);
+    }
+    head += "\r\nUser-Agent: CPAP-Uploader\r\nConnection: keep-alive\r\n";
+    if (!authorization.isEmpty()) {
+        head += "Authorization: ";
+        head += authorization.c_str();
+        head += "\r\n";
+    }
+    if (chunkedRequest) {
+        head += "Transfer-Encoding: chunked\r\n";
+    } else if (contentLength > 0 || strcmp(method, "PUT") == 0) {
+        head += "Content-Length: " + std::to_string(contentLength) + "\r\n";
+    }
+    head += headers.c_str();
+    head += "\r\n";
+
+    return writeAll((const uint8_t*)head.data(), head.length());
+}
+
+bool HttpConnection::writeBody(const uint8_t* data, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+    if (chunkedRequest) {
+        char size[16];
+        snprintf(size, sizeof(size), "%x\r\n", (unsigned int)len);
+        return writeAll((const uint8_t*)size, strlen(size)) && writeAll(data, len) &&
+               writeAll((const uint8_t*)"\r\n", 2);
+    }
+    return writeAll(data, len);
+}
+
+bool HttpConnection::endRequest() {
+    if (chunkedRequest) {
+        chunkedRequest = false;
+        return writeAll((const uint8_t*)"0\r\n\r\n", 5);
+    }
+    return true;
+}
+
+bool HttpConnection::fillBuffer() {
+    unsigned long start = millis();
+    while (true) {
+        int available = client->available();
+        if (available > 0) {
+            size_t want = (size_t)available < sizeof(readBuffer) ? (size_t)available : sizeof(readBuffer);
+            int n = client->read(readBuffer, want);
+            if (n > 0) {
+                readPos = 0;
+                readLen = (size_t)n;
+                return true;
+            }
+        } else if (!client->connected()) {
+            return false;
+        }
+        if (millis() - start > timeoutMs) {
+            LOG_ERROR("[HTTP] Timed out waiting for the server");
+            return false;
+        }
+        delay(1);
+    }
+}
+
+bool HttpConnection::readLine(String& line) {
+    std::string text;
+    while (true) {
+        if (readPos >= readLen && !fillBuffer()) {
+            return false;
+        }
+        char c = (char)readBuffer[readPos++];
+        if (c == '\n') {
+            if (!text.empty() && text[text.length() - 1] == '\r') {
+                text.erase(text.length() - 1);
+            }
+            line = String(text.c_str());
+            return true;
+        }
+        if (text.length() >= 1024) {
+            LOG_ERROR("[HTTP] Response line too long");
+            return false;
+        }
+        text += c;
+    }
+}
+
+// length < 0: until the server closes the connection
+bool HttpConnection::readBody(long length, HttpConnection::BodyHandler handler, void* context) {
+    while (length != 0) {
+        if (readPos >= readLen && !fillBuffer()) {
+            return length < 0;
+        }
+        size_t n = readLen - readPos;
+        if (length > 0 && (size_t)length < n) {
+            n = (size_t)length;
+        }
+        if (handler) {
+            handler(readBuffer + readPos, n, context);
+        }
+        readPos += n;
+        if (length > 0) {
+            length -= n;
+        }
+    }
+    return true;
+}
+
+bool HttpConnection::readChunkedBody(HttpConnection::BodyHandler handler, void* context) {
+    String line;
+    while (true) {
+        if (!readLine(line)) {
+            return false;
+        }
+        long size = strtol(line.c_str(), nullptr, 16);
+        if (size < 0) {
+            return false;
+        }
+        if (size == 0) {
+            // Trailer headers end with an empty line
+            do {
+                if (!readLine(line)) {
+                    return false;
+                }
+            } while (!line.isEmpty());
+            return true;
+        }
+        if (!readBody(size, handler, context) || !readLine(line)) {
+            return false;
+        }
+    }
+}
+
+int HttpConnection::readResponse(HttpConnection::BodyHandler handler, void* context) {
+    if (client == nullptr) {
+        return -1;
+    }
+
+    String line;
+    capturedValue = "";
+    int status;
+    long contentLength;
+    bool chunked;
+    bool closeAfter;
+    do {
+        if (!readLine(line) || !line.startsWith("HTTP/1.") || line.length() < 12) {
+            close();
+            return -1;
+        }
+        status = atoi(line.c_str() + 9);
+        contentLength = -1;
+        chunked = false;
+        closeAfter = line.startsWith("HTTP/1.0");
+
+        while (true) {
+            if (!readLine(line)) {
+                close();
+                return -1;
+            }
+            if (line.isEmpty()) {
+                break;
+            }
+            String name = line;
+            name.toLowerCase();
+            if (name.startsWith("content-length:")) {
+                contentLength = atol(line.c_str() + 15);
+            } else if (name.startsWith("transfer-encoding:") && strstr(name.c_str(), "chunked")) {
+                chunked = true;
+            } else if (name.startsWith("connection:")) {
+                closeAfter = strstr(name.c_str(), "close") != nullptr;
+            }
+            if (capturedName != nullptr && name.startsWith(capturedName) &&
+                name.c_str()[strlen(capturedName)] == ':') {
+                const char* value = line.c_str() + strlen(capturedName) + 1;
+                while (*value == ' ') {
+                    value++;
+                }
+                capturedValue = value;
+            }
+        }
+    } while (status >= 100 && status < 200);
+
+    bool bodyRead;
+    if (status == 204 || status == 304) {
+        bodyRead = true;
+    } else if (chunked) {
+        bodyRead = readChunkedBody(handler, context);
+    } else if (contentLength >= 0) {
+        bodyRead = readBody(contentLength, handler, context);
+    } else {
+        bodyRead = readBody(-1, handler, context);
+        closeAfter = true;
+    }
+
+    if (!bodyRead) {
+        close();
+        return -1;
+    }
+    if (closeAfter) {
+        close();
+    }
+    return status;
+}
+
+int HttpConnection::request(const char* method, const String& path, const String& headers,
+                            const String& body, HttpConnection::BodyHandler handler, void* context) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool sent = beginRequest(method, path, (long)body.length(), headers) &&
+                    writeBody((const uint8_t*)body.c_str(), body.length());
+        bool reusedConnection = reused;
+        int status = sent ? readResponse(handler, context) : -1;
+        if (status >= 0 || !reusedConnection) {
+            return status;
+        }
+        // The server closed the idle keep-alive connection: one fresh try
+        LOG_DEBUG("[HTTP] Reused connection was closed by the server, reconnecting");
+        close();
+    }
+    return -1;
+}
+
+String HttpConnection::urlFor(const String& path) const {
+    String url = String(secure ? "https://" : "http://") + host;
+    if (port != (secure ? 443 : 80)) {
+        url += ":" + String(port);
+    }
+    return url + encodePath(path);
+}
+
+String HttpConnection::encodePath(const String& path) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string encoded;
+    for (const char* p = path.c_str(); *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' || c == '~') {
+            encoded += (char)c;
+        } else {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 0x0F];
+        }
+    }
+    return String(encoded.c_str());
+}
+
+String HttpConnection::base64Encode(const String& text) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const uint8_t* data = (const uint8_t*)text.c_str();
+    size_t len = text.length();
+    std::string encoded;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t group = (uint32_t)data[i] << 16;
+        if (i + 1 < len) group |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len) group |= data[i + 2];
+        encoded += alphabet[(group >> 18) & 0x3F];
+        encoded += alphabet[(group >> 12) & 0x3F];
+        encoded += i + 1 < len ? alphabet[(group >> 6) & 0x3F] : '=';
+        encoded += i + 2 < len ? alphabet[group & 0x3F] : '=';
+    }
+    return String(encoded.c_str());
+}
@@ -0,0 +1,378 @@
+#include "LocalDirUploader.h"
+#include "Logger.h"
+#include "UploadPipeline.h"
+#include "Md5Digest.h"
+#include "Config.h"
+
+#ifdef ENABLE_LOCAL_UPLOAD
+
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+
+/**
+ * Pipeline sink writing to an open stdio file
+ */
+class LocalFileSink : public UploadSink {
+public:
+    explicit LocalFileSink(FILE* file) : file(file), written(0) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        if (fwrite(data, 1, len, file) != len) {
+            LOGF("[Local] ERROR: Write failed at offset %lu: %s", written, strerror(errno));
+            return false;
+        }
+        written += len;
+        return true;
+    }
+
+    unsigned long getWritten() const { return written; }
+
+private:
+    FILE* file;
+    unsigned long written;
+};
+
+static long fileLength(FILE* file) {
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return ftell(file);
+}
+
+LocalDirUploader::LocalDirUploader(const String& directory)
+    : baseDir(directory), connected(false), filesWritten(0), bytesWritten(0),
+      pushFile(nullptr), pushSink(nullptr), pushSize(0) {
+    // Remote paths start with '/'
+    while (baseDir.length() > 1 && baseDir.endsWith("/")) {
+        baseDir = baseDir.substring(0, baseDir.length() - 1);
+    }
+}
+
+LocalDirUploader::~LocalDirUploader() {
+    end();
+}
+
+UploadBackend* LocalDirUploader::create(const Config& /*config*/, const EndpointConfig& endpoint) {
+    return new LocalDirUploader(endpoint.url);
+}
+
+String LocalDirUploader::buildPath(const String& remotePath) const {
+    return baseDir + remotePath;
+}
+
+// mkdir -p for every directory above path
+bool LocalDirUploader::createParentDirectories(const String& path) {
+    std::string full(path.c_str());
+    for (size_t slash = full.find('/', 1); slash != std::string::npos; slash = full.find('/', slash + 1)) {
+        std::string dir = full.substr(0, slash);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            LOGF("[Local] ERROR: Cannot create directory %s: %s", dir.c_str(), strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+void LocalDirUploader::end() {
+    if (pushFile != nullptr) {
+        finishFile(false);
+    }
+    connected = false;
+}
+
+bool LocalDirUploader::ensureConnected() {
+    if (connected) {
+        return true;
+    }
+    if (baseDir.isEmpty()) {
+        LOG("[Local] ERROR: ENDPOINT must name a directory");
+        return false;
+    }
+
+    // Creating a placeholder path below the base creates the base itself
+    if (!createParentDirectories(baseDir + "/")) {
+        return false;
+    }
+    struct stat st;
+    if (stat(baseDir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        LOGF("[Local] ERROR: Not a directory: %s", baseDir.c_str());
+        return false;
+    }
+
+    LOGF("[Local] Writing uploads to %s", baseDir.c_str());
+    connected = true;
+    return true;
+}
+
+bool LocalDirUploader::uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                                  const String& remotePath, unsigned long& bytesTransferred,
+                                  unsigned long startOffset, unsigned long maxBytes) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+
+    if (!connected) {
+        LOG("[Local] Not connected");
+        return false;
+    }
+
+    if (fileSize == 0) {
+        LOGF("[Local] WARNING: File is empty: %s", localPath.c_str());
+        return false;
+    }
+    if (startOffset >= fileSize) {
+        startOffset = 0;
+    }
+
+    String target = buildPath(remotePath);
+    if (!createParentDirectories(target)) {
+        return false;
+    }
+
+    // Resume keeps the bytes already written, if the copy is long enough
+    FILE* remoteFile = nullptr;
+    long remoteSize = 0;
+    if (startOffset > 0) {
+        remoteFile = fopen(target.c_str(), "r+b");
+        remoteSize = remoteFile ? fileLength(remoteFile) : -1;
+        if (remoteSize < (long)startOffset) {
+            LOGF("[Local] WARNING: Target shorter than checkpoint (%lu bytes), starting over", startOffset);
+            if (remoteFile) {
+                fclose(remoteFile);
+                remoteFile = nullptr;
+            }
+            startOffset = 0;
+        }
+    }
+    if (remoteFile == nullptr) {
+        remoteFile = fopen(target.c_str(), "wb");
+        remoteSize = 0;
+    }
+    if (remoteFile == nullptr) {
+        LOGF("[Local] ERROR: Cannot open %s: %s", target.c_str(), strerror(errno));
+        return false;
+    }
+    if (startOffset > 0 && (!localFile.seek(startOffset) || fseek(remoteFile, startOffset, SEEK_SET) != 0)) {
+        LOGF("[Local] ERROR: Failed to seek to resume offset %lu", startOffset);
+        fclose(remoteFile);
+        return false;
+    }
+
+    size_t bytesToSend = fileSize - startOffset;
+    if (maxBytes > 0 && maxBytes < bytesToSend) {
+        bytesToSend = maxBytes;
+    }
+
+    // Same pipeline and inline hashing as the network backends
+    Md5Digest digest;
+    bool wholeFile = (startOffset == 0 && bytesToSend == fileSize);
+    UploadPipeline pipeline;
+    bool success = pipeline.begin();
+    if (success) {
+        pipeline.setDigest(wholeFile ? &digest : nullptr);
+        LocalFileSink sink(remoteFile);
+        success = pipeline.run(localFile, bytesToSend, sink, bytesTransferred) &&
+                  bytesTransferred == bytesToSend;
+        pipeline.end();
+    } else {
+        LOG("[Local] ERROR: Failed to allocate upload buffers");
+    }
+
+    // A resumed file can be left longer than the source if it was rewritten
+    if (fflush(remoteFile) != 0) {
+        success = false;
+    }
+    if (success && remoteSize > (long)fileSize && startOffset + bytesTransferred == fileSize) {
+        if (ftruncate(fileno(remoteFile), fileSize) != 0) {
+            success = false;
+        }
+    }
+    fclose(remoteFile);
+
+    if (success) {
+        if (wholeFile && digest.getBytes() == fileSize) {
+            lastChecksum = digest.finishHex();
+        }
+        filesWritten++;
+        bytesWritten += bytesTransferred;
+        LOG_DEBUGF("[Local] Wrote %lu bytes to %s", bytesTransferred, target.c_str());
+    } else {
+        LOGF("[Local] ERROR: Upload of %s failed after %lu bytes", localPath.c_str(), bytesTransferred);
+    }
+    return success;
+}
+
+bool LocalDirUploader::uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                                    unsigned long& bytesTransferred) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+
+    if (!connected) {
+        LOG("[Local] Not connected");
+        return false;
+    }
+
+    String target = buildPath(remotePath);
+    if (!createParentDirectories(target)) {
+        return false;
+    }
+    FILE* remoteFile = fopen(target.c_str(), "wb");
+    if (remoteFile == nullptr) {
+        LOGF("[Local] ERROR: Cannot open %s: %s", target.c_str(), strerror(errno));
+        return false;
+    }
+
+    UploadPipeline pipeline;
+    bool success = pipeline.begin();
+    if (success) {
+        LocalFileSink sink(remoteFile);
+        success = pipeline.run(source, totalBytes, sink, bytesTransferred);
+        if (totalBytes != UploadPipeline::STREAM_TO_END && bytesTransferred != totalBytes) {
+            success = false;
+        }
+        pipeline.end();
+    } else {
+        LOG("[Local] ERROR: Failed to allocate upload buffers");
+    }
+    if (fclose(remoteFile) != 0) {
+        success = false;
+    }
+
+    if (success) {
+        filesWritten++;
+        bytesWritten += bytesTransferred;
+        LOG_DEBUGF("[Local] Streamed %lu bytes to %s", bytesTransferred, target.c_str());
+    } else {
+        LOGF("[Local] ERROR: Stream to %s failed after %lu bytes", target.c_str(), bytesTransferred);
+    }
+    return success;
+}
+
+UploadSink* LocalDirUploader::beginFile(const String& remotePath, size_t totalBytes) {
+    lastChecksum = "";
+
+    if (!connected) {
+        LOG("[Local] Not connected");
+        return nullptr;
+    }
+    if (pushFile != nullptr) {
+        LOG_ERROR("[Local] beginFile() while another pushed file is open");
+        return nullptr;
+    }
+
+    String target = buildPath(remotePath);
+    if (!createParentDirectories(target)) {
+        return nullptr;
+    }
+    pushFile = fopen(target.c_str(), "wb");
+    if (pushFile == nullptr) {
+        LOGF("[Local] ERROR: Cannot open %s: %s", target.c_str(), strerror(errno));
+        return nullptr;
+    }
+    pushTarget = target;
+    pushSize = totalBytes;
+    pushSink = new LocalFileSink(pushFile);
+    return pushSink;
+}
+
+bool LocalDirUploader::finishFile(bool complete) {
+    if (pushFile == nullptr) {
+        return false;
+    }
+
+    unsigned long written = pushSink->getWritten();
+    bool success = complete && written == pushSize;
+    if (fclose(pushFile) != 0) {
+        success = false;
+    }
+    delete pushSink;
+    pushSink = nullptr;
+    pushFile = nullptr;
+
+    if (success) {
+        filesWritten++;
+        bytesWritten += written;
+        LOG_DEBUGF("[Local] Wrote %lu bytes to %s", written, pushTarget.c_str());
+    } else if (complete) {
+        LOGF("[Local] ERROR: Write to %s failed after %lu bytes", pushTarget.c_str(), written);
+    }
+    return success;
+}
+
+bool LocalDirUploader::patchRange(const String& localPath, const String& remotePath, fs::FS &sd,
+                                  unsigned long offset, unsigned long length) {
+    if (!connected) {
+        return false;
+    }
+
+    FILE* remoteFile = fopen(buildPath(remotePath).c_str(), "r+b");
+    if (remoteFile == nullptr) {
+        return false;
+    }
+    if (fileLength(remoteFile) < (long)(offset + length) || fseek(remoteFile, offset, SEEK_SET) != 0) {
+        fclose(remoteFile);
+        return false;
+    }
+
+    fs::File localFile = sd.open(localPath, FILE_READ);
+    bool success = localFile && localFile.seek(offset);
+    uint8_t buffer[512];
+    while (success && length > 0) {
+        size_t n = length < sizeof(buffer) ? length : sizeof(buffer);
+        success = localFile.read(buffer, n) == n && fwrite(buffer, 1, n, remoteFile) == n;
+        length -= n;
+    }
+    if (localFile) {
+        localFile.close();
+    }
+    if (fclose(remoteFile) != 0) {
+        success = false;
+    }
+    return success;
+}
+
+bool LocalDirUploader::listDirectory(const String& path, std::map<String, unsigned long>& files,
+                                     std::set<String>* subdirs) {
+    files.clear();
+    if (subdirs) {
+        subdirs->clear();
+    }
+    if (!connected) {
+        return false;
+    }
+
+    String dirPath = buildPath(path);
+    DIR* dir = opendir(dirPath.c_str());
+    if (dir == nullptr) {
+        return errno == ENOENT;  // Missing directory lists as empty
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        String entryPath = dirPath + "/" + entry->d_name;
+        struct stat st;
+        if (stat(entryPath.c_str(), &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            if (subdirs) {
+                subdirs->insert(String(entry->d_name));
+            }
+        } else {
+            files[String(entry->d_name)] = (unsigned long)st.st_size;
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+void LocalDirUploader::logSessionStats() {
+    LOG_DEBUGF("[Local] %lu files, %lu bytes written so far", filesWritten, bytesWritten);
+}
+
+#endif // ENABLE_LOCAL_UPLOAD
@@ -0,0 +1,13 @@
+#include "Md5Digest.h"
+
+String Md5Digest::finishHex() {
+    uint8_t hash[16];
+    MD5Final(hash, &ctx);
+
+    char hex[33];
+    for (int i = 0; i < 16; i++) {
+        sprintf(hex + i * 2, "%02x", hash[i]);
+    }
+    hex[32] = '\0';
+    return String(hex);
+}
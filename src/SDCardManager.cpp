@@ -47,7 +47,7 @@ bool SDCardManager::takeControl() {
     delay(500);
 
     // Initialize SD_MMC
-    if (!SD_MMC.begin("/sdcard", SDIO_BIT_MODE_FAST)) {  // false = 4-bit mode
+    if (!SD_MMC.begin(SD_MOUNT_POINT, SDIO_BIT_MODE_FAST)) {  // false = 4-bit mode
         LOG("SD card mount failed");
         releaseControl();
         return false;
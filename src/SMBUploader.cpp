@@ -1,22 +1,352 @@
 #include "SMBUploader.h"
 #include "Logger.h"
+#include "UploadPipeline.h"
+#include "BufferPool.h"
+#include "Md5Digest.h"
+#include "Config.h"
 
 #ifdef ENABLE_SMB_UPLOAD
 
 #include <fcntl.h>  // For O_WRONLY, O_CREAT, O_TRUNC flags
+#include <poll.h>   // For waiting on the SMB socket in async mode
+#include <errno.h>
+#include <string>
 
 // Include libsmb2 headers
 // Note: These will be available when libsmb2 is added as ESP-IDF component
 extern "C" {
     #include "smb2/smb2.h"
     #include "smb2/libsmb2.h"
+    #include "smb2/libsmb2-raw.h"
 }
 
-// Buffer size for file streaming (32KB for good performance)
-#define UPLOAD_BUFFER_SIZE 32768
+/**
+ * UploadSink that writes pipeline chunks to an open SMB file handle
+ */
+class SMBWriteSink : public UploadSink {
+public:
+    SMBWriteSink(struct smb2_context* ctx, struct smb2fh* fh, size_t fileSize)
+        : smb2(ctx), remoteFile(fh), fileSize(fileSize), written(0) {}
+    
+    bool write(const uint8_t* data, size_t len) override {
+        ssize_t bytesWritten = smb2_write(smb2, remoteFile, data, len);
+        if (bytesWritten < 0) {
+            const char* error = smb2_get_error(smb2);
+            LOGF("[SMB] ERROR: Write failed at offset %lu: %s", written, error);
+            LOG("[SMB] Possible causes:");
+            LOG("[SMB]   - Network connection lost");
+            LOG("[SMB]   - Remote server disk full");
+            LOG("[SMB]   - SMB session timeout");
+            return false;
+        }
+        
+        if ((size_t)bytesWritten != len) {
+            LOGF("[SMB] ERROR: Incomplete write, expected %u bytes, wrote %d", len, bytesWritten);
+            LOG("[SMB] Network may be unstable");
+            return false;
+        }
+        
+        written += bytesWritten;
+        
+        // Print progress for large files (every 1MB)
+        if (written % (1024 * 1024) == 0) {
+            if (fileSize > 0) {
+                LOG_DEBUGF("[SMB] Progress: %lu KB / %u KB", written / 1024, fileSize / 1024);
+            } else {
+                LOG_DEBUGF("[SMB] Progress: %lu KB", written / 1024);
+            }
+        }
+        return true;
+    }
+    
+    unsigned long getWritten() const { return written; }
+    
+private:
+    struct smb2_context* smb2;
+    struct smb2fh* remoteFile;
+    size_t fileSize;
+    unsigned long written;
+};
+
+// Timeout for synchronous libsmb2 calls (seconds), so an echo or write to
+// a vanished NAS cannot block the main loop indefinitely
+#define SMB_COMMAND_TIMEOUT_SECONDS 30
+
+// Give up on an async write window if no reply arrives for this long (ms)
+#define SMB_ASYNC_REPLY_TIMEOUT_MS 30000
+
+/**
+ * UploadSink that keeps up to N smb2_pwrite_async requests in flight
+ *
+ * Each chunk is copied into a window slot and issued at the next file offset,
+ * so requests always go out in offset order. When every slot is busy the sink
+ * services the socket until a reply frees one. The first failed write stops
+ * new requests; replies for the writes already on the wire are still drained
+ * before finish() returns, so no callback can outlive the slot buffers.
+ *
+ * If the connection itself breaks (service error or reply timeout), libsmb2
+ * still owns the queued PDUs. The caller must destroy the context (which
+ * cancels them through the callbacks) before this sink is destroyed.
+ */
+class SMBAsyncWriteSink : public UploadSink {
+public:
+    SMBAsyncWriteSink(struct smb2_context* ctx, struct smb2fh* fh, size_t fileSize, int window,
+                      uint64_t startOffset = 0)
+        : smb2(ctx), remoteFile(fh), fileSize(fileSize), window(window),
+          nextOffset(startOffset), inFlight(0), maxInFlight(0), failed(false), broken(false),
+          failOffset(0), lastProgressMB(0) {
+        for (int i = 0; i < SMB_MAX_WRITE_WINDOW; i++) {
+            slots[i].buffer = nullptr;
+            slots[i].busy = false;
+            slots[i].owner = this;
+        }
+    }
+    
+    ~SMBAsyncWriteSink() {
+        for (int i = 0; i < SMB_MAX_WRITE_WINDOW; i++) {
+            if (slots[i].buffer != nullptr) {
+                BufferPool::getInstance().release(slots[i].buffer);
+            }
+        }
+    }
+    
+    /**
+     * Borrow one chunk buffer per window slot
+     * @return false if memory is short (caller should fall back to sync writes)
+     */
+    bool begin(size_t chunkSize) {
+        for (int i = 0; i < window; i++) {
+            slots[i].buffer = BufferPool::getInstance().acquire(chunkSize);
+            if (slots[i].buffer == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    bool write(const uint8_t* data, size_t len) override {
+        // Wait for a free slot
+        while (inFlight >= window && !failed) {
+            if (!serviceOnce()) {
+                return false;
+            }
+        }
+        if (failed) {
+            return false;
+        }
+        
+        Slot* slot = nullptr;
+        for (int i = 0; i < window; i++) {
+            if (!slots[i].busy) {
+                slot = &slots[i];
+                break;
+            }
+        }
+        
+        memcpy(slot->buffer, data, len);
+        slot->offset = nextOffset;
+        slot->length = len;
+        slot->busy = true;
+        
+        if (smb2_pwrite_async(smb2, remoteFile, slot->buffer, len, slot->offset,
+                              writeCallback, slot) < 0) {
+            LOGF("[SMB] ERROR: Failed to queue write at offset %lu: %s",
+                 (unsigned long)slot->offset, smb2_get_error(smb2));
+            slot->busy = false;
+            markFailed(slot->offset);
+            return false;
+        }
+        
+        nextOffset += len;
+        inFlight++;
+        if (inFlight > maxInFlight) {
+            maxInFlight = inFlight;
+        }
+        return true;
+    }
+    
+    /**
+     * Wait for every outstanding write to be acknowledged
+     * @return true if all writes succeeded
+     */
+    bool finish() {
+        while (inFlight > 0 && !broken) {
+            if (!serviceOnce()) {
+                return false;
+            }
+        }
+        return !failed;
+    }
+    
+    /**
+     * File offset up to which the server has acknowledged every byte
+     */
+    unsigned long ackedBytes() const {
+        uint64_t acked = failed ? failOffset : nextOffset;
+        for (int i = 0; i < window; i++) {
+            if (slots[i].busy && slots[i].offset < acked) {
+                acked = slots[i].offset;
+            }
+        }
+        return (unsigned long)acked;
+    }
+    
+    bool isConnectionBroken() const { return broken; }
+    int getMaxInFlight() const { return maxInFlight; }
+    
+private:
+    struct Slot {
+        uint8_t* buffer;
+        uint64_t offset;
+        uint32_t length;
+        bool busy;
+        SMBAsyncWriteSink* owner;
+    };
+    
+    struct smb2_context* smb2;
+    struct smb2fh* remoteFile;
+    size_t fileSize;
+    int window;
+    Slot slots[SMB_MAX_WRITE_WINDOW];
+    uint64_t nextOffset;
+    int inFlight;
+    int maxInFlight;
+    bool failed;
+    bool broken;
+    uint64_t failOffset;
+    unsigned long lastProgressMB;
+    
+    void markFailed(uint64_t offset) {
+        if (!failed || offset < failOffset) {
+            failOffset = offset;
+        }
+        failed = true;
+    }
+    
+    static void writeCallback(struct smb2_context* ctx, int status, void* commandData, void* privateData) {
+        Slot* slot = static_cast<Slot*>(privateData);
+        slot->owner->onWriteComplete(slot, status);
+    }
+    
+    void onWriteComplete(Slot* slot, int status) {
+        if (status < 0) {
+            // Only report the first failure; later ones are usually the same cause
+            if (!failed) {
+                LOGF("[SMB] ERROR: Write failed at offset %lu: %s",
+                     (unsigned long)slot->offset, smb2_get_error(smb2));
+                LOG("[SMB] Possible causes:");
+                LOG("[SMB]   - Network connection lost");
+                LOG("[SMB]   - Remote server disk full");
+                LOG("[SMB]   - SMB session timeout");
+            }
+            markFailed(slot->offset);
+        } else if ((uint32_t)status != slot->length) {
+            if (!failed) {
+                LOGF("[SMB] ERROR: Incomplete write at offset %lu, expected %u bytes, wrote %d",
+                     (unsigned long)slot->offset, slot->length, status);
+                LOG("[SMB] Network may be unstable");
+            }
+            markFailed(slot->offset + status);
+        }
+        
+        slot->busy = false;
+        inFlight--;
+        
+        // Print progress for large files (every 1MB acknowledged)
+        unsigned long ackedMB = ackedBytes() / (1024 * 1024);
+        if (ackedMB > lastProgressMB) {
+            lastProgressMB = ackedMB;
+            if (fileSize > 0) {
+                LOG_DEBUGF("[SMB] Progress: %lu KB / %u KB", ackedBytes() / 1024, fileSize / 1024);
+            } else {
+                LOG_DEBUGF("[SMB] Progress: %lu KB", ackedBytes() / 1024);
+            }
+        }
+    }
+    
+    /**
+     * Wait for socket activity and let libsmb2 process replies
+     * @return false if the connection is unusable
+     */
+    bool serviceOnce() {
+        struct pollfd pfd;
+        pfd.fd = smb2_get_fd(smb2);
+        pfd.events = smb2_which_events(smb2);
+        pfd.revents = 0;
+        
+        int rc = poll(&pfd, 1, SMB_ASYNC_REPLY_TIMEOUT_MS);
+        if (rc == 0) {
+            LOGF("[SMB] ERROR: No reply from server for %d ms with %d writes outstanding",
+                 SMB_ASYNC_REPLY_TIMEOUT_MS, inFlight);
+            LOG("[SMB] Network connection may be lost");
+            broken = true;
+            markFailed(ackedBytes());
+            return false;
+        }
+        if (rc < 0) {
+            LOGF("[SMB] ERROR: poll() failed on SMB socket (errno %d)", errno);
+            broken = true;
+            markFailed(ackedBytes());
+            return false;
+        }
+        
+        if (smb2_service(smb2, pfd.revents) < 0) {
+            LOGF("[SMB] ERROR: Connection error while writing: %s", smb2_get_error(smb2));
+            broken = true;
+            markFailed(ackedBytes());
+            return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * Replies of one CREATE+WRITE+CLOSE compound request
+ * Every command gets its own callback, even when an earlier one failed
+ * (the server then answers the rest with the same error).
+ */
+struct CompoundReply {
+    int pending;          // Commands not answered yet
+    uint32_t status;      // First failing NT status (SMB2_STATUS_SUCCESS = all fine)
+    uint32_t written;     // Bytes the WRITE reported
+    
+    static void onReply(struct smb2_context* ctx, int status, void* commandData, void* privateData) {
+        CompoundReply* reply = static_cast<CompoundReply*>(privateData);
+        if ((uint32_t)status != SMB2_STATUS_SUCCESS && reply->status == SMB2_STATUS_SUCCESS) {
+            reply->status = (uint32_t)status;
+        }
+        reply->pending--;
+    }
+    
+    static void onWrite(struct smb2_context* ctx, int status, void* commandData, void* privateData) {
+        if ((uint32_t)status == SMB2_STATUS_SUCCESS && commandData != nullptr) {
+            static_cast<CompoundReply*>(privateData)->written =
+                static_cast<struct smb2_write_reply*>(commandData)->count;
+        }
+        onReply(ctx, status, commandData, privateData);
+    }
+};
+
+// File id the related commands of a compound request use for the handle
+// the CREATE before them opened
+static const uint8_t COMPOUND_FILE_ID[SMB2_FD_SIZE] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+// True if a libsmb2 error string means part of the remote path does not exist
+static bool isPathNotFoundError(const char* error) {
+    return error != nullptr &&
+           (strstr(error, "STATUS_OBJECT_PATH_NOT_FOUND") != NULL ||
+            strstr(error, "STATUS_OBJECT_NAME_NOT_FOUND") != NULL);
+}
 
 SMBUploader::SMBUploader(const String& endpoint, const String& user, const String& password)
-    : smbUser(user), smbPassword(password), smb2(nullptr), connected(false) {
+    : smbUser(user), smbPassword(password), smb2(nullptr), connected(false), writeWindow(1),
+      keepaliveIntervalMs(60000), idleTimeoutMs(900000),
+      lastTrafficTime(0), lastActivityTime(0), reconnectCount(0),
+      dirCacheHits(0), dirCacheMisses(0), compoundEnabled(true), compoundUploads(0),
+      pushFile(nullptr), pushSink(nullptr), pushAsyncSink(nullptr), pushSize(0) {
     parseEndpoint(endpoint);
 }
 
@@ -24,6 +354,19 @@ SMBUploader::~SMBUploader() {
     end();
 }
 
+UploadBackend* SMBUploader::create(const Config& config, const EndpointConfig& endpoint) {
+    SMBUploader* uploader = new SMBUploader(endpoint.url, endpoint.user, endpoint.password);
+    uploader->setWriteWindow(config.getSmbWriteWindow());
+    uploader->setKeepalive(config.getSmbKeepaliveSeconds(),
+                           config.getSmbIdleTimeoutSeconds());
+    return uploader;
+}
+
+void SMBUploader::logSessionStats() {
+    LOG_DEBUGF("[SMB] Directory cache: %lu hits, %lu misses", dirCacheHits, dirCacheMisses);
+    LOG_DEBUGF("[SMB] Small files sent as compound requests: %lu", compoundUploads);
+}
+
 bool SMBUploader::parseEndpoint(const String& endpoint) {
     // Expected format: //server/share or //server/share/path
     // We only need server and share for connection
@@ -100,6 +443,8 @@ bool SMBUploader::connect() {
         return false;
     }
     
+    smb2_set_timeout(smb2, SMB_COMMAND_TIMEOUT_SECONDS);
+    
     // Set security mode (allow guest if no credentials)
     if (smbUser.isEmpty()) {
         LOG("[SMB] WARNING: No credentials provided, attempting guest access");
@@ -127,8 +472,22 @@ bool SMBUploader::connect() {
     }
     
     connected = true;
+    knownDirectories.clear();
+    compoundEnabled = true;
+    markActivity();
     LOG("[SMB] Connected successfully");
     
+    // Chunk ceiling: server's negotiated max write and the buffer size we can
+    // get - a pool slot, or what the heap can spare for the pipeline ring
+    // plus the async write slots when the pool could not be reserved
+    BufferPool& pool = BufferPool::getInstance();
+    if (pool.isActive()) {
+        chunkTuner.begin(smb2_get_max_write_size(smb2), pool.getSlotSize());
+    } else {
+        chunkTuner.begin(smb2_get_max_write_size(smb2), ESP.getMaxAllocHeap(),
+                         UPLOAD_PIPELINE_BUFFER_COUNT + (writeWindow > 1 ? writeWindow : 0));
+    }
+    
     // Test if we can access the base path (if configured)
     if (!smbBasePath.isEmpty()) {
         String testPath = "/" + smbBasePath;
@@ -151,6 +510,11 @@ bool SMBUploader::connect() {
 }
 
 void SMBUploader::disconnect() {
+    if (!knownDirectories.empty()) {
+        LOG_DEBUGF("[SMB] Directory cache: %lu hits, %lu misses", dirCacheHits, dirCacheMisses);
+        knownDirectories.clear();
+    }
+    
     if (smb2 != nullptr) {
         if (connected) {
             smb2_disconnect_share(smb2);
@@ -165,7 +529,75 @@ bool SMBUploader::begin() {
     return connect();
 }
 
+void SMBUploader::markActivity() {
+    lastActivityTime = millis();
+    lastTrafficTime = lastActivityTime;
+}
+
+bool SMBUploader::sendKeepalive() {
+    if (smb2_echo(smb2) < 0) {
+        LOGF("[SMB] WARNING: Keepalive echo failed: %s", smb2_get_error(smb2));
+        return false;
+    }
+    lastTrafficTime = millis();
+    LOG_DEBUG("[SMB] Keepalive echo OK");
+    return true;
+}
+
+bool SMBUploader::ensureConnected() {
+    if (connected) {
+        // A session that has been silent for a while may have been dropped by
+        // the server or a NAT; probe it before trusting it with an upload
+        if (keepaliveIntervalMs > 0 && millis() - lastTrafficTime >= keepaliveIntervalMs) {
+            if (!sendKeepalive()) {
+                LOG("[SMB] Session lost, reconnecting...");
+                disconnect();
+                if (!connect()) {
+                    return false;
+                }
+                reconnectCount++;
+                LOGF("[SMB] Session re-established (reconnects: %lu)", reconnectCount);
+                return true;
+            }
+        }
+        LOG_DEBUG("[SMB] Reusing existing session");
+        return true;
+    }
+    
+    return connect();
+}
+
+void SMBUploader::maintain() {
+    if (!connected) {
+        return;
+    }
+    
+    unsigned long now = millis();
+    
+    if (idleTimeoutMs > 0 && now - lastActivityTime >= idleTimeoutMs) {
+        LOGF("[SMB] Closing idle session after %lu seconds without uploads",
+             (now - lastActivityTime) / 1000);
+        disconnect();
+        return;
+    }
+    
+    if (keepaliveIntervalMs > 0 && now - lastTrafficTime >= keepaliveIntervalMs) {
+        if (!sendKeepalive()) {
+            LOG("[SMB] Dropping dead session, will reconnect on next upload");
+            disconnect();
+        }
+    }
+}
+
+void SMBUploader::setKeepalive(unsigned long keepaliveSeconds, unsigned long idleTimeoutSeconds) {
+    keepaliveIntervalMs = keepaliveSeconds * 1000;
+    idleTimeoutMs = idleTimeoutSeconds * 1000;
+}
+
 void SMBUploader::end() {
+    if (pushFile != nullptr) {
+        finishFile(false);
+    }
     disconnect();
 }
 
@@ -173,6 +605,19 @@ bool SMBUploader::isConnected() const {
     return connected;
 }
 
+void SMBUploader::setWriteWindow(int window) {
+    if (window < 1) {
+        window = 1;
+    }
+    if (window > SMB_MAX_WRITE_WINDOW) {
+        window = SMB_MAX_WRITE_WINDOW;
+    }
+    writeWindow = window;
+    if (writeWindow > 1) {
+        LOGF("[SMB] Async write window: %d outstanding writes", writeWindow);
+    }
+}
+
 bool SMBUploader::createDirectory(const String& path) {
     if (!connected) {
         LOG("[SMB] ERROR: Not connected - cannot create directory");
@@ -183,6 +628,8 @@ bool SMBUploader::createDirectory(const String& path) {
         return true;  // Root always exists
     }
     
+    markActivity();
+    
     // Remove leading slash for libsmb2 compatibility (paths are relative to share)
     String cleanPath = path;
     if (cleanPath.startsWith("/")) {
@@ -193,6 +640,13 @@ bool SMBUploader::createDirectory(const String& path) {
         return true;  // Root always exists
     }
     
+    // Already verified on this connection - no round trip needed
+    if (knownDirectories.count(cleanPath) > 0) {
+        dirCacheHits++;
+        return true;
+    }
+    dirCacheMisses++;
+    
     // Check if directory already exists
     struct smb2_stat_64 st;
     int stat_result = smb2_stat(smb2, cleanPath.c_str(), &st);
@@ -200,6 +654,7 @@ bool SMBUploader::createDirectory(const String& path) {
         // Path exists, check if it's a directory
         if (st.smb2_type == SMB2_TYPE_DIRECTORY) {
             LOG_DEBUGF("[SMB] Directory already exists: %s", cleanPath.c_str());
+            knownDirectories.insert(cleanPath);
             return true;  // Directory already exists
         } else {
             LOGF("[SMB] ERROR: Path exists but is not a directory: %s", cleanPath.c_str());
@@ -233,6 +688,7 @@ bool SMBUploader::createDirectory(const String& path) {
         // STATUS_INVALID_PARAMETER can mean the directory already exists in some SMB implementations
         if (smb2_stat(smb2, cleanPath.c_str(), &st) == 0 && st.smb2_type == SMB2_TYPE_DIRECTORY) {
             LOG_DEBUGF("[SMB] Directory already exists (mkdir failed but stat succeeded): %s", cleanPath.c_str());
+            knownDirectories.insert(cleanPath);
             return true;  // Directory exists, treat as success
         }
         
@@ -253,18 +709,60 @@ bool SMBUploader::createDirectory(const String& path) {
     }
     
     LOGF("[SMB] Directory created successfully: %s", cleanPath.c_str());
+    knownDirectories.insert(cleanPath);
     return true;
 }
 
-bool SMBUploader::upload(const String& localPath, const String& remotePath, 
-                         fs::FS &sd, unsigned long& bytesTransferred) {
-    bytesTransferred = 0;
+bool SMBUploader::listDirectory(const String& path, std::map<String, unsigned long>& files,
+                                std::set<String>* subdirs) {
+    files.clear();
+    if (subdirs) {
+        subdirs->clear();
+    }
     
     if (!connected) {
-        LOG("SMB: Not connected");
+        LOG("[SMB] ERROR: Not connected - cannot list directory");
+        return false;
+    }
+    
+    markActivity();
+    
+    String fullRemotePath = buildRemotePath(path);
+    struct smb2dir* dir = smb2_opendir(smb2, fullRemotePath.c_str());
+    if (dir == nullptr) {
+        const char* error = smb2_get_error(smb2);
+        if (isPathNotFoundError(error)) {
+            LOG_DEBUGF("[SMB] Remote directory does not exist: %s", fullRemotePath.c_str());
+            return true;
+        }
+        LOGF("[SMB] ERROR: Failed to list %s: %s", fullRemotePath.c_str(), error);
         return false;
     }
     
+    struct smb2dirent* entry;
+    while ((entry = smb2_readdir(smb2, dir)) != nullptr) {
+        if (strcmp(entry->name, ".") == 0 || strcmp(entry->name, "..") == 0) {
+            continue;
+        }
+        if (entry->st.smb2_type == SMB2_TYPE_DIRECTORY) {
+            if (subdirs) {
+                subdirs->insert(String(entry->name));
+            }
+        } else {
+            files[String(entry->name)] = (unsigned long)entry->st.smb2_size;
+        }
+    }
+    smb2_closedir(smb2, dir);
+    
+    // The listing proves the directory exists on this connection
+    knownDirectories.insert(fullRemotePath);
+    
+    LOG_DEBUGF("[SMB] Listed %s: %u files, %u directories", fullRemotePath.c_str(),
+               files.size(), subdirs ? subdirs->size() : 0);
+    return true;
+}
+
+String SMBUploader::buildRemotePath(const String& remotePath) const {
     // Prepend base path if configured
     // Note: libsmb2 expects paths relative to share root WITHOUT leading slash
     String fullRemotePath = remotePath;
@@ -279,27 +777,84 @@ bool SMBUploader::upload(const String& localPath, const String& remotePath,
         // Remove leading slash for libsmb2 compatibility
         fullRemotePath = fullRemotePath.substring(1);
     }
+    return fullRemotePath;
+}
+
+bool SMBUploader::patchRange(const String& localPath, const String& remotePath, fs::FS &sd,
+                             unsigned long offset, unsigned long length) {
+    if (!connected) {
+        LOG("SMB: Not connected");
+        return false;
+    }
     
-    // Open local file from SD card
-    File localFile = sd.open(localPath, FILE_READ);
-    if (!localFile) {
-        LOGF("[SMB] ERROR: Failed to open local file: %s", localPath.c_str());
-        LOG("[SMB] File may not exist or SD card has read errors");
+    markActivity();
+    
+    String fullRemotePath = buildRemotePath(remotePath);
+    
+    // Patching only makes sense on an existing remote copy - never create one
+    struct smb2fh* remoteFile = smb2_open(smb2, fullRemotePath.c_str(), O_WRONLY);
+    if (remoteFile == nullptr) {
+        LOG_DEBUGF("[SMB] Cannot patch %s: %s", fullRemotePath.c_str(), smb2_get_error(smb2));
         return false;
     }
     
-    size_t fileSize = localFile.size();
+    struct smb2_stat_64 st;
+    if (smb2_fstat(smb2, remoteFile, &st) != 0 || st.smb2_size < offset + length) {
+        LOGF("[SMB] WARNING: Remote file too short to patch %lu bytes at %lu: %s",
+             length, offset, fullRemotePath.c_str());
+        smb2_close(smb2, remoteFile);
+        return false;
+    }
     
-    // Sanity check file size
-    if (fileSize == 0) {
-        LOGF("[SMB] WARNING: File is empty: %s", localPath.c_str());
+    File localFile = sd.open(localPath, FILE_READ);
+    if (!localFile || !localFile.seek(offset)) {
+        LOGF("[SMB] ERROR: Failed to read local range of %s", localPath.c_str());
+        if (localFile) {
+            localFile.close();
+        }
+        smb2_close(smb2, remoteFile);
+        return false;
+    }
+    
+    size_t chunkSize = chunkTuner.getChunkSize();
+    size_t bufferSize = length < chunkSize ? length : chunkSize;
+    uint8_t* buffer = BufferPool::getInstance().acquire(bufferSize);
+    if (buffer == nullptr) {
+        LOG("[SMB] ERROR: Failed to allocate patch buffer");
         localFile.close();
+        smb2_close(smb2, remoteFile);
         return false;
     }
     
-    LOG_DEBUGF("[SMB] Uploading %s (%u bytes)", localPath.c_str(), fileSize);
-    LOG_DEBUGF("[SMB] Remote path: %s", fullRemotePath.c_str());
+    bool success = true;
+    unsigned long done = 0;
+    while (done < length) {
+        size_t toRead = (length - done) < bufferSize ? (length - done) : bufferSize;
+        size_t bytesRead = localFile.read(buffer, toRead);
+        if (bytesRead == 0) {
+            LOGF("[SMB] ERROR: Read error while patching %s", localPath.c_str());
+            success = false;
+            break;
+        }
+        if (smb2_pwrite(smb2, remoteFile, buffer, bytesRead, offset + done) != (int)bytesRead) {
+            LOGF("[SMB] ERROR: Patch write failed at offset %lu: %s", offset + done, smb2_get_error(smb2));
+            success = false;
+            break;
+        }
+        done += bytesRead;
+    }
     
+    BufferPool::getInstance().release(buffer);
+    localFile.close();
+    smb2_close(smb2, remoteFile);
+    
+    if (success) {
+        LOG_DEBUGF("[SMB] Patched %lu bytes at offset %lu of %s", length, offset, fullRemotePath.c_str());
+    }
+    return success;
+}
+
+struct smb2fh* SMBUploader::openRemoteFile(const String& fullRemotePath, int flags) {
     // Ensure parent directory exists
     int lastSlash = fullRemotePath.lastIndexOf('/');
     if (lastSlash > 0) {
@@ -307,14 +862,19 @@ bool SMBUploader::upload(const String& localPath, const String& remotePath,
         if (!createDirectory(parentDir)) {
             LOGF("[SMB] ERROR: Failed to create parent directory: %s", parentDir.c_str());
             LOG("[SMB] Check permissions on remote share");
-            localFile.close();
-            return false;
+            return nullptr;
         }
     }
     
-    // Open remote file for writing
-    // Convert Arduino String to C string for libsmb2
-    struct smb2fh* remoteFile = smb2_open(smb2, fullRemotePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC);
+    struct smb2fh* remoteFile = smb2_open(smb2, fullRemotePath.c_str(), flags);
+    if (remoteFile == nullptr && lastSlash > 0 && isPathNotFoundError(smb2_get_error(smb2))) {
+        // The parent was removed behind our back - the directory cache is stale
+        LOG_WARN("[SMB] Remote directory vanished, clearing directory cache");
+        knownDirectories.clear();
+        if (createDirectory(fullRemotePath.substring(0, lastSlash))) {
+            remoteFile = smb2_open(smb2, fullRemotePath.c_str(), flags);
+        }
+    }
     if (remoteFile == nullptr) {
         const char* error = smb2_get_error(smb2);
         LOGF("[SMB] ERROR: Failed to open remote file: %s", error);
@@ -323,106 +883,516 @@ bool SMBUploader::upload(const String& localPath, const String& remotePath,
         LOG("[SMB]   - Insufficient permissions on remote share");
         LOG("[SMB]   - Disk full on remote server");
         LOG("[SMB]   - Invalid characters in filename");
-        localFile.close();
+    }
+    return remoteFile;
+}
+
+size_t SMBUploader::compoundLimit() const {
+    if (!compoundEnabled || SMB_COMPOUND_MAX_SIZE == 0) {
+        return 0;
+    }
+    size_t limit = SMB_COMPOUND_MAX_SIZE;
+    size_t maxWrite = smb2_get_max_write_size(smb2);
+    if (maxWrite < limit) {
+        limit = maxWrite;
+    }
+    // The whole file is read into one buffer; never fall back to malloc for it
+    BufferPool& pool = BufferPool::getInstance();
+    if (pool.isActive() && pool.getSlotSize() < limit) {
+        limit = pool.getSlotSize();
+    }
+    return limit;
+}
+
+bool SMBUploader::writeCompound(const String& fullRemotePath, const uint8_t* data, size_t len,
+                                uint32_t& ntStatus) {
+    ntStatus = SMB2_STATUS_SUCCESS;
+    
+    // Same access and disposition as smb2_open(O_WRONLY | O_CREAT | O_TRUNC)
+    std::string name(fullRemotePath.c_str());
+    for (char& c : name) {
+        if (c == '/') {
+            c = '\\';
+        }
+    }
+    struct smb2_create_request createReq;
+    memset(&createReq, 0, sizeof(createReq));
+    createReq.requested_oplock_level = SMB2_OPLOCK_LEVEL_NONE;
+    createReq.impersonation_level = SMB2_IMPERSONATION_IMPERSONATION;
+    createReq.desired_access = SMB2_FILE_WRITE_DATA | SMB2_FILE_WRITE_EA | SMB2_FILE_WRITE_ATTRIBUTES;
+    createReq.share_access = SMB2_FILE_SHARE_READ | SMB2_FILE_SHARE_WRITE;
+    createReq.create_disposition = SMB2_FILE_OVERWRITE_IF;
+    createReq.create_options = SMB2_FILE_NON_DIRECTORY_FILE;
+    createReq.name = name.c_str();
+    
+    struct smb2_write_request writeReq;
+    memset(&writeReq, 0, sizeof(writeReq));
+    memcpy(writeReq.file_id, COMPOUND_FILE_ID, SMB2_FD_SIZE);
+    writeReq.length = len;
+    writeReq.offset = 0;
+    writeReq.buf = data;
+    
+    struct smb2_close_request closeReq;
+    memset(&closeReq, 0, sizeof(closeReq));
+    memcpy(closeReq.file_id, COMPOUND_FILE_ID, SMB2_FD_SIZE);
+    
+    CompoundReply reply = {3, SMB2_STATUS_SUCCESS, 0};
+    struct smb2_pdu* createPdu = smb2_cmd_create_async(smb2, &createReq, CompoundReply::onReply, &reply);
+    struct smb2_pdu* writePdu = createPdu ? smb2_cmd_write_async(smb2, &writeReq, CompoundReply::onWrite, &reply)
+                                          : nullptr;
+    struct smb2_pdu* closePdu = writePdu ? smb2_cmd_close_async(smb2, &closeReq, CompoundReply::onReply, &reply)
+                                         : nullptr;
+    if (closePdu == nullptr) {
+        LOGF("[SMB] WARNING: Cannot build compound request: %s", smb2_get_error(smb2));
+        if (writePdu) {
+            smb2_free_pdu(smb2, writePdu);
+        }
+        if (createPdu) {
+            smb2_free_pdu(smb2, createPdu);
+        }
+        ntStatus = SMB2_STATUS_NOT_SUPPORTED;
         return false;
     }
+    smb2_add_compound_pdu(smb2, createPdu, writePdu);
+    smb2_add_compound_pdu(smb2, writePdu, closePdu);
+    smb2_queue_pdu(smb2, createPdu);
     
-    // Allocate buffer for streaming
-    uint8_t* buffer = (uint8_t*)malloc(UPLOAD_BUFFER_SIZE);
+    // Same wait as SMBAsyncWriteSink: the socket is serviced until every
+    // command is answered
+    while (reply.pending > 0) {
+        struct pollfd pfd;
+        pfd.fd = smb2_get_fd(smb2);
+        pfd.events = smb2_which_events(smb2);
+        pfd.revents = 0;
+        
+        int rc = poll(&pfd, 1, SMB_ASYNC_REPLY_TIMEOUT_MS);
+        if (rc <= 0 || smb2_service(smb2, pfd.revents) < 0) {
+            if (rc == 0) {
+                LOGF("[SMB] ERROR: No reply from server for %d ms", SMB_ASYNC_REPLY_TIMEOUT_MS);
+            } else {
+                LOGF("[SMB] ERROR: Connection error while writing: %s", smb2_get_error(smb2));
+            }
+            // Destroying the context cancels the queued commands through the
+            // callbacks while reply is still in scope
+            LOG("[SMB] Dropping connection, will reconnect on next upload");
+            disconnect();
+            ntStatus = reply.status != SMB2_STATUS_SUCCESS ? reply.status : SMB2_STATUS_CANCELLED;
+            return false;
+        }
+    }
+    
+    ntStatus = reply.status;
+    if (ntStatus == SMB2_STATUS_SUCCESS && reply.written != len) {
+        LOGF("[SMB] ERROR: Incomplete write, expected %u bytes, wrote %u", len, reply.written);
+        return false;
+    }
+    return ntStatus == SMB2_STATUS_SUCCESS;
+}
+
+SMBUploader::SmallFileResult SMBUploader::uploadSmallFile(fs::File& localFile, const String& fullRemotePath,
+                                                          size_t fileSize, Md5Digest& digest) {
+    uint8_t* buffer = BufferPool::getInstance().acquire(fileSize);
     if (buffer == nullptr) {
-        LOG("[SMB] ERROR: Failed to allocate upload buffer");
+        return SMALL_FILE_FALLBACK;
+    }
+    size_t bytesRead = 0;
+    while (bytesRead < fileSize) {
+        size_t n = localFile.read(buffer + bytesRead, fileSize - bytesRead);
+        if (n == 0) {
+            break;
+        }
+        bytesRead += n;
+    }
+    if (bytesRead != fileSize) {
+        LOGF("[SMB] ERROR: Read error on SD card after %u of %u bytes", bytesRead, fileSize);
+        BufferPool::getInstance().release(buffer);
+        return SMALL_FILE_FAILED;
+    }
+    digest.update(buffer, fileSize);
+    
+    SmallFileResult result = SMALL_FILE_FALLBACK;
+    int lastSlash = fullRemotePath.lastIndexOf('/');
+    String parentDir = lastSlash > 0 ? fullRemotePath.substring(0, lastSlash) : String("");
+    if (createDirectory(parentDir)) {
+        uint32_t status;
+        bool sent = writeCompound(fullRemotePath, buffer, fileSize, status);
+        if (!sent && connected && lastSlash > 0 &&
+            (status == SMB2_STATUS_OBJECT_PATH_NOT_FOUND || status == SMB2_STATUS_OBJECT_NAME_NOT_FOUND)) {
+            // The parent was removed behind our back - the directory cache is stale
+            LOG_WARN("[SMB] Remote directory vanished, clearing directory cache");
+            knownDirectories.clear();
+            sent = createDirectory(parentDir) && writeCompound(fullRemotePath, buffer, fileSize, status);
+        }
+        if (sent) {
+            compoundUploads++;
+            result = SMALL_FILE_SENT;
+        } else if (!connected) {
+            result = SMALL_FILE_FAILED;
+        } else {
+            // Some servers reject related compounds; the regular path still works
+            LOGF("[SMB] WARNING: Compound upload refused (%s), using separate requests this session",
+                 nterror_to_str(status));
+            compoundEnabled = false;
+        }
+    }
+    BufferPool::getInstance().release(buffer);
+    return result;
+}
+
+bool SMBUploader::writeStream(UploadSource& source, struct smb2fh* remoteFile, uint64_t fileSize,
+                              unsigned long startOffset, size_t bytesToSend, Md5Digest* digest,
+                              unsigned long& bytesTransferred, unsigned long& elapsedMs,
+                              bool& connectionBroken) {
+    bytesTransferred = 0;
+    elapsedMs = 0;
+    connectionBroken = false;
+    
+    // Allocate the read/write ring (SD reads overlap network writes)
+    size_t chunkSize = chunkTuner.getChunkSize();
+    UploadPipeline pipeline(chunkSize, UPLOAD_PIPELINE_BUFFER_COUNT);
+    if (!pipeline.begin()) {
+        LOG("[SMB] ERROR: Failed to allocate upload buffers");
         LOG("[SMB] System may be low on memory");
-        smb2_close(smb2, remoteFile);
-        localFile.close();
         return false;
     }
+    pipeline.setDigest(digest);
     
     // Track upload timing
     unsigned long startTime = millis();
     
-    // Stream file data
-    bool success = true;
-    unsigned long totalBytesRead = 0;
+    // Stream data
+    bool success;
+    SMBAsyncWriteSink* asyncSink = nullptr;
+    if (writeWindow > 1) {
+        asyncSink = new SMBAsyncWriteSink(smb2, remoteFile, fileSize, writeWindow, startOffset);
+        if (!asyncSink->begin(pipeline.getBufferSize())) {
+            LOGF("[SMB] WARNING: Not enough memory for %d write slots, using synchronous writes",
+                 writeWindow);
+            delete asyncSink;
+            asyncSink = nullptr;
+        }
+    }
     
-    while (localFile.available()) {
-        size_t bytesRead = localFile.read(buffer, UPLOAD_BUFFER_SIZE);
-        if (bytesRead == 0) {
-            // Check if we've read all expected bytes
-            if (totalBytesRead < fileSize) {
-                LOGF("[SMB] ERROR: Unexpected end of file, read %lu of %u bytes", totalBytesRead, fileSize);
-                LOG("[SMB] SD card may have read errors");
-                success = false;
+    if (asyncSink != nullptr) {
+        unsigned long bytesQueued = 0;
+        bool queued = pipeline.run(source, bytesToSend, *asyncSink, bytesQueued);
+        // Always drain replies, even after a failure, so no callback outlives the sink
+        bool acked = asyncSink->finish();
+        success = queued && acked;
+        bytesTransferred = asyncSink->ackedBytes() - startOffset;
+        connectionBroken = asyncSink->isConnectionBroken();
+        LOG_DEBUGF("[SMB] Peak writes in flight: %d/%d", asyncSink->getMaxInFlight(), writeWindow);
+    } else {
+        SMBWriteSink sink(smb2, remoteFile, fileSize);
+        success = pipeline.run(source, bytesToSend, sink, bytesTransferred);
+    }
+    
+    // Verify we transferred all bytes (a stream to end has no expected length)
+    bool toEnd = (bytesToSend == UploadPipeline::STREAM_TO_END);
+    if (success && !toEnd && bytesTransferred != bytesToSend) {
+        LOGF("[SMB] ERROR: Size mismatch, transferred %lu bytes, expected %u", bytesTransferred, bytesToSend);
+        LOG("[SMB] Upload incomplete - file may be corrupted on remote server");
+        success = false;
+    }
+    
+    // Cleanup
+    pipeline.end();
+    
+    if (connectionBroken) {
+        // libsmb2 still holds the unanswered writes; tearing down the context
+        // cancels them (and frees the handle) before the slot buffers go away.
+        LOG("[SMB] Dropping connection, will reconnect on next upload");
+        disconnect();
+    }
+    
+    if (asyncSink != nullptr) {
+        delete asyncSink;
+    }
+    
+    if (connected) {
+        markActivity();
+    }
+    
+    elapsedMs = millis() - startTime;
+    
+    // Feed throughput back so the next upload can use a better chunk size.
+    // Generated streams (compression) can be CPU bound and would skew it.
+    if (success && !toEnd) {
+        chunkTuner.recordTransfer(chunkSize, bytesTransferred, elapsedMs);
+    }
+    
+    return success;
+}
+
+bool SMBUploader::uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                             const String& remotePath, unsigned long& bytesTransferred,
+                             unsigned long startOffset, unsigned long maxBytes) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+    
+    if (!connected) {
+        LOG("SMB: Not connected");
+        return false;
+    }
+    
+    markActivity();
+    
+    String fullRemotePath = buildRemotePath(remotePath);
+    
+    // Sanity check file size
+    if (fileSize == 0) {
+        LOGF("[SMB] WARNING: File is empty: %s", localPath.c_str());
+        return false;
+    }
+    
+    if (startOffset >= fileSize) {
+        LOGF("[SMB] WARNING: Resume offset %lu beyond file size %u, starting over", startOffset, fileSize);
+        startOffset = 0;
+    }
+    
+    LOG_DEBUGF("[SMB] Uploading %s (%u bytes)", localPath.c_str(), fileSize);
+    LOG_DEBUGF("[SMB] Remote path: %s", fullRemotePath.c_str());
+    
+    // Small whole files: create, write and close in one round trip
+    bool wholeRequest = (startOffset == 0 && (maxBytes == 0 || maxBytes >= fileSize));
+    if (wholeRequest && fileSize <= compoundLimit()) {
+        Md5Digest digest;
+        unsigned long startTime = millis();
+        SmallFileResult result = uploadSmallFile(localFile, fullRemotePath, fileSize, digest);
+        if (result != SMALL_FILE_FALLBACK) {
+            if (connected) {
+                markActivity();
             }
-            break;
+            if (result == SMALL_FILE_FAILED) {
+                LOGF("[SMB] Upload failed - Expected %u bytes, transferred 0 bytes", fileSize);
+                return false;
+            }
+            bytesTransferred = fileSize;
+            lastChecksum = digest.finishHex();
+            LOGF("[SMB] Upload complete: %lu bytes in %lu ms (compound request)",
+                 bytesTransferred, millis() - startTime);
+            return true;
         }
-        
-        totalBytesRead += bytesRead;
-        
-        ssize_t bytesWritten = smb2_write(smb2, remoteFile, buffer, bytesRead);
-        if (bytesWritten < 0) {
-            const char* error = smb2_get_error(smb2);
-            LOGF("[SMB] ERROR: Write failed at offset %lu: %s", bytesTransferred, error);
-            LOG("[SMB] Possible causes:");
-            LOG("[SMB]   - Network connection lost");
-            LOG("[SMB]   - Remote server disk full");
-            LOG("[SMB]   - SMB session timeout");
-            success = false;
-            break;
+        if (!localFile.seek(0)) {
+            LOGF("[SMB] ERROR: Failed to rewind local file: %s", localPath.c_str());
+            return false;
         }
-        
-        if ((size_t)bytesWritten != bytesRead) {
-            LOGF("[SMB] ERROR: Incomplete write, expected %u bytes, wrote %d", bytesRead, bytesWritten);
-            LOG("[SMB] Network may be unstable");
-            success = false;
-            break;
+    }
+    
+    // Open remote file for writing (creating parent directories)
+    // When resuming, keep the bytes already on the server (no O_TRUNC)
+    int openFlags = (startOffset > 0) ? (O_WRONLY | O_CREAT) : (O_WRONLY | O_CREAT | O_TRUNC);
+    struct smb2fh* remoteFile = openRemoteFile(fullRemotePath, openFlags);
+    if (remoteFile == nullptr) {
+        return false;
+    }
+    
+    // Verify the remote copy really holds the checkpointed prefix before resuming
+    uint64_t remoteSize = 0;
+    if (startOffset > 0) {
+        struct smb2_stat_64 st;
+        if (smb2_fstat(smb2, remoteFile, &st) == 0 && st.smb2_size >= startOffset) {
+            remoteSize = st.smb2_size;
+            LOGF("[SMB] Resuming %s at offset %lu of %u bytes", localPath.c_str(), startOffset, fileSize);
+        } else {
+            LOGF("[SMB] WARNING: Remote file shorter than checkpoint (%lu bytes), starting over", startOffset);
+            smb2_ftruncate(smb2, remoteFile, 0);
+            startOffset = 0;
         }
-        
-        bytesTransferred += bytesWritten;
-        
-        // Print progress for large files (every 1MB)
-        if (bytesTransferred % (1024 * 1024) == 0) {
-            LOG_DEBUGF("[SMB] Progress: %lu KB / %u KB", bytesTransferred / 1024, fileSize / 1024);
+    }
+    
+    if (startOffset > 0) {
+        if (!localFile.seek(startOffset) ||
+            smb2_lseek(smb2, remoteFile, startOffset, SEEK_SET, NULL) < 0) {
+            LOGF("[SMB] ERROR: Failed to seek to resume offset %lu", startOffset);
+            smb2_close(smb2, remoteFile);
+            return false;
         }
-        
-        // Yield to prevent watchdog timeout on large files
-        yield();
     }
     
-    // Verify we transferred all bytes
-    if (success && bytesTransferred != fileSize) {
-        LOGF("[SMB] ERROR: Size mismatch, transferred %lu bytes, expected %u", bytesTransferred, fileSize);
-        LOG("[SMB] Upload incomplete - file may be corrupted on remote server");
-        success = false;
+    // Budget-limited sessions may send only part of the remaining file
+    size_t bytesToSend = fileSize - startOffset;
+    if (maxBytes > 0 && maxBytes < bytesToSend) {
+        bytesToSend = maxBytes;
     }
     
-    // Cleanup
-    free(buffer);
+    // A whole-file transfer reads every byte once anyway - hash it on the way
+    // so the caller can record the checksum without a second pass over the SD card
+    Md5Digest digest;
+    bool wholeFile = (startOffset == 0 && bytesToSend == fileSize);
+    
+    FileUploadSource source(localFile);
+    unsigned long uploadTime = 0;
+    bool connectionBroken = false;
+    bool success = writeStream(source, remoteFile, fileSize, startOffset, bytesToSend,
+                               wholeFile ? &digest : nullptr, bytesTransferred, uploadTime,
+                               connectionBroken);
+    
+    // A resumed file can be left longer than the source if it was rewritten
+    if (success && remoteSize > fileSize && startOffset + bytesTransferred == fileSize) {
+        smb2_ftruncate(smb2, remoteFile, fileSize);
+    }
     
-    // Close remote file
-    if (smb2_close(smb2, remoteFile) < 0) {
+    // A broken connection already released the handle with the context
+    if (!connectionBroken && smb2_close(smb2, remoteFile) < 0) {
         LOGF("[SMB] WARNING: Failed to close remote file: %s", smb2_get_error(smb2));
         // Don't fail the upload if close fails - data was already written
     }
     
-    localFile.close();
+    if (success && wholeFile && digest.getBytes() == fileSize) {
+        lastChecksum = digest.finishHex();
+    }
+    
+    unsigned long committed = startOffset + bytesTransferred;
+    
+    if (success) {
+        float transferRate = uploadTime > 0 ? (bytesTransferred / 1024.0) / (uploadTime / 1000.0) : 0.0;
+        if (committed < fileSize) {
+            LOGF("[SMB] Partial upload: %lu bytes in %lu ms (%.2f KB/s), %lu of %u bytes on server", 
+                 bytesTransferred, uploadTime, transferRate, committed, fileSize);
+        } else {
+            LOGF("[SMB] Upload complete: %lu bytes in %lu ms (%.2f KB/s)", 
+                 bytesTransferred, uploadTime, transferRate);
+        }
+        LOG_DEBUGF("[SMB] File size verification: SD=%u bytes, On server=%lu bytes, Match=%s",
+             fileSize, committed, (committed == fileSize) ? "YES" : "NO");
+    } else {
+        LOGF("[SMB] Upload failed - Expected %u bytes, transferred %lu bytes (%lu of %u on server)", 
+             bytesToSend, bytesTransferred, committed, fileSize);
+    }
+    
+    return success;
+}
+
+bool SMBUploader::uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                               unsigned long& bytesTransferred) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+    
+    if (!connected) {
+        LOG("SMB: Not connected");
+        return false;
+    }
+    
+    markActivity();
+    
+    String fullRemotePath = buildRemotePath(remotePath);
+    bool toEnd = (totalBytes == UploadPipeline::STREAM_TO_END);
+    if (toEnd) {
+        LOG_DEBUGF("[SMB] Streaming to %s", fullRemotePath.c_str());
+    } else {
+        LOG_DEBUGF("[SMB] Streaming %u bytes to %s", totalBytes, fullRemotePath.c_str());
+    }
+    
+    struct smb2fh* remoteFile = openRemoteFile(fullRemotePath, O_WRONLY | O_CREAT | O_TRUNC);
+    if (remoteFile == nullptr) {
+        return false;
+    }
+    
+    unsigned long uploadTime = 0;
+    bool connectionBroken = false;
+    bool success = writeStream(source, remoteFile, toEnd ? 0 : totalBytes, 0, totalBytes, nullptr,
+                               bytesTransferred, uploadTime, connectionBroken);
     
-    unsigned long uploadTime = millis() - startTime;
+    if (!connectionBroken && smb2_close(smb2, remoteFile) < 0) {
+        LOGF("[SMB] WARNING: Failed to close remote file: %s", smb2_get_error(smb2));
+    }
     
     if (success) {
         float transferRate = uploadTime > 0 ? (bytesTransferred / 1024.0) / (uploadTime / 1000.0) : 0.0;
-        LOGF("[SMB] Upload complete: %lu bytes in %lu ms (%.2f KB/s)", 
+        LOGF("[SMB] Stream complete: %lu bytes in %lu ms (%.2f KB/s)",
              bytesTransferred, uploadTime, transferRate);
-        LOG_DEBUGF("[SMB] File size verification: SD=%u bytes, Transferred=%lu bytes, Match=%s",
-             fileSize, bytesTransferred, (bytesTransferred == fileSize) ? "YES" : "NO");
-        
-        if (bytesTransferred != fileSize) {
-            LOG("[SMB] ERROR: Size mismatch detected! File may be corrupted on remote server");
+    } else if (toEnd) {
+        LOGF("[SMB] Stream failed after %lu bytes", bytesTransferred);
+    } else {
+        LOGF("[SMB] Stream failed - Expected %u bytes, transferred %lu bytes",
+             totalBytes, bytesTransferred);
+    }
+    
+    return success;
+}
+
+
+UploadSink* SMBUploader::beginFile(const String& remotePath, size_t totalBytes) {
+    lastChecksum = "";
+    
+    if (!connected) {
+        LOG("SMB: Not connected");
+        return nullptr;
+    }
+    if (pushFile != nullptr) {
+        LOG_ERROR("[SMB] beginFile() while another pushed file is open");
+        return nullptr;
+    }
+    
+    markActivity();
+    
+    String fullRemotePath = buildRemotePath(remotePath);
+    LOG_DEBUGF("[SMB] Receiving %u bytes for %s", totalBytes, fullRemotePath.c_str());
+    pushFile = openRemoteFile(fullRemotePath, O_WRONLY | O_CREAT | O_TRUNC);
+    if (pushFile == nullptr) {
+        return nullptr;
+    }
+    pushSize = totalBytes;
+    
+    // The caller's pipeline uses the default chunk size, so the slots do too
+    if (writeWindow > 1) {
+        pushAsyncSink = new SMBAsyncWriteSink(smb2, pushFile, totalBytes, writeWindow);
+        if (pushAsyncSink->begin(UPLOAD_PIPELINE_BUFFER_SIZE)) {
+            return pushAsyncSink;
         }
+        LOGF("[SMB] WARNING: Not enough memory for %d write slots, using synchronous writes",
+             writeWindow);
+        delete pushAsyncSink;
+        pushAsyncSink = nullptr;
+    }
+    pushSink = new SMBWriteSink(smb2, pushFile, totalBytes);
+    return pushSink;
+}
+
+bool SMBUploader::finishFile(bool complete) {
+    if (pushFile == nullptr) {
+        return false;
+    }
+    
+    bool success = complete;
+    bool connectionBroken = false;
+    unsigned long written;
+    if (pushAsyncSink != nullptr) {
+        // Always drain replies, even after a failure, so no callback outlives the sink
+        if (!pushAsyncSink->finish()) {
+            success = false;
+        }
+        written = pushAsyncSink->ackedBytes();
+        connectionBroken = pushAsyncSink->isConnectionBroken();
     } else {
-        LOGF("[SMB] Upload failed - Expected %u bytes, transferred %lu bytes", 
-             fileSize, bytesTransferred);
+        written = pushSink->getWritten();
+    }
+    if (success && written != pushSize) {
+        LOGF("[SMB] ERROR: Size mismatch, transferred %lu bytes, expected %u", written, pushSize);
+        success = false;
+    }
+    
+    if (connectionBroken) {
+        // Same as writeStream(): the context must go before the slot buffers
+        LOG("[SMB] Dropping connection, will reconnect on next upload");
+        disconnect();
+    } else if (smb2_close(smb2, pushFile) < 0) {
+        LOGF("[SMB] WARNING: Failed to close remote file: %s", smb2_get_error(smb2));
     }
     
+    delete pushAsyncSink;
+    delete pushSink;
+    pushAsyncSink = nullptr;
+    pushSink = nullptr;
+    pushFile = nullptr;
+    
+    if (connected) {
+        markActivity();
+    }
+    if (!success && complete) {
+        LOGF("[SMB] Pushed file failed - %lu of %u bytes on server", written, pushSize);
+    }
     return success;
 }
 
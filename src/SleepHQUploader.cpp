@@ -1,56 +1,400 @@
 #include "SleepHQUploader.h"
 #include "Logger.h"
+#include "Config.h"
+#include "Md5Digest.h"
+#include <ArduinoJson.h>
 
 #ifdef ENABLE_SLEEPHQ_UPLOAD
 
-// TODO: Implementation pending
-// This is a placeholder for future SleepHQ direct upload support
+#include <string>
+
+static const char* MULTIPART_BOUNDARY = "----CPAPUploaderFormBoundary";
+
+// API responses are small JSON documents; anything longer is cut here
+static const size_t MAX_RESPONSE_BODY = 4096;
+
+static void collectBody(const uint8_t* data, size_t len, void* context) {
+    std::string* body = static_cast<std::string*>(context);
+    if (body->length() < MAX_RESPONSE_BODY) {
+        body->append((const char*)data, len);
+    }
+}
+
+// Responses are small (MAX_RESPONSE_BODY); /api/v1/me carries the most
+// attributes the uploader does not use
+typedef StaticJsonDocument<1536> ResponseDocument;
+
+static bool parseResponse(const std::string& body, ResponseDocument& doc) {
+    DeserializationError error = deserializeJson(doc, body.data(), body.size());
+    if (error) {
+        LOGF("[SleepHQ] ERROR: Unreadable response: %s", error.c_str());
+        return false;
+    }
+    return true;
+}
+
+// JSON:API ids, sent as strings or numbers (empty if absent)
+static String idValue(JsonVariant value) {
+    if (value.is<const char*>()) {
+        return String(value.as<const char*>());
+    }
+    if (value.is<long>()) {
+        return String(value.as<long>());
+    }
+    return "";
+}
+
+static bool isSuccess(int status) {
+    return status >= 200 && status < 300;
+}
+
+// content_hash (MD5 of the data followed by the file name) is only known
+// after the data, so it is the last form field
+static std::string hashFieldHeader() {
+    return std::string("\r\n--") + MULTIPART_BOUNDARY +
+           "\r\nContent-Disposition: form-data; name=\"content_hash\"\r\n\r\n";
+}
+
+static std::string closingBoundary() {
+    return std::string("\r\n--") + MULTIPART_BOUNDARY + "--\r\n";
+}
+
+/**
+ * Sink for the file part of a multipart POST: sends the data and hashes
+ * it for content_hash on the way
+ */
+class SleepHQFileSink : public UploadSink {
+public:
+    explicit SleepHQFileSink(HttpConnection& http) : written(0), http(http) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        if (!http.writeBody(data, len)) {
+            return false;
+        }
+        digest.update(data, len);
+        written += len;
+        return true;
+    }
+
+    Md5Digest digest;
+    unsigned long written;
+
+private:
+    HttpConnection& http;
+};
 
 SleepHQUploader::SleepHQUploader(const String& endpoint, const String& user, const String& apiKey)
-    : userId(user), apiKey(apiKey), authenticated(false) {
-    parseEndpoint(endpoint);
+    : clientId(user),
+      clientSecret(apiKey),
+      configured(false),
+      authenticated(false),
+      tokenTime(0),
+      tokenLifetimeMs(0),
+      importFiles(0),
+      pushSink(nullptr),
+      pushSize(0),
+      importCount(0),
+      fileCount(0) {
+    configured = http.setUrl(endpoint.isEmpty() ? String(SLEEPHQ_DEFAULT_ENDPOINT) : endpoint);
 }
 
 SleepHQUploader::~SleepHQUploader() {
     end();
 }
 
-bool SleepHQUploader::parseEndpoint(const String& endpoint) {
-    // TODO: Parse SleepHQ API endpoint
-    apiEndpoint = endpoint;
-    LOG("[SleepHQ] TODO: SleepHQ uploader not yet implemented");
-    return false;
+UploadBackend* SleepHQUploader::create(const Config& /*config*/, const EndpointConfig& endpoint) {
+    return new SleepHQUploader(endpoint.url, endpoint.user, endpoint.password);
 }
 
 bool SleepHQUploader::authenticate() {
-    LOG("[SleepHQ] ERROR: SleepHQ uploader not yet implemented");
-    return false;
+    String form = "grant_type=client_credentials&client_id=" + HttpConnection::encodePath(clientId) +
+                  "&client_secret=" + HttpConnection::encodePath(clientSecret) + "&scope=read%20write";
+    std::string body;
+    int status = http.request("POST", apiPath("/oauth/token"),
+                              "Content-Type: application/x-www-form-urlencoded\r\nAccept: application/json\r\n",
+                              form, &collectBody, &body);
+    if (status == 400 || status == 401) {
+        LOGF("[SleepHQ] ERROR: Authentication failed (HTTP %d), check ENDPOINT_USER (client ID) and ENDPOINT_PASS (client secret)",
+             status);
+        return false;
+    }
+    ResponseDocument doc;
+    String token;
+    if (status == 200 && parseResponse(body, doc)) {
+        token = doc["access_token"] | "";
+    }
+    if (token.isEmpty()) {
+        LOGF("[SleepHQ] ERROR: Token request failed (HTTP %d)", status);
+        return false;
+    }
+    http.setBearerToken(token);
+    tokenTime = millis();
+    long lifetime = doc["expires_in"] | 0L;
+    tokenLifetimeMs = (lifetime > 0 ? (unsigned long)lifetime : 7200UL) * 1000UL;
+    return true;
 }
 
-void SleepHQUploader::disconnect() {
-    authenticated = false;
+// Renew the access token a minute before it expires
+bool SleepHQUploader::ensureToken() {
+    if (millis() - tokenTime + 60000UL < tokenLifetimeMs) {
+        return true;
+    }
+    LOG_DEBUG("[SleepHQ] Access token expiring, renewing");
+    return authenticate();
 }
 
 bool SleepHQUploader::begin() {
-    LOG("[SleepHQ] ERROR: SleepHQ uploader not yet implemented");
-    LOG("[SleepHQ] Please use SMB upload or wait for SleepHQ implementation");
-    return false;
+    if (!configured) {
+        LOG_ERROR("[SleepHQ] ENDPOINT must be empty or an https:// URL");
+        return false;
+    }
+
+    LOGF("[SleepHQ] Connecting to %s:%u", http.getHost().c_str(), http.getPort());
+    if (!http.connect() || !authenticate()) {
+        http.close();
+        return false;
+    }
+
+    // Imports belong to a team: use the account's current one
+    std::string body;
+    int status = http.request("GET", apiPath("/api/v1/me"), "Accept: application/json\r\n", "",
+                              &collectBody, &body);
+    ResponseDocument doc;
+    teamId = "";
+    if (status == 200 && parseResponse(body, doc)) {
+        teamId = idValue(doc["data"]["attributes"]["current_team_id"]);
+    }
+    if (teamId.isEmpty()) {
+        LOGF("[SleepHQ] ERROR: Cannot read account team (HTTP %d)", status);
+        http.close();
+        return false;
+    }
+
+    authenticated = true;
+    LOGF("[SleepHQ] Connected (team %s)", teamId.c_str());
+    return true;
 }
 
 void SleepHQUploader::end() {
-    disconnect();
+    if (pushSink != nullptr) {
+        delete pushSink;
+        pushSink = nullptr;
+    }
+    if (!importId.isEmpty()) {
+        LOGF("[SleepHQ] WARNING: Import %s abandoned with %lu unprocessed files", importId.c_str(), importFiles);
+        importId = "";
+    }
+    http.close();
+    authenticated = false;
+}
+
+// Connect on first use (and after a dropped connection)
+bool SleepHQUploader::ensureConnected() {
+    if (isConnected()) {
+        return true;
+    }
+    LOG_DEBUG("[SleepHQ] Not connected, attempting to connect...");
+    if (!begin()) {
+        LOG_ERROR("[SleepHQ] Failed to connect to SleepHQ service");
+        return false;
+    }
+    return true;
 }
 
 bool SleepHQUploader::isConnected() const {
     return authenticated;
 }
 
-bool SleepHQUploader::upload(const String& localPath, const String& remotePath, 
-                             fs::FS &sd, unsigned long& bytesTransferred) {
+bool SleepHQUploader::ensureImport() {
+    if (!importId.isEmpty()) {
+        return true;
+    }
+    std::string body;
+    int status = http.request("POST", apiPath("/api/v1/teams/" + teamId + "/imports"),
+                              "Content-Type: application/x-www-form-urlencoded\r\nAccept: application/json\r\n",
+                              "programatic=true", &collectBody, &body);
+    ResponseDocument doc;
+    String id;
+    if (isSuccess(status) && parseResponse(body, doc)) {
+        id = idValue(doc["data"]["id"]);
+    }
+    if (id.isEmpty()) {
+        LOGF("[SleepHQ] ERROR: Cannot create import (HTTP %d)", status);
+        return false;
+    }
+    importId = id;
+    importFiles = 0;
+    importCount++;
+    LOG_DEBUGF("[SleepHQ] Opened import %s", importId.c_str());
+    return true;
+}
+
+bool SleepHQUploader::beginPost(const String& remotePath, size_t fileSize) {
+    int slash = remotePath.lastIndexOf('/');
+    std::string name(remotePath.substring(slash + 1).c_str());
+    std::string folder(remotePath.substring(0, slash + 1).c_str());
+    std::string boundary(MULTIPART_BOUNDARY);
+
+    std::string preamble =
+        "--" + boundary + "\r\nContent-Disposition: form-data; name=\"name\"\r\n\r\n" + name + "\r\n" +
+        "--" + boundary + "\r\nContent-Disposition: form-data; name=\"path\"\r\n\r\n" + folder + "\r\n" +
+        "--" + boundary + "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"" + name + "\"\r\n" +
+        "Content-Type: application/octet-stream\r\n\r\n";
+    long length = (long)(preamble.length() + fileSize + hashFieldHeader().length() + 32 +
+                         closingBoundary().length());
+
+    String headers = String("Content-Type: multipart/form-data; boundary=") + MULTIPART_BOUNDARY +
+                     "\r\nAccept: application/json\r\n";
+    if (!http.beginRequest("POST", apiPath("/api/v1/imports/" + importId + "/files"), length, headers) ||
+        !http.writeBody((const uint8_t*)preamble.data(), preamble.length())) {
+        return false;
+    }
+    pushSink = new SleepHQFileSink(http);
+    pushSize = fileSize;
+    pushName = String(name.c_str());
+    return true;
+}
+
+int SleepHQUploader::finishPost(bool complete) {
+    SleepHQFileSink* sink = pushSink;
+    pushSink = nullptr;
+    if (!complete || sink->written != pushSize) {
+        // The body is incomplete; the connection cannot carry another request
+        delete sink;
+        http.close();
+        return -1;
+    }
+
+    Md5Digest contentHash = sink->digest;
+    contentHash.update((const uint8_t*)pushName.c_str(), pushName.length());
+    std::string trailer = hashFieldHeader() + contentHash.finishHex().c_str() + closingBoundary();
+    lastChecksum = sink->digest.finishHex();
+    delete sink;
+    if (!http.writeBody((const uint8_t*)trailer.data(), trailer.length())) {
+        return -1;
+    }
+
+    std::string body;
+    return http.readResponse(&collectBody, &body);
+}
+
+int SleepHQUploader::postFile(fs::File& file, size_t fileSize, const String& remotePath,
+                              unsigned long& bytesTransferred) {
+    bytesTransferred = 0;
+    if (!beginPost(remotePath, fileSize)) {
+        return -1;
+    }
+
+    UploadPipeline pipeline;
+    if (!pipeline.begin()) {
+        LOG_ERROR("[SleepHQ] ERROR: Failed to allocate upload buffers");
+        return finishPost(false);
+    }
+    FileUploadSource source(file);
+    bool sent = pipeline.run(source, fileSize, *pushSink, bytesTransferred) && bytesTransferred == fileSize;
+    pipeline.end();
+    return finishPost(sent);
+}
+
+bool SleepHQUploader::recordPost(int status, const String& remotePath, size_t fileSize) {
+    if (!isSuccess(status)) {
+        LOGF("[SleepHQ] ERROR: Upload of %s failed (HTTP %d)", remotePath.c_str(), status);
+        // The import misses this file: the batch starts again with a new one
+        importId = "";
+        lastChecksum = "";
+        return false;
+    }
+
+    importFiles++;
+    fileCount++;
+    LOG_DEBUGF("[SleepHQ] Added %s to import %s (%u bytes)", remotePath.c_str(), importId.c_str(), fileSize);
+    return true;
+}
+
+bool SleepHQUploader::uploadFile(fs::File& localFile, size_t fileSize, const String& /*localPath*/,
+                                 const String& remotePath, unsigned long& bytesTransferred,
+                                 unsigned long /*startOffset*/, unsigned long /*maxBytes*/) {
     bytesTransferred = 0;
-    LOG("[SleepHQ] ERROR: SleepHQ uploader not yet implemented");
-    LOG("[SleepHQ] Please use SMB upload or wait for SleepHQ implementation");
-    return false;
+    lastChecksum = "";
+
+    if (!authenticated) {
+        LOG("[SleepHQ] Not connected");
+        return false;
+    }
+
+    int status = -1;
+    if (ensureToken() && ensureImport()) {
+        // The file can be read again, so a POST that hit a closed
+        // keep-alive connection is retried once on a fresh one
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (attempt > 0 && !localFile.seek(0)) {
+                break;
+            }
+            status = postFile(localFile, fileSize, remotePath, bytesTransferred);
+            if (status >= 0 || !http.wasReused()) {
+                break;
+            }
+        }
+    }
+
+    if (!recordPost(status, remotePath, fileSize)) {
+        bytesTransferred = 0;
+        return false;
+    }
+    return true;
+}
+
+// Pushed data cannot be replayed, so unlike upload() there is no retry on
+// a keep-alive connection the server had closed
+UploadSink* SleepHQUploader::beginFile(const String& remotePath, size_t totalBytes) {
+    lastChecksum = "";
+
+    if (!authenticated) {
+        LOG("[SleepHQ] Not connected");
+        return nullptr;
+    }
+    if (pushSink != nullptr) {
+        LOG_ERROR("[SleepHQ] beginFile() while another file is being posted");
+        return nullptr;
+    }
+    if (!ensureToken() || !ensureImport() || !beginPost(remotePath, totalBytes)) {
+        recordPost(-1, remotePath, totalBytes);
+        return nullptr;
+    }
+    pushPath = remotePath;
+    return pushSink;
+}
+
+bool SleepHQUploader::finishFile(bool complete) {
+    if (pushSink == nullptr) {
+        return false;
+    }
+    return recordPost(finishPost(complete), pushPath, pushSize);
+}
+
+bool SleepHQUploader::commitBatch() {
+    if (importId.isEmpty()) {
+        return true;  // Nothing uploaded since the last commit
+    }
+    String id = importId;
+    importId = "";
+
+    int status = -1;
+    if (authenticated && ensureToken()) {
+        status = http.request("POST", apiPath("/api/v1/imports/" + id + "/process_files"),
+                              "Accept: application/json\r\n");
+    }
+    if (!isSuccess(status)) {
+        LOGF("[SleepHQ] ERROR: Processing import %s failed (HTTP %d)", id.c_str(), status);
+        return false;
+    }
+    LOGF("[SleepHQ] Import %s submitted for processing (%lu files)", id.c_str(), importFiles);
+    return true;
+}
+
+void SleepHQUploader::logSessionStats() {
+    LOG_DEBUGF("[SleepHQ] %lu files in %lu imports, %lu requests on %lu connections",
+               fileCount, importCount, http.getRequestCount(), http.getConnectCount());
 }
 
 #endif // ENABLE_SLEEPHQ_UPLOAD
@@ -0,0 +1,443 @@
+#include "TCPUploader.h"
+#include "Logger.h"
+#include "Config.h"
+#include "Md5Digest.h"
+
+#ifdef ENABLE_TCP_UPLOAD
+
+#include <string>
+
+#ifndef UNIT_TEST
+#include <WiFiClient.h>
+#endif
+
+static const uint8_t FRAME_FILE = 'F';
+static const uint8_t FRAME_ACK = 'A';
+static const size_t ACK_SIZE = 14;   // 'A' u32 seq, u8 status, u64 bytes
+static const uint64_t UNKNOWN_SIZE = ~(uint64_t)0;
+
+static void putLE(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += (char)(value >> (8 * i));
+    }
+}
+
+static uint64_t getLE(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+static const char* ackStatusName(uint8_t status) {
+    switch (status) {
+        case TCPUploader::ACK_OK: return "ok";
+        case TCPUploader::ACK_CRC_MISMATCH: return "CRC mismatch";
+        case TCPUploader::ACK_WRITE_ERROR: return "write error on the receiver";
+        case TCPUploader::ACK_BAD_REQUEST: return "path or size rejected";
+        default: return "unknown status";
+    }
+}
+
+/**
+ * Sink for the data of one file frame: sends length-prefixed chunks and
+ * keeps the CRC of the data for the trailer
+ */
+class TCPFrameSink : public UploadSink {
+public:
+    TCPFrameSink(TCPUploader& uploader, uint32_t seq) : uploader(uploader), seq(seq), written(0) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        while (len > 0) {
+            size_t n = len < TCP_MAX_CHUNK ? len : TCP_MAX_CHUNK;
+            uint8_t prefix[4] = {(uint8_t)n, (uint8_t)(n >> 8), (uint8_t)(n >> 16), (uint8_t)(n >> 24)};
+            if (!uploader.writeAll(prefix, sizeof(prefix)) || !uploader.writeAll(data, n)) {
+                return false;
+            }
+            crc.update(data, n);
+            written += n;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    TCPUploader& uploader;
+    uint32_t seq;
+    Crc32 crc;
+    unsigned long written;
+};
+
+TCPUploader::TCPUploader(const String& endpoint, const String& token)
+    : client(nullptr),
+      ownsClient(false),
+      port(TCP_DEFAULT_PORT),
+      token(token),
+      configured(false),
+      connected(false),
+      timeoutMs(10000),
+      nextSeq(1),
+      batchFailed(false),
+      pushSink(nullptr),
+      pushSize(0),
+      connectCount(0),
+      fileCount(0),
+      byteCount(0),
+      maxUnacked(0) {
+    std::string text(endpoint.c_str());
+    if (text.compare(0, 6, "tcp://") == 0) {
+        text = text.substr(6);
+    }
+    while (!text.empty() && text[text.length() - 1] == '/') {
+        text.erase(text.length() - 1);
+    }
+    size_t colon = text.find(':');
+    if (colon != std::string::npos) {
+        int parsedPort = atoi(text.c_str() + colon + 1);
+        if (parsedPort <= 0 || parsedPort > 65535) {
+            LOGF("[TCP] ERROR: Invalid port in ENDPOINT: %s", endpoint.c_str());
+            return;
+        }
+        port = (uint16_t)parsedPort;
+        text = text.substr(0, colon);
+    }
+    if (text.empty() || text.find('/') != std::string::npos) {
+        LOGF("[TCP] ERROR: ENDPOINT must be host[:port]: %s", endpoint.c_str());
+        return;
+    }
+    host = String(text.c_str());
+    configured = true;
+}
+
+TCPUploader::~TCPUploader() {
+    end();
+    if (ownsClient) {
+        delete client;
+    }
+}
+
+UploadBackend* TCPUploader::create(const Config& /*config*/, const EndpointConfig& endpoint) {
+    return new TCPUploader(endpoint.url, endpoint.password);
+}
+
+void TCPUploader::setClient(Client* transport) {
+    end();
+    if (ownsClient) {
+        delete client;
+    }
+    client = transport;
+    ownsClient = false;
+}
+
+bool TCPUploader::writeAll(const uint8_t* data, size_t len) {
+    unsigned long lastProgress = millis();
+    while (len > 0) {
+        size_t written = client->write(data, len);
+        if (written > 0) {
+            data += written;
+            len -= written;
+            lastProgress = millis();
+        } else if (!client->connected() || millis() - lastProgress > timeoutMs) {
+            LOG_ERROR("[TCP] Write failed, closing connection");
+            disconnect();
+            return false;
+        } else {
+            delay(1);
+        }
+    }
+    return true;
+}
+
+bool TCPUploader::readExact(uint8_t* data, size_t len) {
+    unsigned long lastProgress = millis();
+    while (len > 0) {
+        int n = client->available() > 0 ? client->read(data, len) : 0;
+        if (n > 0) {
+            data += n;
+            len -= n;
+            lastProgress = millis();
+        } else if (!client->connected() || millis() - lastProgress > timeoutMs) {
+            LOG_ERROR("[TCP] Receiver did not answer, closing connection");
+            disconnect();
+            return false;
+        } else {
+            delay(1);
+        }
+    }
+    return true;
+}
+
+void TCPUploader::disconnect() {
+    if (!unacked.empty()) {
+        LOGF("[TCP] %u files sent on the dropped connection were not acknowledged",
+             (unsigned int)unacked.size());
+        batchFailed = true;
+        unacked.clear();
+    }
+    if (client) {
+        client->stop();
+    }
+    connected = false;
+}
+
+bool TCPUploader::begin() {
+    if (!configured) {
+        return false;
+    }
+    disconnect();
+
+#ifndef UNIT_TEST
+    if (client == nullptr) {
+        client = new WiFiClient();
+        ownsClient = true;
+    }
+#endif
+    if (client == nullptr) {
+        return false;
+    }
+
+    LOGF("[TCP] Connecting to %s:%u", host.c_str(), port);
+    if (!client->connect(host.c_str(), port)) {
+        LOGF("[TCP] ERROR: Cannot connect to %s:%u", host.c_str(), port);
+        return false;
+    }
+    connectCount++;
+
+    std::string hello("CPAP");
+    putLE(hello, PROTOCOL_VERSION, 1);
+    putLE(hello, token.length(), 2);
+    hello += token.c_str();
+    uint8_t reply[6];
+    if (!writeAll((const uint8_t*)hello.data(), hello.length()) || !readExact(reply, sizeof(reply))) {
+        return false;
+    }
+    if (memcmp(reply, "CPAP", 4) != 0 || reply[4] != PROTOCOL_VERSION) {
+        LOG_ERROR("[TCP] ERROR: Endpoint is not a CPAP receiver or speaks another protocol version");
+        disconnect();
+        return false;
+    }
+    if (reply[5] != 0) {
+        LOG_ERROR("[TCP] ERROR: Receiver rejected the token, check ENDPOINT_PASS");
+        disconnect();
+        return false;
+    }
+
+    connected = true;
+    LOG("[TCP] Connected");
+    return true;
+}
+
+bool TCPUploader::ensureConnected() {
+    if (isConnected()) {
+        return true;
+    }
+    return begin();
+}
+
+bool TCPUploader::isConnected() const {
+    return connected && client && client->connected();
+}
+
+void TCPUploader::end() {
+    if (pushSink) {
+        delete pushSink;
+        pushSink = nullptr;
+    }
+    disconnect();
+    batchFailed = false;
+}
+
+bool TCPUploader::readAck() {
+    uint8_t ack[ACK_SIZE];
+    if (!readExact(ack, sizeof(ack))) {
+        return false;
+    }
+    uint32_t seq = (uint32_t)getLE(ack + 1, 4);
+    if (ack[0] != FRAME_ACK || unacked.empty() || seq != unacked.front()) {
+        LOGF("[TCP] ERROR: Unexpected reply from receiver (seq %lu)", (unsigned long)seq);
+        disconnect();
+        return false;
+    }
+    unacked.pop_front();
+
+    uint64_t bytes = getLE(ack + 6, 8);
+    if (ack[5] != ACK_OK) {
+        LOGF("[TCP] ERROR: Receiver refused file #%lu: %s", (unsigned long)seq, ackStatusName(ack[5]));
+        batchFailed = true;
+        disconnect();
+        return false;
+    }
+    fileCount++;
+    byteCount += bytes;
+    return true;
+}
+
+bool TCPUploader::pollAcks() {
+    while (connected && !unacked.empty() && client->available() >= (int)ACK_SIZE) {
+        if (!readAck()) {
+            return false;
+        }
+    }
+    return !batchFailed;
+}
+
+bool TCPUploader::drainAcks(size_t limit) {
+    while (connected && unacked.size() > limit) {
+        if (!readAck()) {
+            return false;
+        }
+    }
+    return !batchFailed;
+}
+
+TCPFrameSink* TCPUploader::beginFrame(const String& remotePath, size_t totalBytes) {
+    if (!connected) {
+        LOG("[TCP] Not connected");
+        return nullptr;
+    }
+    // An earlier file of the batch already failed: stop sending
+    if (!pollAcks() || !drainAcks(TCP_UPLOAD_WINDOW - 1)) {
+        return nullptr;
+    }
+
+    uint32_t seq = nextSeq++;
+    std::string header;
+    header.reserve(16 + remotePath.length());
+    putLE(header, FRAME_FILE, 1);
+    putLE(header, seq, 4);
+    putLE(header, remotePath.length(), 2);
+    header += remotePath.c_str();
+    putLE(header, totalBytes == UploadPipeline::STREAM_TO_END ? UNKNOWN_SIZE : (uint64_t)totalBytes, 8);
+    if (!writeAll((const uint8_t*)header.data(), header.length())) {
+        return nullptr;
+    }
+    return new TCPFrameSink(*this, seq);
+}
+
+bool TCPUploader::finishFrame(TCPFrameSink* sink, size_t totalBytes, bool complete) {
+    bool whole = complete && (totalBytes == UploadPipeline::STREAM_TO_END || sink->written == totalBytes);
+    uint32_t seq = sink->seq;
+    uint32_t crc = sink->crc.getValue();
+    delete sink;
+    if (!whole) {
+        // A frame cannot be abandoned halfway: the stream is out of sync
+        LOG_ERROR("[TCP] Transfer incomplete, closing connection");
+        disconnect();
+        return false;
+    }
+
+    std::string trailer;
+    putLE(trailer, 0, 4);
+    putLE(trailer, crc, 4);
+    if (!writeAll((const uint8_t*)trailer.data(), trailer.length())) {
+        return false;
+    }
+    unacked.push_back(seq);
+    if (unacked.size() > maxUnacked) {
+        maxUnacked = unacked.size();
+    }
+    return pollAcks();
+}
+
+bool TCPUploader::uploadFile(fs::File& localFile, size_t fileSize, const String& /*localPath*/,
+                             const String& remotePath, unsigned long& bytesTransferred,
+                             unsigned long /*startOffset*/, unsigned long /*maxBytes*/) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+
+    if (!connected) {
+        LOG("[TCP] Not connected");
+        return false;
+    }
+
+    TCPFrameSink* sink = beginFrame(remotePath, fileSize);
+    if (!sink) {
+        return false;
+    }
+
+    UploadPipeline pipeline;
+    bool sent = false;
+    Md5Digest digest;
+    if (pipeline.begin()) {
+        FileUploadSource source(localFile);
+        pipeline.setDigest(&digest);
+        sent = pipeline.run(source, fileSize, *sink, bytesTransferred) && bytesTransferred == fileSize;
+        pipeline.end();
+    } else {
+        LOG_ERROR("[TCP] ERROR: Failed to allocate upload buffers");
+    }
+
+    if (!finishFrame(sink, fileSize, sent)) {
+        LOGF("[TCP] ERROR: Upload of %s failed", remotePath.c_str());
+        bytesTransferred = 0;
+        return false;
+    }
+    lastChecksum = digest.finishHex();
+    LOG_DEBUGF("[TCP] Sent %s (%u bytes, %u unacked)", remotePath.c_str(), fileSize,
+               (unsigned int)unacked.size());
+    return true;
+}
+
+// Archives and compressed files may be recorded as soon as this returns,
+// so the ack is waited for here
+bool TCPUploader::uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                               unsigned long& bytesTransferred) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+
+    TCPFrameSink* sink = beginFrame(remotePath, totalBytes);
+    if (!sink) {
+        return false;
+    }
+    UploadPipeline pipeline;
+    bool sent = false;
+    if (pipeline.begin()) {
+        sent = pipeline.run(source, totalBytes, *sink, bytesTransferred);
+        pipeline.end();
+    } else {
+        LOG_ERROR("[TCP] ERROR: Failed to allocate upload buffers");
+    }
+    if (!finishFrame(sink, totalBytes, sent) || !drainAcks(0)) {
+        LOGF("[TCP] ERROR: Upload of %s failed", remotePath.c_str());
+        bytesTransferred = 0;
+        return false;
+    }
+    return true;
+}
+
+UploadSink* TCPUploader::beginFile(const String& remotePath, size_t totalBytes) {
+    lastChecksum = "";
+    if (pushSink != nullptr) {
+        LOG_ERROR("[TCP] beginFile() while another file is being sent");
+        return nullptr;
+    }
+    pushSink = beginFrame(remotePath, totalBytes);
+    pushSize = totalBytes;
+    return pushSink;
+}
+
+bool TCPUploader::finishFile(bool complete) {
+    if (pushSink == nullptr) {
+        return false;
+    }
+    TCPFrameSink* sink = pushSink;
+    pushSink = nullptr;
+    return finishFrame(sink, pushSize, complete);
+}
+
+bool TCPUploader::commitBatch() {
+    bool accepted = drainAcks(0);
+    batchFailed = false;
+    if (!accepted) {
+        LOG_ERROR("[TCP] ERROR: Receiver did not acknowledge every file of the batch");
+    }
+    return accepted;
+}
+
+void TCPUploader::logSessionStats() {
+    LOG_DEBUGF("[TCP] %lu files (%llu bytes) acknowledged on %lu connections, up to %u in flight",
+               fileCount, byteCount, connectCount, (unsigned int)maxUnacked);
+}
+
+#endif // ENABLE_TCP_UPLOAD
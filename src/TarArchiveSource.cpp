@@ -0,0 +1,220 @@
+#include "TarArchiveSource.h"
+#include "Logger.h"
+
+// Zero-filled end-of-archive marker (two blocks)
+static const size_t TAR_TRAILER_SIZE = 2 * TarArchiveSource::BLOCK_SIZE;
+
+TarArchiveSource::TarArchiveSource(fs::FS &sd, const String& folderPath, const String& archiveDir)
+    : sd(sd),
+      folderPath(folderPath),
+      archiveDir(archiveDir),
+      dataBytes(0),
+      entryIndex(0),
+      phase(PHASE_HEADER),
+      phaseOffset(0),
+      phaseLength(0),
+      failed(false) {
+}
+
+TarArchiveSource::~TarArchiveSource() {
+    closeCurrent();
+}
+
+size_t TarArchiveSource::paddingFor(unsigned long size) {
+    size_t remainder = size % BLOCK_SIZE;
+    return remainder == 0 ? 0 : BLOCK_SIZE - remainder;
+}
+
+bool TarArchiveSource::addFile(const String& fileName) {
+    fs::File file = sd.open(folderPath + "/" + fileName, FILE_READ);
+    if (!file) {
+        LOGF("[TarArchive] ERROR: Cannot open %s/%s", folderPath.c_str(), fileName.c_str());
+        return false;
+    }
+    unsigned long size = file.size();
+    time_t lastWrite = file.getLastWrite();
+    file.close();
+
+    return addFile(fileName, size, lastWrite);
+}
+
+bool TarArchiveSource::addFile(const String& fileName, unsigned long size, time_t lastWrite) {
+    if (archiveDir.length() + 1 + fileName.length() > MAX_NAME_LENGTH) {
+        LOGF("[TarArchive] ERROR: Name too long for archive: %s", fileName.c_str());
+        return false;
+    }
+
+    Entry entry;
+    entry.name = fileName;
+    entry.size = size;
+    entry.lastWrite = lastWrite;
+
+    entries.push_back(entry);
+    dataBytes += entry.size;
+    return true;
+}
+
+size_t TarArchiveSource::archiveSizeFor(const std::vector<unsigned long>& fileSizes) {
+    size_t total = TAR_TRAILER_SIZE;
+    for (unsigned long size : fileSizes) {
+        total += BLOCK_SIZE + size + paddingFor(size);
+    }
+    return total;
+}
+
+size_t TarArchiveSource::getArchiveSize() const {
+    std::vector<unsigned long> sizes;
+    for (const Entry& entry : entries) {
+        sizes.push_back(entry.size);
+    }
+    return archiveSizeFor(sizes);
+}
+
+// Octal field, zero padded and NUL terminated, as tar expects
+static void writeOctal(uint8_t* field, size_t width, unsigned long value) {
+    snprintf((char*)field, width, "%0*lo", (int)(width - 1), value);
+}
+
+bool TarArchiveSource::formatHeader(uint8_t* block, const char* name, unsigned long size,
+                                    time_t lastWrite) {
+    size_t nameLength = strlen(name);
+    if (nameLength > MAX_NAME_LENGTH) {
+        return false;
+    }
+
+    memset(block, 0, BLOCK_SIZE);
+    memcpy(block, name, nameLength);               // name[100]
+    writeOctal(block + 100, 8, 0644);              // mode[8]
+    writeOctal(block + 108, 8, 0);                 // uid[8]
+    writeOctal(block + 116, 8, 0);                 // gid[8]
+    writeOctal(block + 124, 12, size);             // size[12]
+    writeOctal(block + 136, 12, lastWrite > 0 ? (unsigned long)lastWrite : 0);  // mtime[12]
+    block[156] = '0';                              // typeflag: regular file
+    memcpy(block + 257, "ustar", 6);               // magic[6] (with NUL)
+    memcpy(block + 263, "00", 2);                  // version[2]
+
+    // Checksum: byte sum with the checksum field itself counted as spaces
+    memset(block + 148, ' ', 8);
+    unsigned long checksum = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        checksum += block[i];
+    }
+    snprintf((char*)block + 148, 7, "%06lo", checksum);
+    block[154] = '\0';
+    block[155] = ' ';
+    return true;
+}
+
+void TarArchiveSource::closeCurrent() {
+    if (current) {
+        current.close();
+    }
+    current = fs::File();
+}
+
+// Format the header of the current entry (or start the trailer)
+void TarArchiveSource::enterEntry() {
+    phaseOffset = 0;
+    if (entryIndex >= entries.size()) {
+        phase = PHASE_TRAILER;
+        phaseLength = TAR_TRAILER_SIZE;
+        return;
+    }
+
+    const Entry& entry = entries[entryIndex];
+    String name = archiveDir + "/" + entry.name;
+    formatHeader(header, name.c_str(), entry.size, entry.lastWrite);
+    phase = PHASE_HEADER;
+    phaseLength = BLOCK_SIZE;
+}
+
+size_t TarArchiveSource::read(uint8_t* buffer, size_t len) {
+    if (failed) {
+        return 0;
+    }
+    if (phase == PHASE_HEADER && phaseLength == 0) {
+        enterEntry();  // First call
+    }
+
+    size_t produced = 0;
+    while (produced < len && phase != PHASE_DONE) {
+        size_t wanted = len - produced;
+        size_t left = phaseLength - phaseOffset;
+        size_t n = wanted < left ? wanted : left;
+
+        switch (phase) {
+            case PHASE_HEADER:
+                memcpy(buffer + produced, header + phaseOffset, n);
+                break;
+
+            case PHASE_DATA: {
+                if (n == 0) {
+                    break;
+                }
+                size_t bytesRead = current.read(buffer + produced, n);
+                if (bytesRead == 0) {
+                    LOGF("[TarArchive] ERROR: %s/%s ended after %u of %lu bytes",
+                         folderPath.c_str(), entries[entryIndex].name.c_str(),
+                         phaseOffset, entries[entryIndex].size);
+                    failed = true;
+                    closeCurrent();
+                    return produced;
+                }
+                n = bytesRead;
+                break;
+            }
+
+            case PHASE_PADDING:
+            case PHASE_TRAILER:
+                memset(buffer + produced, 0, n);
+                break;
+
+            default:
+                break;
+        }
+
+        produced += n;
+        phaseOffset += n;
+        if (phaseOffset < phaseLength) {
+            continue;
+        }
+
+        // Phase finished - move on
+        phaseOffset = 0;
+        switch (phase) {
+            case PHASE_HEADER: {
+                const Entry& entry = entries[entryIndex];
+                current = sd.open(folderPath + "/" + entry.name, FILE_READ);
+                if (!current) {
+                    LOGF("[TarArchive] ERROR: Cannot open %s/%s", folderPath.c_str(),
+                         entry.name.c_str());
+                    failed = true;
+                    return produced;
+                }
+                phase = PHASE_DATA;
+                phaseLength = entry.size;
+                break;
+            }
+
+            case PHASE_DATA:
+                closeCurrent();
+                phase = PHASE_PADDING;
+                phaseLength = paddingFor(entries[entryIndex].size);
+                break;
+
+            case PHASE_PADDING:
+                entryIndex++;
+                enterEntry();
+                break;
+
+            case PHASE_TRAILER:
+                phase = PHASE_DONE;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return produced;
+}
@@ -1,5 +1,6 @@
 #include "TestWebServer.h"
 #include "Logger.h"
+#include "BufferPool.h"
 #include <time.h>
 
 // Global trigger flags
@@ -11,6 +12,104 @@ volatile bool g_scanNowFlag = false;
 extern unsigned long nextUploadRetryTime;
 extern bool budgetExhaustedRetry;
 
+// Scratch buffer size when the BufferPool is not available
+#define RESPONSE_FALLBACK_BUFFER_SIZE 1024
+
+/**
+ * ResponseStream - Sends a response with chunked transfer encoding
+ *
+ * Output is collected in a scratch buffer borrowed from the BufferPool
+ * and flushed to the client whenever it fills. Large pages never exist
+ * as one growing heap String.
+ */
+class ResponseStream {
+public:
+    ResponseStream(WebServer* srv) : server(srv), buffer(nullptr), capacity(0), length(0) {}
+    
+    ~ResponseStream() {
+        BufferPool::getInstance().release(buffer);
+    }
+    
+    void begin(int code, const char* contentType) {
+        BufferPool& pool = BufferPool::getInstance();
+        capacity = pool.isActive() ? pool.getSlotSize() : RESPONSE_FALLBACK_BUFFER_SIZE;
+        buffer = pool.acquire(capacity);
+        if (buffer == nullptr) {
+            capacity = 0;  // Unbuffered: every print goes straight to the client
+        }
+        server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server->send(code, contentType, "");
+    }
+    
+    void print(const char* data, size_t len) {
+        if (capacity == 0) {
+            server->sendContent(data, len);
+            return;
+        }
+        while (len > 0) {
+            size_t space = capacity - length;
+            size_t n = len < space ? len : space;
+            memcpy(buffer + length, data, n);
+            length += n;
+            data += n;
+            len -= n;
+            if (length == capacity) {
+                flush();
+            }
+        }
+    }
+    
+    void print(const char* str) { print(str, strlen(str)); }
+    void print(const String& str) { print(str.c_str(), str.length()); }
+    
+    // Write a string as JSON string content (without the surrounding quotes)
+    void printJsonEscaped(const char* str, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            char c = str[i];
+            switch (c) {
+                case '"':  print("\\\"", 2); break;
+                case '\\': print("\\\\", 2); break;
+                case '\b': print("\\b", 2); break;
+                case '\f': print("\\f", 2); break;
+                case '\n': print("\\n", 2); break;
+                case '\r': print("\\r", 2); break;
+                case '\t': print("\\t", 2); break;
+                default:
+                    if (c >= 0 && c < 0x20) {
+                        char buf[7];
+                        snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+                        print(buf, 6);
+                    } else {
+                        print(&c, 1);
+                    }
+                    break;
+            }
+        }
+    }
+    
+    // Flush the remainder and terminate the chunked response
+    void end() {
+        flush();
+        server->sendContent("");
+        BufferPool::getInstance().release(buffer);
+        buffer = nullptr;
+        capacity = 0;
+    }
+    
+private:
+    WebServer* server;
+    uint8_t* buffer;
+    size_t capacity;
+    size_t length;
+    
+    void flush() {
+        if (length > 0) {
+            server->sendContent((const char*)buffer, length);
+            length = 0;
+        }
+    }
+};
+
 // Constructor
 TestWebServer::TestWebServer(Config* cfg, UploadStateManager* state,
                              TimeBudgetManager* budget, ScheduleManager* schedule, 
@@ -80,32 +179,36 @@ void TestWebServer::handleClient() {
 
 // GET / - HTML status page
 void TestWebServer::handleRoot() {
-    String html = "<!DOCTYPE html><html><head>";
-    html += "<title>CPAP Auto-Uploader Status</title>";
-    html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-    html += "<style>";
-    html += "body { font-family: Arial, sans-serif; margin: 20px; background: #f0f0f0; }";
-    html += "h1 { color: #333; }";
-    html += "h2 { color: #666; margin-top: 30px; }";
-    html += ".container { background: white; padding: 20px; border-radius: 8px; max-width: 800px; }";
-    html += ".info { margin: 10px 0; }";
-    html += ".label { font-weight: bold; display: inline-block; width: 200px; }";
-    html += ".value { color: #0066cc; }";
-    html += ".button { display: inline-block; padding: 10px 20px; margin: 10px 5px; ";
-    html += "background: #0066cc; color: white; text-decoration: none; border-radius: 4px; }";
-    html += ".button:hover { background: #0052a3; }";
-    html += ".button.danger { background: #cc0000; }";
-    html += ".button.danger:hover { background: #a30000; }";
-    html += "</style>";
-    html += "</head><body>";
-    html += "<div class='container'>";
-    html += "<h1>CPAP Auto-Uploader Status</h1>";
+    ResponseStream out(server);
+    out.begin(200, "text/html");
+    out.print("<!DOCTYPE html><html><head>");
+    out.print("<title>CPAP Auto-Uploader Status</title>");
+    out.print("<meta name='viewport' content='width=device-width, initial-scale=1'>");
+    out.print("<style>");
+    out.print("body { font-family: Arial, sans-serif; margin: 20px; background: #f0f0f0; }");
+    out.print("h1 { color: #333; }");
+    out.print("h2 { color: #666; margin-top: 30px; }");
+    out.print(".container { background: white; padding: 20px; border-radius: 8px; max-width: 800px; }");
+    out.print(".info { margin: 10px 0; }");
+    out.print(".label { font-weight: bold; display: inline-block; width: 200px; }");
+    out.print(".value { color: #0066cc; }");
+    out.print(".button { display: inline-block; padding: 10px 20px; margin: 10px 5px; ");
+    out.print("background: #0066cc; color: white; text-decoration: none; border-radius: 4px; }");
+    out.print(".button:hover { background: #0052a3; }");
+    out.print(".button.danger { background: #cc0000; }");
+    out.print(".button.danger:hover { background: #a30000; }");
+    out.print("</style>");
+    out.print("</head><body>");
+    out.print("<div class='container'>");
+    out.print("<h1>CPAP Auto-Uploader Status</h1>");
     
     // System information
-    html += "<h2>System Information</h2>";
-    html += "<div class='info'><span class='label'>Uptime:</span><span class='value'>" + getUptimeString() + "</span></div>";
-    html += "<div class='info'><span class='label'>Current Time:</span><span class='value'>" + getCurrentTimeString() + "</span></div>";
-    html += "<div class='info'><span class='label'>Free Heap:</span><span class='value'>" + String(ESP.getFreeHeap()) + " bytes</span></div>";
+    out.print("<h2>System Information</h2>");
+    out.print("<div class='info'><span class='label'>Uptime:</span><span class='value'>" + getUptimeString() + "</span></div>");
+    out.print("<div class='info'><span class='label'>Current Time:</span><span class='value'>" + getCurrentTimeString() + "</span></div>");
+    out.print("<div class='info'><span class='label'>Free Heap:</span><span class='value'>" + String(ESP.getFreeHeap()) + " bytes</span></div>");
+    out.print("<div class='info'><span class='label'>Heap Low-Water / Largest Block:</span><span class='value'>" +
+              String(ESP.getMinFreeHeap()) + " / " + String(ESP.getMaxAllocHeap()) + " bytes</span></div>");
     
     // WiFi information
     if (wifiManager && wifiManager->isConnected()) {
@@ -126,45 +229,45 @@ void TestWebServer::handleRoot() {
             qualityColor = "#cc0000";
         }
         
-        html += "<div class='info'><span class='label'>WiFi Signal:</span><span class='value' style='color:" + qualityColor + ";'>";
-        html += quality + " (" + String(rssi) + " dBm)</span></div>";
+        out.print("<div class='info'><span class='label'>WiFi Signal:</span><span class='value' style='color:" + qualityColor + ";'>");
+        out.print(quality + " (" + String(rssi) + " dBm)</span></div>");
     }
     
     // Upload status
-    html += "<h2>Upload Status</h2>";
+    out.print("<h2>Upload Status</h2>");
     if (scheduleManager) {
         unsigned long secondsUntilNext = scheduleManager->getSecondsUntilNextUpload();
-        html += "<div class='info'><span class='label'>Next Upload In:</span><span class='value'>";
+        out.print("<div class='info'><span class='label'>Next Upload In:</span><span class='value'>");
         if (secondsUntilNext == 0) {
-            html += "Upload window active";
+            out.print("Upload window active");
         } else {
-            html += String(secondsUntilNext / 3600) + " hours, ";
-            html += String((secondsUntilNext % 3600) / 60) + " minutes";
+            out.print(String(secondsUntilNext / 3600) + " hours, ");
+            out.print(String((secondsUntilNext % 3600) / 60) + " minutes");
         }
-        html += "</span></div>";
-        html += "<div class='info'><span class='label'>Upload Time Synced:</span><span class='value'>";
-        html += scheduleManager->isTimeSynced() ? "Yes" : "No";
-        html += "</span></div>";
+        out.print("</span></div>");
+        out.print("<div class='info'><span class='label'>Upload Time Synced:</span><span class='value'>");
+        out.print(scheduleManager->isTimeSynced() ? "Yes" : "No");
+        out.print("</span></div>");
     } else {
-        html += "<div class='info'><span class='label'>Status:</span><span class='value'>Initializing...</span></div>";
+        out.print("<div class='info'><span class='label'>Status:</span><span class='value'>Initializing...</span></div>");
     }
     
     if (budgetManager) {
         unsigned long remainingBudget = budgetManager->getRemainingBudgetMs();
-        html += "<div class='info'><span class='label'>Time Budget Remaining:</span><span class='value'>";
+        out.print("<div class='info'><span class='label'>Time Budget Remaining:</span><span class='value'>");
         if (remainingBudget == 0) {
-            html += "No active session";
+            out.print("No active session");
         } else {
-            html += String(remainingBudget) + " ms";
+            out.print(String(remainingBudget) + " ms");
         }
-        html += "</span></div>";
+        out.print("</span></div>");
         
         unsigned long rate = budgetManager->getTransmissionRate();
         float rateKB = rate / 1024.0;
-        html += "<div class='info'><span class='label'>Transfer Rate:</span><span class='value'>";
-        html += String(rateKB, 1) + " KB/s (" + String(rate) + " B/s)</span></div>";
+        out.print("<div class='info'><span class='label'>Transfer Rate:</span><span class='value'>");
+        out.print(String(rateKB, 1) + " KB/s (" + String(rate) + " B/s)</span></div>");
     } else {
-        html += "<div class='info'><span class='label'>Budget:</span><span class='value'>Not initialized</span></div>";
+        out.print("<div class='info'><span class='label'>Budget:</span><span class='value'>Not initialized</span></div>");
     }
     
     // Upload progress
@@ -176,19 +279,19 @@ void TestWebServer::handleRoot() {
         
         if (totalFolders == 0) {
             // State not yet initialized (no upload session has run)
-            html += "<div class='info'><span class='label'>Upload Status:</span><span class='value'>";
-            html += "Not yet scanned (waiting for first upload window)</span></div>";
+            out.print("<div class='info'><span class='label'>Upload Status:</span><span class='value'>");
+            out.print("Not yet scanned (waiting for first upload window)</span></div>");
         } else {
-            html += "<div class='info'><span class='label'>Upload Progress:</span><span class='value'>";
+            out.print("<div class='info'><span class='label'>Upload Progress:</span><span class='value'>");
             if (pendingFolders > 0) {
-                html += String(completedFolders) + " / " + String(totalFolders) + " folders completed, " + String(pendingFolders) + " empty</span></div>";
+                out.print(String(completedFolders) + " / " + String(totalFolders) + " folders completed, " + String(pendingFolders) + " empty</span></div>");
             } else {
-                html += String(completedFolders) + " / " + String(totalFolders) + " folders completed</span></div>";
+                out.print(String(completedFolders) + " / " + String(totalFolders) + " folders completed</span></div>");
             }
             
             if (incompleteFolders > 0) {
-                html += "<div class='info'><span class='label'>Incomplete Folders:</span><span class='value'>";
-                html += String(incompleteFolders) + "</span></div>";
+                out.print("<div class='info'><span class='label'>Incomplete Folders:</span><span class='value'>");
+                out.print(String(incompleteFolders) + "</span></div>");
             }
         }
         
@@ -196,11 +299,11 @@ void TestWebServer::handleRoot() {
         String retryFolder = stateManager->getCurrentRetryFolder();
         if (!retryFolder.isEmpty()) {
             int retryCount = stateManager->getCurrentRetryCount();
-            html += "<div class='info'><span class='label'>Current Retry:</span><span class='value' style='color: #cc6600;'>";
-            html += "Folder " + retryFolder + " (attempt " + String(retryCount + 1) + ")</span></div>";
+            out.print("<div class='info'><span class='label'>Current Retry:</span><span class='value' style='color: #cc6600;'>");
+            out.print("Folder " + retryFolder + " (attempt " + String(retryCount + 1) + ")</span></div>");
         }
     } else {
-        html += "<div class='info'><span class='label'>Pending Folders:</span><span class='value'>Unknown</span></div>";
+        out.print("<div class='info'><span class='label'>Pending Folders:</span><span class='value'>Unknown</span></div>");
     }
     
     // Retry warning
@@ -210,11 +313,11 @@ void TestWebServer::handleRoot() {
             int retryCount = stateManager->getCurrentRetryCount();
             int maxRetries = config ? config->getMaxRetryAttempts() : 3;
             
-            html += "<h2 style='color: #cc6600;'>WARNING: Upload in Progress</h2>";
-            html += "<div style='background: #fff3cd; border: 1px solid #ffc107; padding: 15px; border-radius: 4px; margin: 10px 0;'>";
-            html += "<p><strong>Folder:</strong> " + retryFolder + "</p>";
-            html += "<p><strong>Attempt:</strong> " + String(retryCount + 1) + " of " + String(maxRetries) + "</p>";
-            html += "<p><strong>Reason:</strong> Upload session time budget exhausted before completing all files.</p>";
+            out.print("<h2 style='color: #cc6600;'>WARNING: Upload in Progress</h2>");
+            out.print("<div style='background: #fff3cd; border: 1px solid #ffc107; padding: 15px; border-radius: 4px; margin: 10px 0;'>");
+            out.print("<p><strong>Folder:</strong> " + retryFolder + "</p>");
+            out.print("<p><strong>Attempt:</strong> " + String(retryCount + 1) + " of " + String(maxRetries) + "</p>");
+            out.print("<p><strong>Reason:</strong> Upload session time budget exhausted before completing all files.</p>");
             
             // Show retry wait time if waiting
             if (budgetExhaustedRetry && nextUploadRetryTime > millis()) {
@@ -222,58 +325,58 @@ void TestWebServer::handleRoot() {
                 unsigned long remainingSeconds = remainingMs / 1000;
                 unsigned long remainingMinutes = remainingSeconds / 60;
                 
-                html += "<p><strong>Next Retry In:</strong> ";
+                out.print("<p><strong>Next Retry In:</strong> ");
                 if (remainingMinutes > 0) {
-                    html += String(remainingMinutes) + " minutes " + String(remainingSeconds % 60) + " seconds";
+                    out.print(String(remainingMinutes) + " minutes " + String(remainingSeconds % 60) + " seconds");
                 } else {
-                    html += String(remainingSeconds) + " seconds";
+                    out.print(String(remainingSeconds) + " seconds");
                 }
-                html += "</p>";
+                out.print("</p>");
             }
             
             if (retryCount >= 2) {
-                html += "<p style='color: #cc0000;'><strong>WARNING: Multiple retries detected!</strong></p>";
-                html += "<p>Consider increasing <code>SESSION_DURATION_SECONDS</code> in config.json if uploads consistently fail.</p>";
-                html += "<p>Current session duration: " + String(config ? config->getSessionDurationSeconds() : 0) + " seconds (active time)</p>";
+                out.print("<p style='color: #cc0000;'><strong>WARNING: Multiple retries detected!</strong></p>");
+                out.print("<p>Consider increasing <code>SESSION_DURATION_SECONDS</code> in config.json if uploads consistently fail.</p>");
+                out.print("<p>Current session duration: " + String(config ? config->getSessionDurationSeconds() : 0) + " seconds (active time)</p>");
             }
             
-            html += "</div>";
+            out.print("</div>");
         }
     }
 
 #ifdef ENABLE_CPAP_MONITOR
     // CPAP SD Card Usage Monitor
     if (cpapMonitor) {
-        html += "<h2>CPAP SD Card Usage (24 Hours)</h2>";
-        html += "<div class='info'><span class='label'>Monitoring Interval:</span><span class='value'>Every 10 minutes</span></div>";
+        out.print("<h2>CPAP SD Card Usage (24 Hours)</h2>");
+        out.print("<div class='info'><span class='label'>Monitoring Interval:</span><span class='value'>Every 10 minutes</span></div>");
         
         // Add the usage table
-        html += cpapMonitor->getUsageTableHTML();
+        out.print(cpapMonitor->getUsageTableHTML());
     }
 #endif //ENABLE_CPAP_MONITOR
 
     
     // Configuration
-    html += "<h2>Configuration</h2>";
+    out.print("<h2>Configuration</h2>");
     if (config) {
-        html += "<div class='info'><span class='label'>Endpoint Type:</span><span class='value'>" + config->getEndpointType() + "</span></div>";
-        html += "<div class='info'><span class='label'>Endpoint:</span><span class='value'>" + config->getEndpoint() + "</span></div>";
-        html += "<div class='info'><span class='label'>Upload Hour:</span><span class='value'>" + String(config->getUploadHour()) + ":00</span></div>";
-        html += "<div class='info'><span class='label'>Session Duration:</span><span class='value'>" + String(config->getSessionDurationSeconds()) + " seconds</span></div>";
+        out.print("<div class='info'><span class='label'>Endpoint Type:</span><span class='value'>" + config->getEndpointType() + "</span></div>");
+        out.print("<div class='info'><span class='label'>Endpoint:</span><span class='value'>" + config->getEndpoint() + "</span></div>");
+        out.print("<div class='info'><span class='label'>Upload Hour:</span><span class='value'>" + String(config->getUploadHour()) + ":00</span></div>");
+        out.print("<div class='info'><span class='label'>Session Duration:</span><span class='value'>" + String(config->getSessionDurationSeconds()) + " seconds</span></div>");
     }
     
     // Action buttons
-    html += "<h2>Actions</h2>";
-    html += "<a href='/trigger-upload' class='button'>Trigger Upload Now</a>";
-    html += "<a href='/scan-now' class='button'>Scan SD Card</a>";
-    html += "<a href='/status' class='button'>View JSON Status</a>";
-    html += "<a href='/config' class='button'>View Full Config</a>";
-    html += "<a href='/logs' class='button'>View System Logs</a>";
-    html += "<a href='/reset-state' class='button danger' onclick='return confirm(\"Are you sure you want to reset upload state?\")'>Reset Upload State</a>";
+    out.print("<h2>Actions</h2>");
+    out.print("<a href='/trigger-upload' class='button'>Trigger Upload Now</a>");
+    out.print("<a href='/scan-now' class='button'>Scan SD Card</a>");
+    out.print("<a href='/status' class='button'>View JSON Status</a>");
+    out.print("<a href='/config' class='button'>View Full Config</a>");
+    out.print("<a href='/logs' class='button'>View System Logs</a>");
+    out.print("<a href='/reset-state' class='button danger' onclick='return confirm(\"Are you sure you want to reset upload state?\")'>Reset Upload State</a>");
     
-    html += "</div></body></html>";
+    out.print("</div></body></html>");
     
-    server->send(200, "text/html", html);
+    out.end();
 }
 
 // GET /trigger-upload - Force immediate upload
@@ -315,28 +418,31 @@ void TestWebServer::handleStatus() {
     server->sendHeader("Access-Control-Allow-Methods", "GET, OPTIONS");
     server->sendHeader("Access-Control-Allow-Headers", "Content-Type");
     
-    String json = "{";
-    json += "\"uptime_seconds\":" + String(millis() / 1000) + ",";
-    json += "\"current_time\":\"" + getCurrentTimeString() + "\",";
-    json += "\"free_heap\":" + String(ESP.getFreeHeap()) + ",";
+    ResponseStream out(server);
+    out.begin(200, "application/json");
+    out.print("{");
+    out.print("\"uptime_seconds\":" + String(millis() / 1000) + ",");
+    out.print("\"current_time\":\"" + getCurrentTimeString() + "\",");
+    out.print("\"free_heap\":" + String(ESP.getFreeHeap()) + ",");
+    out.print("\"heap\":" + BufferPool::getInstance().getHeapReportJSON() + ",");
     
     // WiFi information
     if (wifiManager && wifiManager->isConnected()) {
-        json += "\"wifi_connected\":true,";
-        json += "\"wifi_rssi\":" + String(wifiManager->getSignalStrength()) + ",";
-        json += "\"wifi_quality\":\"" + wifiManager->getSignalQuality() + "\",";
+        out.print("\"wifi_connected\":true,");
+        out.print("\"wifi_rssi\":" + String(wifiManager->getSignalStrength()) + ",");
+        out.print("\"wifi_quality\":\"" + wifiManager->getSignalQuality() + "\",");
     } else {
-        json += "\"wifi_connected\":false,";
+        out.print("\"wifi_connected\":false,");
     }
     
     if (scheduleManager) {
-        json += "\"next_upload_seconds\":" + String(scheduleManager->getSecondsUntilNextUpload()) + ",";
-        json += "\"time_synced\":" + String(scheduleManager->isTimeSynced() ? "true" : "false") + ",";
+        out.print("\"next_upload_seconds\":" + String(scheduleManager->getSecondsUntilNextUpload()) + ",");
+        out.print("\"time_synced\":" + String(scheduleManager->isTimeSynced() ? "true" : "false") + ",");
     }
     
     if (budgetManager) {
-        json += "\"budget_remaining_ms\":" + String(budgetManager->getRemainingBudgetMs()) + ",";
-        json += "\"transfer_rate_bytes_per_sec\":" + String(budgetManager->getTransmissionRate()) + ",";
+        out.print("\"budget_remaining_ms\":" + String(budgetManager->getRemainingBudgetMs()) + ",");
+        out.print("\"transfer_rate_bytes_per_sec\":" + String(budgetManager->getTransmissionRate()) + ",");
     }
     
     // Upload progress and retry information
@@ -345,45 +451,45 @@ void TestWebServer::handleStatus() {
         int incompleteFolders = stateManager->getIncompleteFoldersCount();
         int totalFolders = completedFolders + incompleteFolders;
         
-        json += "\"completed_folders\":" + String(completedFolders) + ",";
-        json += "\"incomplete_folders\":" + String(incompleteFolders) + ",";
-        json += "\"total_folders\":" + String(totalFolders) + ",";
-        json += "\"upload_state_initialized\":" + String(totalFolders > 0 ? "true" : "false") + ",";
+        out.print("\"completed_folders\":" + String(completedFolders) + ",");
+        out.print("\"incomplete_folders\":" + String(incompleteFolders) + ",");
+        out.print("\"total_folders\":" + String(totalFolders) + ",");
+        out.print("\"upload_state_initialized\":" + String(totalFolders > 0 ? "true" : "false") + ",");
         
         String retryFolder = stateManager->getCurrentRetryFolder();
         if (!retryFolder.isEmpty()) {
             int retryCount = stateManager->getCurrentRetryCount();
-            json += "\"current_retry_folder\":\"" + retryFolder + "\",";
-            json += "\"current_retry_count\":" + String(retryCount);
+            out.print("\"current_retry_folder\":\"" + retryFolder + "\",");
+            out.print("\"current_retry_count\":" + String(retryCount));
         } else {
-            json += "\"current_retry_folder\":null,";
-            json += "\"current_retry_count\":0";
+            out.print("\"current_retry_folder\":null,");
+            out.print("\"current_retry_count\":0");
         }
     } else {
-        json += "\"completed_folders\":0,";
-        json += "\"incomplete_folders\":0,";
-        json += "\"total_folders\":0,";
-        json += "\"upload_state_initialized\":false,";
-        json += "\"current_retry_folder\":null,";
-        json += "\"current_retry_count\":0";
+        out.print("\"completed_folders\":0,");
+        out.print("\"incomplete_folders\":0,");
+        out.print("\"total_folders\":0,");
+        out.print("\"upload_state_initialized\":false,");
+        out.print("\"current_retry_folder\":null,");
+        out.print("\"current_retry_count\":0");
     }
     
     if (config) {
-        json += ",\"endpoint_type\":\"" + config->getEndpointType() + "\"";
-        json += ",\"upload_hour\":" + String(config->getUploadHour());
-        json += ",\"session_duration_seconds\":" + String(config->getSessionDurationSeconds());
-        json += ",\"max_retry_attempts\":" + String(config->getMaxRetryAttempts());
-        json += ",\"boot_delay_seconds\":" + String(config->getBootDelaySeconds());
-        json += ",\"sd_release_interval_seconds\":" + String(config->getSdReleaseIntervalSeconds());
+        out.print(",\"endpoint_type\":\"" + config->getEndpointType() + "\"");
+        out.print(",\"upload_hour\":" + String(config->getUploadHour()));
+        out.print(",\"session_duration_seconds\":" + String(config->getSessionDurationSeconds()));
+        out.print(",\"max_retry_attempts\":" + String(config->getMaxRetryAttempts()));
+        out.print(",\"boot_delay_seconds\":" + String(config->getBootDelaySeconds()));
+        out.print(",\"sd_release_interval_seconds\":" + String(config->getSdReleaseIntervalSeconds()));
     }
     
     // Add retry timing information
     if (budgetExhaustedRetry && nextUploadRetryTime > millis()) {
         unsigned long remainingMs = nextUploadRetryTime - millis();
-        json += ",\"retry_wait_active\":true";
-        json += ",\"retry_wait_remaining_seconds\":" + String(remainingMs / 1000);
+        out.print(",\"retry_wait_active\":true");
+        out.print(",\"retry_wait_remaining_seconds\":" + String(remainingMs / 1000));
     } else {
-        json += ",\"retry_wait_active\":false";
+        out.print(",\"retry_wait_active\":false");
     }
     
     // Add recommendations if retries are happening
@@ -391,30 +497,30 @@ void TestWebServer::handleStatus() {
         String retryFolder = stateManager->getCurrentRetryFolder();
         if (!retryFolder.isEmpty()) {
             int retryCount = stateManager->getCurrentRetryCount();
-            json += ",\"retry_warning\":true";
+            out.print(",\"retry_warning\":true");
             
             if (retryCount >= 2 && config) {
-                json += ",\"recommendation\":\"Consider increasing SESSION_DURATION_SECONDS (current: " + 
-                       String(config->getSessionDurationSeconds()) + "s)\"";
+                out.print(",\"recommendation\":\"Consider increasing SESSION_DURATION_SECONDS (current: " + 
+                       String(config->getSessionDurationSeconds()) + "s)\"");
             }
         } else {
-            json += ",\"retry_warning\":false";
+            out.print(",\"retry_warning\":false");
         }
     }
     
     // Add CPAP monitor data (without usage percentage)
     if (cpapMonitor) {
-        json += ",\"cpap_monitor\":{";
-        json += "\"interval_minutes\":10";
-        json += ",\"data_points\":144";
-        json += ",\"usage_data\":" + cpapMonitor->getUsageDataJSON();
-        json += "}";
+        out.print(",\"cpap_monitor\":{");
+        out.print("\"interval_minutes\":10");
+        out.print(",\"data_points\":144");
+        out.print(",\"usage_data\":" + cpapMonitor->getUsageDataJSON());
+        out.print("}");
     }
 
     
-    json += "}";
+    out.print("}");
     
-    server->send(200, "application/json", json);
+    out.end();
 }
 
 // GET /reset-state - Clear upload state
@@ -440,44 +546,46 @@ void TestWebServer::handleConfig() {
     server->sendHeader("Access-Control-Allow-Methods", "GET, OPTIONS");
     server->sendHeader("Access-Control-Allow-Headers", "Content-Type");
     
-    String json = "{";
+    ResponseStream out(server);
+    out.begin(200, "application/json");
+    out.print("{");
     
     if (config) {
         // Check if credentials are stored in secure mode
         bool credentialsSecured = config->areCredentialsInFlash();
         
-        json += "\"wifi_ssid\":\"" + config->getWifiSSID() + "\",";
+        out.print("\"wifi_ssid\":\"" + config->getWifiSSID() + "\",");
         
         // Return censored value for WiFi password if in secure mode
         if (credentialsSecured) {
-            json += "\"wifi_password\":\"***STORED_IN_FLASH***\",";
+            out.print("\"wifi_password\":\"***STORED_IN_FLASH***\",");
         } else {
-            json += "\"wifi_password\":\"" + config->getWifiPassword() + "\",";
+            out.print("\"wifi_password\":\"" + config->getWifiPassword() + "\",");
         }
         
-        json += "\"endpoint\":\"" + config->getEndpoint() + "\",";
-        json += "\"endpoint_type\":\"" + config->getEndpointType() + "\",";
-        json += "\"endpoint_user\":\"" + config->getEndpointUser() + "\",";
+        out.print("\"endpoint\":\"" + config->getEndpoint() + "\",");
+        out.print("\"endpoint_type\":\"" + config->getEndpointType() + "\",");
+        out.print("\"endpoint_user\":\"" + config->getEndpointUser() + "\",");
         
         // Return censored value for endpoint password if in secure mode
         if (credentialsSecured) {
-            json += "\"endpoint_password\":\"***STORED_IN_FLASH***\",";
+            out.print("\"endpoint_password\":\"***STORED_IN_FLASH***\",");
         } else {
-            json += "\"endpoint_password\":\"" + config->getEndpointPassword() + "\",";
+            out.print("\"endpoint_password\":\"" + config->getEndpointPassword() + "\",");
         }
         
-        json += "\"upload_hour\":" + String(config->getUploadHour()) + ",";
-        json += "\"session_duration_seconds\":" + String(config->getSessionDurationSeconds()) + ",";
-        json += "\"max_retry_attempts\":" + String(config->getMaxRetryAttempts()) + ",";
-        json += "\"gmt_offset_hours\":" + String(config->getGmtOffsetHours()) + ",";
+        out.print("\"upload_hour\":" + String(config->getUploadHour()) + ",");
+        out.print("\"session_duration_seconds\":" + String(config->getSessionDurationSeconds()) + ",");
+        out.print("\"max_retry_attempts\":" + String(config->getMaxRetryAttempts()) + ",");
+        out.print("\"gmt_offset_hours\":" + String(config->getGmtOffsetHours()) + ",");
         
         // Add credentials_secured field to indicate storage mode
-        json += "\"credentials_secured\":" + String(credentialsSecured ? "true" : "false");
+        out.print("\"credentials_secured\":" + String(credentialsSecured ? "true" : "false"));
     }
     
-    json += "}";
+    out.print("}");
     
-    server->send(200, "application/json", json);
+    out.end();
 }
 
 // Handle 404 errors
@@ -566,16 +674,20 @@ void TestWebServer::handleLogs() {
     // Retrieve logs from Logger
     Logger::LogData logData = Logger::getInstance().retrieveLogs();
     
-    // Build JSON response
-    String json = "{";
-    json += "\"status\":\"success\",";
-    json += "\"logs\":\"" + escapeJson(logData.content) + "\",";
-    json += "\"bytes_lost\":" + String(logData.bytesLost) + ",";
-    json += "\"bytes_returned\":" + String(logData.content.length()) + ",";
-    json += "\"timestamp\":\"" + getCurrentTimeString() + "\"";
-    json += "}";
-    
-    server->send(200, "application/json", json);
+    // Stream the JSON response, escaping the log text straight into the
+    // output buffer instead of building an escaped copy
+    ResponseStream out(server);
+    out.begin(200, "application/json");
+    out.print("{");
+    out.print("\"status\":\"success\",");
+    out.print("\"logs\":\"");
+    out.printJsonEscaped(logData.content.c_str(), logData.content.length());
+    out.print("\",");
+    out.print("\"bytes_lost\":" + String(logData.bytesLost) + ",");
+    out.print("\"bytes_returned\":" + String(logData.content.length()) + ",");
+    out.print("\"timestamp\":\"" + getCurrentTimeString() + "\"");
+    out.print("}");
+    out.end();
 }
 
 // Update manager references (needed after uploader recreation)
@@ -589,48 +701,3 @@ void TestWebServer::updateManagers(UploadStateManager* state, TimeBudgetManager*
 void TestWebServer::setWiFiManager(WiFiManager* wifi) {
     wifiManager = wifi;
 }
-
-// Helper: Escape special characters for JSON string
-String TestWebServer::escapeJson(const String& str) {
-    String escaped = "";
-    escaped.reserve(str.length() + 20);  // Reserve extra space for escape sequences
-    
-    for (size_t i = 0; i < str.length(); i++) {
-        char c = str.charAt(i);
-        switch (c) {
-            case '"':
-                escaped += "\\\"";
-                break;
-            case '\\':
-                escaped += "\\\\";
-                break;
-            case '\b':
-                escaped += "\\b";
-                break;
-            case '\f':
-                escaped += "\\f";
-                break;
-            case '\n':
-                escaped += "\\n";
-                break;
-            case '\r':
-                escaped += "\\r";
-                break;
-            case '\t':
-                escaped += "\\t";
-                break;
-            default:
-                // Handle control characters (0x00-0x1F)
-                if (c >= 0 && c < 0x20) {
-                    char buf[7];
-                    snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
-                    escaped += buf;
-                } else {
-                    escaped += c;
-                }
-                break;
-        }
-    }
-    
-    return escaped;
-}
@@ -12,10 +12,13 @@ TimeBudgetManager::TimeBudgetManager()
       isPaused(false),
       transmissionRateBytesPerSec(DEFAULT_RATE),
       rateHistoryIndex(0),
-      rateHistoryCount(0) {
-    // Initialize rate history array
+      rateHistoryCount(0),
+      compressedRateIndex(0),
+      compressedRateCount(0) {
+    // Initialize rate history arrays
     for (int i = 0; i < RATE_HISTORY_SIZE; i++) {
         rateHistory[i] = 0;
+        compressedRateHistory[i] = 0;
     }
 }
 
@@ -110,10 +113,20 @@ bool TimeBudgetManager::hasBudget() {
  * @return Estimated upload time in milliseconds
  */
 unsigned long TimeBudgetManager::estimateUploadTimeMs(unsigned long fileSize) {
+    return estimateTimeMs(fileSize, transmissionRateBytesPerSec);
+}
+
+/**
+ * Time to move a number of bytes at a rate
+ * @param bytes Byte count
+ * @param rateBytesPerSec Rate in bytes per second
+ * @return Time in milliseconds
+ */
+unsigned long TimeBudgetManager::estimateTimeMs(unsigned long bytes, unsigned long rateBytesPerSec) {
     // Calculate time = size / rate
     // Convert to milliseconds: (bytes / (bytes/sec)) * 1000
-    unsigned long estimatedSeconds = fileSize / transmissionRateBytesPerSec;
-    unsigned long remainderMs = ((fileSize % transmissionRateBytesPerSec) * 1000) / transmissionRateBytesPerSec;
+    unsigned long estimatedSeconds = bytes / rateBytesPerSec;
+    unsigned long remainderMs = ((bytes % rateBytesPerSec) * 1000) / rateBytesPerSec;
     
     return (estimatedSeconds * 1000) + remainderMs;
 }
@@ -136,6 +149,19 @@ bool TimeBudgetManager::canUploadFile(unsigned long fileSize) {
     return estimatedTime <= remainingBudget;
 }
 
+/**
+ * Estimate how many bytes can be sent in the remaining budget
+ * Used to size partial uploads of files too large for one session
+ * @return Bytes at the current transmission rate
+ */
+unsigned long TimeBudgetManager::estimateBytesInRemainingBudget() {
+    unsigned long remainingMs = getRemainingBudgetMs();
+    
+    // bytes = rate * ms / 1000, split to avoid overflow on long budgets
+    return (remainingMs / 1000) * transmissionRateBytesPerSec +
+           ((remainingMs % 1000) * transmissionRateBytesPerSec) / 1000;
+}
+
 /**
  * Record a completed upload to update transmission rate
  * @param fileSize Number of bytes transferred
@@ -195,6 +221,61 @@ unsigned long TimeBudgetManager::getTransmissionRate() {
     return transmissionRateBytesPerSec;
 }
 
+/**
+ * Record a completed compressed upload
+ * @param rawBytes Uncompressed bytes read from the SD card
+ * @param elapsedMs Time taken for compressing and sending, in milliseconds
+ */
+void TimeBudgetManager::recordCompressedUpload(unsigned long rawBytes, unsigned long elapsedMs) {
+    if (elapsedMs == 0) {
+        return; // Avoid division by zero
+    }
+    
+    compressedRateHistory[compressedRateIndex] = (rawBytes * 1000) / elapsedMs;
+    compressedRateIndex = (compressedRateIndex + 1) % RATE_HISTORY_SIZE;
+    
+    if (compressedRateCount < RATE_HISTORY_SIZE) {
+        compressedRateCount++;
+    }
+}
+
+/**
+ * Get the effective rate of compressed uploads
+ * Until one has been measured, compression is assumed to gain nothing.
+ * @return Raw bytes per second
+ */
+unsigned long TimeBudgetManager::getCompressedRate() {
+    if (compressedRateCount == 0) {
+        return transmissionRateBytesPerSec;
+    }
+    
+    unsigned long sum = 0;
+    for (int i = 0; i < compressedRateCount; i++) {
+        sum += compressedRateHistory[i];
+    }
+    
+    unsigned long rate = sum / compressedRateCount;
+    return rate > 0 ? rate : 1;
+}
+
+/**
+ * Estimate the time to compress and upload a file
+ * @param fileSize Uncompressed file size in bytes
+ * @return Estimated upload time in milliseconds
+ */
+unsigned long TimeBudgetManager::estimateCompressedUploadTimeMs(unsigned long fileSize) {
+    return estimateTimeMs(fileSize, getCompressedRate());
+}
+
+/**
+ * Check if a file can be compressed and uploaded within remaining budget
+ * @param fileSize Uncompressed file size in bytes
+ * @return true if file fits in budget, false otherwise
+ */
+bool TimeBudgetManager::canUploadCompressed(unsigned long fileSize) {
+    return estimateCompressedUploadTimeMs(fileSize) <= getRemainingBudgetMs();
+}
+
 /**
  * Get wait time before next session (5 minutes for retry attempts)
  * @return Wait time in milliseconds
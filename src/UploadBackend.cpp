@@ -0,0 +1,102 @@
+#include "UploadBackend.h"
+#include "Config.h"
+#include "Logger.h"
+
+#ifdef ENABLE_SMB_UPLOAD
+#include "SMBUploader.h"
+#endif
+
+#ifdef ENABLE_WEBDAV_UPLOAD
+#include "WebDAVUploader.h"
+#endif
+
+#ifdef ENABLE_SLEEPHQ_UPLOAD
+#include "SleepHQUploader.h"
+#endif
+
+#ifdef ENABLE_TCP_UPLOAD
+#include "TCPUploader.h"
+#endif
+
+#ifdef ENABLE_LOCAL_UPLOAD
+#include "LocalDirUploader.h"
+#endif
+
+bool UploadBackend::upload(const String& localPath, const String& remotePath,
+                           fs::FS &sd, unsigned long& bytesTransferred,
+                           unsigned long startOffset, unsigned long maxBytes) {
+    bytesTransferred = 0;
+    File localFile = sd.open(localPath, FILE_READ);
+    if (!localFile) {
+        LOGF("[%s] ERROR: Failed to open local file: %s", getName(), localPath.c_str());
+        return false;
+    }
+
+    bool success = uploadFile(localFile, localFile.size(), localPath, remotePath,
+                              bytesTransferred, startOffset, maxBytes);
+    localFile.close();
+    return success;
+}
+
+UploadBackendRegistry& UploadBackendRegistry::getInstance() {
+    static UploadBackendRegistry instance;
+    return instance;
+}
+
+// Backends selected by build flags
+UploadBackendRegistry::UploadBackendRegistry() {
+#ifdef ENABLE_SMB_UPLOAD
+    registerBackend("SMB", &SMBUploader::create);
+#endif
+#ifdef ENABLE_WEBDAV_UPLOAD
+    registerBackend("WEBDAV", &WebDAVUploader::create);
+#endif
+#ifdef ENABLE_SLEEPHQ_UPLOAD
+    registerBackend("SLEEPHQ", &SleepHQUploader::create);
+#endif
+#ifdef ENABLE_TCP_UPLOAD
+    registerBackend("TCP", &TCPUploader::create);
+#endif
+#ifdef ENABLE_LOCAL_UPLOAD
+    registerBackend("LOCAL", &LocalDirUploader::create);
+#endif
+}
+
+bool UploadBackendRegistry::registerBackend(const char* type, Factory factory) {
+    if (isRegistered(type)) {
+        LOGF("[Backend] WARNING: Endpoint type %s already registered", type);
+        return false;
+    }
+    Entry entry = {type, factory};
+    entries.push_back(entry);
+    return true;
+}
+
+UploadBackend* UploadBackendRegistry::create(const EndpointConfig& endpoint, const Config& config) const {
+    for (const Entry& entry : entries) {
+        if (endpoint.type == entry.type) {
+            return entry.factory(config, endpoint);
+        }
+    }
+    return nullptr;
+}
+
+bool UploadBackendRegistry::isRegistered(const String& type) const {
+    for (const Entry& entry : entries) {
+        if (type == entry.type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+String UploadBackendRegistry::getTypes() const {
+    String types;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i > 0) {
+            types += ", ";
+        }
+        types += entries[i].type;
+    }
+    return types;
+}
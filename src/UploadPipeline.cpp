@@ -0,0 +1,308 @@
+#include "UploadPipeline.h"
+#include "Logger.h"
+#include "BufferPool.h"
+#include "Md5Digest.h"
+
+// Stack size for the SD reader task (bytes)
+#define PIPELINE_READER_STACK_SIZE 4096
+
+UploadPipeline::UploadPipeline(size_t bufferSize, int bufferCount)
+    : bufferSize(bufferSize),
+      bufferCount(bufferCount),
+      readerStalls(0),
+      writerStalls(0),
+      maxInFlight(0),
+      digest(nullptr)
+#ifndef UNIT_TEST
+      , readerSource(nullptr),
+      readerRemaining(0),
+      abortRequested(false),
+      freeQueue(nullptr),
+      filledQueue(nullptr),
+      readerDone(nullptr)
+#endif
+{
+    if (this->bufferCount < 1) {
+        this->bufferCount = 1;
+    }
+    if (this->bufferCount > MAX_BUFFERS) {
+        this->bufferCount = MAX_BUFFERS;
+    }
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        buffers[i] = nullptr;
+    }
+}
+
+UploadPipeline::~UploadPipeline() {
+    end();
+}
+
+bool UploadPipeline::begin() {
+    for (int i = 0; i < bufferCount; i++) {
+        if (buffers[i] != nullptr) {
+            continue;  // Already allocated
+        }
+        buffers[i] = BufferPool::getInstance().acquire(bufferSize);
+        if (buffers[i] == nullptr) {
+            LOGF("[UploadPipeline] ERROR: Failed to allocate buffer %d of %d (%u bytes)",
+                 i + 1, bufferCount, bufferSize);
+            LOG("[UploadPipeline] System may be low on memory");
+            end();
+            return false;
+        }
+    }
+    return true;
+}
+
+void UploadPipeline::end() {
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (buffers[i] != nullptr) {
+            BufferPool::getInstance().release(buffers[i]);
+            buffers[i] = nullptr;
+        }
+    }
+}
+
+void UploadPipeline::resetStats() {
+    readerStalls = 0;
+    writerStalls = 0;
+    maxInFlight = 0;
+}
+
+bool UploadPipeline::run(fs::File& source, size_t bytesToRead, UploadSink& sink,
+                         unsigned long& bytesTransferred) {
+    FileUploadSource fileSource(source);
+    return run(fileSource, bytesToRead, sink, bytesTransferred);
+}
+
+#ifdef UNIT_TEST
+
+// Native build: drive the ring cooperatively on the calling thread.
+// The reader fills slots until the ring is full (backpressure) or the
+// requested bytes are exhausted, then the writer drains the oldest slot.
+bool UploadPipeline::run(UploadSource& source, size_t bytesToRead, UploadSink& sink,
+                         unsigned long& bytesTransferred) {
+    bytesTransferred = 0;
+    resetStats();
+
+    if (buffers[0] == nullptr) {
+        LOG("[UploadPipeline] ERROR: run() called before begin()");
+        return false;
+    }
+
+    size_t lengths[MAX_BUFFERS];
+    int head = 0;    // Oldest filled slot
+    int filled = 0;  // Number of filled slots
+    size_t remaining = bytesToRead;
+    bool toEnd = (bytesToRead == STREAM_TO_END);
+    bool readError = false;
+
+    while (true) {
+        // Reader: fill free slots in ring order
+        while (remaining > 0 && !readError) {
+            if (filled == bufferCount) {
+                readerStalls++;  // Ring full - wait for the writer
+                break;
+            }
+            int slot = (head + filled) % bufferCount;
+            size_t toRead = remaining < bufferSize ? remaining : bufferSize;
+            size_t bytesRead = source.read(buffers[slot], toRead);
+            if (bytesRead == 0) {
+                if (toEnd) {
+                    remaining = 0;  // Source finished
+                } else {
+                    readError = true;
+                }
+                break;
+            }
+            if (digest != nullptr) {
+                digest->update(buffers[slot], bytesRead);
+            }
+            lengths[slot] = bytesRead;
+            if (!toEnd) {
+                remaining -= bytesRead;
+            }
+            filled++;
+            if (filled > maxInFlight) {
+                maxInFlight = filled;
+            }
+        }
+
+        if (filled == 0) {
+            break;  // Nothing left to write
+        }
+
+        // Writer: drain the oldest slot
+        if (!sink.write(buffers[head], lengths[head])) {
+            return false;
+        }
+        bytesTransferred += lengths[head];
+        head = (head + 1) % bufferCount;
+        filled--;
+
+        yield();
+    }
+
+    if (readError) {
+        LOGF("[UploadPipeline] ERROR: Unexpected end of file, read %lu of %u bytes",
+             (unsigned long)(bytesToRead - remaining), bytesToRead);
+        LOG("[UploadPipeline] SD card may have read errors");
+        return false;
+    }
+
+    return true;
+}
+
+#else
+
+void UploadPipeline::readerTask(void* arg) {
+    static_cast<UploadPipeline*>(arg)->readerLoop();
+    vTaskDelete(NULL);
+}
+
+void UploadPipeline::readerLoop() {
+    bool readError = false;
+    bool toEnd = (readerRemaining == STREAM_TO_END);
+
+    while (readerRemaining > 0 && !abortRequested) {
+        int16_t slot;
+        if (uxQueueMessagesWaiting(freeQueue) == 0) {
+            readerStalls++;  // Ring full - block until the writer returns a slot
+        }
+        xQueueReceive(freeQueue, &slot, portMAX_DELAY);
+        if (abortRequested) {
+            break;
+        }
+
+        size_t toRead = readerRemaining < bufferSize ? readerRemaining : bufferSize;
+        size_t bytesRead = readerSource->read(buffers[slot], toRead);
+        if (bytesRead == 0) {
+            readError = !toEnd;
+            break;
+        }
+        // Hash here, off the network task, while the slot is still hot
+        if (digest != nullptr) {
+            digest->update(buffers[slot], bytesRead);
+        }
+        if (!toEnd) {
+            readerRemaining -= bytesRead;
+        }
+
+        Chunk chunk;
+        chunk.index = slot;
+        chunk.length = bytesRead;
+        xQueueSend(filledQueue, &chunk, portMAX_DELAY);
+    }
+
+    // End-of-stream marker (filledQueue has one spare slot, so this never blocks)
+    Chunk end;
+    end.index = -1;
+    end.length = readError ? -1 : 0;
+    xQueueSend(filledQueue, &end, portMAX_DELAY);
+
+    xSemaphoreGive(readerDone);
+}
+
+bool UploadPipeline::run(UploadSource& source, size_t bytesToRead, UploadSink& sink,
+                         unsigned long& bytesTransferred) {
+    bytesTransferred = 0;
+    resetStats();
+
+    if (buffers[0] == nullptr) {
+        LOG("[UploadPipeline] ERROR: run() called before begin()");
+        return false;
+    }
+
+    freeQueue = xQueueCreate(bufferCount, sizeof(int16_t));
+    filledQueue = xQueueCreate(bufferCount + 1, sizeof(Chunk));
+    readerDone = xSemaphoreCreateBinary();
+    if (freeQueue == nullptr || filledQueue == nullptr || readerDone == nullptr) {
+        LOG("[UploadPipeline] ERROR: Failed to create pipeline queues");
+        if (freeQueue) vQueueDelete(freeQueue);
+        if (filledQueue) vQueueDelete(filledQueue);
+        if (readerDone) vSemaphoreDelete(readerDone);
+        freeQueue = filledQueue = nullptr;
+        readerDone = nullptr;
+        return false;
+    }
+
+    for (int16_t i = 0; i < bufferCount; i++) {
+        xQueueSend(freeQueue, &i, 0);
+    }
+
+    readerSource = &source;
+    readerRemaining = bytesToRead;
+    abortRequested = false;
+
+    BaseType_t created = xTaskCreatePinnedToCore(readerTask, "sd_reader",
+                                                 PIPELINE_READER_STACK_SIZE, this,
+                                                 uxTaskPriorityGet(NULL), NULL,
+                                                 UPLOAD_PIPELINE_READER_CORE);
+    if (created != pdPASS) {
+        LOG("[UploadPipeline] ERROR: Failed to start SD reader task");
+        vQueueDelete(freeQueue);
+        vQueueDelete(filledQueue);
+        vSemaphoreDelete(readerDone);
+        freeQueue = filledQueue = nullptr;
+        readerDone = nullptr;
+        return false;
+    }
+
+    bool sinkOk = true;
+    bool readError = false;
+
+    // Writer: drain filled slots in order until the end-of-stream marker.
+    // After a sink failure we keep returning slots so the reader can reach
+    // the end marker and exit cleanly.
+    while (true) {
+        Chunk chunk;
+        if (uxQueueMessagesWaiting(filledQueue) == 0) {
+            writerStalls++;  // SD bound - wait for the reader
+        }
+        xQueueReceive(filledQueue, &chunk, portMAX_DELAY);
+
+        if (chunk.index < 0) {
+            readError = (chunk.length < 0);
+            break;
+        }
+
+        int inFlight = uxQueueMessagesWaiting(filledQueue) + 1;
+        if (inFlight > maxInFlight) {
+            maxInFlight = inFlight;
+        }
+
+        if (sinkOk) {
+            if (sink.write(buffers[chunk.index], chunk.length)) {
+                bytesTransferred += chunk.length;
+            } else {
+                sinkOk = false;
+                abortRequested = true;
+            }
+        }
+
+        xQueueSend(freeQueue, &chunk.index, portMAX_DELAY);
+    }
+
+    xSemaphoreTake(readerDone, portMAX_DELAY);
+
+    vQueueDelete(freeQueue);
+    vQueueDelete(filledQueue);
+    vSemaphoreDelete(readerDone);
+    freeQueue = filledQueue = nullptr;
+    readerDone = nullptr;
+    readerSource = nullptr;
+
+    if (readError) {
+        LOGF("[UploadPipeline] ERROR: Unexpected end of file, read %lu of %u bytes",
+             (unsigned long)(bytesToRead - readerRemaining), bytesToRead);
+        LOG("[UploadPipeline] SD card may have read errors");
+        return false;
+    }
+
+    LOG_DEBUGF("[UploadPipeline] Reader stalls: %lu, writer stalls: %lu, peak in flight: %d/%d",
+               readerStalls, writerStalls, maxInFlight, bufferCount);
+
+    return sinkOk;
+}
+
+#endif // UNIT_TEST
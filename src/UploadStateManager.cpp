@@ -1,40 +1,188 @@
 #include "UploadStateManager.h"
 #include "Logger.h"
 #include <ArduinoJson.h>
+#include "BufferPool.h"
 
-#ifdef UNIT_TEST
-#include "MockMD5.h"
-#else
-#include "esp32/rom/md5_hash.h"
-#endif
+#include "Md5Digest.h"
+#include "Crc32.h"
+#include "ByteOrder.h"
+
+#include <algorithm>
+
+// Binary state file layout (little endian)
+// Header: "USTB", u16 version, u16 short record size, u16 path record
+// size, u16 reserved, u32 CRC-32 of the first 12 bytes.
+// Short record (session, folder): u8 type, u8 flags, u16 c, u32 a, u32 b, u32 CRC.
+// Path record (file, growing file, checkpoint): u8 type, u8 flags, u16 0,
+// u32 a, u32 b, char text[32], char path[64], u32 CRC. Text and path are
+// NUL padded. The CRC covers the bytes before it.
+static const uint8_t STATE_MAGIC[4] = {'U', 'S', 'T', 'B'};
+static const uint16_t STATE_FORMAT_VERSION = 2;  // 1 was the JSON file
+static const size_t STATE_HEADER_SIZE = 16;
+static const size_t SHORT_RECORD_SIZE = 16;
+static const size_t PATH_RECORD_SIZE = 112;
+static const size_t RECORD_TEXT_OFFSET = 12;
+static const size_t RECORD_TEXT_SIZE = 32;
+static const size_t RECORD_PATH_OFFSET = 44;
+static const size_t RECORD_PATH_SIZE = 64;
 
-UploadStateManager::UploadStateManager() 
-    : stateFilePath("/.upload_state.json"),
+enum StateRecordType {
+    RECORD_SESSION = 1,      // flags: reconcile pending; a: last upload, b: retry folder, c: retry count
+    RECORD_FOLDER = 2,       // flags: FOLDER_*; a: YYYYMMDD, b: first seen empty
+    RECORD_FILE = 16,        // flags: FILE_*; a: size, b: last write; text: checksum
+    RECORD_APPEND = 17,      // flags: 1 = present; a: uploaded length; text: tail hash
+    RECORD_CHECKPOINT = 18   // flags: 1 = present; a: file size, b: committed bytes
+};
+
+enum {
+    FOLDER_NONE = 0,
+    FOLDER_COMPLETED = 1,
+    FOLDER_PENDING = 2
+};
+
+enum {
+    FILE_HAS_CHECKSUM = 1,
+    FILE_HAS_STAT = 2
+};
+
+// Record size for a type byte (0 = unknown type)
+static size_t recordSize(uint8_t type) {
+    switch (type) {
+        case RECORD_SESSION:
+        case RECORD_FOLDER:
+            return SHORT_RECORD_SIZE;
+        case RECORD_FILE:
+        case RECORD_APPEND:
+        case RECORD_CHECKPOINT:
+            return PATH_RECORD_SIZE;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t recordCrc(const uint8_t* record, size_t size) {
+    return Crc32::compute(0, record, size - 4);
+}
+
+static void sealRecord(uint8_t* record) {
+    size_t size = recordSize(record[0]);
+    putLE32(record + size - 4, recordCrc(record, size));
+}
+
+// NUL-padded text field; false if the value does not fit
+static bool putField(uint8_t* field, size_t width, const String& value) {
+    if (value.length() > width) {
+        return false;
+    }
+    memset(field, 0, width);
+    memcpy(field, value.c_str(), value.length());
+    return true;
+}
+
+static String getField(const uint8_t* field, size_t width) {
+    char buffer[RECORD_PATH_SIZE + 1];
+    memcpy(buffer, field, width);
+    buffer[width] = '\0';
+    return String(buffer);
+}
+
+static void beginRecord(uint8_t* record, uint8_t type, uint8_t flags, uint32_t a, uint32_t b) {
+    memset(record, 0, recordSize(type));
+    record[0] = type;
+    record[1] = flags;
+    putLE32(record + 4, a);
+    putLE32(record + 8, b);
+}
+
+UploadStateManager::UploadStateManager(const String& path) 
+    : stateFilePath(path),
       lastUploadTimestamp(0),
       currentRetryCount(0),
-      totalFoldersCount(0) {
+      totalFoldersCount(0),
+      checkpointSize(0),
+      checkpointCommitted(0),
+      reconcilePending(false),
+      savedSessionCrc(0),
+      savedCheckpointCrc(0),
+      journalRecords(0),
+      rewriteNeeded(true) {
+    int extension = path.lastIndexOf('.');
+    legacyFilePath = (extension > 0 ? path.substring(0, extension) : path) + ".json";
 }
 
 bool UploadStateManager::begin(fs::FS &sd) {
     LOG("[UploadStateManager] Initializing...");
     
-    // Try to load existing state
-    if (!loadState(sd)) {
+    // Binary state first; a JSON file of earlier firmware is migrated once
+    bool loaded = loadState(sd);
+    if (!loaded && sd.exists(legacyFilePath)) {
+        loaded = loadLegacyState(sd);
+        if (loaded) {
+            LOGF("[UploadStateManager] Migrating %s to %s", legacyFilePath.c_str(), stateFilePath.c_str());
+            if (writeStateFile(sd)) {
+                sd.remove(legacyFilePath);
+            } else {
+                LOG_WARN("[UploadStateManager] Migration failed, will retry at next start");
+            }
+        }
+    }
+    
+    if (loaded) {
+        LOG("[UploadStateManager] State file loaded successfully");
+        LOG_DEBUGF("[UploadStateManager]   Tracked files: %u", fileChecksums.size());
+        LOG_DEBUGF("[UploadStateManager]   Completed folders: %u", completedDatalogFolders.size());
+        LOG_DEBUGF("[UploadStateManager]   Pending folders: %u", pendingDatalogFolders.size());
+        if (!currentRetryFolder.isEmpty()) {
+            LOG_DEBUGF("[UploadStateManager]   Current retry folder: %s (attempt %d)", 
+                 currentRetryFolder.c_str(), currentRetryCount);
+        }
+        if (!checkpointPath.isEmpty()) {
+            LOG_DEBUGF("[UploadStateManager]   Resume checkpoint: %s at %lu of %lu bytes", 
+                 checkpointPath.c_str(), checkpointCommitted, checkpointSize);
+        }
+        if (reconcilePending) {
+            LOG_DEBUG("[UploadStateManager]   Remote reconcile pending");
+        }
+    } else {
         LOG("[UploadStateManager] WARNING: No existing state file or failed to load");
         LOG("[UploadStateManager] Starting with empty state - all files will be considered new");
         
         // Initialize with empty state - this is safe and allows operation to continue
-        fileChecksums.clear();
-        completedDatalogFolders.clear();
-        pendingDatalogFolders.clear();
-        currentRetryFolder = "";
-        currentRetryCount = 0;
-        lastUploadTimestamp = 0;
+        clearState();
+        
+        // Anything already on the server must be matched up before re-uploading
+        reconcilePending = true;
     }
     
     return true;  // Always return true - we can operate with empty state
 }
 
+void UploadStateManager::clearState() {
+    fileChecksums.clear();
+    fileStats.clear();
+    appendLengths.clear();
+    appendTails.clear();
+    completedDatalogFolders.clear();
+    pendingDatalogFolders.clear();
+    currentRetryFolder = "";
+    currentRetryCount = 0;
+    lastUploadTimestamp = 0;
+    clearUploadCheckpoint();
+    reconcilePending = false;
+    
+    dirtyFiles.clear();
+    dirtyAppends.clear();
+    dirtyFolders.clear();
+    journalRecords = 0;
+    rewriteNeeded = true;
+}
+
+uint8_t* UploadStateManager::acquireReadBuffer(size_t& size) {
+    BufferPool& pool = BufferPool::getInstance();
+    size = pool.isActive() ? pool.getSlotSize() : CHECKSUM_READ_SIZE;
+    return pool.acquire(size);
+}
+
 String UploadStateManager::calculateChecksum(fs::FS &sd, const String& filePath) {
     File file = sd.open(filePath, FILE_READ);
     if (!file) {
@@ -49,11 +197,16 @@ String UploadStateManager::calculateChecksum(fs::FS &sd, const String& filePath)
         return "";
     }
     
-    struct MD5Context md5_ctx;
-    MD5Init(&md5_ctx);
+    // Borrow a transfer buffer: large reads are much faster on SD_MMC
+    size_t bufferSize;
+    uint8_t* buffer = acquireReadBuffer(bufferSize);
+    if (buffer == nullptr) {
+        LOGF("[UploadStateManager] ERROR: No buffer for checksum of: %s", filePath.c_str());
+        file.close();
+        return "";
+    }
     
-    const size_t bufferSize = 512;
-    uint8_t buffer[bufferSize];
+    Md5Digest digest;
     size_t totalBytesRead = 0;
     size_t expectedSize = file.size();
     
@@ -62,39 +215,29 @@ String UploadStateManager::calculateChecksum(fs::FS &sd, const String& filePath)
         if (bytesRead == 0) {
             // Read error
             LOGF("[UploadStateManager] ERROR: Read error while calculating checksum for: %s", filePath.c_str());
+            BufferPool::getInstance().release(buffer);
             file.close();
             return "";
         }
         
-        MD5Update(&md5_ctx, buffer, bytesRead);
+        digest.update(buffer, bytesRead);
         totalBytesRead += bytesRead;
         
-        // Yield periodically to prevent watchdog timeout on large files
-        if (totalBytesRead % (10 * bufferSize) == 0) {
-            yield();
-        }
+        // Yield between reads to prevent watchdog timeout on large files
+        yield();
     }
     
+    BufferPool::getInstance().release(buffer);
+    
     // Verify we read the expected amount
     if (totalBytesRead != expectedSize) {
         LOG_DEBUGF("[UploadStateManager] WARNING: Checksum size mismatch for %s (read %u bytes, expected %u bytes)", 
              filePath.c_str(), totalBytesRead, expectedSize);
     }
     
-    uint8_t hash[16];
-    MD5Final(hash, &md5_ctx);
-    
     file.close();
     
-    // Convert hash to hex string
-    String checksumStr = "";
-    for (int i = 0; i < 16; i++) {
-        char hex[3];
-        sprintf(hex, "%02x", hash[i]);
-        checksumStr += hex;
-    }
-    
-    return checksumStr;
+    return digest.finishHex();
 }
 
 bool UploadStateManager::hasFileChanged(fs::FS &sd, const String& filePath) {
@@ -118,17 +261,220 @@ bool UploadStateManager::hasFileChanged(fs::FS &sd, const String& filePath) {
 
 void UploadStateManager::markFileUploaded(const String& filePath, const String& checksum) {
     fileChecksums[filePath] = checksum;
+    fileStats.erase(filePath);
+    dirtyFiles.insert(filePath);
+}
+
+void UploadStateManager::markFileUploaded(const String& filePath, const String& checksum,
+                                          unsigned long size, time_t lastWrite) {
+    fileChecksums[filePath] = checksum;
+    if (lastWrite > 0 && !checksum.isEmpty()) {
+        fileStats[filePath] = formatStat(size, lastWrite);
+    } else {
+        fileStats.erase(filePath);
+    }
+    dirtyFiles.insert(filePath);
+}
+
+String UploadStateManager::formatStat(unsigned long size, time_t lastWrite) {
+    char stat[32];
+    snprintf(stat, sizeof(stat), "%lu:%lu", size, (unsigned long)lastWrite);
+    return String(stat);
+}
+
+bool UploadStateManager::hasFileChangedQuick(fs::FS &sd, const String& filePath) {
+    File file = sd.open(filePath, FILE_READ);
+    if (!file) {
+        return false;  // Same as hasFileChanged(): unreadable files are not uploaded
+    }
+    unsigned long size = file.size();
+    time_t lastWrite = file.getLastWrite();
+    file.close();
+    
+    // Without a timestamp size alone cannot tell a rewrite apart (the .crc
+    // files never change size), so fall back to reading the whole file
+    if (lastWrite <= 0) {
+        return hasFileChanged(sd, filePath);
+    }
+    
+    String stat = formatStat(size, lastWrite);
+    auto it = fileStats.find(filePath);
+    if (it != fileStats.end()) {
+        return it->second != stat;
+    }
+    
+    // Checksum recorded by an older firmware without the stat: verify once
+    // by content and adopt the current stat if it still matches
+    if (hasFileChanged(sd, filePath)) {
+        return true;
+    }
+    fileStats[filePath] = stat;
+    dirtyFiles.insert(filePath);
+    return false;
+}
+
+String UploadStateManager::calculateTailHash(fs::FS &sd, const String& filePath, unsigned long length) {
+    File file = sd.open(filePath, FILE_READ);
+    if (!file) {
+        return "";
+    }
+    
+    unsigned long windowStart = length > APPEND_TAIL_WINDOW ? length - APPEND_TAIL_WINDOW : 0;
+    if (file.size() < length || !file.seek(windowStart)) {
+        file.close();
+        return "";
+    }
+    
+    size_t bufferSize;
+    uint8_t* buffer = acquireReadBuffer(bufferSize);
+    if (buffer == nullptr) {
+        file.close();
+        return "";
+    }
+    
+    Md5Digest digest;
+    unsigned long remaining = length - windowStart;
+    
+    while (remaining > 0) {
+        size_t toRead = remaining < bufferSize ? remaining : bufferSize;
+        size_t bytesRead = file.read(buffer, toRead);
+        if (bytesRead == 0) {
+            LOGF("[UploadStateManager] ERROR: Read error while hashing tail of: %s", filePath.c_str());
+            BufferPool::getInstance().release(buffer);
+            file.close();
+            return "";
+        }
+        digest.update(buffer, bytesRead);
+        remaining -= bytesRead;
+    }
+    
+    BufferPool::getInstance().release(buffer);
+    
+    file.close();
+    
+    return digest.finishHex();
+}
+
+UploadStateManager::AppendStatus UploadStateManager::checkAppend(fs::FS &sd, const String& filePath,
+                                                                 unsigned long currentSize,
+                                                                 unsigned long& appendOffset) {
+    appendOffset = 0;
+    
+    auto lengthIt = appendLengths.find(filePath);
+    auto tailIt = appendTails.find(filePath);
+    if (lengthIt == appendLengths.end() || tailIt == appendTails.end()) {
+        return APPEND_REPLACED;  // Never uploaded in append mode
+    }
+    
+    unsigned long uploadedLength = lengthIt->second;
+    if (uploadedLength == 0 || currentSize < uploadedLength) {
+        return APPEND_REPLACED;  // Shrunk - file was recreated
+    }
+    
+    // Only the tail window is re-read, not the whole prefix
+    String tail = calculateTailHash(sd, filePath, uploadedLength);
+    if (tail.isEmpty() || tail != tailIt->second) {
+        LOG_DEBUGF("[UploadStateManager] Tail changed, full upload needed: %s", filePath.c_str());
+        return APPEND_REPLACED;
+    }
+    
+    if (currentSize == uploadedLength) {
+        return APPEND_UNCHANGED;
+    }
+    
+    appendOffset = uploadedLength;
+    return APPEND_GROWN;
+}
+
+void UploadStateManager::recordUploadedLength(fs::FS &sd, const String& filePath, unsigned long length) {
+    String tail = calculateTailHash(sd, filePath, length);
+    if (tail.isEmpty()) {
+        clearUploadedLength(filePath);
+        return;
+    }
+    appendLengths[filePath] = length;
+    appendTails[filePath] = tail;
+    dirtyAppends.insert(filePath);
+}
+
+void UploadStateManager::clearUploadedLength(const String& filePath) {
+    if (appendLengths.erase(filePath) + appendTails.erase(filePath) > 0) {
+        dirtyAppends.insert(filePath);
+    }
+}
+
+uint32_t UploadStateManager::packFolderName(const String& folderName) {
+    if (folderName.length() != 8) {
+        return 0;
+    }
+    uint32_t date = 0;
+    for (int i = 0; i < 8; i++) {
+        char c = folderName.c_str()[i];
+        if (c < '0' || c > '9') {
+            return 0;
+        }
+        date = date * 10 + (c - '0');
+    }
+    return isFolderDate(date) ? date : 0;
+}
+
+bool UploadStateManager::formatFolderName(uint32_t date, char* name) {
+    name[0] = '\0';
+    if (!isFolderDate(date)) {
+        return false;
+    }
+    char buffer[12];
+    if (snprintf(buffer, sizeof(buffer), "%08lu", (unsigned long)date) != 8) {
+        return false;
+    }
+    memcpy(name, buffer, 9);
+    return true;
+}
+
+void UploadStateManager::insertCompletedFolder(uint32_t date) {
+    auto it = std::lower_bound(completedDatalogFolders.begin(), completedDatalogFolders.end(), date);
+    if (it == completedDatalogFolders.end() || *it != date) {
+        completedDatalogFolders.insert(it, date);
+    }
+}
+
+std::vector<UploadStateManager::PendingFolder>::iterator UploadStateManager::findPendingFolder(uint32_t date) {
+    auto it = std::lower_bound(pendingDatalogFolders.begin(), pendingDatalogFolders.end(), date);
+    if (it != pendingDatalogFolders.end() && it->date == date) {
+        return it;
+    }
+    return pendingDatalogFolders.end();
 }
 
 bool UploadStateManager::isFolderCompleted(const String& folderName) {
-    return completedDatalogFolders.find(folderName) != completedDatalogFolders.end();
+    uint32_t date = packFolderName(folderName);
+    return date != 0 && std::binary_search(completedDatalogFolders.begin(), completedDatalogFolders.end(), date);
 }
 
 void UploadStateManager::markFolderCompleted(const String& folderName) {
-    completedDatalogFolders.insert(folderName);
+    uint32_t date = packFolderName(folderName);
+    if (date == 0) {
+        LOG_WARNF("[UploadStateManager] Not a DATALOG folder name: %s", folderName.c_str());
+        return;
+    }
+    insertCompletedFolder(date);
+    dirtyFolders.push_back(date);
+    openFolders.erase(date);
+    
+    // Completed folders are never revisited, so drop their append records
+    String prefix = String("/DATALOG/") + folderName + "/";
+    for (auto it = appendLengths.begin(); it != appendLengths.end();) {
+        if (it->first.startsWith(prefix)) {
+            dirtyAppends.insert(it->first);
+            appendTails.erase(it->first);
+            it = appendLengths.erase(it);
+        } else {
+            ++it;
+        }
+    }
     
     // Remove from pending state if it was pending
-    auto pendingIt = pendingDatalogFolders.find(folderName);
+    auto pendingIt = findPendingFolder(date);
     if (pendingIt != pendingDatalogFolders.end()) {
         pendingDatalogFolders.erase(pendingIt);
         LOG_DEBUGF("[UploadStateManager] Removed folder from pending state: %s", folderName.c_str());
@@ -169,46 +515,73 @@ int UploadStateManager::getIncompleteFoldersCount() const {
     if (totalFoldersCount == 0) {
         return 0;  // Not yet scanned
     }
-    return totalFoldersCount - completedDatalogFolders.size() - pendingDatalogFolders.size();
+    return totalFoldersCount - completedDatalogFolders.size() - pendingDatalogFolders.size() - openFolders.size();
 }
 
 void UploadStateManager::setTotalFoldersCount(int count) {
     totalFoldersCount = count;
 }
 
+void UploadStateManager::markFolderOpen(const String& folderName) {
+    uint32_t date = packFolderName(folderName);
+    if (date == 0) {
+        LOG_WARNF("[UploadStateManager] Not a DATALOG folder name: %s", folderName.c_str());
+        return;
+    }
+    openFolders.insert(date);
+}
+
+void UploadStateManager::clearOpenFolders() {
+    openFolders.clear();
+}
+
 bool UploadStateManager::isPendingFolder(const String& folderName) {
-    return pendingDatalogFolders.find(folderName) != pendingDatalogFolders.end();
+    return findPendingFolder(packFolderName(folderName)) != pendingDatalogFolders.end();
 }
 
 void UploadStateManager::markFolderPending(const String& folderName, unsigned long timestamp) {
-    pendingDatalogFolders[folderName] = timestamp;
+    uint32_t date = packFolderName(folderName);
+    if (date == 0) {
+        LOG_WARNF("[UploadStateManager] Not a DATALOG folder name: %s", folderName.c_str());
+        return;
+    }
+    auto it = std::lower_bound(pendingDatalogFolders.begin(), pendingDatalogFolders.end(), date);
+    if (it != pendingDatalogFolders.end() && it->date == date) {
+        it->firstSeen = timestamp;
+    } else {
+        PendingFolder folder = {date, (uint32_t)timestamp};
+        pendingDatalogFolders.insert(it, folder);
+    }
+    dirtyFolders.push_back(date);
     LOG_DEBUGF("[UploadStateManager] Marked folder as pending: %s (timestamp: %lu)", 
          folderName.c_str(), timestamp);
 }
 
 void UploadStateManager::removeFolderFromPending(const String& folderName) {
-    auto it = pendingDatalogFolders.find(folderName);
+    auto it = findPendingFolder(packFolderName(folderName));
     if (it != pendingDatalogFolders.end()) {
+        dirtyFolders.push_back(it->date);
         pendingDatalogFolders.erase(it);
         LOG_DEBUGF("[UploadStateManager] Removed folder from pending state: %s", folderName.c_str());
     }
 }
 
 bool UploadStateManager::shouldPromotePendingToCompleted(const String& folderName, unsigned long currentTime) {
-    auto it = pendingDatalogFolders.find(folderName);
+    auto it = findPendingFolder(packFolderName(folderName));
     if (it == pendingDatalogFolders.end()) {
         return false;  // Not a pending folder
     }
     
-    unsigned long firstSeenTime = it->second;
+    unsigned long firstSeenTime = it->firstSeen;
     return (currentTime - firstSeenTime) >= PENDING_FOLDER_TIMEOUT_SECONDS;
 }
 
 void UploadStateManager::promotePendingToCompleted(const String& folderName) {
-    auto it = pendingDatalogFolders.find(folderName);
+    auto it = findPendingFolder(packFolderName(folderName));
     if (it != pendingDatalogFolders.end()) {
+        insertCompletedFolder(it->date);
+        dirtyFolders.push_back(it->date);
         pendingDatalogFolders.erase(it);
-        completedDatalogFolders.insert(folderName);
         LOGF("[UploadStateManager] Promoted pending folder to completed: %s (empty for 7+ days)", 
              folderName.c_str());
     }
@@ -218,6 +591,11 @@ int UploadStateManager::getPendingFoldersCount() const {
     return pendingDatalogFolders.size();
 }
 
+size_t UploadStateManager::getFolderMemoryUsage() const {
+    return completedDatalogFolders.capacity() * sizeof(uint32_t) +
+           pendingDatalogFolders.capacity() * sizeof(PendingFolder);
+}
+
 String UploadStateManager::getCurrentRetryFolder() const {
     return currentRetryFolder;
 }
@@ -230,14 +608,75 @@ void UploadStateManager::setLastUploadTimestamp(unsigned long timestamp) {
     lastUploadTimestamp = timestamp;
 }
 
+void UploadStateManager::setUploadCheckpoint(const String& filePath, unsigned long fileSize, 
+                                             unsigned long bytesCommitted) {
+    checkpointPath = filePath;
+    checkpointSize = fileSize;
+    checkpointCommitted = bytesCommitted;
+    LOG_DEBUGF("[UploadStateManager] Checkpoint: %s at %lu of %lu bytes", 
+               filePath.c_str(), bytesCommitted, fileSize);
+}
+
+unsigned long UploadStateManager::getResumeOffset(const String& filePath, unsigned long fileSize) const {
+    if (checkpointPath.isEmpty() || checkpointPath != filePath) {
+        return 0;
+    }
+    
+    // A size change means the file was rewritten - the remote prefix may not match
+    if (checkpointSize != fileSize || checkpointCommitted >= fileSize) {
+        return 0;
+    }
+    
+    return checkpointCommitted;
+}
+
+void UploadStateManager::clearUploadCheckpoint() {
+    checkpointPath = "";
+    checkpointSize = 0;
+    checkpointCommitted = 0;
+}
+
+bool UploadStateManager::isReconcilePending() const {
+    return reconcilePending;
+}
+
+void UploadStateManager::setReconcilePending(bool pending) {
+    reconcilePending = pending;
+}
+
+bool UploadStateManager::hasUploadCheckpoint() const {
+    return !checkpointPath.isEmpty();
+}
+
+String UploadStateManager::getCheckpointPath() const {
+    return checkpointPath;
+}
+
 bool UploadStateManager::save(fs::FS &sd) {
     return saveState(sd);
 }
 
-bool UploadStateManager::loadState(fs::FS &sd) {
-    File file = sd.open(stateFilePath, FILE_READ);
+bool UploadStateManager::reset(fs::FS &sd) {
+    LOG("[UploadStateManager] Resetting upload state");
+    
+    clearState();
+    totalFoldersCount = 0;
+    reconcilePending = true;
+    
+    sd.remove(stateFilePath + ".tmp");  // Leftover from an interrupted save
+    if ((sd.exists(stateFilePath) && !sd.remove(stateFilePath)) ||
+        (sd.exists(legacyFilePath) && !sd.remove(legacyFilePath))) {
+        LOG("[UploadStateManager] ERROR: Failed to delete state file");
+        return false;
+    }
+    
+    return true;
+}
+
+// JSON state file of earlier firmware (version 1), read once for migration
+bool UploadStateManager::loadLegacyState(fs::FS &sd) {
+    File file = sd.open(legacyFilePath, FILE_READ);
     if (!file) {
-        LOG("[UploadStateManager] State file does not exist - will create on first save");
         return false;
     }
     
@@ -321,6 +760,55 @@ bool UploadStateManager::loadState(fs::FS &sd) {
     }
 #endif
     
+    // Load size/timestamp records (absent in older state files)
+    fileStats.clear();
+#ifdef UNIT_TEST
+    JsonObject stats = doc.getObject("file_stats");
+    if (!stats.isNull()) {
+        for (auto it = stats.begin(); it != stats.end(); ++it) {
+            fileStats[String(it->first.c_str())] = String(it->second.as<const char*>());
+        }
+    }
+#else
+    JsonObject stats = doc["file_stats"];
+    if (!stats.isNull()) {
+        for (JsonPair kv : stats) {
+            fileStats[String(kv.key().c_str())] = String(kv.value().as<const char*>());
+        }
+    }
+#endif
+    
+    // Load append records for growing files (absent in older state files)
+    appendLengths.clear();
+    appendTails.clear();
+#ifdef UNIT_TEST
+    JsonObject lengths = doc.getObject("file_lengths");
+    if (!lengths.isNull()) {
+        for (auto it = lengths.begin(); it != lengths.end(); ++it) {
+            appendLengths[String(it->first.c_str())] = it->second.as<unsigned long>();
+        }
+    }
+    JsonObject tails = doc.getObject("file_tails");
+    if (!tails.isNull()) {
+        for (auto it = tails.begin(); it != tails.end(); ++it) {
+            appendTails[String(it->first.c_str())] = String(it->second.as<const char*>());
+        }
+    }
+#else
+    JsonObject lengths = doc["file_lengths"];
+    if (!lengths.isNull()) {
+        for (JsonPair kv : lengths) {
+            appendLengths[String(kv.key().c_str())] = kv.value().as<unsigned long>();
+        }
+    }
+    JsonObject tails = doc["file_tails"];
+    if (!tails.isNull()) {
+        for (JsonPair kv : tails) {
+            appendTails[String(kv.key().c_str())] = String(kv.value().as<const char*>());
+        }
+    }
+#endif
+    
     // Load completed folders
     completedDatalogFolders.clear();
 #ifdef UNIT_TEST
@@ -332,9 +820,15 @@ bool UploadStateManager::loadState(fs::FS &sd) {
 #endif
     if (!folders.isNull()) {
         for (JsonVariant v : folders) {
-            completedDatalogFolders.insert(String(v.as<const char*>()));
+            uint32_t date = packFolderName(String(v.as<const char*>()));
+            if (date != 0) {
+                completedDatalogFolders.push_back(date);
+            }
         }
     }
+    std::sort(completedDatalogFolders.begin(), completedDatalogFolders.end());
+    completedDatalogFolders.erase(std::unique(completedDatalogFolders.begin(), completedDatalogFolders.end()),
+                                  completedDatalogFolders.end());
     
     // Load pending folders (backward compatibility - initialize empty if missing)
     pendingDatalogFolders.clear();
@@ -343,7 +837,7 @@ bool UploadStateManager::loadState(fs::FS &sd) {
     JsonObject pendingFolders = doc.getObject("pending_datalog_folders");
     if (!pendingFolders.isNull()) {
         for (auto it = pendingFolders.begin(); it != pendingFolders.end(); ++it) {
-            pendingDatalogFolders[String(it->first.c_str())] = it->second.as<unsigned long>();
+            markFolderPending(String(it->first.c_str()), it->second.as<unsigned long>());
         }
     }
 #else
@@ -351,7 +845,7 @@ bool UploadStateManager::loadState(fs::FS &sd) {
     JsonObject pendingFolders = doc["pending_datalog_folders"];
     if (!pendingFolders.isNull()) {
         for (JsonPair kv : pendingFolders) {
-            pendingDatalogFolders[String(kv.key().c_str())] = kv.value().as<unsigned long>();
+            markFolderPending(String(kv.key().c_str()), kv.value().as<unsigned long>());
         }
     }
 #endif
@@ -360,69 +854,243 @@ bool UploadStateManager::loadState(fs::FS &sd) {
     currentRetryFolder = doc["current_retry_folder"] | "";
     currentRetryCount = doc["current_retry_count"] | 0;
     
-    LOG("[UploadStateManager] State file loaded successfully");
-    LOG_DEBUGF("[UploadStateManager]   Tracked files: %u", fileChecksums.size());
-    LOG_DEBUGF("[UploadStateManager]   Completed folders: %u", completedDatalogFolders.size());
-    LOG_DEBUGF("[UploadStateManager]   Pending folders: %u", pendingDatalogFolders.size());
-    if (!currentRetryFolder.isEmpty()) {
-        LOG_DEBUGF("[UploadStateManager]   Current retry folder: %s (attempt %d)", 
-             currentRetryFolder.c_str(), currentRetryCount);
-    }
+    // Load resume checkpoint (absent in older state files)
+    checkpointPath = doc["upload_checkpoint_path"] | "";
+    checkpointSize = doc["upload_checkpoint_size"] | 0UL;
+    checkpointCommitted = doc["upload_checkpoint_committed"] | 0UL;
+    
+    // Remote reconcile interrupted in an earlier session (absent in older state files)
+    reconcilePending = doc["reconcile_pending"] | false;
     
+    LOG("[UploadStateManager] Legacy JSON state file loaded");
     return true;
 }
 
-bool UploadStateManager::saveState(fs::FS &sd) {
-    // Calculate required JSON document size dynamically
-    // Estimate: base overhead (200) + folders (30 bytes each) + pending folders (50 bytes each) + checksums (100 bytes each)
-    size_t estimatedSize = 200 + 
-                          (completedDatalogFolders.size() * 30) + 
-                          (pendingDatalogFolders.size() * 50) +
-                          (fileChecksums.size() * 100);
-    
-    // Add 50% overhead for JSON formatting and safety margin
-    size_t jsonCapacity = estimatedSize * 3 / 2;
-    
-    // Ensure minimum capacity of 4KB
-    if (jsonCapacity < 4096) {
-        jsonCapacity = 4096;
+// Stream the binary state file, one record at a time
+// Returns false if there is no file or its header is not ours.
+bool UploadStateManager::loadState(fs::FS &sd) {
+    File file = sd.open(stateFilePath, FILE_READ);
+    if (!file) {
+        if (!sd.exists(legacyFilePath)) {
+            LOG("[UploadStateManager] State file does not exist - will create on first save");
+        }
+        return false;
     }
     
-    LOG_DEBUGF("[UploadStateManager] Allocating %u bytes for JSON document (%u completed, %u pending, %u files)", 
-         jsonCapacity, completedDatalogFolders.size(), pendingDatalogFolders.size(), fileChecksums.size());
-    
-    // Allocate JSON document with calculated capacity
-    DynamicJsonDocument doc(jsonCapacity);
-    
-    // Save version
-    doc["version"] = 1;
-    
-    // Save timestamp
-    doc["last_upload_timestamp"] = lastUploadTimestamp;
+    uint8_t header[STATE_HEADER_SIZE];
+    if (file.read(header, STATE_HEADER_SIZE) != STATE_HEADER_SIZE ||
+        memcmp(header, STATE_MAGIC, 4) != 0 ||
+        getLE32(header + 12) != Crc32::compute(0, header, 12)) {
+        LOG_WARN("[UploadStateManager] State file damaged, ignoring it");
+        file.close();
+        return false;
+    }
+    if (getLE16(header + 4) != STATE_FORMAT_VERSION ||
+        getLE16(header + 6) != SHORT_RECORD_SIZE ||
+        getLE16(header + 8) != PATH_RECORD_SIZE) {
+        LOGF("[UploadStateManager] WARNING: Unknown state file version: %u", getLE16(header + 4));
+        file.close();
+        return false;
+    }
     
-    // Save file checksums
-    JsonObject checksums = doc.createNestedObject("file_checksums");
-    for (const auto& pair : fileChecksums) {
-        checksums[pair.first.c_str()] = pair.second.c_str();
+    clearState();
+    uint8_t record[PATH_RECORD_SIZE];
+    bool intact = true;
+    while (true) {
+        size_t bytesRead = file.read(record, SHORT_RECORD_SIZE);
+        if (bytesRead == 0) {
+            break;  // End of file
+        }
+        size_t size = recordSize(record[0]);
+        if (bytesRead != SHORT_RECORD_SIZE || size == 0 ||
+            (size > SHORT_RECORD_SIZE &&
+             file.read(record + SHORT_RECORD_SIZE, size - SHORT_RECORD_SIZE) != size - SHORT_RECORD_SIZE) ||
+            getLE32(record + size - 4) != recordCrc(record, size)) {
+            intact = false;
+            break;
+        }
+        applyRecord(record);
+        journalRecords++;
     }
+    file.close();
     
-    // Save completed folders
-    JsonArray folders = doc.createNestedArray("completed_datalog_folders");
-    for (const String& folder : completedDatalogFolders) {
-        folders.add(folder);
+    // The records before the damage are kept; the next save rewrites the file
+    rewriteNeeded = !intact;
+    if (!intact) {
+        LOGF("[UploadStateManager] WARNING: State file damaged after %lu records (interrupted save?)",
+             (unsigned long)journalRecords);
     }
     
-    // Save pending folders
-    JsonObject pendingFolders = doc.createNestedObject("pending_datalog_folders");
-    for (const auto& pair : pendingDatalogFolders) {
-        pendingFolders[pair.first.c_str()] = pair.second;
+    uint8_t current[PATH_RECORD_SIZE];
+    encodeSession(current);
+    savedSessionCrc = getLE32(current + SHORT_RECORD_SIZE - 4);
+    encodeCheckpoint(current);
+    savedCheckpointCrc = getLE32(current + PATH_RECORD_SIZE - 4);
+    return true;
+}
+
+void UploadStateManager::encodeSession(uint8_t* record) const {
+    beginRecord(record, RECORD_SESSION, reconcilePending ? 1 : 0, lastUploadTimestamp,
+                packFolderName(currentRetryFolder));
+    putLE16(record + 2, currentRetryCount > 0xFFFF ? 0xFFFF : currentRetryCount);
+    sealRecord(record);
+}
+
+void UploadStateManager::encodeFolder(uint32_t date, uint8_t* record) const {
+    uint8_t state = FOLDER_NONE;
+    uint32_t firstSeen = 0;
+    auto pending = std::lower_bound(pendingDatalogFolders.begin(), pendingDatalogFolders.end(), date);
+    if (std::binary_search(completedDatalogFolders.begin(), completedDatalogFolders.end(), date)) {
+        state = FOLDER_COMPLETED;
+    } else if (pending != pendingDatalogFolders.end() && pending->date == date) {
+        state = FOLDER_PENDING;
+        firstSeen = pending->firstSeen;
+    }
+    beginRecord(record, RECORD_FOLDER, state, date, firstSeen);
+    sealRecord(record);
+}
+
+bool UploadStateManager::encodeCheckpoint(uint8_t* record) const {
+    beginRecord(record, RECORD_CHECKPOINT, checkpointPath.isEmpty() ? 0 : 1,
+                checkpointSize, checkpointCommitted);
+    bool fits = putField(record + RECORD_PATH_OFFSET, RECORD_PATH_SIZE, checkpointPath);
+    if (!fits) {
+        record[1] = 0;  // Too long to keep: the file restarts from zero
+    }
+    sealRecord(record);
+    return fits;
+}
+
+bool UploadStateManager::encodeFile(const String& path, uint8_t* record) const {
+    uint8_t flags = 0;
+    unsigned long size = 0;
+    unsigned long lastWrite = 0;
+    auto checksum = fileChecksums.find(path);
+    auto stat = fileStats.find(path);
+    if (checksum != fileChecksums.end()) {
+        flags |= FILE_HAS_CHECKSUM;
+    }
+    if (stat != fileStats.end() && sscanf(stat->second.c_str(), "%lu:%lu", &size, &lastWrite) == 2) {
+        flags |= FILE_HAS_STAT;
+    }
+    beginRecord(record, RECORD_FILE, flags, size, lastWrite);
+    if (!putField(record + RECORD_PATH_OFFSET, RECORD_PATH_SIZE, path) ||
+        ((flags & FILE_HAS_CHECKSUM) &&
+         !putField(record + RECORD_TEXT_OFFSET, RECORD_TEXT_SIZE, checksum->second))) {
+        return false;
+    }
+    sealRecord(record);
+    return true;
+}
+
+bool UploadStateManager::encodeAppend(const String& path, uint8_t* record) const {
+    auto length = appendLengths.find(path);
+    auto tail = appendTails.find(path);
+    bool present = length != appendLengths.end() && tail != appendTails.end();
+    beginRecord(record, RECORD_APPEND, present ? 1 : 0, present ? length->second : 0, 0);
+    if (!putField(record + RECORD_PATH_OFFSET, RECORD_PATH_SIZE, path) ||
+        (present && !putField(record + RECORD_TEXT_OFFSET, RECORD_TEXT_SIZE, tail->second))) {
+        return false;
+    }
+    sealRecord(record);
+    return true;
+}
+
+void UploadStateManager::setFolderState(uint32_t date, uint8_t state, uint32_t firstSeen) {
+    auto completed = std::lower_bound(completedDatalogFolders.begin(), completedDatalogFolders.end(), date);
+    if (completed != completedDatalogFolders.end() && *completed == date) {
+        completedDatalogFolders.erase(completed);
+    }
+    auto pending = findPendingFolder(date);
+    if (pending != pendingDatalogFolders.end()) {
+        pendingDatalogFolders.erase(pending);
     }
     
-    // Save retry tracking
-    doc["current_retry_folder"] = currentRetryFolder.c_str();
-    doc["current_retry_count"] = currentRetryCount;
+    if (state == FOLDER_COMPLETED) {
+        insertCompletedFolder(date);
+    } else if (state == FOLDER_PENDING) {
+        auto it = std::lower_bound(pendingDatalogFolders.begin(), pendingDatalogFolders.end(), date);
+        PendingFolder folder = {date, firstSeen};
+        pendingDatalogFolders.insert(it, folder);
+    }
+}
+
+// Replay one record; it replaces whatever an earlier record said about its key
+void UploadStateManager::applyRecord(const uint8_t* record) {
+    uint8_t flags = record[1];
+    uint32_t a = getLE32(record + 4);
+    uint32_t b = getLE32(record + 8);
     
-    // Write to temporary file first to avoid corruption
+    switch (record[0]) {
+        case RECORD_SESSION: {
+            reconcilePending = (flags & 1) != 0;
+            lastUploadTimestamp = a;
+            currentRetryCount = getLE16(record + 2);
+            char folderName[9];
+            currentRetryFolder = formatFolderName(b, folderName) ? String(folderName) : String("");
+            break;
+        }
+        case RECORD_FOLDER:
+            if (isFolderDate(a)) {
+                setFolderState(a, flags, b);
+            }
+            break;
+        case RECORD_FILE: {
+            String path = getField(record + RECORD_PATH_OFFSET, RECORD_PATH_SIZE);
+            if (flags & FILE_HAS_CHECKSUM) {
+                fileChecksums[path] = getField(record + RECORD_TEXT_OFFSET, RECORD_TEXT_SIZE);
+            } else {
+                fileChecksums.erase(path);
+            }
+            if (flags & FILE_HAS_STAT) {
+                fileStats[path] = formatStat(a, b);
+            } else {
+                fileStats.erase(path);
+            }
+            break;
+        }
+        case RECORD_APPEND: {
+            String path = getField(record + RECORD_PATH_OFFSET, RECORD_PATH_SIZE);
+            if (flags & 1) {
+                appendLengths[path] = a;
+                appendTails[path] = getField(record + RECORD_TEXT_OFFSET, RECORD_TEXT_SIZE);
+            } else {
+                appendLengths.erase(path);
+                appendTails.erase(path);
+            }
+            break;
+        }
+        case RECORD_CHECKPOINT:
+            if (flags & 1) {
+                checkpointPath = getField(record + RECORD_PATH_OFFSET, RECORD_PATH_SIZE);
+                checkpointSize = a;
+                checkpointCommitted = b;
+            } else {
+                clearUploadCheckpoint();
+            }
+            break;
+    }
+}
+
+uint32_t UploadStateManager::countLiveRecords() const {
+    uint32_t files = fileChecksums.size();
+    for (const auto& pair : fileStats) {
+        if (fileChecksums.find(pair.first) == fileChecksums.end()) {
+            files++;
+        }
+    }
+    return 2 + files + appendLengths.size() + completedDatalogFolders.size() + pendingDatalogFolders.size();
+}
+
+bool UploadStateManager::saveState(fs::FS &sd) {
+    if (rewriteNeeded || journalRecords > 2 * countLiveRecords() + UPLOAD_STATE_COMPACT_SLACK) {
+        return writeStateFile(sd);
+    }
+    return appendStateChanges(sd);
+}
+
+// Write the live state to a new file and swap it in
+bool UploadStateManager::writeStateFile(fs::FS &sd) {
     String tempFilePath = stateFilePath + ".tmp";
     File file = sd.open(tempFilePath, FILE_WRITE);
     if (!file) {
@@ -430,48 +1098,162 @@ bool UploadStateManager::saveState(fs::FS &sd) {
         return false;
     }
     
-    size_t bytesWritten = serializeJson(doc, file);
+    uint8_t header[STATE_HEADER_SIZE];
+    memcpy(header, STATE_MAGIC, 4);
+    putLE16(header + 4, STATE_FORMAT_VERSION);
+    putLE16(header + 6, SHORT_RECORD_SIZE);
+    putLE16(header + 8, PATH_RECORD_SIZE);
+    putLE16(header + 10, 0);
+    putLE32(header + 12, Crc32::compute(0, header, 12));
+    size_t expected = STATE_HEADER_SIZE;
+    size_t written = file.write(header, STATE_HEADER_SIZE);
+    uint32_t records = 0;
+    
+    uint8_t record[PATH_RECORD_SIZE];
+    encodeSession(record);
+    uint32_t sessionCrc = getLE32(record + SHORT_RECORD_SIZE - 4);
+    written += file.write(record, SHORT_RECORD_SIZE);
+    expected += SHORT_RECORD_SIZE;
+    records++;
+    
+    encodeCheckpoint(record);
+    uint32_t checkpointCrc = getLE32(record + PATH_RECORD_SIZE - 4);
+    written += file.write(record, PATH_RECORD_SIZE);
+    expected += PATH_RECORD_SIZE;
+    records++;
+    
+    for (uint32_t date : completedDatalogFolders) {
+        encodeFolder(date, record);
+        written += file.write(record, SHORT_RECORD_SIZE);
+        expected += SHORT_RECORD_SIZE;
+        records++;
+    }
+    for (const PendingFolder& folder : pendingDatalogFolders) {
+        encodeFolder(folder.date, record);
+        written += file.write(record, SHORT_RECORD_SIZE);
+        expected += SHORT_RECORD_SIZE;
+        records++;
+    }
+    
+    std::set<String> paths;
+    for (const auto& pair : fileChecksums) {
+        paths.insert(pair.first);
+    }
+    for (const auto& pair : fileStats) {
+        paths.insert(pair.first);
+    }
+    for (const String& path : paths) {
+        if (!encodeFile(path, record)) {
+            LOG_WARNF("[UploadStateManager] Path too long to record: %s", path.c_str());
+            continue;
+        }
+        written += file.write(record, PATH_RECORD_SIZE);
+        expected += PATH_RECORD_SIZE;
+        records++;
+    }
+    for (const auto& pair : appendLengths) {
+        if (!encodeAppend(pair.first, record)) {
+            LOG_WARNF("[UploadStateManager] Path too long to record: %s", pair.first.c_str());
+            continue;
+        }
+        written += file.write(record, PATH_RECORD_SIZE);
+        expected += PATH_RECORD_SIZE;
+        records++;
+    }
     file.close();
     
-    if (bytesWritten == 0) {
-        LOG("[UploadStateManager] ERROR: Failed to write state file (0 bytes written)");
-        sd.remove(tempFilePath);  // Clean up failed temp file
+    if (written != expected) {
+        LOG("[UploadStateManager] ERROR: Failed to write state file");
+        sd.remove(tempFilePath);
         return false;
     }
     
-    // Verify the temp file was written correctly
-    File verifyFile = sd.open(tempFilePath, FILE_READ);
-    if (!verifyFile) {
-        LOG("[UploadStateManager] ERROR: Failed to verify temp state file");
+    if (sd.exists(stateFilePath) && !sd.remove(stateFilePath)) {
+        LOG_DEBUG("[UploadStateManager] WARNING: Failed to remove old state file");
+        // Continue anyway - rename might still work
+    }
+    if (!sd.rename(tempFilePath, stateFilePath)) {
+        LOG("[UploadStateManager] ERROR: Failed to rename temp state file");
         sd.remove(tempFilePath);
         return false;
     }
     
-    size_t verifySize = verifyFile.size();
-    verifyFile.close();
+    dirtyFiles.clear();
+    dirtyAppends.clear();
+    dirtyFolders.clear();
+    savedSessionCrc = sessionCrc;
+    savedCheckpointCrc = checkpointCrc;
+    journalRecords = records;
+    rewriteNeeded = false;
+    LOG_DEBUGF("[UploadStateManager] State file written (%lu records, %u bytes)",
+               (unsigned long)records, written);
+    return true;
+}
+
+// Append a record for every key changed since the last save
+bool UploadStateManager::appendStateChanges(fs::FS &sd) {
+    std::vector<uint8_t> changes;
+    uint8_t record[PATH_RECORD_SIZE];
     
-    if (verifySize != bytesWritten) {
-        LOG_DEBUGF("[UploadStateManager] ERROR: State file size mismatch (wrote %u bytes, file is %u bytes)", 
-             bytesWritten, verifySize);
-        sd.remove(tempFilePath);
-        return false;
+    encodeSession(record);
+    uint32_t sessionCrc = getLE32(record + SHORT_RECORD_SIZE - 4);
+    if (sessionCrc != savedSessionCrc) {
+        changes.insert(changes.end(), record, record + SHORT_RECORD_SIZE);
+    }
+    encodeCheckpoint(record);
+    uint32_t checkpointCrc = getLE32(record + PATH_RECORD_SIZE - 4);
+    if (checkpointCrc != savedCheckpointCrc) {
+        changes.insert(changes.end(), record, record + PATH_RECORD_SIZE);
     }
     
-    // Remove old state file if it exists
-    if (sd.exists(stateFilePath)) {
-        if (!sd.remove(stateFilePath)) {
-            LOG_DEBUG("[UploadStateManager] WARNING: Failed to remove old state file");
-            // Continue anyway - rename might still work
+    std::sort(dirtyFolders.begin(), dirtyFolders.end());
+    dirtyFolders.erase(std::unique(dirtyFolders.begin(), dirtyFolders.end()), dirtyFolders.end());
+    for (uint32_t date : dirtyFolders) {
+        encodeFolder(date, record);
+        changes.insert(changes.end(), record, record + SHORT_RECORD_SIZE);
+    }
+    for (const String& path : dirtyFiles) {
+        if (encodeFile(path, record)) {
+            changes.insert(changes.end(), record, record + PATH_RECORD_SIZE);
+        } else {
+            LOG_WARNF("[UploadStateManager] Path too long to record: %s", path.c_str());
+        }
+    }
+    for (const String& path : dirtyAppends) {
+        if (encodeAppend(path, record)) {
+            changes.insert(changes.end(), record, record + PATH_RECORD_SIZE);
+        } else {
+            LOG_WARNF("[UploadStateManager] Path too long to record: %s", path.c_str());
         }
     }
     
-    // Rename temp file to actual state file
-    if (!sd.rename(tempFilePath, stateFilePath)) {
-        LOG("[UploadStateManager] ERROR: Failed to rename temp state file");
-        sd.remove(tempFilePath);  // Clean up
-        return false;
+    if (!changes.empty()) {
+        File file = sd.open(stateFilePath, FILE_APPEND);
+        if (!file) {
+            LOGF("[UploadStateManager] ERROR: Failed to open state file for writing: %s", stateFilePath.c_str());
+            return false;
+        }
+        size_t written = file.write(changes.data(), changes.size());
+        file.close();
+        if (written != changes.size()) {
+            // A partial record would hide anything appended after it
+            LOG("[UploadStateManager] ERROR: Failed to write state file");
+            rewriteNeeded = true;
+            return false;
+        }
+        
+        size_t records = 0;
+        for (size_t offset = 0; offset < changes.size(); offset += recordSize(changes[offset])) {
+            records++;
+        }
+        journalRecords += records;
+        LOG_DEBUGF("[UploadStateManager] State saved (%u changed records)", records);
     }
     
-    LOG_DEBUGF("[UploadStateManager] State file saved successfully (%u bytes)", bytesWritten);
+    dirtyFiles.clear();
+    dirtyAppends.clear();
+    dirtyFolders.clear();
+    savedSessionCrc = sessionCrc;
+    savedCheckpointCrc = checkpointCrc;
     return true;
 }
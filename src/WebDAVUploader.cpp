@@ -1,61 +1,749 @@
 #include "WebDAVUploader.h"
 #include "Logger.h"
+#include "Config.h"
+#include "Md5Digest.h"
 
 #ifdef ENABLE_WEBDAV_UPLOAD
 
-// TODO: Implementation pending
-// This is a placeholder for future WebDAV upload support
+#include <string>
 
-WebDAVUploader::WebDAVUploader(const String& endpoint, const String& user, const String& password)
-    : webdavUser(user), webdavPassword(password), connected(false) {
-    parseEndpoint(endpoint);
+static const char* PROPFIND_BODY =
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+    "<d:propfind xmlns:d=\"DAV:\"><d:prop><d:resourcetype/><d:getcontentlength/></d:prop></d:propfind>";
+
+// Longest single <response> element accepted from a PROPFIND listing
+static const size_t MAX_PROPFIND_ENTRY = 4096;
+
+/**
+ * Incremental parser for PROPFIND multistatus bodies
+ * Each <response> element is parsed as soon as it is complete and then
+ * dropped, so a listing of any length needs one entry of memory.
+ * Namespace prefixes vary between servers (d:, D:, none) and are ignored.
+ */
+struct PropfindParser {
+    std::string buffer;
+    std::string selfPath;  // Decoded path of the listed collection, no trailing slash
+    std::map<String, unsigned long>* files;
+    std::set<String>* subdirs;
+    bool failed;
+
+    // Position of the '<' of the next tag with this local name (opening
+    // tag, or closing tag if closing is set), or npos
+    static size_t findTag(const std::string& xml, const char* localName, bool closing, size_t from) {
+        size_t nameLen = strlen(localName);
+        for (size_t pos = xml.find(localName, from); pos != std::string::npos;
+             pos = xml.find(localName, pos + 1)) {
+            size_t end = pos + nameLen;
+            if (end >= xml.length() || (xml[end] != '>' && xml[end] != ' ' && xml[end] != '/')) {
+                continue;
+            }
+            size_t start = pos;
+            if (start > 0 && xml[start - 1] == ':') {
+                start--;
+                while (start > 0 && xml[start - 1] != '<' && xml[start - 1] != '/' &&
+                       xml[start - 1] != ' ' && xml[start - 1] != '>') {
+                    start--;
+                }
+            }
+            if (closing) {
+                if (start >= 2 && xml[start - 1] == '/' && xml[start - 2] == '<') {
+                    return start - 2;
+                }
+            } else if (start >= 1 && xml[start - 1] == '<') {
+                return start - 1;
+            }
+        }
+        return std::string::npos;
+    }
+
+    static bool elementText(const std::string& xml, const char* localName, std::string& text) {
+        size_t open = findTag(xml, localName, false, 0);
+        if (open == std::string::npos) {
+            return false;
+        }
+        size_t start = xml.find('>', open);
+        if (start == std::string::npos || xml[start - 1] == '/') {
+            return false;
+        }
+        size_t end = xml.find('<', start + 1);
+        if (end == std::string::npos) {
+            return false;
+        }
+        text = xml.substr(start + 1, end - start - 1);
+        return true;
+    }
+
+    static std::string percentDecode(const std::string& text) {
+        std::string decoded;
+        for (size_t i = 0; i < text.length(); i++) {
+            if (text[i] == '%' && i + 2 < text.length() && isxdigit(text[i + 1]) && isxdigit(text[i + 2])) {
+                decoded += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+                i += 2;
+            } else {
+                decoded += text[i];
+            }
+        }
+        return decoded;
+    }
+
+    void parseEntry(const std::string& entry) {
+        std::string href;
+        if (!elementText(entry, "href", href)) {
+            return;
+        }
+        std::string path = percentDecode(href);
+        // Absolute URLs: keep only the path
+        size_t scheme = path.find("://");
+        if (scheme != std::string::npos) {
+            size_t slash = path.find('/', scheme + 3);
+            path = slash == std::string::npos ? "/" : path.substr(slash);
+        }
+        while (path.length() > 1 && path[path.length() - 1] == '/') {
+            path.erase(path.length() - 1);
+        }
+        if (path == selfPath) {
+            return;
+        }
+        size_t lastSlash = path.find_last_of('/');
+        String name(path.substr(lastSlash == std::string::npos ? 0 : lastSlash + 1).c_str());
+        if (name.isEmpty()) {
+            return;
+        }
+
+        if (findTag(entry, "collection", false, 0) != std::string::npos) {
+            if (subdirs) {
+                subdirs->insert(name);
+            }
+        } else {
+            std::string length;
+            (*files)[name] = elementText(entry, "getcontentlength", length)
+                                 ? strtoul(length.c_str(), nullptr, 10) : 0;
+        }
+    }
+
+    void feed(const uint8_t* data, size_t len) {
+        if (failed) {
+            return;
+        }
+        buffer.append((const char*)data, len);
+        while (true) {
+            size_t close = findTag(buffer, "response", true, 0);
+            if (close == std::string::npos) {
+                break;
+            }
+            size_t end = buffer.find('>', close);
+            parseEntry(buffer.substr(0, close));
+            buffer.erase(0, end + 1);
+        }
+        if (buffer.length() > MAX_PROPFIND_ENTRY) {
+            LOG_ERROR("[WebDAV] PROPFIND entry too large");
+            failed = true;
+        }
+    }
+
+    static void handler(const uint8_t* data, size_t len, void* context) {
+        static_cast<PropfindParser*>(context)->feed(data, len);
+    }
+};
+
+WebDAVUploader::WebDAVUploader(const String& endpoint, const String& user, const String& password,
+                               bool insecureTls)
+    : configured(false),
+      connected(false),
+      lastRequestTime(0),
+      resumeMethod(RESUME_NONE),
+      resumeProbed(false),
+      dirCacheHits(0),
+      dirCacheMisses(0),
+      pushSink(nullptr),
+      pushSize(0) {
+    configured = http.setUrl(endpoint);
+    http.setBasicAuth(user, password);
+    http.setInsecure(insecureTls);
 }
 
 WebDAVUploader::~WebDAVUploader() {
     end();
 }
 
-bool WebDAVUploader::parseEndpoint(const String& endpoint) {
-    // TODO: Parse WebDAV URL
-    webdavUrl = endpoint;
-    LOG("[WebDAV] TODO: WebDAV uploader not yet implemented");
-    return false;
+UploadBackend* WebDAVUploader::create(const Config& config, const EndpointConfig& endpoint) {
+    return new WebDAVUploader(endpoint.url, endpoint.user, endpoint.password, config.isWebdavTlsInsecure());
 }
 
-bool WebDAVUploader::connect() {
-    LOG("[WebDAV] ERROR: WebDAV uploader not yet implemented");
-    return false;
+static bool isSuccess(int status) {
+    return status >= 200 && status < 300;
 }
 
-void WebDAVUploader::disconnect() {
-    connected = false;
+static void collectBody(const uint8_t* data, size_t len, void* context) {
+    static_cast<std::string*>(context)->append((const char*)data, len);
 }
 
 bool WebDAVUploader::begin() {
-    LOG("[WebDAV] ERROR: WebDAV uploader not yet implemented");
-    LOG("[WebDAV] Please use SMB upload or wait for WebDAV implementation");
-    return false;
+    if (!configured) {
+        LOG_ERROR("[WebDAV] ENDPOINT must be an http:// or https:// URL");
+        return false;
+    }
+
+    LOGF("[WebDAV] Connecting to %s://%s:%u%s", http.isSecure() ? "https" : "http",
+         http.getHost().c_str(), http.getPort(), http.getBasePath().c_str());
+    if (!http.connect()) {
+        return false;
+    }
+
+    // Checks the endpoint collection and the credentials in one request
+    int status = http.request("PROPFIND", davPath("/"), "Depth: 0\r\nContent-Type: application/xml\r\n",
+                              PROPFIND_BODY);
+    lastRequestTime = millis();
+    if (status == 401 || status == 403) {
+        LOGF("[WebDAV] ERROR: Authentication failed (HTTP %d), check ENDPOINT_USER and ENDPOINT_PASS", status);
+        http.close();
+        return false;
+    }
+    if (status != 207) {
+        LOGF("[WebDAV] ERROR: Endpoint collection not usable (HTTP %d)", status);
+        http.close();
+        return false;
+    }
+
+    connected = true;
+    if (!resumeProbed) {
+        probeResume();
+    }
+    LOG("[WebDAV] Connected");
+    return true;
+}
+
+void WebDAVUploader::probeResume() {
+    static const char* NAMES[] = {"none (whole files)", "Content-Range PUT", "PATCH partial update",
+                                  "Nextcloud chunked upload"};
+    resumeProbed = true;
+    resumeMethod = RESUME_NONE;
+
+    // sabre/dav announces its partial update plugin in the DAV header
+    http.captureHeader("dav");
+    int status = http.request("OPTIONS", davPath("/"));
+    String davHeader = http.getCapturedHeader();
+    http.captureHeader(nullptr);
+    davHeader.toLowerCase();
+    if (isSuccess(status) && strstr(davHeader.c_str(), "sabredav-partialupdate") != nullptr) {
+        resumeMethod = RESUME_PATCH;
+    }
+
+    // Nextcloud: .../remote.php/dav/files/<user>/... uploads through .../remote.php/dav/uploads/<user>
+    std::string base(http.getBasePath().c_str());
+    size_t files = base.find("/remote.php/dav/files/");
+    if (resumeMethod == RESUME_NONE && files != std::string::npos) {
+        size_t userStart = files + strlen("/remote.php/dav/files/");
+        std::string user = base.substr(userStart, base.find('/', userStart) - userStart);
+        uploadsPath = String((base.substr(0, files) + "/remote.php/dav/uploads/" + user).c_str());
+        status = http.request("PROPFIND", uploadsPath + "/", "Depth: 0\r\nContent-Type: application/xml\r\n",
+                              PROPFIND_BODY);
+        if (status == 207) {
+            resumeMethod = RESUME_CHUNKED_UPLOAD;
+        }
+    }
+
+    if (resumeMethod == RESUME_NONE && probeContentRange()) {
+        resumeMethod = RESUME_CONTENT_RANGE;
+    }
+    lastRequestTime = millis();
+    LOGF("[WebDAV] Resume method: %s", NAMES[resumeMethod]);
+}
+
+// Servers that do not implement Content-Range on PUT reject it or replace
+// the whole file with the range, so the result is checked by reading it back
+bool WebDAVUploader::probeContentRange() {
+    String probe = davPath("/.cpap_resume_probe");
+    if (!isSuccess(http.request("PUT", probe, "", "ABCD"))) {
+        return false;
+    }
+    bool works = false;
+    if (isSuccess(http.request("PUT", probe, "Content-Range: bytes 2-3/*\r\n", "XY"))) {
+        std::string content;
+        works = (http.request("GET", probe, "", "", &collectBody, &content) == 200 && content == "ABXY");
+    }
+    http.request("DELETE", probe);
+    return works;
 }
 
 void WebDAVUploader::end() {
-    disconnect();
+    if (pushSink != nullptr) {
+        delete pushSink;
+        pushSink = nullptr;
+    }
+    if (connected) {
+        LOG_DEBUG("[WebDAV] Closing connection");
+    }
+    http.close();
+    connected = false;
+    knownDirectories.clear();
+}
+
+// Connect on first use (and after end())
+bool WebDAVUploader::ensureConnected() {
+    if (isConnected()) {
+        return true;
+    }
+    LOG_DEBUG("[WebDAV] Not connected, attempting to connect...");
+    if (!begin()) {
+        LOG_ERROR("[WebDAV] Failed to connect to WebDAV server");
+        return false;
+    }
+    return true;
 }
 
 bool WebDAVUploader::isConnected() const {
     return connected;
 }
 
+void WebDAVUploader::refreshIdleConnection() {
+    if (http.isOpen() && millis() - lastRequestTime > WEBDAV_IDLE_REUSE_MS) {
+        LOG_DEBUG("[WebDAV] Connection idle, reopening before upload");
+        http.close();
+    }
+}
+
 bool WebDAVUploader::createDirectory(const String& path) {
-    LOG("[WebDAV] ERROR: WebDAV uploader not yet implemented");
+    int status = http.request("MKCOL", davPath(path));
+    lastRequestTime = millis();
+    // 405: the collection already exists
+    if (status == 201 || status == 405) {
+        knownDirectories.insert(path);
+        return true;
+    }
+    LOGF("[WebDAV] ERROR: MKCOL %s failed (HTTP %d)", path.c_str(), status);
     return false;
 }
 
-bool WebDAVUploader::upload(const String& localPath, const String& remotePath, 
-                            fs::FS &sd, unsigned long& bytesTransferred) {
+bool WebDAVUploader::ensureParentDirectories(const String& remotePath) {
+    std::string path(remotePath.c_str());
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        String dir(path.substr(0, slash).c_str());
+        if (knownDirectories.count(dir) > 0) {
+            dirCacheHits++;
+            continue;
+        }
+        dirCacheMisses++;
+        if (!createDirectory(dir)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int WebDAVUploader::sendStream(const char* method, const String& serverPath, const String& headers,
+                               UploadSource& source, size_t totalBytes, Md5Digest* digest,
+                               unsigned long& bytesTransferred) {
     bytesTransferred = 0;
-    LOG("[WebDAV] ERROR: WebDAV uploader not yet implemented");
-    LOG("[WebDAV] Please use SMB upload or wait for WebDAV implementation");
-    return false;
+    bool toEnd = (totalBytes == UploadPipeline::STREAM_TO_END);
+    if (!http.beginRequest(method, serverPath, toEnd ? HttpConnection::CHUNKED : (long)totalBytes, headers)) {
+        return -1;
+    }
+
+    UploadPipeline pipeline;
+    if (!pipeline.begin()) {
+        LOG_ERROR("[WebDAV] ERROR: Failed to allocate upload buffers");
+        http.close();
+        return -1;
+    }
+    pipeline.setDigest(digest);
+    HttpBodySink sink(http);
+    bool sent = pipeline.run(source, totalBytes, sink, bytesTransferred) &&
+                (toEnd || bytesTransferred == totalBytes);
+    pipeline.end();
+
+    if (!sent || !http.endRequest()) {
+        // The body is incomplete; the connection cannot carry another request
+        http.close();
+        return -1;
+    }
+    int status = http.readResponse();
+    lastRequestTime = millis();
+    return status;
+}
+
+int WebDAVUploader::writeRange(fs::File& file, const String& remotePath, size_t fileSize,
+                               unsigned long offset, unsigned long length, bool create, Md5Digest* digest) {
+    const char* method = "PUT";
+    String path = davPath(remotePath);
+    String headers;
+    bool piece = (resumeMethod == RESUME_CHUNKED_UPLOAD && !create);
+    if (piece) {
+        path = transferPath(remotePath, fileSize) + "/" + pieceName(offset);
+    } else if (!create) {
+        char range[64];
+        if (resumeMethod == RESUME_PATCH) {
+            method = "PATCH";
+            snprintf(range, sizeof(range), "X-Update-Range: bytes=%lu-%lu\r\n", offset, offset + length - 1);
+            headers = String("Content-Type: application/x-sabredav-partialupdate\r\n") + range;
+        } else {
+            snprintf(range, sizeof(range), "Content-Range: bytes %lu-%lu/*\r\n", offset, offset + length - 1);
+            headers = range;
+        }
+    }
+
+    // A file can be read again, so a request that hit a closed keep-alive
+    // connection or a vanished parent collection is retried once
+    int status = -1;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!file.seek(offset)) {
+            LOGF("[WebDAV] ERROR: Failed to seek to offset %lu", offset);
+            return -1;
+        }
+        if (attempt > 0 && digest != nullptr && offset == 0) {
+            digest->begin();
+        }
+        FileUploadSource source(file);
+        unsigned long sent = 0;
+        status = sendStream(method, path, headers, source, length, digest, sent);
+        bool staleConnection = (status < 0 && http.wasReused());
+        if (status == 409 && !piece) {
+            LOG_DEBUG("[WebDAV] Parent collection missing, recreating");
+            knownDirectories.clear();
+            if (!ensureParentDirectories(remotePath)) {
+                break;
+            }
+        } else if (!staleConnection) {
+            break;
+        }
+    }
+    return status;
+}
+
+String WebDAVUploader::transferPath(const String& remotePath, size_t fileSize) const {
+    // Stable per file and size, so the next session finds the pieces again
+    Md5Digest digest;
+    String key = remotePath + ":" + String((unsigned long)fileSize);
+    digest.update((const uint8_t*)key.c_str(), key.length());
+    return uploadsPath + "/cpap-" + digest.finishHex().substring(0, 16);
+}
+
+// Pieces are named by offset; the server assembles them in name order
+String WebDAVUploader::pieceName(unsigned long offset) {
+    char name[16];
+    snprintf(name, sizeof(name), "%015lu", offset);
+    return String(name);
+}
+
+unsigned long WebDAVUploader::findResumePoint(const String& remotePath, size_t fileSize,
+                                              unsigned long startOffset) {
+    std::map<String, unsigned long> entries;
+    if (resumeMethod == RESUME_CHUNKED_UPLOAD) {
+        // Continue after the pieces that form a contiguous prefix. Stray
+        // pieces would be assembled too, so those mean starting over.
+        String transfer = transferPath(remotePath, fileSize);
+        unsigned long confirmed = 0;
+        size_t used = 0;
+        if (listCollection(transfer, entries, nullptr) == 207) {
+            for (auto it = entries.find(pieceName(0)); it != entries.end() && it->second > 0;
+                 it = entries.find(pieceName(confirmed))) {
+                confirmed += it->second;
+                used++;
+            }
+        }
+        if (confirmed >= startOffset && confirmed <= fileSize && used == entries.size()) {
+            return confirmed;
+        }
+        LOGF("[WebDAV] WARNING: Uploaded pieces do not reach checkpoint (%lu bytes), starting over", startOffset);
+        http.request("DELETE", transfer + "/");
+        return 0;
+    }
+
+    // Range writes continue the remote file if it holds the checkpointed prefix
+    int slash = remotePath.lastIndexOf('/');
+    String name = remotePath.substring(slash + 1);
+    if (listDirectory(remotePath.substring(0, slash), entries)) {
+        auto it = entries.find(name);
+        if (it != entries.end() && it->second >= startOffset) {
+            return startOffset;
+        }
+    }
+    LOGF("[WebDAV] WARNING: Remote file shorter than checkpoint (%lu bytes), starting over", startOffset);
+    return 0;
+}
+
+bool WebDAVUploader::assembleChunks(const String& remotePath, size_t fileSize) {
+    String headers = "Destination: " + http.urlFor(davPath(remotePath)) + "\r\nOverwrite: T\r\n" +
+                     "OC-Total-Length: " + String((unsigned long)fileSize) + "\r\n";
+    int status = http.request("MOVE", transferPath(remotePath, fileSize) + "/.file", headers);
+    lastRequestTime = millis();
+    if (!isSuccess(status)) {
+        LOGF("[WebDAV] ERROR: Assembling %s failed (HTTP %d)", remotePath.c_str(), status);
+        return false;
+    }
+    return true;
+}
+
+bool WebDAVUploader::uploadFile(fs::File& localFile, size_t fileSize, const String& localPath,
+                                const String& remotePath, unsigned long& bytesTransferred,
+                                unsigned long startOffset, unsigned long maxBytes) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+
+    if (!connected) {
+        LOG("[WebDAV] Not connected");
+        return false;
+    }
+
+    if (fileSize == 0) {
+        LOGF("[WebDAV] WARNING: File is empty: %s", localPath.c_str());
+        return false;
+    }
+
+    if (!ensureParentDirectories(remotePath)) {
+        return false;
+    }
+    refreshIdleConnection();
+
+    // Range requested by the caller: [startOffset, endOffset)
+    bool resumable = (resumeMethod != RESUME_NONE);
+    if (!resumable || startOffset >= fileSize) {
+        startOffset = 0;
+    }
+    unsigned long endOffset = fileSize;
+    if (resumable && maxBytes > 0 && startOffset + maxBytes < fileSize) {
+        endOffset = startOffset + maxBytes;
+    }
+
+    // What the server really holds decides where sending starts. Starting
+    // over still ends at endOffset, so the caller's checkpoint stays true.
+    unsigned long offset = startOffset > 0 ? findResumePoint(remotePath, fileSize, startOffset) : 0;
+    if (offset > endOffset) {
+        offset = endOffset;
+    }
+    if (offset > 0) {
+        LOGF("[WebDAV] Resuming %s at offset %lu of %u bytes", localPath.c_str(), offset, fileSize);
+    }
+
+    // Large files go in pieces the server acknowledges one by one; a
+    // Nextcloud upload collection is only worth it for more than one piece
+    bool transfer = (resumeMethod == RESUME_CHUNKED_UPLOAD &&
+                     (offset > 0 || endOffset < fileSize || fileSize > WEBDAV_RESUME_PIECE_SIZE));
+    if (transfer && offset == 0) {
+        int status = http.request("MKCOL", transferPath(remotePath, fileSize));
+        if (status != 201 && status != 405) {
+            LOGF("[WebDAV] ERROR: Cannot create upload collection (HTTP %d)", status);
+            return false;
+        }
+    }
+
+    Md5Digest digest;
+    bool wholeFile = (offset == 0 && endOffset == fileSize);
+    unsigned long startTime = millis();
+    int status = 201;
+    while (offset < endOffset) {
+        unsigned long length = endOffset - offset;
+        if (resumable && length > WEBDAV_RESUME_PIECE_SIZE) {
+            length = WEBDAV_RESUME_PIECE_SIZE;
+        }
+        bool create = (offset == 0 && !transfer);
+        status = writeRange(localFile, remotePath, fileSize, offset, length, create,
+                            wholeFile ? &digest : nullptr);
+        if (!isSuccess(status)) {
+            break;
+        }
+        offset += length;
+    }
+
+    bool success = isSuccess(status);
+    if (!success) {
+        LOGF("[WebDAV] ERROR: Upload of %s failed at offset %lu (HTTP %d)", remotePath.c_str(), offset, status);
+    } else if (transfer && offset == fileSize && !assembleChunks(remotePath, fileSize)) {
+        // Every byte is uploaded: the next attempt only repeats the MOVE
+        offset = fileSize - 1;
+        success = false;
+    }
+
+    // Acknowledged prefix (nothing usable is left by a failed whole-file PUT)
+    bytesTransferred = offset > startOffset ? offset - startOffset : 0;
+    if (!success) {
+        return false;
+    }
+
+    if (wholeFile && digest.getBytes() == fileSize) {
+        lastChecksum = digest.finishHex();
+    }
+    unsigned long elapsed = millis() - startTime;
+    LOG_DEBUGF("[WebDAV] Uploaded %s: %lu bytes in %lu ms, %lu of %u bytes on server", remotePath.c_str(),
+               bytesTransferred, elapsed, endOffset, fileSize);
+    return true;
+}
+
+bool WebDAVUploader::uploadStream(UploadSource& source, size_t totalBytes, const String& remotePath,
+                                  unsigned long& bytesTransferred) {
+    bytesTransferred = 0;
+    lastChecksum = "";
+
+    if (!connected) {
+        LOG("[WebDAV] Not connected");
+        return false;
+    }
+    if (!ensureParentDirectories(remotePath)) {
+        return false;
+    }
+
+    // A generated stream cannot be replayed: make sure it starts on a live connection
+    refreshIdleConnection();
+    int status = sendStream("PUT", davPath(remotePath), "", source, totalBytes, nullptr, bytesTransferred);
+    if (!isSuccess(status)) {
+        LOGF("[WebDAV] ERROR: PUT %s failed (HTTP %d)", remotePath.c_str(), status);
+        if (status == 409) {
+            knownDirectories.clear();
+        }
+        return false;
+    }
+    return true;
+}
+
+// Like uploadStream(): the pushed body cannot be replayed, so it starts on a
+// live connection and a failed PUT is not retried
+UploadSink* WebDAVUploader::beginFile(const String& remotePath, size_t totalBytes) {
+    lastChecksum = "";
+
+    if (!connected) {
+        LOG("[WebDAV] Not connected");
+        return nullptr;
+    }
+    if (pushSink != nullptr) {
+        LOG_ERROR("[WebDAV] beginFile() while another PUT is open");
+        return nullptr;
+    }
+    if (!ensureParentDirectories(remotePath)) {
+        return nullptr;
+    }
+
+    refreshIdleConnection();
+    if (!http.beginRequest("PUT", davPath(remotePath), (long)totalBytes, "")) {
+        LOGF("[WebDAV] ERROR: PUT %s failed to start", remotePath.c_str());
+        return nullptr;
+    }
+    pushSink = new HttpBodySink(http);
+    pushSize = totalBytes;
+    pushPath = remotePath;
+    return pushSink;
+}
+
+bool WebDAVUploader::finishFile(bool complete) {
+    if (pushSink == nullptr) {
+        return false;
+    }
+
+    bool sent = complete && pushSink->getWritten() == pushSize;
+    delete pushSink;
+    pushSink = nullptr;
+
+    int status = -1;
+    if (sent && http.endRequest()) {
+        status = http.readResponse();
+    } else {
+        // The body is incomplete; the connection cannot carry another request
+        http.close();
+    }
+    lastRequestTime = millis();
+
+    if (!isSuccess(status)) {
+        LOGF("[WebDAV] ERROR: PUT %s failed (HTTP %d)", pushPath.c_str(), status);
+        if (status == 409) {
+            knownDirectories.clear();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool WebDAVUploader::patchRange(const String& localPath, const String& remotePath, fs::FS &sd,
+                                unsigned long offset, unsigned long length) {
+    if (!connected || !supportsAppend()) {
+        return false;
+    }
+
+    fs::File localFile = sd.open(localPath, FILE_READ);
+    if (!localFile || localFile.size() < offset + length) {
+        LOGF("[WebDAV] ERROR: Failed to read local range of %s", localPath.c_str());
+        if (localFile) {
+            localFile.close();
+        }
+        return false;
+    }
+    refreshIdleConnection();
+    int status = writeRange(localFile, remotePath, localFile.size(), offset, length, false, nullptr);
+    localFile.close();
+    if (!isSuccess(status)) {
+        LOGF("[WebDAV] ERROR: Patching %lu bytes at %lu of %s failed (HTTP %d)", length, offset,
+             remotePath.c_str(), status);
+        return false;
+    }
+    return true;
+}
+
+int WebDAVUploader::listCollection(const String& serverPath, std::map<String, unsigned long>& files,
+                                   std::set<String>* subdirs) {
+    files.clear();
+    if (subdirs) {
+        subdirs->clear();
+    }
+
+    PropfindParser parser;
+    parser.selfPath = PropfindParser::percentDecode(serverPath.c_str());
+    while (parser.selfPath.length() > 1 && parser.selfPath[parser.selfPath.length() - 1] == '/') {
+        parser.selfPath.erase(parser.selfPath.length() - 1);
+    }
+    parser.files = &files;
+    parser.subdirs = subdirs;
+    parser.failed = false;
+
+    // Collections are addressed with a trailing slash (avoids a redirect)
+    String collection = serverPath.endsWith("/") ? serverPath : serverPath + "/";
+    int status = http.request("PROPFIND", collection, "Depth: 1\r\nContent-Type: application/xml\r\n",
+                              PROPFIND_BODY, &PropfindParser::handler, &parser);
+    lastRequestTime = millis();
+
+    if (status == 207 && !parser.failed) {
+        return status;
+    }
+    if (status != 404) {
+        LOGF("[WebDAV] ERROR: PROPFIND %s failed (HTTP %d)", serverPath.c_str(), status);
+    }
+    files.clear();
+    if (subdirs) {
+        subdirs->clear();
+    }
+    return parser.failed ? -1 : status;
+}
+
+bool WebDAVUploader::listDirectory(const String& path, std::map<String, unsigned long>& files,
+                                   std::set<String>* subdirs) {
+    if (!connected) {
+        files.clear();
+        if (subdirs) {
+            subdirs->clear();
+        }
+        return false;
+    }
+    int status = listCollection(davPath(path), files, subdirs);
+    if (status == 404) {
+        return true;  // Missing directory lists as empty
+    }
+    if (status != 207) {
+        return false;
+    }
+
+    // Every listed subdirectory exists: later uploads need no MKCOL for them
+    String prefix = path.endsWith("/") ? path.substring(0, path.length() - 1) : path;
+    if (subdirs) {
+        for (const String& dir : *subdirs) {
+            knownDirectories.insert(prefix + "/" + dir);
+        }
+    }
+    if (!prefix.isEmpty()) {
+        knownDirectories.insert(prefix);
+    }
+    return true;
+}
+
+void WebDAVUploader::logSessionStats() {
+    LOG_DEBUGF("[WebDAV] %lu requests on %lu connections, directory cache: %lu hits, %lu misses",
+               http.getRequestCount(), http.getConnectCount(), dirCacheHits, dirCacheMisses);
 }
 
 #endif // ENABLE_WEBDAV_UPLOAD
@@ -4,6 +4,8 @@
 #include "WiFiManager.h"
 #include "FileUploader.h"
 #include "Logger.h"
+#include "BufferPool.h"
+#include "UploadPipeline.h"
 #include "pins_config.h"
 
 #ifdef ENABLE_TEST_WEBSERVER
@@ -99,6 +101,15 @@ void setup() {
     // Release SD card back to CPAP machine
     sdManager.releaseControl();
 
+    // Reserve transfer buffers while the heap is still unfragmented (before
+    // WiFi and the web server start). One slot per pipeline buffer, one per
+    // async SMB write, plus one for checksums and web responses. Each slot
+    // holds a whole transfer chunk, as far as the heap allows.
+    int windowSlots = config.getSmbWriteWindow() > 1 ? config.getSmbWriteWindow() : 0;
+    BufferPool::getInstance().begin(UPLOAD_PIPELINE_BUFFER_COUNT + windowSlots + 1,
+                                    BUFFER_POOL_SLOT_SIZE, ESP.getMaxAllocHeap());
+    BufferPool::getInstance().logHeapReport("Boot");
+
     // Initialize WiFi in station mode
     if (!wifiManager.connectStation(config.getWifiSSID(), config.getWifiPassword())) {
         LOG("Failed to connect to WiFi");
@@ -209,31 +220,11 @@ void loop() {
         if (sdManager.takeControl()) {
             LOG("Resetting upload state...");
             
-            // Delete the state file
-            if (sdManager.getFS().remove("/.upload_state.json")) {
-                LOG("Upload state file deleted successfully");
+            // Clear state in place; the uploader (and its open SMB session) is kept
+            if (uploader && uploader->resetState(sdManager.getFS())) {
+                LOG("Upload state reset successfully");
             } else {
-                LOG_WARN("Failed to delete state file (may not exist)");
-            }
-            
-            // Reinitialize uploader to load fresh state
-            if (uploader) {
-                delete uploader;
-                uploader = new FileUploader(&config, &wifiManager);
-                if (uploader->begin(sdManager.getFS())) {
-                    LOG("Uploader reinitialized with fresh state");
-                    
-                    // Update TestWebServer with new manager references
-                    if (testWebServer) {
-                        testWebServer->updateManagers(uploader->getStateManager(),
-                                                     uploader->getBudgetManager(),
-                                                     uploader->getScheduleManager());
-                        uploader->setWebServer(testWebServer);
-                        LOG_DEBUG("TestWebServer manager references updated");
-                    }
-                } else {
-                    LOG_ERROR("Failed to reinitialize uploader");
-                }
+                LOG_WARN("Failed to delete state file");
             }
             
             sdManager.releaseControl();
@@ -318,6 +309,11 @@ void loop() {
     }
 #endif
     
+    // Keep the upload session alive between upload windows (closes it if WiFi dropped)
+    if (uploader) {
+        uploader->maintainConnections();
+    }
+    
     // Check WiFi connection (non-blocking with 30 second retry interval)
     if (!wifiManager.isConnected()) {
         unsigned long currentTime = millis();
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <map>
+#include <memory>
 #include <vector>
 #include <cstdint>
 
@@ -35,6 +36,7 @@ public:
     long longValue;
     bool isString;
     bool hasValue;  // Track if this variant actually has a value
+    std::shared_ptr<std::map<std::string, JsonVariant>> members;  // Object value (string parser only)
     
     JsonVariant() : longValue(0), isString(false), hasValue(false) {}
     JsonVariant(const char* val) : stringValue(val ? val : ""), longValue(0), isString(true), hasValue(true) {}
@@ -49,6 +51,12 @@ public:
     template<typename T>
     T as() const;
     
+    template<typename T>
+    bool is() const;
+    
+    // Member of an object value (null variant if absent or not an object)
+    JsonVariant operator[](const char* key) const;
+    
     String operator|(const char* defaultValue) const {
         if (hasValue && isString && !stringValue.empty()) {
             return String(stringValue.c_str());
@@ -102,6 +110,27 @@ template<> inline unsigned long JsonVariant::as<unsigned long>() const {
     return static_cast<unsigned long>(longValue);
 }
 
+// Template specializations for is()
+template<> inline bool JsonVariant::is<const char*>() const {
+    return hasValue && isString;
+}
+
+template<> inline bool JsonVariant::is<long>() const {
+    return hasValue && !isString && !members;
+}
+
+template<> inline bool JsonVariant::is<int>() const {
+    return is<long>();
+}
+
+inline JsonVariant JsonVariant::operator[](const char* key) const {
+    if (!members) {
+        return JsonVariant();
+    }
+    auto it = members->find(key);
+    return it != members->end() ? it->second : JsonVariant();
+}
+
 // Mock JSON pair
 class JsonPair {
 public:
@@ -455,6 +484,121 @@ DeserializationError deserializeJson(T& doc, fs::File& file) {
     return DeserializationError(DeserializationError::Ok);
 }
 
+// Recursive parser behind deserializeJson(doc, input, length): nested
+// objects become variants with members, arrays are skipped (null)
+class MockJsonParser {
+public:
+    MockJsonParser(const char* input, size_t length) : text(input, length), pos(0) {}
+    
+    bool parseObject(std::map<std::string, JsonVariant>& members) {
+        if (!consume('{')) return false;
+        skipSpace();
+        if (consume('}')) return true;
+        while (true) {
+            std::string key;
+            JsonVariant value;
+            skipSpace();
+            if (!parseString(key)) return false;
+            skipSpace();
+            if (!consume(':') || !parseValue(value)) return false;
+            members[key] = value;
+            skipSpace();
+            if (consume('}')) return true;
+            if (!consume(',')) return false;
+        }
+    }
+    
+    bool atEnd() {
+        skipSpace();
+        return pos == text.length();
+    }
+    
+private:
+    std::string text;
+    size_t pos;
+    
+    void skipSpace() {
+        while (pos < text.length() && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' || text[pos] == '\t')) {
+            pos++;
+        }
+    }
+    
+    bool consume(char c) {
+        if (pos < text.length() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    
+    bool parseString(std::string& out) {
+        if (!consume('"')) return false;
+        while (pos < text.length() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.length()) {
+                pos++;
+            }
+            out += text[pos++];
+        }
+        return consume('"');
+    }
+    
+    bool parseValue(JsonVariant& value) {
+        skipSpace();
+        if (pos >= text.length()) return false;
+        char c = text[pos];
+        if (c == '"') {
+            std::string str;
+            if (!parseString(str)) return false;
+            value = JsonVariant(str);
+        } else if (c == '{') {
+            std::shared_ptr<std::map<std::string, JsonVariant>> members(new std::map<std::string, JsonVariant>());
+            if (!parseObject(*members)) return false;
+            value = JsonVariant();
+            value.hasValue = true;
+            value.members = members;
+        } else if (c == '[') {
+            int depth = 0;
+            do {
+                if (text[pos] == '[') depth++;
+                if (text[pos] == ']') depth--;
+                pos++;
+            } while (depth > 0 && pos < text.length());
+            if (depth != 0) return false;
+            value = JsonVariant();
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            size_t start = pos++;
+            while (pos < text.length() && ((text[pos] >= '0' && text[pos] <= '9') || text[pos] == '.' ||
+                                           text[pos] == 'e' || text[pos] == 'E' || text[pos] == '+' || text[pos] == '-')) {
+                pos++;
+            }
+            value = JsonVariant(std::stol(text.substr(start, pos - start)));
+        } else if (text.compare(pos, 4, "true") == 0) {
+            pos += 4;
+            value = JsonVariant(1);
+        } else if (text.compare(pos, 5, "false") == 0) {
+            pos += 5;
+            value = JsonVariant(0);
+        } else if (text.compare(pos, 4, "null") == 0) {
+            pos += 4;
+            value = JsonVariant();
+        } else {
+            return false;
+        }
+        return true;
+    }
+};
+
+// Mock deserializeJson from memory - nested objects, as read by operator[]
+template<typename T>
+DeserializationError deserializeJson(T& doc, const char* input, size_t length) {
+    MockJsonParser parser(input, length);
+    if (!parser.parseObject(doc.objectData) || !parser.atEnd()) {
+        doc.objectData.clear();
+        return DeserializationError(DeserializationError::InvalidInput, "InvalidInput");
+    }
+    return DeserializationError(DeserializationError::Ok);
+}
+
 // Mock serializeJson function
 template<typename T>
 size_t serializeJson(T& doc, fs::File& file) {
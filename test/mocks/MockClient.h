@@ -0,0 +1,32 @@
+#ifndef MOCK_CLIENT_H
+#define MOCK_CLIENT_H
+
+#ifdef UNIT_TEST
+
+#include <cstdint>
+#include <cstddef>
+
+// Mock of the Arduino Client interface (WiFiClient, WiFiClientSecure).
+// Tests derive scripted clients from it.
+class Client {
+public:
+    virtual ~Client() {}
+
+    virtual int connect(const char* host, uint16_t port) = 0;
+    virtual size_t write(uint8_t byte) { return write(&byte, 1); }
+    virtual size_t write(const uint8_t* buf, size_t size) = 0;
+    virtual int available() = 0;
+    virtual int read() {
+        uint8_t byte;
+        return read(&byte, 1) == 1 ? byte : -1;
+    }
+    virtual int read(uint8_t* buf, size_t size) = 0;
+    virtual void flush() {}
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() { return connected() != 0; }
+};
+
+#endif // UNIT_TEST
+
+#endif // MOCK_CLIENT_H
@@ -7,6 +7,7 @@
 #include <map>
 #include <vector>
 #include <cstring>
+#include <ctime>
 
 // Mock String class for testing (mimics Arduino String)
 class String {
@@ -18,6 +19,7 @@ public:
     String(const char* str) : data(str ? str : "") {}
     String(const std::string& str) : data(str) {}
     String(int num) : data(std::to_string(num)) {}
+    String(long num) : data(std::to_string(num)) {}
     String(unsigned long num) : data(std::to_string(num)) {}
     
     const char* c_str() const { return data.c_str(); }
@@ -27,6 +29,7 @@ public:
     bool operator==(const String& other) const { return data == other.data; }
     bool operator!=(const String& other) const { return data != other.data; }
     bool operator<(const String& other) const { return data < other.data; }
+    bool operator>(const String& other) const { return data > other.data; }
     
     bool equals(const String& other) const { return data == other.data; }
     bool equals(const char* str) const { return data == (str ? str : ""); }
@@ -59,6 +62,11 @@ public:
         return pos != std::string::npos ? static_cast<int>(pos) : -1;
     }
     
+    int lastIndexOf(char ch) const {
+        size_t pos = data.rfind(ch);
+        return pos != std::string::npos ? static_cast<int>(pos) : -1;
+    }
+    
     String substring(size_t start) const {
         return String(data.substr(start));
     }
@@ -92,6 +100,11 @@ public:
     std::string toStdString() const { return data; }
 };
 
+// "literal" + String, as Arduino's StringSumHelper allows
+inline String operator+(const char* lhs, const String& rhs) {
+    return String(lhs) + rhs;
+}
+
 // Forward declaration
 class MockFile;
 
@@ -101,14 +114,20 @@ private:
     struct FileData {
         std::vector<uint8_t> content;
         bool isDirectory;
+        time_t lastWrite;  // 0 = no timestamp (like a FAT volume without RTC time)
         
-        FileData() : isDirectory(false) {}
+        FileData() : isDirectory(false), lastWrite(0) {}
     };
     
     std::map<std::string, FileData> files;
+    unsigned long bytesRead;  // Data read through MockFile::read(buffer, len)
+    unsigned long entriesOpened;  // Directory entries opened by MockFile::openNextFile()
+    unsigned long entriesRead;    // Directory entries returned by readDir()
+    unsigned long statCalls;      // stat() lookups
+    std::map<std::string, unsigned long> opens;  // open() calls per path
     
 public:
-    MockFS() {}
+    MockFS() : bytesRead(0), entriesOpened(0), entriesRead(0), statCalls(0) {}
     
     // Add a file to the mock filesystem
     void addFile(const String& path, const std::vector<uint8_t>& content) {
@@ -130,9 +149,36 @@ public:
         files[path.toStdString()] = data;
     }
     
-    // Check if a file exists
+    // Set a file's last-write time (addFile() resets it to 0)
+    void setLastWrite(const String& path, time_t lastWrite) {
+        auto it = files.find(path.toStdString());
+        if (it != files.end()) {
+            it->second.lastWrite = lastWrite;
+        }
+    }
+    
+    time_t getLastWrite(const String& path) {
+        auto it = files.find(path.toStdString());
+        return it != files.end() ? it->second.lastWrite : 0;
+    }
+    
+    // Check if a file or directory exists
     bool exists(const String& path) {
-        return files.find(path.toStdString()) != files.end();
+        return files.find(path.toStdString()) != files.end() || isDirectoryPath(path);
+    }
+    
+    // A directory added explicitly, or implied by the files below it
+    bool isDirectoryPath(const String& path) {
+        auto it = files.find(path.toStdString());
+        if (it != files.end()) {
+            return it->second.isDirectory;
+        }
+        std::string prefix = path.toStdString();
+        if (prefix.empty() || prefix.back() != '/') {
+            prefix += '/';
+        }
+        auto next = files.lower_bound(prefix);
+        return next != files.end() && next->first.compare(0, prefix.length(), prefix) == 0;
     }
     
     // Remove a file
@@ -216,6 +262,66 @@ public:
     // Clear all files (for test cleanup)
     void clear() {
         files.clear();
+        bytesRead = 0;
+        resetDirectoryCounters();
+    }
+    
+    // Read accounting (how much data a test made the card deliver)
+    unsigned long getBytesRead() const { return bytesRead; }
+    void resetBytesRead() { bytesRead = 0; }
+    void countRead(size_t len) { bytesRead += len; }
+    
+    // Directory accounting: entries opened as files by openNextFile(),
+    // entries read by readDir() and stat() lookups (see DirectoryScanner)
+    unsigned long getEntriesOpened() const { return entriesOpened; }
+    unsigned long getEntriesRead() const { return entriesRead; }
+    unsigned long getStatCalls() const { return statCalls; }
+    void resetDirectoryCounters() { entriesOpened = 0; entriesRead = 0; statCalls = 0; opens.clear(); }
+    void countEntryOpened() { entriesOpened++; }
+    
+    // open() calls for one path since the last reset
+    unsigned long getOpenCount(const String& path) const {
+        auto it = opens.find(path.toStdString());
+        return it == opens.end() ? 0 : it->second;
+    }
+    
+    // POSIX-style directory reading, what DirectoryScanner uses on the
+    // device: readdir() gives each entry's name and type, stat() its size.
+    // Neither opens a file.
+    struct DirRecord {
+        String name;
+        bool isDirectory;
+    };
+    
+    bool readDir(const String& path, std::vector<DirRecord>& records) {
+        if (!isDirectoryPath(path)) {
+            return false;
+        }
+        String prefix = path.endsWith("/") ? path : path + "/";
+        for (const String& name : listDir(path)) {
+            DirRecord record;
+            record.name = name;
+            record.isDirectory = isDirectoryPath(prefix + name);
+            records.push_back(record);
+            entriesRead++;
+        }
+        return true;
+    }
+    
+    bool stat(const String& path, size_t& size, time_t& lastWrite) {
+        statCalls++;
+        auto it = files.find(path.toStdString());
+        if (it == files.end()) {
+            if (!isDirectoryPath(path)) {
+                return false;
+            }
+            size = 0;
+            lastWrite = 0;
+            return true;
+        }
+        size = it->second.content.size();
+        lastWrite = it->second.lastWrite;
+        return true;
     }
     
     // Internal method to set file content (used by MockFile)
@@ -236,17 +342,22 @@ private:
     size_t filePosition;
     bool isOpen;
     bool isWriteMode;
-    bool isDirectory;
+    bool directory;
+    std::vector<String> children;  // Directory entries, listed on first openNextFile()
+    size_t nextChild;
     
 public:
-    MockFile() : fs(nullptr), filePosition(0), isOpen(false), isWriteMode(false), isDirectory(false) {}
+    MockFile() : fs(nullptr), filePosition(0), isOpen(false), isWriteMode(false), directory(false), nextChild(0) {}
     
     MockFile(MockFS* filesystem, const String& filePath, const char* mode)
-        : fs(filesystem), path(filePath), filePosition(0), isOpen(false), isDirectory(false) {
+        : fs(filesystem), path(filePath), filePosition(0), isOpen(false), directory(false), nextChild(0) {
         
         isWriteMode = (mode && (strchr(mode, 'w') != nullptr || strchr(mode, 'a') != nullptr));
         
-        if (mode && strchr(mode, 'w') != nullptr) {
+        if (!isWriteMode && fs && fs->isDirectoryPath(path)) {
+            directory = true;
+            isOpen = true;
+        } else if (mode && strchr(mode, 'w') != nullptr) {
             // Write mode: truncate file (start with empty content)
             content.clear();
             isOpen = true;
@@ -272,7 +383,31 @@ public:
     }
     
     bool isDir() {
-        return isDirectory;
+        return directory;
+    }
+    
+    bool isDirectory() {
+        return directory;
+    }
+    
+    // Next entry of an open directory (an invalid file at the end)
+    MockFile openNextFile() {
+        if (!isOpen || !directory || !fs) {
+            return MockFile();
+        }
+        if (nextChild == 0 && children.empty()) {
+            children = fs->listDir(path);
+        }
+        if (nextChild >= children.size()) {
+            return MockFile();
+        }
+        String prefix = path.endsWith("/") ? path : path + "/";
+        fs->countEntryOpened();
+        return MockFile(fs, prefix + children[nextChild++], "r");
+    }
+    
+    time_t getLastWrite() {
+        return fs ? fs->getLastWrite(path) : 0;
     }
     
     String name() {
@@ -293,6 +428,9 @@ public:
         
         memcpy(buffer, content.data() + filePosition, toRead);
         filePosition += toRead;
+        if (fs) {
+            fs->countRead(toRead);
+        }
         
         return toRead;
     }
@@ -364,6 +502,7 @@ public:
 
 // Implementation of MockFS::open (needs MockFile to be defined)
 inline MockFile MockFS::open(const String& path, const char* mode) {
+    opens[path.toStdString()]++;
     return MockFile(this, path, mode);
 }
 
@@ -25,10 +25,13 @@ inline void MD5Init(struct MD5Context* context) {
 }
 
 inline void MD5Update(struct MD5Context* context, const uint8_t* input, size_t inputLen) {
-    // Simple mock: just XOR the input bytes into the state
+    // Simple mock: just XOR the input bytes into the state. The lane is
+    // picked by stream position, so the result does not depend on how the
+    // input was split across calls (like a real hash).
     for (size_t i = 0; i < inputLen; i++) {
-        context->state[i % 4] ^= input[i];
-        context->state[i % 4] = (context->state[i % 4] << 1) | (context->state[i % 4] >> 31);
+        size_t lane = (context->count[0] + i) % 4;
+        context->state[lane] ^= input[i];
+        context->state[lane] = (context->state[lane] << 1) | (context->state[lane] >> 31);
     }
     context->count[0] += inputLen;
 }
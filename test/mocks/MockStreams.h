@@ -0,0 +1,208 @@
+#ifndef MOCK_STREAMS_H
+#define MOCK_STREAMS_H
+
+#ifdef UNIT_TEST
+
+// In-memory pipeline endpoints, synthetic file contents and the backend
+// suite fixture for the stream tests (compression, codecs, backends).
+// Include after the sources under test: needs UploadPipeline.h, Crc32.h
+// and Md5Digest.h.
+
+#include "UploadPipeline.h"
+#include "Crc32.h"
+#include "Md5Digest.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// In-memory source that hands out at most `step` bytes per read
+class MemorySource : public UploadSource {
+public:
+    MemorySource(const std::vector<uint8_t>& data, size_t step = 1000000)
+        : data(data), offset(0), step(step) {}
+    MemorySource(const std::string& text, size_t step = 1000000)
+        : data(text.begin(), text.end()), offset(0), step(step) {}
+    size_t read(uint8_t* buffer, size_t len) override {
+        size_t n = len < step ? len : step;
+        if (n > data.size() - offset) {
+            n = data.size() - offset;
+        }
+        memcpy(buffer, data.data() + offset, n);
+        offset += n;
+        return n;
+    }
+private:
+    std::vector<uint8_t> data;
+    size_t offset;
+    size_t step;
+};
+
+// Sink that keeps the whole stream
+class CollectingSink : public UploadSink {
+public:
+    std::vector<uint8_t> data;
+    bool write(const uint8_t* chunk, size_t len) override {
+        data.insert(data.end(), chunk, chunk + len);
+        return true;
+    }
+};
+
+// One 16-bit little-endian EDF sample
+inline void appendSample(std::vector<uint8_t>& data, int16_t sample) {
+    data.push_back(sample & 0xFF);
+    data.push_back((sample >> 8) & 0xFF);
+}
+
+inline void putEdfField(std::string& header, const std::string& value, size_t width) {
+    std::string field = value.substr(0, width);
+    field.resize(width, ' ');
+    header += field;
+}
+
+// EDF header in the layout ResMed machines write: fixed part, then each
+// per-signal field for all signals in turn
+inline std::vector<uint8_t> makeEdfHeader(const std::vector<std::string>& labels,
+                                          const std::vector<int>& samples, int records) {
+    size_t count = labels.size();
+    std::string header;
+    putEdfField(header, "0", 8);
+    putEdfField(header, "X X X X", 80);
+    putEdfField(header, "Startdate 01-NOV-2024 X X ResMed", 80);
+    putEdfField(header, "01.11.24", 8);
+    putEdfField(header, "22.00.00", 8);
+    putEdfField(header, std::to_string(256 * (count + 1)), 8);
+    putEdfField(header, labels[0] == "EDF Annotations" ? "EDF+C" : "", 44);
+    putEdfField(header, std::to_string(records), 8);
+    putEdfField(header, "60", 8);
+    putEdfField(header, std::to_string(count), 4);
+
+    for (size_t i = 0; i < count; i++) putEdfField(header, labels[i], 16);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "", 80);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "", 8);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "-100", 8);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "100", 8);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "-32768", 8);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "32767", 8);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "", 80);
+    for (size_t i = 0; i < count; i++) putEdfField(header, std::to_string(samples[i]), 8);
+    for (size_t i = 0; i < count; i++) putEdfField(header, "", 32);
+    return std::vector<uint8_t>(header.begin(), header.end());
+}
+
+// Night file with 1-minute records.
+// kind 0 = BRP (25 Hz flow + pressure), 1 = PLD (0.5 Hz trends),
+// 2 = SAD (1 Hz oximetry), 3 = EVE (EDF+ annotations)
+inline std::vector<uint8_t> makeEdf(int kind, int minutes) {
+    std::vector<std::string> labels;
+    std::vector<int> samples;
+    if (kind == 0) {
+        labels = {"Flow.40ms", "Press.40ms", "Crc16"};
+        samples = {1500, 1500, 1};
+    } else if (kind == 1) {
+        labels = {"MaskPress.2s", "Press.2s", "EprPress.2s", "Leak.2s", "RespRate.2s",
+                  "TidVol.2s", "MinVent.2s", "Snore.2s", "FlowLim.2s", "Crc16"};
+        samples = {30, 30, 30, 30, 30, 30, 30, 30, 30, 1};
+    } else if (kind == 2) {
+        labels = {"Pulse.1s", "SpO2.1s", "Crc16"};
+        samples = {60, 60, 1};
+    } else {
+        labels = {"EDF Annotations"};
+        samples = {60};
+    }
+    std::vector<uint8_t> data = makeEdfHeader(labels, samples, minutes);
+
+    srand(42 + kind);
+    for (int minute = 0; minute < minutes; minute++) {
+        size_t recordStart = data.size();
+        if (kind == 0) {
+            for (int i = 0; i < 1500; i++) {
+                double t = (minute * 1500 + i) / 25.0;
+                double breath = sin(t * 2 * M_PI / 4.2);
+                appendSample(data, (int16_t)(420 * breath + 90 * breath * breath * breath +
+                                             (rand() % 9) - 4));
+            }
+            for (int i = 0; i < 1500; i++) {
+                appendSample(data, (int16_t)(500 + ((minute / 10) % 3) + (i % 105 < 45 ? 20 : 0)));
+            }
+        } else if (kind == 1) {
+            for (int signal = 0; signal < 9; signal++) {
+                for (int i = 0; i < 30; i++) {
+                    int value = signal * 100 + minute / 5;
+                    if (signal >= 3) {
+                        value += rand() % 5;  // Measured trends wander, set pressures do not
+                    }
+                    appendSample(data, (int16_t)value);
+                }
+            }
+        } else if (kind == 2) {
+            for (int i = 0; i < 60; i++) {
+                appendSample(data, (int16_t)(62 + (minute + i / 20) % 4));
+            }
+            for (int i = 0; i < 60; i++) {
+                appendSample(data, (int16_t)(95 + ((minute * 60 + i) / 45) % 3));
+            }
+        } else {
+            std::string annotation = "+" + std::to_string(minute * 60) + "\x14\x14";
+            if (minute % 7 == 3) {
+                annotation += "+" + std::to_string(minute * 60 + 12) + "\x15" "10\x14Hypopnea\x14";
+            }
+            annotation.resize(120, '\0');
+            data.insert(data.end(), annotation.begin(), annotation.end());
+        }
+
+        if (kind != 3) {
+            // Record checksum, as random as any CRC
+            uint16_t crc = (uint16_t)Crc32::compute(0, data.data() + recordStart, data.size() - recordStart);
+            appendSample(data, (int16_t)crc);
+        }
+    }
+    return data;
+}
+
+// Deterministic file content that differs per seed
+inline std::string makeContent(size_t size, int seed) {
+    std::string content(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        content[i] = (char)((i * 31 + seed) & 0xFF);
+    }
+    return content;
+}
+
+// Lowercase hex MD5 of a whole buffer
+inline std::string md5Hex(const std::string& data) {
+    Md5Digest digest;
+    digest.update((const uint8_t*)data.data(), data.size());
+    return digest.finishHex().c_str();
+}
+
+// Fixture for the backend suites: a fresh fake server and uploader per
+// test, wired together, over the global testFS. Defines `server`,
+// `uploader`, setUp(), tearDown() and uploadFile(path).
+#define BACKEND_TEST_FIXTURE(ServerType, BackendType, ...)      \
+    static ServerType* server;                                  \
+    static BackendType* uploader;                               \
+                                                                \
+    void setUp(void) {                                          \
+        testFS.clear();                                         \
+        MockTimeState::reset();                                 \
+        server = new ServerType();                              \
+        uploader = new BackendType(__VA_ARGS__);                \
+        uploader->setClient(server);                            \
+    }                                                           \
+                                                                \
+    void tearDown(void) {                                       \
+        delete uploader;                                        \
+        delete server;                                          \
+    }                                                           \
+                                                                \
+    static inline bool uploadFile(const String& path) {         \
+        unsigned long sent = 0;                                 \
+        return uploader->upload(path, path, testFS, sent);      \
+    }
+
+#endif // UNIT_TEST
+
+#endif // MOCK_STREAMS_H
@@ -0,0 +1,230 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+// Include the BufferPool implementation (and the pipeline that borrows from it)
+#include "BufferPool.h"
+#include "../../src/BufferPool.cpp"
+#include "UploadPipeline.h"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+
+#include <string>
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+// Sink that accepts everything
+class NullSink : public UploadSink {
+public:
+    size_t total;
+    NullSink() : total(0) {}
+    bool write(const uint8_t* data, size_t len) override {
+        total += len;
+        return true;
+    }
+};
+
+void setUp(void) {
+    testFS.clear();
+    BufferPool::getInstance().end();
+}
+
+void tearDown(void) {
+    BufferPool::getInstance().end();
+    testFS.clear();
+}
+
+// Every slot gets the wanted size, however many slots there are, unless
+// the arena would take too much of the largest free block
+void test_pool_slot_size_per_slot() {
+    BufferPool& pool = BufferPool::getInstance();
+
+    TEST_ASSERT_TRUE(pool.begin(3));  // 2 pipeline + 1 scratch
+    TEST_ASSERT_TRUE(pool.isActive());
+    TEST_ASSERT_EQUAL(3, pool.getSlotCount());
+    TEST_ASSERT_EQUAL(BUFFER_POOL_SLOT_SIZE, pool.getSlotSize());
+    pool.end();
+
+    TEST_ASSERT_TRUE(pool.begin(7, 32768, 500000));  // 2 pipeline + 4 async + 1 scratch
+    TEST_ASSERT_EQUAL(32768, pool.getSlotSize());
+    pool.end();
+
+    TEST_ASSERT_TRUE(pool.begin(7, 32768, 200000));  // 7 x 16KB is over half of it
+    TEST_ASSERT_EQUAL(8192, pool.getSlotSize());
+    pool.end();
+
+    TEST_ASSERT_TRUE(pool.begin(3, 20000));  // Rounded down to a power of two
+    TEST_ASSERT_EQUAL(16384, pool.getSlotSize());
+}
+
+// Slot size and count are clamped to the supported range
+void test_pool_limits_clamped() {
+    BufferPool& pool = BufferPool::getInstance();
+
+    TEST_ASSERT_TRUE(pool.begin(100, 1000));
+    TEST_ASSERT_EQUAL(BufferPool::MAX_SLOTS, pool.getSlotCount());
+    TEST_ASSERT_EQUAL(BUFFER_POOL_MIN_SLOT_SIZE, pool.getSlotSize());
+    pool.end();
+
+    TEST_ASSERT_TRUE(pool.begin(1, 1024 * 1024));
+    TEST_ASSERT_EQUAL(BUFFER_POOL_MAX_SLOT_SIZE, pool.getSlotSize());
+}
+
+// Slots are handed out once, reused after release, and tracked
+void test_pool_acquire_release_reuse() {
+    BufferPool& pool = BufferPool::getInstance();
+    TEST_ASSERT_TRUE(pool.begin(3, 4096));
+    unsigned long fallbacks = pool.getFallbackCount();
+
+    uint8_t* a = pool.acquire(4096);
+    uint8_t* b = pool.acquire(100);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_TRUE(a != b);
+    TEST_ASSERT_EQUAL(2, pool.getSlotsInUse());
+
+    memset(a, 0xAA, 4096);  // Whole slot is writable
+    memset(b, 0xBB, 4096);
+    TEST_ASSERT_EQUAL(0xAA, a[4095]);
+
+    pool.release(a);
+    TEST_ASSERT_EQUAL(1, pool.getSlotsInUse());
+    uint8_t* c = pool.acquire(4096);
+    TEST_ASSERT_TRUE(c == a);  // Freed slot is reused
+
+    pool.release(b);
+    pool.release(c);
+    TEST_ASSERT_EQUAL(0, pool.getSlotsInUse());
+    TEST_ASSERT_EQUAL(2, pool.getPeakSlotsInUse());
+    TEST_ASSERT_EQUAL(fallbacks, pool.getFallbackCount());
+}
+
+// An exhausted pool falls back to malloc and counts it
+void test_pool_exhausted_falls_back() {
+    BufferPool& pool = BufferPool::getInstance();
+    TEST_ASSERT_TRUE(pool.begin(2, 4096));
+    unsigned long fallbacks = pool.getFallbackCount();
+
+    uint8_t* a = pool.acquire(4096);
+    uint8_t* b = pool.acquire(4096);
+    uint8_t* extra = pool.acquire(4096);
+    TEST_ASSERT_NOT_NULL(extra);
+    TEST_ASSERT_EQUAL(fallbacks + 1, pool.getFallbackCount());
+    TEST_ASSERT_EQUAL(2, pool.getSlotsInUse());
+
+    pool.release(extra);  // Freed, not returned to the pool
+    TEST_ASSERT_EQUAL(2, pool.getSlotsInUse());
+    pool.release(a);
+    pool.release(b);
+    TEST_ASSERT_EQUAL(0, pool.getSlotsInUse());
+}
+
+// Requests larger than a slot, or before begin(), use malloc
+void test_pool_oversize_and_inactive_fall_back() {
+    BufferPool& pool = BufferPool::getInstance();
+    unsigned long fallbacks = pool.getFallbackCount();
+
+    uint8_t* early = pool.acquire(1000);  // Pool not started
+    TEST_ASSERT_NOT_NULL(early);
+    TEST_ASSERT_EQUAL(fallbacks + 1, pool.getFallbackCount());
+    pool.release(early);
+
+    TEST_ASSERT_TRUE(pool.begin(2, 4096));
+    uint8_t* big = pool.acquire(4097);
+    TEST_ASSERT_NOT_NULL(big);
+    TEST_ASSERT_EQUAL(fallbacks + 2, pool.getFallbackCount());
+    TEST_ASSERT_EQUAL(0, pool.getSlotsInUse());
+    pool.release(big);
+}
+
+// Releasing a slot twice does not corrupt the accounting
+void test_pool_double_release_ignored() {
+    BufferPool& pool = BufferPool::getInstance();
+    TEST_ASSERT_TRUE(pool.begin(2, 4096));
+
+    uint8_t* a = pool.acquire(4096);
+    uint8_t* b = pool.acquire(4096);
+    pool.release(a);
+    pool.release(a);
+    TEST_ASSERT_EQUAL(1, pool.getSlotsInUse());
+    pool.release(nullptr);
+    pool.release(b);
+    TEST_ASSERT_EQUAL(0, pool.getSlotsInUse());
+}
+
+// Repeated uploads through the pipeline borrow from the pool only
+void test_pool_steady_state_pipeline_allocates_nothing() {
+    BufferPool& pool = BufferPool::getInstance();
+    TEST_ASSERT_TRUE(pool.begin(UPLOAD_PIPELINE_BUFFER_COUNT + 1));
+
+    std::vector<uint8_t> content(50000, 0x5A);
+    testFS.addFile("/DATALOG/20241101/BRP.edf", content);
+
+    unsigned long fallbacks = pool.getFallbackCount();
+    for (int i = 0; i < 20; i++) {
+        UploadPipeline pipeline(pool.getSlotSize(), UPLOAD_PIPELINE_BUFFER_COUNT);
+        TEST_ASSERT_TRUE(pipeline.begin());
+
+        fs::File file = testFS.open("/DATALOG/20241101/BRP.edf", FILE_READ);
+        NullSink sink;
+        unsigned long bytesTransferred = 0;
+        TEST_ASSERT_TRUE(pipeline.run(file, content.size(), sink, bytesTransferred));
+        TEST_ASSERT_EQUAL(content.size(), sink.total);
+        file.close();
+
+        pipeline.end();
+        TEST_ASSERT_EQUAL(0, pool.getSlotsInUse());
+    }
+
+    TEST_ASSERT_EQUAL(fallbacks, pool.getFallbackCount());
+    TEST_ASSERT_EQUAL(UPLOAD_PIPELINE_BUFFER_COUNT, pool.getPeakSlotsInUse());
+}
+
+// Fragmentation is the share of free heap outside the largest block
+void test_fragmentation_percent() {
+    TEST_ASSERT_EQUAL(0, BufferPool::fragmentationPercent(0, 0));
+    TEST_ASSERT_EQUAL(0, BufferPool::fragmentationPercent(100000, 100000));
+    TEST_ASSERT_EQUAL(50, BufferPool::fragmentationPercent(200000, 100000));
+    TEST_ASSERT_EQUAL(75, BufferPool::fragmentationPercent(160000, 40000));
+}
+
+// The /status heap report carries the pool counters
+void test_heap_report_json() {
+    BufferPool& pool = BufferPool::getInstance();
+    TEST_ASSERT_TRUE(pool.begin(3, 16384));
+    uint8_t* a = pool.acquire(1024);
+
+    std::string json = pool.getHeapReportJSON().c_str();
+    TEST_ASSERT_TRUE(json.find("\"pool_slot_size\":16384") != std::string::npos);
+    TEST_ASSERT_TRUE(json.find("\"pool_slots\":3") != std::string::npos);
+    TEST_ASSERT_TRUE(json.find("\"pool_in_use\":1") != std::string::npos);
+    TEST_ASSERT_TRUE(json.find("\"fragmentation_percent\":") != std::string::npos);
+    TEST_ASSERT_EQUAL('}', json[json.size() - 1]);
+
+    pool.release(a);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pool_slot_size_per_slot);
+    RUN_TEST(test_pool_limits_clamped);
+    RUN_TEST(test_pool_acquire_release_reuse);
+    RUN_TEST(test_pool_exhausted_falls_back);
+    RUN_TEST(test_pool_oversize_and_inactive_fall_back);
+    RUN_TEST(test_pool_double_release_ignored);
+    RUN_TEST(test_pool_steady_state_pipeline_allocates_nothing);
+    RUN_TEST(test_fragmentation_percent);
+    RUN_TEST(test_heap_report_json);
+
+    return UNITY_END();
+}
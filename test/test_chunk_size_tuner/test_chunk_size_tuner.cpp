@@ -0,0 +1,306 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+// Include the ChunkSizeTuner implementation
+#include "ChunkSizeTuner.h"
+#include "../../src/ChunkSizeTuner.cpp"
+
+#include <cmath>
+
+static const size_t KB = 1024;
+static const uint32_t LARGE_MAX_WRITE = 1024 * 1024;   // Typical Samba negotiated max write
+
+/**
+ * Simulated link for the chunk size sweep
+ *
+ * Per chunk the network side pays a fixed request cost, its share of the
+ * round trip (divided by the write window) and the wire time. The SD side
+ * pays a per-read setup cost and the card's streaming time. The upload
+ * pipeline overlaps the two, so a chunk costs the slower of both.
+ */
+struct SimulatedLink {
+    const char* name;
+    double rttMs;
+    double wifiKBps;
+    double requestOverheadMs;  // SMB header + lwIP + libsmb2 per write
+    int window;                // Outstanding writes
+    double sdReadKBps;
+    double sdOpMs;             // Per-read command overhead on SD_MMC
+
+    double chunkMs(size_t chunk) const {
+        double kb = chunk / 1024.0;
+        double net = requestOverheadMs + rttMs / window + kb * 1000.0 / wifiKBps;
+        double sd = sdOpMs + kb * 1000.0 / sdReadKBps;
+        return net > sd ? net : sd;
+    }
+
+    unsigned long transferMs(size_t chunk, unsigned long bytes) const {
+        unsigned long chunks = (bytes + chunk - 1) / chunk;
+        return (unsigned long)ceil(chunks * chunkMs(chunk));
+    }
+
+    unsigned long rateBps(size_t chunk) const {
+        return (unsigned long)(chunk * 1000.0 / chunkMs(chunk));
+    }
+};
+
+static const SimulatedLink LINKS[] = {
+    { "strong Wi-Fi, sync",  3.0, 1200.0, 1.0, 1, 9000.0, 0.8 },
+    { "weak Wi-Fi, sync",   25.0,  250.0, 1.5, 1, 9000.0, 0.8 },
+    { "weak Wi-Fi, window 4", 25.0, 250.0, 1.5, 4, 9000.0, 0.8 },
+    { "slow card, LAN",      2.0, 1500.0, 1.0, 4, 1200.0, 6.0 },
+};
+
+// Feed simulated 1MB files until the tuner settles (or give up)
+static int runUntilSettled(ChunkSizeTuner& tuner, const SimulatedLink& link, int maxFiles = 200) {
+    const unsigned long fileBytes = 1024 * 1024;
+    int files = 0;
+    while (!tuner.isSettled() && files < maxFiles) {
+        size_t chunk = tuner.getChunkSize();
+        tuner.recordTransfer(chunk, fileBytes, link.transferMs(chunk, fileBytes));
+        files++;
+    }
+    return files;
+}
+
+// Feed a transfer at a fixed rate for the tuner's current size
+static void feedRate(ChunkSizeTuner& tuner, unsigned long bytesPerSec) {
+    unsigned long bytes = ChunkSizeTuner::MIN_SAMPLE_BYTES;
+    tuner.recordTransfer(tuner.getChunkSize(), bytes, bytes * 1000 / bytesPerSec);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// With room to spare the tuner starts at the default size
+void test_starts_at_default_size() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+
+    TEST_ASSERT_EQUAL(CHUNK_TUNER_DEFAULT_SIZE, tuner.getChunkSize());
+    TEST_ASSERT_EQUAL(64 * KB, tuner.getCeiling());
+    TEST_ASSERT_FALSE(tuner.isSettled());
+}
+
+// A small negotiated max write caps the chunk size
+void test_ceiling_limited_by_server_max_write() {
+    ChunkSizeTuner tuner;
+    tuner.begin(8192, 1024 * 1024, 2);
+
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getCeiling());
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getChunkSize());
+}
+
+// Every buffer of the upload must fit in the heap share
+void test_ceiling_limited_by_heap() {
+    ChunkSizeTuner tuner;
+    // 50% of 100000 over 6 buffers (2 pipeline + 4 async slots) = 8333
+    tuner.begin(LARGE_MAX_WRITE, 100000, 6);
+
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getCeiling());
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getChunkSize());
+}
+
+// With a buffer pool the slot size is the limit, not the heap
+void test_ceiling_limited_by_pool_slot() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 8192);
+
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getCeiling());
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getChunkSize());
+}
+
+// The smallest size is used even when the heap is nearly exhausted
+void test_ceiling_never_below_minimum() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 6000, 2);
+
+    TEST_ASSERT_EQUAL(CHUNK_TUNER_MIN_SIZE, tuner.getCeiling());
+    TEST_ASSERT_EQUAL(CHUNK_TUNER_MIN_SIZE, tuner.getChunkSize());
+}
+
+// Unknown max write (0) leaves the heap as the only limit
+void test_unknown_max_write_uses_heap_limit() {
+    ChunkSizeTuner tuner;
+    tuner.begin(0, 1024 * 1024, 2);
+
+    TEST_ASSERT_EQUAL(CHUNK_TUNER_MAX_SIZE, tuner.getCeiling());
+}
+
+// No decision is made until enough bytes have been measured
+void test_small_samples_accumulate() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+
+    TEST_ASSERT_FALSE(tuner.recordTransfer(16 * KB, 100 * KB, 1000));
+    TEST_ASSERT_EQUAL(0, tuner.getMeasuredRate(16 * KB));
+    TEST_ASSERT_EQUAL(16 * KB, tuner.getChunkSize());
+
+    // Second file completes the sample: 256KB in 2.5s
+    TEST_ASSERT_TRUE(tuner.recordTransfer(16 * KB, 156 * KB, 1500));
+    TEST_ASSERT_EQUAL(256 * KB * 1000 / 2500, tuner.getMeasuredRate(16 * KB));
+    TEST_ASSERT_EQUAL(32 * KB, tuner.getChunkSize());  // Probing upwards first
+}
+
+// Samples recorded with a size the tuner has moved away from are ignored
+void test_stale_samples_ignored() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+
+    TEST_ASSERT_FALSE(tuner.recordTransfer(8 * KB, 1024 * KB, 1000));
+    TEST_ASSERT_FALSE(tuner.recordTransfer(12345, 1024 * KB, 1000));
+    TEST_ASSERT_EQUAL(0, tuner.getMeasuredRate(8 * KB));
+    TEST_ASSERT_EQUAL(16 * KB, tuner.getChunkSize());
+}
+
+// When bigger is always faster the tuner climbs to the ceiling and stays
+void test_climbs_to_ceiling_when_larger_is_faster() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+
+    unsigned long rates[] = { 40000, 60000, 80000, 100000, 120000 };  // 4..64KB
+    for (int i = 0; i < 10 && !tuner.isSettled(); i++) {
+        int index = 0;
+        while ((size_t)(4096 << index) != tuner.getChunkSize()) index++;
+        feedRate(tuner, rates[index]);
+    }
+
+    TEST_ASSERT_TRUE(tuner.isSettled());
+    TEST_ASSERT_EQUAL(64 * KB, tuner.getChunkSize());
+}
+
+// A peak below the start is found by reversing direction
+void test_finds_peak_below_start() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+
+    unsigned long rates[] = { 70000, 100000, 80000, 60000, 50000 };  // Peak at 8KB
+    for (int i = 0; i < 10 && !tuner.isSettled(); i++) {
+        int index = 0;
+        while ((size_t)(4096 << index) != tuner.getChunkSize()) index++;
+        feedRate(tuner, rates[index]);
+    }
+
+    TEST_ASSERT_TRUE(tuner.isSettled());
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getChunkSize());
+    TEST_ASSERT_EQUAL(0, tuner.getMeasuredRate(64 * KB));  // Never probed past the drop
+}
+
+// Differences inside the hysteresis band do not cause a move
+void test_hysteresis_keeps_current_size() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+
+    feedRate(tuner, 100000);                 // 16KB
+    TEST_ASSERT_EQUAL(32 * KB, tuner.getChunkSize());
+    feedRate(tuner, 102000);                 // 32KB: unmeasured 64KB is probed next
+    TEST_ASSERT_EQUAL(64 * KB, tuner.getChunkSize());
+    feedRate(tuner, 101000);                 // 64KB: 32KB is only 1% faster
+    TEST_ASSERT_TRUE(tuner.isSettled());
+    TEST_ASSERT_EQUAL(64 * KB, tuner.getChunkSize());
+}
+
+// A settled tuner re-probes its neighbours and follows a changed link
+void test_reprobe_follows_changed_link() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+
+    unsigned long before[] = { 40000, 60000, 80000, 100000, 120000 };
+    unsigned long after[]  = { 90000, 100000, 60000, 40000, 20000 };  // Link got lossy
+    for (int i = 0; i < 10 && !tuner.isSettled(); i++) {
+        int index = 0;
+        while ((size_t)(4096 << index) != tuner.getChunkSize()) index++;
+        feedRate(tuner, before[index]);
+    }
+    TEST_ASSERT_EQUAL(64 * KB, tuner.getChunkSize());
+
+    // Settled samples keep the size until the re-probe interval elapses
+    for (int i = 0; i < ChunkSizeTuner::REPROBE_INTERVAL - 1; i++) {
+        feedRate(tuner, after[4]);
+        TEST_ASSERT_EQUAL(64 * KB, tuner.getChunkSize());
+    }
+
+    for (int i = 0; i < 40 && tuner.getChunkSize() != 8 * KB; i++) {
+        int index = 0;
+        while ((size_t)(4096 << index) != tuner.getChunkSize()) index++;
+        feedRate(tuner, after[index]);
+    }
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getChunkSize());
+}
+
+// A reconnect with less heap pulls the current size under the new ceiling
+void test_reconnect_lowers_ceiling() {
+    ChunkSizeTuner tuner;
+    tuner.begin(LARGE_MAX_WRITE, 1024 * 1024, 2);
+    TEST_ASSERT_EQUAL(16 * KB, tuner.getChunkSize());
+
+    tuner.begin(LARGE_MAX_WRITE, 40000, 2);  // 20000 / 2 = 10000 per buffer
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getCeiling());
+    TEST_ASSERT_EQUAL(8 * KB, tuner.getChunkSize());
+    TEST_ASSERT_FALSE(tuner.recordTransfer(16 * KB, 1024 * KB, 1000));  // Old size is stale
+}
+
+// Benchmark: sweep every chunk size over simulated links and check that the
+// tuner lands within the hysteresis band of the best size under its ceiling
+void test_benchmark_chunk_size_sweep() {
+    printf("\n[Benchmark] Simulated upload throughput (KB/s) by chunk size\n");
+    printf("%-22s", "link");
+    for (size_t chunk = CHUNK_TUNER_MIN_SIZE; chunk <= CHUNK_TUNER_MAX_SIZE; chunk *= 2) {
+        printf("%8uK", (unsigned)(chunk / 1024));
+    }
+    printf("   tuned  (files)\n");
+
+    for (size_t l = 0; l < sizeof(LINKS) / sizeof(LINKS[0]); l++) {
+        const SimulatedLink& link = LINKS[l];
+
+        unsigned long bestRate = 0;
+        printf("%-22s", link.name);
+        for (size_t chunk = CHUNK_TUNER_MIN_SIZE; chunk <= CHUNK_TUNER_MAX_SIZE; chunk *= 2) {
+            unsigned long r = link.rateBps(chunk);
+            if (r > bestRate) {
+                bestRate = r;
+            }
+            printf("%9lu", r / 1024);
+        }
+
+        ChunkSizeTuner tuner;
+        tuner.begin(0, 1024 * 1024, 2 + (link.window > 1 ? link.window : 0));
+        int files = runUntilSettled(tuner, link);
+        printf("%7uK  (%d)\n", (unsigned)(tuner.getChunkSize() / 1024), files);
+
+        TEST_ASSERT_TRUE(tuner.isSettled());
+        unsigned long tunedRate = link.rateBps(tuner.getChunkSize());
+        TEST_ASSERT_TRUE(tunedRate * 100 >= bestRate * (100 - ChunkSizeTuner::HYSTERESIS_PERCENT));
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_starts_at_default_size);
+    RUN_TEST(test_ceiling_limited_by_server_max_write);
+    RUN_TEST(test_ceiling_limited_by_heap);
+    RUN_TEST(test_ceiling_limited_by_pool_slot);
+    RUN_TEST(test_ceiling_never_below_minimum);
+    RUN_TEST(test_unknown_max_write_uses_heap_limit);
+    RUN_TEST(test_small_samples_accumulate);
+    RUN_TEST(test_stale_samples_ignored);
+    RUN_TEST(test_climbs_to_ceiling_when_larger_is_faster);
+    RUN_TEST(test_finds_peak_below_start);
+    RUN_TEST(test_hysteresis_keeps_current_size);
+    RUN_TEST(test_reprobe_follows_changed_link);
+    RUN_TEST(test_reconnect_lowers_ceiling);
+    RUN_TEST(test_benchmark_chunk_size_sweep);
+
+    return UNITY_END();
+}
@@ -336,6 +336,181 @@ void test_config_all_timing_fields() {
     TEST_ASSERT_EQUAL(750, config.getSdReleaseWaitMs());
 }
 
+// Test SMB write window configuration
+void test_config_smb_write_window() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "SMB_WRITE_WINDOW": 4
+    })";
+    
+    mockSD.addFile("/config.json", configContent);
+    
+    Config config;
+    TEST_ASSERT_TRUE(config.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL(4, config.getSmbWriteWindow());
+}
+
+// Test SMB write window default and clamping
+void test_config_smb_write_window_default_and_clamp() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share"
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config defaults;
+    TEST_ASSERT_TRUE(defaults.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL(1, defaults.getSmbWriteWindow());
+    
+    configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "SMB_WRITE_WINDOW": 64
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config clamped;
+    TEST_ASSERT_TRUE(clamped.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL(8, clamped.getSmbWriteWindow());
+}
+
+// Test SMB session keepalive and idle timeout configuration
+void test_config_smb_keepalive() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share"
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config defaults;
+    TEST_ASSERT_TRUE(defaults.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL(60, defaults.getSmbKeepaliveSeconds());
+    TEST_ASSERT_EQUAL(900, defaults.getSmbIdleTimeoutSeconds());
+    
+    configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "SMB_KEEPALIVE_SECONDS": 0,
+        "SMB_IDLE_TIMEOUT_SECONDS": 3600
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config custom;
+    TEST_ASSERT_TRUE(custom.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL(0, custom.getSmbKeepaliveSeconds());
+    TEST_ASSERT_EQUAL(3600, custom.getSmbIdleTimeoutSeconds());
+}
+
+// Test DATALOG archive mode flag
+void test_config_datalog_archive() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share"
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config defaults;
+    TEST_ASSERT_TRUE(defaults.loadFromSD(mockSD));
+    TEST_ASSERT_FALSE(defaults.isDatalogArchiveEnabled());
+    
+    configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "DATALOG_ARCHIVE": true
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config archive;
+    TEST_ASSERT_TRUE(archive.loadFromSD(mockSD));
+    TEST_ASSERT_TRUE(archive.isDatalogArchiveEnabled());
+}
+
+// Test the WebDAV certificate check opt-out
+void test_config_webdav_tls_insecure() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "https://cloud.example.com/dav"
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config defaults;
+    TEST_ASSERT_TRUE(defaults.loadFromSD(mockSD));
+    TEST_ASSERT_FALSE(defaults.isWebdavTlsInsecure());
+    
+    configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "https://nas.local/dav",
+        "WEBDAV_TLS_INSECURE": true
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config insecure;
+    TEST_ASSERT_TRUE(insecure.loadFromSD(mockSD));
+    TEST_ASSERT_TRUE(insecure.isWebdavTlsInsecure());
+}
+
+// Test upload compression flag
+void test_config_compress_uploads() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share"
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config defaults;
+    TEST_ASSERT_TRUE(defaults.loadFromSD(mockSD));
+    TEST_ASSERT_FALSE(defaults.isCompressionEnabled());
+    
+    configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "COMPRESS_UPLOADS": true
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config compressed;
+    TEST_ASSERT_TRUE(compressed.loadFromSD(mockSD));
+    TEST_ASSERT_TRUE(compressed.isCompressionEnabled());
+}
+
+// Test compression codec selection
+void test_config_compression_codec() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "COMPRESS_UPLOADS": true
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config defaults;
+    TEST_ASSERT_TRUE(defaults.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL_STRING("GZIP", defaults.getCompressionCodec().c_str());
+    
+    configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "COMPRESS_UPLOADS": true,
+        "COMPRESSION_CODEC": "edf"
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config edf;
+    TEST_ASSERT_TRUE(edf.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL_STRING("EDF", edf.getCompressionCodec().c_str());
+    
+    configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "ENDPOINT": "//server/share",
+        "COMPRESSION_CODEC": "ZSTD"
+    })";
+    mockSD.addFile("/config.json", configContent);
+    
+    Config unknown;
+    TEST_ASSERT_TRUE(unknown.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL_STRING("GZIP", unknown.getCompressionCodec().c_str());
+}
+
 
 // ============================================================================
 // CREDENTIAL SECURITY TESTS (Preferences-based secure storage)
@@ -924,6 +1099,13 @@ int main(int argc, char **argv) {
     RUN_TEST(test_config_high_retry_attempts);
     RUN_TEST(test_config_boot_delay_and_sd_release);
     RUN_TEST(test_config_all_timing_fields);
+    RUN_TEST(test_config_smb_write_window);
+    RUN_TEST(test_config_smb_write_window_default_and_clamp);
+    RUN_TEST(test_config_smb_keepalive);
+    RUN_TEST(test_config_datalog_archive);
+    RUN_TEST(test_config_webdav_tls_insecure);
+    RUN_TEST(test_config_compress_uploads);
+    RUN_TEST(test_config_compression_codec);
     
     // Credential security tests (Preferences-based)
     RUN_TEST(test_config_plain_text_mode);
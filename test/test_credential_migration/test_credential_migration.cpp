@@ -187,6 +187,38 @@ void test_migration_mixed_state() {
     TEST_ASSERT_EQUAL_STRING("PlainEndpointPass", config.getEndpointPassword().c_str());
 }
 
+void test_migration_mirror_endpoint() {
+    std::string configContent = R"({
+        "WIFI_SSID": "TestNetwork",
+        "WIFI_PASS": "MyWifiPass123",
+        "ENDPOINT": "//server/share",
+        "ENDPOINT_PASS": "MyEndpointPass456",
+        "MIRROR_ENDPOINT_TYPE": "SLEEPHQ",
+        "MIRROR_ENDPOINT_USER": "client-id",
+        "MIRROR_ENDPOINT_PASS": "MyMirrorSecret789"
+    })";
+    
+    mockSD.addFile("/config.json", configContent);
+    
+    Config config;
+    TEST_ASSERT_TRUE(config.loadFromSD(mockSD));
+    TEST_ASSERT_TRUE(config.hasMirrorEndpoint());
+    EndpointConfig mirror = config.getMirrorEndpoint();
+    TEST_ASSERT_EQUAL_STRING("SLEEPHQ", mirror.type.c_str());
+    TEST_ASSERT_EQUAL_STRING("client-id", mirror.user.c_str());
+    TEST_ASSERT_EQUAL_STRING("MyMirrorSecret789", mirror.password.c_str());
+    
+    std::vector<uint8_t> updatedBytes = mockSD.getFileContent("/config.json");
+    std::string updatedConfig(updatedBytes.begin(), updatedBytes.end());
+    TEST_ASSERT_TRUE(updatedConfig.find("MyMirrorSecret789") == std::string::npos);
+    
+    // Next boot reads the mirror secret back from flash
+    Config reloaded;
+    TEST_ASSERT_TRUE(reloaded.loadFromSD(mockSD));
+    TEST_ASSERT_EQUAL_STRING("MyMirrorSecret789", reloaded.getMirrorEndpoint().password.c_str());
+    TEST_ASSERT_EQUAL_STRING("MyEndpointPass456", reloaded.getPrimaryEndpoint().password.c_str());
+}
+
 int main(int argc, char **argv) {
     UNITY_BEGIN();
     
@@ -196,6 +228,7 @@ int main(int argc, char **argv) {
     RUN_TEST(test_migration_empty_credentials);
     RUN_TEST(test_migration_persistence);
     RUN_TEST(test_migration_mixed_state);
+    RUN_TEST(test_migration_mirror_endpoint);
     
     UNITY_END();
     
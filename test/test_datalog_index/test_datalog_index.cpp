@@ -0,0 +1,227 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+#include "../mocks/ArduinoJson.h"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+#include "DatalogIndex.h"
+#include "../../src/Crc32.cpp"
+#include "../../src/DatalogIndex.cpp"
+
+#include <cstdlib>
+
+// Global mock filesystem for tests (the SD card)
+MockFS testFS;
+
+static const time_t JAN_10_2024 = 1704880800;  // 2024-01-10 10:00 UTC
+
+void setUp(void) {
+    testFS.clear();
+    MockTimeState::reset();
+    MockTimeState::setTime(JAN_10_2024);
+    setenv("TZ", "UTC0", 1);
+    tzset();
+}
+
+void tearDown(void) {
+    testFS.clear();
+}
+
+// Index built by a walk of the given folders
+static void buildIndex(DatalogIndex& index, const std::vector<uint32_t>& dates) {
+    TEST_ASSERT_TRUE(index.attach(testFS));
+    index.beginWalk();
+    for (uint32_t date : dates) {
+        index.addFolder(date);
+    }
+    index.finishWalk(time(NULL));
+}
+
+void test_folder_names() {
+    TEST_ASSERT_EQUAL_UINT32(20240131, DatalogIndex::parseFolderName("20240131"));
+    TEST_ASSERT_EQUAL_UINT32(0, DatalogIndex::parseFolderName("2024013"));
+    TEST_ASSERT_EQUAL_UINT32(0, DatalogIndex::parseFolderName("2024013a"));
+    TEST_ASSERT_EQUAL_UINT32(0, DatalogIndex::parseFolderName("20241301"));
+    TEST_ASSERT_EQUAL_STRING("20240131", DatalogIndex::folderName(20240131).c_str());
+
+    TEST_ASSERT_EQUAL_UINT32(20240201, DatalogIndex::addDays(20240131, 1));
+    TEST_ASSERT_EQUAL_UINT32(20240229, DatalogIndex::addDays(20240228, 1));
+    TEST_ASSERT_EQUAL_UINT32(20250101, DatalogIndex::addDays(20241231, 1));
+    TEST_ASSERT_EQUAL_UINT32(20231231, DatalogIndex::addDays(20240101, -1));
+    TEST_ASSERT_EQUAL_UINT32(20240110, DatalogIndex::dateOf(JAN_10_2024));
+}
+
+// Records survive a save and a load, sorted by date
+void test_save_load_round_trip() {
+    DatalogIndex index;
+    buildIndex(index, {20240105, 20240103, 20240104});
+    index.recordListing(20240104, 7, 123456);
+    index.recordListing(20240105, 0, 0);
+    TEST_ASSERT_TRUE(index.save(testFS));
+    TEST_ASSERT_FALSE(index.isDirty());
+
+    DatalogIndex loaded;
+    TEST_ASSERT_TRUE(loaded.load(testFS));
+    TEST_ASSERT_EQUAL_UINT32(index.getIndexId(), loaded.getIndexId());
+    TEST_ASSERT_EQUAL_UINT32(index.getLastWalkTime(), loaded.getLastWalkTime());
+    TEST_ASSERT_EQUAL(3, loaded.getFolderCount());
+    TEST_ASSERT_EQUAL_UINT32(20240103, loaded.getFolders()[0].date);
+    TEST_ASSERT_EQUAL_UINT32(20240105, loaded.getNewestDate());
+
+    DatalogIndex::Entry* entry = loaded.find(20240104);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL(DatalogIndex::FOLDER_HAS_FILES, entry->state);
+    TEST_ASSERT_EQUAL(7, entry->entries);
+    TEST_ASSERT_EQUAL_UINT32(123456, entry->bytes);
+    TEST_ASSERT_EQUAL(DatalogIndex::FOLDER_EMPTY, loaded.find(20240105)->state);
+    TEST_ASSERT_EQUAL(DatalogIndex::FOLDER_NEW, loaded.find(20240103)->state);
+    TEST_ASSERT_NULL(loaded.find(20240106));
+}
+
+// A damaged index file is ignored and rebuilt
+void test_damaged_index_rebuilt() {
+    DatalogIndex index;
+    buildIndex(index, {20240101, 20240102});
+    TEST_ASSERT_TRUE(index.save(testFS));
+
+    std::vector<uint8_t> content = testFS.getFileContent("/.datalog_index");
+    content[content.size() - 6] ^= 0x01;
+    testFS.addFile("/.datalog_index", content);
+
+    DatalogIndex reloaded;
+    TEST_ASSERT_FALSE(reloaded.load(testFS));
+    TEST_ASSERT_TRUE(reloaded.attach(testFS));
+    TEST_ASSERT_FALSE(reloaded.isBuilt());
+    TEST_ASSERT_EQUAL(0, reloaded.getFolderCount());
+
+    // Truncated file
+    content.resize(content.size() - 4);
+    testFS.addFile("/.datalog_index", content);
+    TEST_ASSERT_TRUE(reloaded.attach(testFS));
+}
+
+// A swapped card brings its own index, or none
+void test_card_swap_detected() {
+    DatalogIndex index;
+    buildIndex(index, {20240101, 20240102});
+    TEST_ASSERT_TRUE(index.save(testFS));
+    TEST_ASSERT_FALSE(index.attach(testFS));  // Same card: nothing to do
+    std::vector<uint8_t> cardA = testFS.getFileContent("/.datalog_index");
+
+    // Card B, indexed by another device session
+    testFS.clear();
+    DatalogIndex other;
+    buildIndex(other, {20230601});
+    TEST_ASSERT_TRUE(other.save(testFS));
+    TEST_ASSERT_TRUE(index.getIndexId() != other.getIndexId());
+
+    TEST_ASSERT_FALSE(index.attach(testFS));
+    TEST_ASSERT_EQUAL(1, index.getFolderCount());
+    TEST_ASSERT_EQUAL_UINT32(20230601, index.getNewestDate());
+
+    // Card C without an index: rebuilt with a new id
+    testFS.clear();
+    uint32_t idB = index.getIndexId();
+    TEST_ASSERT_TRUE(index.attach(testFS));
+    TEST_ASSERT_EQUAL(0, index.getFolderCount());
+    TEST_ASSERT_TRUE(idB != index.getIndexId());
+
+    // Card A back in
+    testFS.addFile("/.datalog_index", cardA);
+    TEST_ASSERT_FALSE(index.attach(testFS));
+    TEST_ASSERT_EQUAL(2, index.getFolderCount());
+}
+
+// Only the dates after the newest folder are checked, up to tomorrow
+void test_probe_dates() {
+    DatalogIndex index;
+    TEST_ASSERT_FALSE(index.canProbe(time(NULL)));  // Not built
+
+    buildIndex(index, {20231220, 20240107});
+    TEST_ASSERT_TRUE(index.canProbe(time(NULL)));
+    std::vector<uint32_t> dates = index.getProbeDates(time(NULL));
+    TEST_ASSERT_EQUAL(4, dates.size());
+    TEST_ASSERT_EQUAL_UINT32(20240108, dates.front());
+    TEST_ASSERT_EQUAL_UINT32(20240111, dates.back());
+
+    // Clock not set
+    TEST_ASSERT_FALSE(index.canProbe(1000));
+
+    // Weekly safety-net walk
+    TEST_ASSERT_TRUE(index.canProbe(time(NULL) + (DATALOG_INDEX_RESCAN_DAYS - 1) * 86400));
+    TEST_ASSERT_FALSE(index.canProbe(time(NULL) + DATALOG_INDEX_RESCAN_DAYS * 86400));
+
+    // Gap longer than the probe window since the newest folder
+    DatalogIndex stale;
+    testFS.clear();
+    buildIndex(stale, {20231130});
+    TEST_ASSERT_FALSE(stale.canProbe(time(NULL)));
+}
+
+// A walk keeps what earlier listings found and drops deleted folders
+void test_walk_keeps_records() {
+    DatalogIndex index;
+    buildIndex(index, {20240101, 20240102, 20240103});
+    index.recordListing(20240102, 4, 4096);
+
+    index.beginWalk();
+    TEST_ASSERT_FALSE(index.addFolder(20240103));
+    TEST_ASSERT_FALSE(index.addFolder(20240102));
+    TEST_ASSERT_TRUE(index.addFolder(20240104));
+    index.finishWalk(time(NULL));
+
+    TEST_ASSERT_EQUAL(3, index.getFolderCount());
+    TEST_ASSERT_NULL(index.find(20240101));
+    TEST_ASSERT_EQUAL_UINT32(20240102, index.getFolders()[0].date);
+    TEST_ASSERT_EQUAL(4, index.find(20240102)->entries);
+    TEST_ASSERT_EQUAL_UINT32(4096, index.find(20240102)->bytes);
+    TEST_ASSERT_EQUAL(DatalogIndex::FOLDER_NEW, index.find(20240104)->state);
+
+    // Probed folders are inserted in order
+    TEST_ASSERT_TRUE(index.addFolder(20240110));
+    TEST_ASSERT_FALSE(index.addFolder(20240110));
+    TEST_ASSERT_EQUAL_UINT32(20240110, index.getNewestDate());
+
+    // Listed flags only last for one session
+    TEST_ASSERT_TRUE(index.find(20240102)->listed);
+    index.resetListed();
+    TEST_ASSERT_FALSE(index.find(20240102)->listed);
+}
+
+// Ten years of nightly folders: 12 bytes a folder on the card
+void test_ten_year_index_size() {
+    DatalogIndex index;
+    std::vector<uint32_t> dates;
+    for (uint32_t date = 20140101; dates.size() < 3653; date = DatalogIndex::addDays(date, 1)) {
+        dates.push_back(date);
+    }
+    buildIndex(index, dates);
+    TEST_ASSERT_TRUE(index.save(testFS));
+    TEST_ASSERT_EQUAL(20 + 3653 * 12 + 4, testFS.getFileContent("/.datalog_index").size());
+
+    DatalogIndex loaded;
+    TEST_ASSERT_TRUE(loaded.load(testFS));
+    TEST_ASSERT_EQUAL(3653, loaded.getFolderCount());
+    TEST_ASSERT_EQUAL_UINT32(dates.back(), loaded.getNewestDate());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_folder_names);
+    RUN_TEST(test_save_load_round_trip);
+    RUN_TEST(test_damaged_index_rebuilt);
+    RUN_TEST(test_card_swap_detected);
+    RUN_TEST(test_probe_dates);
+    RUN_TEST(test_walk_keeps_records);
+    RUN_TEST(test_ten_year_index_size);
+
+    return UNITY_END();
+}
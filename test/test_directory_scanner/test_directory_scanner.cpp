@@ -0,0 +1,163 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+#include "../mocks/ArduinoJson.h"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+#include "DirectoryScanner.h"
+#include "DatalogIndex.h"
+#include "../../src/DirectoryScanner.cpp"
+#include "../../src/Crc32.cpp"
+#include "../../src/DatalogIndex.cpp"
+
+#include <ctime>
+#include <string>
+
+// Global mock filesystem for tests (the SD card)
+MockFS testFS;
+
+void setUp(void) {
+    testFS.clear();
+}
+
+void tearDown(void) {
+    testFS.clear();
+}
+
+static bool isEdf(const String& name) {
+    return name.endsWith(".edf");
+}
+
+static void makeFolder() {
+    testFS.addFile("/DATALOG/20240101/20240101_220000_BRP.edf", std::string(1000, 'b'));
+    testFS.addFile("/DATALOG/20240101/20240101_220000_PLD.edf", std::string(250, 'p'));
+    testFS.addFile("/DATALOG/20240101/notes.txt", std::string(10, 'n'));
+    testFS.addDirectory("/DATALOG/20240101/SUB");
+    testFS.setLastWrite("/DATALOG/20240101/20240101_220000_BRP.edf", 1704146400);
+}
+
+// Names and types in one pass, no entry opened, no stat unless asked
+void test_scan_names_and_types() {
+    makeFolder();
+
+    std::vector<DirEntry> entries;
+    TEST_ASSERT_TRUE(DirectoryScanner::scan(testFS, "/DATALOG/20240101", entries));
+    TEST_ASSERT_EQUAL(4, entries.size());
+    int directories = 0;
+    for (const DirEntry& entry : entries) {
+        directories += entry.isDirectory ? 1 : 0;
+        TEST_ASSERT_EQUAL_UINT32(0, entry.size);
+    }
+    TEST_ASSERT_EQUAL(1, directories);
+    TEST_ASSERT_EQUAL(4, testFS.getEntriesRead());
+    TEST_ASSERT_EQUAL(0, testFS.getStatCalls());
+    TEST_ASSERT_EQUAL(0, testFS.getEntriesOpened());
+
+    entries.clear();
+    TEST_ASSERT_TRUE(DirectoryScanner::scan(testFS, "/DATALOG/20240101", entries,
+                                            DirectoryScanner::DIRECTORIES_ONLY));
+    TEST_ASSERT_EQUAL(1, entries.size());
+    TEST_ASSERT_EQUAL_STRING("SUB", entries[0].name.c_str());
+}
+
+// Size and last write time come from one stat per accepted file, after the filter
+void test_scan_sizes_after_filter() {
+    makeFolder();
+
+    std::vector<DirEntry> entries;
+    TEST_ASSERT_TRUE(DirectoryScanner::scan(testFS, "/DATALOG/20240101", entries,
+                                            DirectoryScanner::FILES_ONLY | DirectoryScanner::WITH_STAT,
+                                            isEdf));
+    TEST_ASSERT_EQUAL(2, entries.size());
+    TEST_ASSERT_EQUAL_STRING("20240101_220000_BRP.edf", entries[0].name.c_str());
+    TEST_ASSERT_EQUAL_UINT32(1000, entries[0].size);
+    TEST_ASSERT_EQUAL(1704146400, entries[0].lastWrite);
+    TEST_ASSERT_EQUAL_UINT32(250, entries[1].size);
+    TEST_ASSERT_FALSE(entries[0].isDirectory);
+    TEST_ASSERT_EQUAL(2, testFS.getStatCalls());
+    TEST_ASSERT_EQUAL(0, testFS.getEntriesOpened());
+}
+
+// Missing paths and files are not directories
+void test_scan_failures() {
+    makeFolder();
+
+    std::vector<DirEntry> entries;
+    TEST_ASSERT_FALSE(DirectoryScanner::scan(testFS, "/DATALOG/20991231", entries));
+    TEST_ASSERT_FALSE(DirectoryScanner::scan(testFS, "/DATALOG/20240101/notes.txt", entries));
+    TEST_ASSERT_EQUAL(0, entries.size());
+
+    // An empty directory lists fine
+    testFS.addDirectory("/DATALOG/20240102");
+    TEST_ASSERT_TRUE(DirectoryScanner::scan(testFS, "/DATALOG/20240102", entries));
+    TEST_ASSERT_EQUAL(0, entries.size());
+}
+
+// Ten years of nightly folders: openNextFile() against the scanner
+void test_benchmark_datalog_walk() {
+    const int folders = 3653;
+    for (uint32_t date = 20140101, n = 0; n < (uint32_t)folders; date = DatalogIndex::addDays(date, 1), n++) {
+        testFS.addDirectory("/DATALOG/" + DatalogIndex::folderName(date));
+    }
+    for (int i = 0; i < 8; i++) {
+        testFS.addFile("/DATALOG/20240101/20240101_22000" + String(i) + "_BRP.edf", std::string(4096, 'x'));
+    }
+
+    // openNextFile(): every entry opened as a file to read its name
+    clock_t start = clock();
+    int found = 0;
+    File root = testFS.open("/DATALOG");
+    File file = root.openNextFile();
+    while (file) {
+        found += file.isDirectory() ? 1 : 0;
+        file.close();
+        file = root.openNextFile();
+    }
+    root.close();
+    double openSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    unsigned long opened = testFS.getEntriesOpened();
+    TEST_ASSERT_EQUAL(folders, found);
+    TEST_ASSERT_EQUAL(folders, opened);
+
+    // Scanner: directory entries only
+    testFS.resetDirectoryCounters();
+    start = clock();
+    std::vector<DirEntry> entries;
+    TEST_ASSERT_TRUE(DirectoryScanner::scan(testFS, "/DATALOG", entries, DirectoryScanner::DIRECTORIES_ONLY));
+    double scanSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    TEST_ASSERT_EQUAL(folders, entries.size());
+    TEST_ASSERT_EQUAL(0, testFS.getEntriesOpened());
+    TEST_ASSERT_EQUAL(0, testFS.getStatCalls());
+
+    // A folder with sizes: one stat per file, nothing opened
+    testFS.resetDirectoryCounters();
+    entries.clear();
+    TEST_ASSERT_TRUE(DirectoryScanner::scan(testFS, "/DATALOG/20240101", entries,
+                                            DirectoryScanner::FILES_ONLY | DirectoryScanner::WITH_STAT));
+    TEST_ASSERT_EQUAL(8, entries.size());
+    TEST_ASSERT_EQUAL(8, testFS.getStatCalls());
+    TEST_ASSERT_EQUAL(0, testFS.getEntriesOpened());
+
+    printf("\n[Benchmark] /DATALOG with %d folders (10 years)\n", folders);
+    printf("%-16s %14s %10s %10s\n", "method", "entries opened", "stat()", "ms (host)");
+    printf("%-16s %14lu %10s %10.2f\n", "openNextFile", opened, "-", openSeconds * 1000);
+    printf("%-16s %14d %10d %10.2f\n", "DirectoryScanner", 0, 0, scanSeconds * 1000);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_scan_names_and_types);
+    RUN_TEST(test_scan_sizes_after_filter);
+    RUN_TEST(test_scan_failures);
+    RUN_TEST(test_benchmark_datalog_walk);
+
+    return UNITY_END();
+}
@@ -0,0 +1,269 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+// Include the EdfCodec implementation (GzipSource for comparison)
+#include "EdfCodec.h"
+#include "GzipSource.h"
+#include "../../src/Crc32.cpp"
+#include "../../src/EdfCodec.cpp"
+#include "../../src/GzipSource.cpp"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+#include "MockStreams.h"
+
+#include <ctime>
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+static std::vector<uint8_t> encodeAll(const std::vector<uint8_t>& raw, size_t readSize,
+                                      size_t inputStep = 1000000, int* signalCount = nullptr) {
+    MemorySource source(raw, inputStep);
+    EdfCodec codec(source, raw.size());
+
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> buffer(readSize);
+    size_t n;
+    while ((n = codec.read(buffer.data(), buffer.size())) > 0) {
+        out.insert(out.end(), buffer.begin(), buffer.begin() + n);
+    }
+    TEST_ASSERT_FALSE(codec.hasFailed());
+    TEST_ASSERT_EQUAL(raw.size(), codec.getInputBytes());
+    TEST_ASSERT_EQUAL(out.size(), codec.getOutputBytes());
+    if (signalCount) {
+        *signalCount = codec.getSignalCount();
+    }
+    return out;
+}
+
+static void assertRoundTrip(const std::vector<uint8_t>& raw, const std::vector<uint8_t>& edz) {
+    std::vector<uint8_t> restored;
+    TEST_ASSERT_TRUE(EdfCodec::decode(edz.data(), edz.size(), restored));
+    TEST_ASSERT_EQUAL(raw.size(), restored.size());
+    TEST_ASSERT_TRUE(restored == raw);
+}
+
+void setUp(void) {
+    testFS.clear();
+    BufferPool::getInstance().end();
+}
+
+void tearDown(void) {
+    testFS.clear();
+}
+
+// Signal files are coded per signal and restore byte for byte
+void test_edf_round_trip_signals() {
+    int signals = 0;
+    std::vector<uint8_t> brp = makeEdf(0, 30);
+    std::vector<uint8_t> edz = encodeAll(brp, 4096, 1000000, &signals);
+    TEST_ASSERT_EQUAL(3, signals);
+    TEST_ASSERT_TRUE(edz.size() < brp.size() * 6 / 10);
+    assertRoundTrip(brp, edz);
+
+    std::vector<uint8_t> pld = makeEdf(1, 120);
+    edz = encodeAll(pld, 4096, 1000000, &signals);
+    TEST_ASSERT_EQUAL(10, signals);
+    TEST_ASSERT_TRUE(edz.size() < pld.size() / 2);
+    assertRoundTrip(pld, edz);
+
+    // EDF+ annotations are text: sent as stored, only the framing is added
+    std::vector<uint8_t> eve = makeEdf(3, 60);
+    edz = encodeAll(eve, 4096, 1000000, &signals);
+    TEST_ASSERT_EQUAL(1, signals);
+    TEST_ASSERT_EQUAL(eve.size() + 4 + 4 + 4 + 2 + 3 + 4, edz.size());
+    assertRoundTrip(eve, edz);
+}
+
+// A record still being written (the file grows during therapy) goes verbatim
+void test_edf_partial_record() {
+    std::vector<uint8_t> raw = makeEdf(0, 5);
+    raw.resize(raw.size() - 1234);
+
+    std::vector<uint8_t> edz = encodeAll(raw, 4096);
+    assertRoundTrip(raw, edz);
+
+    // Header only, no records yet
+    std::vector<uint8_t> header = makeEdf(2, 0);
+    TEST_ASSERT_EQUAL(1024, header.size());
+    assertRoundTrip(header, encodeAll(header, 4096));
+}
+
+// Anything that is not a usable EDF file is passed through verbatim
+void test_edf_non_edf_input_verbatim() {
+    int signals = -1;
+    std::vector<uint8_t> empty;
+    std::vector<uint8_t> edz = encodeAll(empty, 4096, 1000000, &signals);
+    TEST_ASSERT_EQUAL(0, signals);
+    TEST_ASSERT_EQUAL(18, edz.size());  // Preamble and CRC
+    assertRoundTrip(empty, edz);
+
+    std::string text = "Identification.json is not an EDF file";
+    std::vector<uint8_t> small(text.begin(), text.end());
+    assertRoundTrip(small, encodeAll(small, 4096, 1000000, &signals));
+    TEST_ASSERT_EQUAL(0, signals);
+
+    std::vector<uint8_t> noise(20000);
+    srand(7);
+    for (size_t i = 0; i < noise.size(); i++) {
+        noise[i] = rand() & 0xFF;
+    }
+    edz = encodeAll(noise, 4096, 1000000, &signals);
+    TEST_ASSERT_EQUAL(0, signals);
+    TEST_ASSERT_EQUAL(noise.size() + 18, edz.size());
+    assertRoundTrip(noise, edz);
+
+    // Header length that does not match the signal count
+    std::vector<uint8_t> bad = makeEdf(1, 3);
+    memcpy(bad.data() + 184, "768     ", 8);
+    edz = encodeAll(bad, 4096, 1000000, &signals);
+    TEST_ASSERT_EQUAL(0, signals);
+    assertRoundTrip(bad, edz);
+}
+
+// Output does not depend on how input arrives or output is drained
+void test_edf_independent_of_slicing() {
+    std::vector<uint8_t> raw = makeEdf(0, 4);
+    std::vector<uint8_t> whole = encodeAll(raw, 65536);
+    std::vector<uint8_t> sliced = encodeAll(raw, 7, 333);
+    TEST_ASSERT_TRUE(whole == sliced);
+    assertRoundTrip(raw, whole);
+}
+
+// The pipeline streams the coder to its end without knowing its size
+void test_edf_through_pipeline() {
+    std::vector<uint8_t> raw = makeEdf(2, 240);
+    testFS.addFile("/DATALOG/20241101/20241101_220000_SAD.edf", raw);
+
+    fs::File file = testFS.open("/DATALOG/20241101/20241101_220000_SAD.edf", FILE_READ);
+    FileUploadSource fileSource(file);
+    EdfCodec codec(fileSource, raw.size());
+
+    UploadPipeline pipeline(4096, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+    CollectingSink sink;
+    unsigned long bytesTransferred = 0;
+    TEST_ASSERT_TRUE(pipeline.run(codec, UploadPipeline::STREAM_TO_END, sink, bytesTransferred));
+    file.close();
+
+    TEST_ASSERT_FALSE(codec.hasFailed());
+    TEST_ASSERT_EQUAL(sink.data.size(), bytesTransferred);
+    TEST_ASSERT_TRUE(bytesTransferred < raw.size() / 2);
+    assertRoundTrip(raw, sink.data);
+}
+
+// Short input fails the stream; damaged streams are rejected by decode()
+void test_edf_failures() {
+    std::vector<uint8_t> raw = makeEdf(1, 10);
+    MemorySource source(raw);
+    EdfCodec codec(source, raw.size() + 100);
+    uint8_t buffer[1024];
+    while (codec.read(buffer, sizeof(buffer)) > 0) {
+    }
+    TEST_ASSERT_TRUE(codec.hasFailed());
+
+    std::vector<uint8_t> edz = encodeAll(raw, 4096);
+    std::vector<uint8_t> restored;
+
+    std::vector<uint8_t> damaged = edz;
+    damaged[damaged.size() / 2] ^= 0x01;
+    TEST_ASSERT_FALSE(EdfCodec::decode(damaged.data(), damaged.size(), restored));
+
+    damaged = edz;
+    damaged.pop_back();
+    TEST_ASSERT_FALSE(EdfCodec::decode(damaged.data(), damaged.size(), restored));
+
+    damaged = edz;
+    damaged[0] = 'X';
+    TEST_ASSERT_FALSE(EdfCodec::decode(damaged.data(), damaged.size(), restored));
+
+    damaged = edz;
+    damaged[4] ^= 0x40;  // Raw size
+    TEST_ASSERT_FALSE(EdfCodec::decode(damaged.data(), damaged.size(), restored));
+}
+
+// Benchmark: ratio and speed against the gzip stage on synthetic night files
+void test_benchmark_edf_vs_gzip() {
+    struct Sample {
+        const char* name;
+        int kind;
+        int minutes;
+    };
+    const Sample samples[] = {
+        {"BRP (flow+pressure)", 0, 480},
+        {"PLD (trends)", 1, 480},
+        {"SAD (oximetry)", 2, 480},
+        {"EVE (annotations)", 3, 480},
+    };
+
+    printf("\n%-22s %9s %9s %7s %8s %9s %7s %8s\n", "file", "raw", "edz", "ratio", "MB/s",
+           "gzip", "ratio", "MB/s");
+
+    size_t totalRaw = 0;
+    size_t totalEdz = 0;
+    size_t totalGz = 0;
+    double edzSeconds = 0;
+    double gzSeconds = 0;
+    for (const Sample& sample : samples) {
+        std::vector<uint8_t> raw = makeEdf(sample.kind, sample.minutes);
+
+        clock_t start = clock();
+        std::vector<uint8_t> edz = encodeAll(raw, 16384);
+        double edzTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+        assertRoundTrip(raw, edz);
+
+        MemorySource source(raw);
+        GzipSource gzip(source, raw.size());
+        TEST_ASSERT_TRUE(gzip.begin());
+        std::vector<uint8_t> buffer(16384);
+        size_t gzSize = 0;
+        size_t n;
+        start = clock();
+        while ((n = gzip.read(buffer.data(), buffer.size())) > 0) {
+            gzSize += n;
+        }
+        double gzTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        printf("%-22s %9u %9u %6.1f%% %8.1f %9u %6.1f%% %8.1f\n", sample.name,
+               (unsigned)raw.size(), (unsigned)edz.size(), 100.0 * edz.size() / raw.size(),
+               edzTime > 0 ? raw.size() / edzTime / 1e6 : 0.0, (unsigned)gzSize,
+               100.0 * gzSize / raw.size(), gzTime > 0 ? raw.size() / gzTime / 1e6 : 0.0);
+        totalRaw += raw.size();
+        totalEdz += edz.size();
+        totalGz += gzSize;
+        edzSeconds += edzTime;
+        gzSeconds += gzTime;
+    }
+    printf("%-22s %9u %9u %6.1f%% %8.1f %9u %6.1f%% %8.1f\n", "total", (unsigned)totalRaw,
+           (unsigned)totalEdz, 100.0 * totalEdz / totalRaw,
+           edzSeconds > 0 ? totalRaw / edzSeconds / 1e6 : 0.0, (unsigned)totalGz,
+           100.0 * totalGz / totalRaw, gzSeconds > 0 ? totalRaw / gzSeconds / 1e6 : 0.0);
+
+    // 25 Hz signal data dominates a night, and there the codec must beat deflate
+    // (annotation files stay on gzip, see FileUploader::uploadCompressedFile)
+    TEST_ASSERT_TRUE(totalEdz < totalGz);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_edf_round_trip_signals);
+    RUN_TEST(test_edf_partial_record);
+    RUN_TEST(test_edf_non_edf_input_verbatim);
+    RUN_TEST(test_edf_independent_of_slicing);
+    RUN_TEST(test_edf_through_pipeline);
+    RUN_TEST(test_edf_failures);
+    RUN_TEST(test_benchmark_edf_vs_gzip);
+
+    return UNITY_END();
+}
@@ -0,0 +1,748 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockMD5.h"
+#include "MockLogger.h"
+#include "MockPreferences.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+#include "../mocks/ESP32Ping.cpp"
+
+// Mock ArduinoJson for testing
+#include "../mocks/ArduinoJson.h"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+// The local-directory backend is the one a native session can run against
+#ifndef ENABLE_LOCAL_UPLOAD
+#define ENABLE_LOCAL_UPLOAD
+#endif
+
+#include <algorithm>
+#include <ctime>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+
+// Mock ESP32-specific time functions (NTP is always in sync here)
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr) {
+}
+
+bool getLocalTime(struct tm* info, uint32_t ms = 5000) {
+    time_t now = MockTimeState::getTime();
+    struct tm* timeinfo = gmtime(&now);
+    if (timeinfo && info) {
+        *info = *timeinfo;
+        return true;
+    }
+    return false;
+}
+
+// Include the whole upload path, ending in FileUploader
+#include "FileUploader.h"
+#include "LocalDirUploader.h"
+#include "../../src/Config.cpp"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadStateManager.cpp"
+#include "../../src/DatalogIndex.cpp"
+#include "../../src/DirectoryScanner.cpp"
+#include "../../src/TimeBudgetManager.cpp"
+#include "../../src/ScheduleManager.cpp"
+#include "../../src/Crc32.cpp"
+#include "../../src/UploadPipeline.cpp"
+#include "../../src/TarArchiveSource.cpp"
+#include "../../src/GzipSource.cpp"
+#include "../../src/EdfCodec.cpp"
+#include "../../src/UploadBackend.cpp"
+#include "../../src/LocalDirUploader.cpp"
+#include "../../src/FileUploader.cpp"
+
+// Global mock filesystem for tests (the SD card)
+MockFS testFS;
+
+// Hardware managers reduced to what an upload session touches
+SDCardManager::SDCardManager() : initialized(true), espHasControl(true) {}
+bool SDCardManager::takeControl() { espHasControl = true; return true; }
+void SDCardManager::releaseControl() { espHasControl = false; }
+bool SDCardManager::hasControl() const { return espHasControl; }
+fs::FS& SDCardManager::getFS() { return testFS; }
+
+WiFiManager::WiFiManager() : connected(true) {}
+bool WiFiManager::isConnected() const { return connected; }
+
+// Host directory standing in for the upload server
+static std::string targetDir;
+
+static void writeConfig(const char* extraKeys) {
+    std::string content = std::string("{\"WIFI_SSID\": \"TestNetwork\", \"ENDPOINT\": \"") + targetDir +
+                          "\", \"ENDPOINT_TYPE\": \"LOCAL\", \"SESSION_DURATION_SECONDS\": 600" +
+                          extraKeys + "}";
+    testFS.addFile("/config.json", content);
+}
+
+static std::vector<uint8_t> makeData(size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        // Compressible like sampled signals: slowly varying values
+        data[i] = (uint8_t)((i / 64) + ((seed >> 16) & 0x03));
+    }
+    return data;
+}
+
+// DATALOG folders of .edf files plus the tracked root and SETTINGS files
+static void makeCard(int folders, int filesPerFolder, size_t fileSize) {
+    const char* kinds[] = {"BRP", "PLD", "SAD", "EVE"};
+    for (int f = 0; f < folders; f++) {
+        String folder = String("/DATALOG/") + String(20240101 + f);
+        for (int i = 0; i < filesPerFolder; i++) {
+            String path = folder + "/20240101_2200" + String(i) + "_" + kinds[i % 4] + ".edf";
+            testFS.addFile(path, makeData(fileSize, f * 100 + i));
+        }
+    }
+    testFS.addFile("/Identification.json", std::string("{\"FlowGenerator\": {}}"));
+    testFS.addFile("/SETTINGS/CurrentSettings.json", std::string("{\"Settings\": {}}"));
+}
+
+static std::string targetPath(const String& remotePath) {
+    return targetDir + remotePath.c_str();
+}
+
+static bool readTarget(const String& remotePath, std::vector<uint8_t>& content) {
+    FILE* file = fopen(targetPath(remotePath).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    content.clear();
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.insert(content.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool targetExists(const String& remotePath) {
+    struct stat st;
+    return stat(targetPath(remotePath).c_str(), &st) == 0;
+}
+
+static void clearTarget() {
+    std::string command = "rm -rf '" + targetDir + "'";
+    system(command.c_str());
+}
+
+static bool runSession(Config& config, FileUploader*& uploader, SDCardManager& sdManager,
+                       WiFiManager& wifi) {
+    if (!config.loadFromSD(testFS)) {
+        return false;
+    }
+    uploader = new FileUploader(&config, &wifi);
+    if (!uploader->begin(testFS)) {
+        return false;
+    }
+    return uploader->uploadNewFiles(&sdManager, true);
+}
+
+void setUp(void) {
+    testFS.clear();
+    Preferences::clearAll();
+    MockTimeState::reset();
+    MockTimeState::setTime(1704150000);  // 2024-01-01, clock synced
+
+    char pattern[] = "/tmp/cpap_local_XXXXXX";
+    char* dir = mkdtemp(pattern);
+    targetDir = dir ? std::string(dir) + "/share" : "/tmp/cpap_local_share";
+}
+
+void tearDown(void) {
+    std::string parent = targetDir.substr(0, targetDir.find_last_of('/'));
+    std::string command = "rm -rf '" + parent + "'";
+    system(command.c_str());
+}
+
+// A full session copies every DATALOG, root and SETTINGS file unchanged
+void test_session_uploads_all_files() {
+    makeCard(2, 3, 20000);
+    writeConfig("");
+    MockTimeState::setTime(1704880800);  // 2024-01-10: the 2024-01-01 night is closed
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    const char* paths[] = {
+        "/DATALOG/20240101/20240101_22000_BRP.edf",
+        "/DATALOG/20240101/20240101_22002_SAD.edf",
+        "/DATALOG/20240102/20240101_22001_PLD.edf",
+        "/Identification.json",
+        "/SETTINGS/CurrentSettings.json"
+    };
+    for (const char* path : paths) {
+        std::vector<uint8_t> content;
+        TEST_ASSERT_TRUE_MESSAGE(readTarget(path, content), path);
+        TEST_ASSERT_TRUE_MESSAGE(content == testFS.getFileContent(path), path);
+    }
+    // The newest night may still grow: it stays open, its files recorded
+    UploadStateManager* state = uploader->getStateManager();
+    TEST_ASSERT_TRUE(state->isFolderCompleted("20240101"));
+    TEST_ASSERT_FALSE(state->isFolderCompleted("20240102"));
+    TEST_ASSERT_TRUE(state->hasUploadedLength("/DATALOG/20240102/20240101_22001_PLD.edf"));
+    TEST_ASSERT_EQUAL(0, state->getIncompleteFoldersCount());
+    delete uploader;
+}
+
+// Nothing changed on the card, so the next session writes nothing
+void test_second_session_uploads_nothing() {
+    makeCard(2, 3, 20000);
+    writeConfig("");
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    clearTarget();
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+    TEST_ASSERT_FALSE(targetExists("/DATALOG"));
+    TEST_ASSERT_FALSE(targetExists("/Identification.json"));
+
+    // A file that changes is the only one sent again
+    testFS.addFile("/SETTINGS/CurrentSettings.json", std::string("{\"Settings\": {\"Mode\": 1}}"));
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+    TEST_ASSERT_TRUE(targetExists("/SETTINGS/CurrentSettings.json"));
+    TEST_ASSERT_FALSE(targetExists("/DATALOG"));
+    delete uploader;
+}
+
+// Later sessions find new folders through the DATALOG index, not a walk
+void test_index_avoids_datalog_walk() {
+    MockTimeState::setTime(1705831200);  // 2024-01-21 10:00
+    makeCard(20, 2, 1000);
+    writeConfig("");
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+    TEST_ASSERT_TRUE(testFS.exists("/.datalog_index"));
+
+    // Nothing new: only the open night (the newest folder, 2 files) is listed
+    testFS.resetDirectoryCounters();
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+    TEST_ASSERT_EQUAL(2, testFS.getEntriesRead());
+
+    // Tonight's folder is found by its date; it and yesterday's are listed
+    testFS.addFile("/DATALOG/20240121/20240121_220000_BRP.edf", makeData(1000, 7));
+    testFS.resetDirectoryCounters();
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+    TEST_ASSERT_TRUE(targetExists("/DATALOG/20240121/20240121_220000_BRP.edf"));
+    TEST_ASSERT_TRUE(uploader->getStateManager()->isFolderCompleted("20240119"));
+    TEST_ASSERT_EQUAL(3, testFS.getEntriesRead());
+    delete uploader;
+
+    // A new uploader (reboot) reuses the index saved on the card
+    FileUploader* rebooted = nullptr;
+    testFS.resetDirectoryCounters();
+    TEST_ASSERT_TRUE(runSession(config, rebooted, sdManager, wifi));
+    TEST_ASSERT_EQUAL(3, testFS.getEntriesRead());
+    delete rebooted;
+}
+
+// The folder scan supplies sizes: a DATALOG file is opened to send it (and,
+// in a night that may still grow, to record its tail), never for its size.
+// The open night's records survive the session and are used by the next one.
+void test_datalog_files_opened_once() {
+    makeCard(2, 4, 20000);
+    writeConfig("");
+    MockTimeState::setTime(1704880800);  // 2024-01-10: the 2024-01-01 night is closed
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    // A closed night's files are final: opened once, to send them
+    const char* closedPaths[] = {
+        "/DATALOG/20240101/20240101_22000_BRP.edf",
+        "/DATALOG/20240101/20240101_22003_EVE.edf"
+    };
+    for (const char* path : closedPaths) {
+        TEST_ASSERT_TRUE_MESSAGE(targetExists(path), path);
+        TEST_ASSERT_TRUE_MESSAGE(testFS.getOpenCount(path) == 1, path);
+    }
+    
+    // The newest night may still grow: a second open hashes the tail
+    const char* path = "/DATALOG/20240102/20240101_22001_PLD.edf";
+    TEST_ASSERT_TRUE_MESSAGE(targetExists(path), path);
+    TEST_ASSERT_TRUE_MESSAGE(testFS.getOpenCount(path) == 2, path);
+    TEST_ASSERT_FALSE(uploader->getStateManager()->isFolderCompleted("20240102"));
+    TEST_ASSERT_TRUE(uploader->getStateManager()->hasUploadedLength(path));
+    delete uploader;
+
+    // After a reboot the saved record is checked against the tail (one more
+    // open) and the unchanged file is not sent again; closed nights are skipped
+    clearTarget();
+    FileUploader* rebooted = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, rebooted, sdManager, wifi));
+    TEST_ASSERT_FALSE(targetExists("/DATALOG"));
+    TEST_ASSERT_TRUE_MESSAGE(testFS.getOpenCount(path) == 3, path);
+    TEST_ASSERT_TRUE_MESSAGE(testFS.getOpenCount(closedPaths[0]) == 1, closedPaths[0]);
+    TEST_ASSERT_TRUE(rebooted->getStateManager()->hasUploadedLength(path));
+    delete rebooted;
+}
+
+// A file of the newest night that grows between sessions gets only its new
+// records; the folder is completed once a newer night exists
+void test_open_night_sends_only_the_tail() {
+    makeCard(2, 2, 20000);
+    writeConfig("");
+    MockTimeState::setTime(1704880800);  // 2024-01-10
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    // Overwrite the server copy: a whole resend would replace the marker
+    const char* path = "/DATALOG/20240102/20240101_22000_BRP.edf";
+    std::vector<uint8_t> marker(20000, 0xAA);
+    FILE* file = fopen(targetPath(path).c_str(), "wb");
+    fwrite(marker.data(), 1, marker.size(), file);
+    fclose(file);
+
+    std::vector<uint8_t> grown = testFS.getFileContent(path);
+    std::vector<uint8_t> tail = makeData(5000, 42);
+    grown.insert(grown.end(), tail.begin(), tail.end());
+    testFS.addFile(path, grown);
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+
+    std::vector<uint8_t> content;
+    TEST_ASSERT_TRUE(readTarget(path, content));
+    TEST_ASSERT_EQUAL(25000, content.size());
+    TEST_ASSERT_TRUE(std::equal(marker.begin(), marker.end(), content.begin()));
+    TEST_ASSERT_TRUE(std::equal(tail.begin(), tail.end(), content.begin() + 20000));
+    TEST_ASSERT_FALSE(uploader->getStateManager()->isFolderCompleted("20240102"));
+
+    // A newer night closes the folder and drops its records
+    testFS.addFile("/DATALOG/20240103/20240103_220000_BRP.edf", makeData(1000, 9));
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+    TEST_ASSERT_TRUE(uploader->getStateManager()->isFolderCompleted("20240102"));
+    TEST_ASSERT_FALSE(uploader->getStateManager()->hasUploadedLength(path));
+    TEST_ASSERT_TRUE(readTarget(path, content));
+    TEST_ASSERT_EQUAL(25000, content.size());
+    TEST_ASSERT_EQUAL_UINT8(0xAA, content[0]);
+    delete uploader;
+}
+
+// A retried folder skips files the backend listing shows are already there
+void test_retried_folder_skips_listed_files() {
+    makeCard(1, 3, 20000);
+    writeConfig("");
+    testFS.addFile("/.upload_state.json",
+                   std::string("{\"version\": 1, \"current_retry_folder\": \"20240101\", "
+                               "\"current_retry_count\": 1}"));
+    
+    // Left on the server by the session that failed: same size, other bytes
+    const char* sentPath = "/DATALOG/20240101/20240101_22000_BRP.edf";
+    std::string command = "mkdir -p '" + targetDir + "/DATALOG/20240101'";
+    system(command.c_str());
+    FILE* file = fopen(targetPath(sentPath).c_str(), "wb");
+    std::vector<uint8_t> marker(20000, 0xAA);
+    fwrite(marker.data(), 1, marker.size(), file);
+    fclose(file);
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    std::vector<uint8_t> content;
+    TEST_ASSERT_TRUE(readTarget(sentPath, content));
+    TEST_ASSERT_TRUE(content == marker);
+    const char* otherPath = "/DATALOG/20240101/20240101_22001_PLD.edf";
+    TEST_ASSERT_TRUE(readTarget(otherPath, content));
+    TEST_ASSERT_TRUE(content == testFS.getFileContent(otherPath));
+    TEST_ASSERT_TRUE(uploader->getStateManager()->hasUploadedLength(sentPath));
+    TEST_ASSERT_EQUAL(0, uploader->getStateManager()->getIncompleteFoldersCount());
+    delete uploader;
+}
+
+// Local backend that takes each folder as a batch, like SleepHQ imports
+class BatchingLocalUploader : public LocalDirUploader {
+public:
+    static bool acceptCommits;
+    static int commits;
+
+    explicit BatchingLocalUploader(const String& directory) : LocalDirUploader(directory) {}
+    static UploadBackend* create(const Config& config, const EndpointConfig& endpoint) {
+        return new BatchingLocalUploader(endpoint.url);
+    }
+    bool supportsBatches() const override { return true; }
+    bool commitBatch() override {
+        commits++;
+        return acceptCommits;
+    }
+};
+bool BatchingLocalUploader::acceptCommits = true;
+int BatchingLocalUploader::commits = 0;
+
+// A folder counts as uploaded only once its batch is committed
+void test_batch_commit_completes_folder() {
+    UploadBackendRegistry::getInstance().registerBackend("BATCHLOCAL", &BatchingLocalUploader::create);
+    makeCard(1, 2, 20000);
+    testFS.addFile("/config.json", std::string("{\"WIFI_SSID\": \"TestNetwork\", \"ENDPOINT\": \"") +
+                                   targetDir + "\", \"ENDPOINT_TYPE\": \"BATCHLOCAL\"}");
+    BatchingLocalUploader::acceptCommits = false;
+    BatchingLocalUploader::commits = 0;
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    runSession(config, uploader, sdManager, wifi);
+    TEST_ASSERT_EQUAL(2, BatchingLocalUploader::commits);  // Folder, then root and SETTINGS
+    TEST_ASSERT_FALSE(uploader->getStateManager()->isFolderCompleted("20240101"));
+    TEST_ASSERT_EQUAL(1, uploader->getStateManager()->getCurrentRetryCount());
+
+    // Next session sends the whole folder again, then root and SETTINGS
+    clearTarget();
+    BatchingLocalUploader::acceptCommits = true;
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+    TEST_ASSERT_TRUE(targetExists("/DATALOG/20240101/20240101_22000_BRP.edf"));
+    TEST_ASSERT_TRUE(targetExists("/DATALOG/20240101/20240101_22001_PLD.edf"));
+    TEST_ASSERT_EQUAL(0, uploader->getStateManager()->getIncompleteFoldersCount());
+    TEST_ASSERT_EQUAL(0, uploader->getStateManager()->getCurrentRetryCount());
+    TEST_ASSERT_EQUAL(4, BatchingLocalUploader::commits);
+    delete uploader;
+}
+
+// Second host directory, next to the first, for MIRROR_ENDPOINT
+static std::string mirrorDir() {
+    return targetDir.substr(0, targetDir.find_last_of('/')) + "/mirror";
+}
+
+static bool mirrorMatchesCard(const char* path) {
+    FILE* file = fopen((mirrorDir() + path).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> content;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.insert(content.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return content == testFS.getFileContent(path);
+}
+
+// A mirror endpoint gets the same files from the same pass over the card
+void test_mirror_reads_each_file_once() {
+    // Reference: one endpoint
+    makeCard(2, 3, 200000);
+    writeConfig("");
+    Config single;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(single, uploader, sdManager, wifi));
+    unsigned long singleReads = testFS.getBytesRead();
+    delete uploader;
+
+    testFS.clear();
+    clearTarget();
+    makeCard(2, 3, 200000);
+    std::string mirrorKeys = ", \"MIRROR_ENDPOINT_TYPE\": \"LOCAL\", \"MIRROR_ENDPOINT\": \"" + mirrorDir() + "\"";
+    writeConfig(mirrorKeys.c_str());
+    Config config;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    const char* paths[] = {
+        "/DATALOG/20240101/20240101_22000_BRP.edf",
+        "/DATALOG/20240102/20240101_22002_SAD.edf",
+        "/Identification.json",
+        "/SETTINGS/CurrentSettings.json"
+    };
+    for (const char* path : paths) {
+        std::vector<uint8_t> content;
+        TEST_ASSERT_TRUE_MESSAGE(readTarget(path, content), path);
+        TEST_ASSERT_TRUE_MESSAGE(content == testFS.getFileContent(path), path);
+        TEST_ASSERT_TRUE_MESSAGE(mirrorMatchesCard(path), path);
+    }
+
+    // Only the per-target bookkeeping (state files, append tails) is read
+    // twice, never the file data: 1.2 MB of data, 4 KB tails
+    unsigned long dataBytes = 6 * 200000;
+    TEST_ASSERT_TRUE(testFS.getBytesRead() < singleReads + dataBytes / 10);
+    TEST_ASSERT_TRUE(testFS.exists("/.upload_state_mirror.bin"));
+    delete uploader;
+}
+
+// A closed night's file is final: the shared read opens it once, with no
+// tail hashed for either endpoint
+void test_mirror_closed_night_opened_once() {
+    makeCard(2, 2, 20000);
+    std::string mirrorKeys = ", \"MIRROR_ENDPOINT_TYPE\": \"LOCAL\", \"MIRROR_ENDPOINT\": \"" + mirrorDir() + "\"";
+    writeConfig(mirrorKeys.c_str());
+    MockTimeState::setTime(1704880800);  // 2024-01-10: the 2024-01-01 night is closed
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    const char* path = "/DATALOG/20240101/20240101_22000_BRP.edf";
+    TEST_ASSERT_TRUE(mirrorMatchesCard(path));
+    TEST_ASSERT_TRUE_MESSAGE(testFS.getOpenCount(path) == 1, path);
+    TEST_ASSERT_TRUE(uploader->getStateManager()->isFolderCompleted("20240101"));
+    TEST_ASSERT_FALSE(uploader->getStateManager()->isFolderCompleted("20240102"));
+    TEST_ASSERT_TRUE(uploader->getStateManager()->hasUploadedLength("/DATALOG/20240102/20240101_22000_BRP.edf"));
+    delete uploader;
+}
+
+// A file too large for the remaining budget hands the folder to the
+// per-endpoint path, which sends a slice: no endpoint is dropped or retried
+void test_mirror_budget_falls_back_per_endpoint() {
+    makeCard(1, 1, 300 * 1024);
+    std::string content = std::string("{\"WIFI_SSID\": \"TestNetwork\", \"ENDPOINT\": \"") + targetDir +
+                          "\", \"ENDPOINT_TYPE\": \"LOCAL\", \"SESSION_DURATION_SECONDS\": 2, "
+                          "\"MIRROR_ENDPOINT_TYPE\": \"LOCAL\", \"MIRROR_ENDPOINT\": \"" + mirrorDir() + "\"}";
+    testFS.addFile("/config.json", content);
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    runSession(config, uploader, sdManager, wifi);
+
+    UploadStateManager* state = uploader->getStateManager();
+    TEST_ASSERT_TRUE(state->hasUploadCheckpoint());
+    TEST_ASSERT_EQUAL(0, state->getCurrentRetryCount());
+    TEST_ASSERT_TRUE(targetExists("/DATALOG/20240101/20240101_22000_BRP.edf"));
+    delete uploader;
+
+    UploadStateManager mirrorState("/.upload_state_mirror.bin");
+    mirrorState.begin(testFS);
+    TEST_ASSERT_EQUAL(0, mirrorState.getCurrentRetryCount());
+}
+
+// A failing mirror does not hold back the primary endpoint, and catches up
+// on its own once it works again
+void test_mirror_failure_tracked_separately() {
+    makeCard(2, 2, 20000);
+    MockTimeState::setTime(1704880800);  // 2024-01-10: the 2024-01-01 night is closed
+    std::string mirrorKeys = ", \"MIRROR_ENDPOINT_TYPE\": \"LOCAL\", \"MIRROR_ENDPOINT\": \"" + mirrorDir() + "\"";
+    writeConfig(mirrorKeys.c_str());
+
+    // A plain file where the mirror directory should be
+    FILE* blocker = fopen(mirrorDir().c_str(), "wb");
+    fclose(blocker);
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_FALSE(runSession(config, uploader, sdManager, wifi));
+    TEST_ASSERT_TRUE(targetExists("/DATALOG/20240101/20240101_22001_PLD.edf"));
+    TEST_ASSERT_TRUE(uploader->getStateManager()->isFolderCompleted("20240101"));
+
+    UploadStateManager mirrorState("/.upload_state_mirror.bin");
+    mirrorState.begin(testFS);
+    TEST_ASSERT_FALSE(mirrorState.isFolderCompleted("20240101"));
+
+    // Mirror reachable again: only it receives the folder
+    remove(mirrorDir().c_str());
+    clearTarget();
+    TEST_ASSERT_TRUE(uploader->uploadNewFiles(&sdManager, true));
+    TEST_ASSERT_FALSE(targetExists("/DATALOG"));
+    TEST_ASSERT_TRUE(mirrorMatchesCard("/DATALOG/20240101/20240101_22000_BRP.edf"));
+    TEST_ASSERT_TRUE(mirrorMatchesCard("/Identification.json"));
+    mirrorState.begin(testFS);
+    TEST_ASSERT_TRUE(mirrorState.isFolderCompleted("20240101"));
+    delete uploader;
+}
+
+// Archive mode writes one .tar per closed folder through the stream path;
+// the newest night goes file by file so it can be appended to
+void test_session_archive_mode() {
+    makeCard(2, 4, 3000);
+    writeConfig(", \"DATALOG_ARCHIVE\": true");
+    MockTimeState::setTime(1704880800);  // 2024-01-10
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    std::vector<uint8_t> archive;
+    TEST_ASSERT_TRUE(readTarget("/DATALOG/20240101.tar", archive));
+    std::vector<unsigned long> sizes(4, 3000);
+    TEST_ASSERT_EQUAL(TarArchiveSource::archiveSizeFor(sizes), archive.size());
+    TEST_ASSERT_FALSE(targetExists("/DATALOG/20240101"));
+    TEST_ASSERT_FALSE(targetExists("/DATALOG/20240102.tar"));
+    TEST_ASSERT_TRUE(targetExists("/DATALOG/20240102/20240101_22003_EVE.edf"));
+    delete uploader;
+}
+
+// Compression writes .gz files in place of the raw .edf files
+void test_session_compressed_mode() {
+    makeCard(1, 2, 20000);
+    writeConfig(", \"COMPRESS_UPLOADS\": true");
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+
+    std::vector<uint8_t> compressed;
+    TEST_ASSERT_TRUE(readTarget("/DATALOG/20240101/20240101_22000_BRP.edf.gz", compressed));
+    TEST_ASSERT_EQUAL_UINT8(0x1f, compressed[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x8b, compressed[1]);
+    TEST_ASSERT_TRUE(compressed.size() < 20000);
+    TEST_ASSERT_FALSE(targetExists("/DATALOG/20240101/20240101_22000_BRP.edf"));
+    delete uploader;
+}
+
+// Unknown endpoint types fail at begin(); compiled-in types are registered once
+void test_backend_registry() {
+    UploadBackendRegistry& registry = UploadBackendRegistry::getInstance();
+    TEST_ASSERT_TRUE(registry.isRegistered("LOCAL"));
+    TEST_ASSERT_FALSE(registry.isRegistered("FTP"));
+    TEST_ASSERT_FALSE(registry.registerBackend("LOCAL", &LocalDirUploader::create));
+
+    writeConfig("");
+    testFS.addFile("/config.json", std::string("{\"WIFI_SSID\": \"TestNetwork\", \"ENDPOINT\": \"x\", "
+                                               "\"ENDPOINT_TYPE\": \"FTP\"}"));
+    Config config;
+    TEST_ASSERT_TRUE(config.loadFromSD(testFS));
+    WiFiManager wifi;
+    FileUploader uploader(&config, &wifi);
+    TEST_ASSERT_FALSE(uploader.begin(testFS));
+
+    SDCardManager sdManager;
+    TEST_ASSERT_FALSE(uploader.uploadNewFiles(&sdManager, true));
+}
+
+// A budget-limited slice followed by a resume rebuilds the file exactly
+void test_local_backend_resume() {
+    std::vector<uint8_t> data = makeData(100000, 7);
+    testFS.addFile("/STR.edf", data);
+
+    LocalDirUploader backend(targetDir.c_str());
+    TEST_ASSERT_TRUE(backend.ensureConnected());
+
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(backend.upload("/STR.edf", "/STR.edf", testFS, sent, 0, 30000));
+    TEST_ASSERT_EQUAL(30000, sent);
+    TEST_ASSERT_TRUE(backend.getLastChecksum().isEmpty());
+
+    TEST_ASSERT_TRUE(backend.upload("/STR.edf", "/STR.edf", testFS, sent, 30000));
+    TEST_ASSERT_EQUAL(70000, sent);
+
+    std::vector<uint8_t> content;
+    TEST_ASSERT_TRUE(readTarget("/STR.edf", content));
+    TEST_ASSERT_TRUE(content == data);
+
+    // Whole-file uploads report the MD5 hashed while sending
+    TEST_ASSERT_TRUE(backend.upload("/STR.edf", "/STR.edf", testFS, sent));
+    TEST_ASSERT_EQUAL(32, backend.getLastChecksum().length());
+
+    std::map<String, unsigned long> files;
+    TEST_ASSERT_TRUE(backend.listDirectory("/", files));
+    TEST_ASSERT_EQUAL(100000, files[String("STR.edf")]);
+    TEST_ASSERT_TRUE(backend.listDirectory("/MISSING", files));
+    TEST_ASSERT_TRUE(files.empty());
+}
+
+// A slice cut by the session budget is progress, not a failed attempt
+void test_budget_slice_keeps_retry_count() {
+    makeCard(1, 1, 300 * 1024);
+    std::string content = std::string("{\"WIFI_SSID\": \"TestNetwork\", \"ENDPOINT\": \"") + targetDir +
+                          "\", \"ENDPOINT_TYPE\": \"LOCAL\", \"SESSION_DURATION_SECONDS\": 2}";
+    testFS.addFile("/config.json", content);
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+    runSession(config, uploader, sdManager, wifi);
+
+    const String path = "/DATALOG/20240101/20240101_22000_BRP.edf";
+    UploadStateManager* state = uploader->getStateManager();
+    TEST_ASSERT_FALSE(state->isFolderCompleted("20240101"));
+    TEST_ASSERT_TRUE(state->hasUploadCheckpoint());
+    TEST_ASSERT_TRUE(state->getResumeOffset(path, 300 * 1024) > 0);
+    TEST_ASSERT_EQUAL(0, state->getCurrentRetryCount());
+    delete uploader;
+}
+
+// End-to-end throughput of a whole session against the host filesystem
+// (mock millis() does not advance, so this times with clock())
+void test_session_throughput_benchmark() {
+    const int folders = 8;
+    const int filesPerFolder = 4;
+    const size_t fileSize = 256 * 1024;
+    makeCard(folders, filesPerFolder, fileSize);
+    writeConfig("");
+    MockTimeState::setTime(1704880800);  // 2024-01-10: only the newest night is open
+
+    Config config;
+    SDCardManager sdManager;
+    WiFiManager wifi;
+    FileUploader* uploader = nullptr;
+
+    clock_t start = clock();
+    TEST_ASSERT_TRUE(runSession(config, uploader, sdManager, wifi));
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    double megabytes = (double)(folders * filesPerFolder * fileSize) / (1024.0 * 1024.0);
+    printf("Session throughput: %.1f MB in %.3f s (%.1f MB/s CPU)\n",
+           megabytes, seconds, seconds > 0 ? megabytes / seconds : 0.0);
+
+    for (int f = 0; f < folders - 1; f++) {
+        TEST_ASSERT_TRUE(uploader->getStateManager()->isFolderCompleted(String(20240101 + f)));
+    }
+    TEST_ASSERT_EQUAL(0, uploader->getStateManager()->getIncompleteFoldersCount());
+    delete uploader;
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_session_uploads_all_files);
+    RUN_TEST(test_second_session_uploads_nothing);
+    RUN_TEST(test_index_avoids_datalog_walk);
+    RUN_TEST(test_datalog_files_opened_once);
+    RUN_TEST(test_open_night_sends_only_the_tail);
+    RUN_TEST(test_retried_folder_skips_listed_files);
+    RUN_TEST(test_batch_commit_completes_folder);
+    RUN_TEST(test_mirror_reads_each_file_once);
+    RUN_TEST(test_mirror_failure_tracked_separately);
+    RUN_TEST(test_mirror_closed_night_opened_once);
+    RUN_TEST(test_mirror_budget_falls_back_per_endpoint);
+    RUN_TEST(test_session_archive_mode);
+    RUN_TEST(test_session_compressed_mode);
+    RUN_TEST(test_backend_registry);
+    RUN_TEST(test_local_backend_resume);
+    RUN_TEST(test_budget_slice_keeps_retry_count);
+    RUN_TEST(test_session_throughput_benchmark);
+
+    return UNITY_END();
+}
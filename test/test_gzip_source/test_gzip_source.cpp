@@ -0,0 +1,309 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+// Include the GzipSource implementation (streamed through the pipeline)
+#include "GzipSource.h"
+#include "../../src/Crc32.cpp"
+#include "../../src/GzipSource.cpp"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+#include "MockStreams.h"
+
+#include <ctime>
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+// Minimal gzip reader for the fixed-Huffman deflate GzipSource emits.
+// Returns false on any format error.
+class FixedInflater {
+public:
+    explicit FixedInflater(const std::vector<uint8_t>& gz) : in(gz), pos(10), bitPos(0) {}
+
+    bool run(std::vector<uint8_t>& out) {
+        if (in.size() < 18 || in[0] != 0x1F || in[1] != 0x8B || in[2] != 8) {
+            return false;
+        }
+        if (bits(1) != 1 || bits(2) != 1) {
+            return false;  // Expect one final fixed block
+        }
+        while (true) {
+            int symbol = decodeSymbol();
+            if (symbol < 0) {
+                return false;
+            }
+            if (symbol < 256) {
+                out.push_back((uint8_t)symbol);
+                continue;
+            }
+            if (symbol == 256) {
+                break;
+            }
+            int code = symbol - 257;
+            if (code > 28) {
+                return false;
+            }
+            size_t length = LENGTH_BASE[code] + bits(LENGTH_EXTRA[code]);
+            int dcode = reverse(bits(5), 5);
+            if (dcode > 29) {
+                return false;
+            }
+            size_t distance = DISTANCE_BASE[dcode] + bits(DISTANCE_EXTRA[dcode]);
+            if (distance > out.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < length; i++) {
+                out.push_back(out[out.size() - distance]);
+            }
+        }
+
+        // Trailer after the byte-aligned end of the block
+        size_t trailer = pos + (bitPos > 0 ? 1 : 0);
+        if (trailer + 8 != in.size()) {
+            return false;
+        }
+        uint32_t crc = readLE(trailer);
+        uint32_t size = readLE(trailer + 4);
+        return crc == Crc32::compute(0, out.data(), out.size()) && size == (uint32_t)out.size();
+    }
+
+private:
+    const std::vector<uint8_t>& in;
+    size_t pos;
+    int bitPos;
+
+    uint32_t bits(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++) {
+            if (pos >= in.size()) {
+                return 0;
+            }
+            value |= ((in[pos] >> bitPos) & 1) << i;
+            if (++bitPos == 8) {
+                bitPos = 0;
+                pos++;
+            }
+        }
+        return value;
+    }
+
+    static int reverse(uint32_t value, int length) {
+        int result = 0;
+        for (int i = 0; i < length; i++) {
+            result = (result << 1) | ((value >> i) & 1);
+        }
+        return result;
+    }
+
+    int decodeSymbol() {
+        int code = 0;
+        for (int length = 1; length <= 9; length++) {
+            code = (code << 1) | bits(1);
+            if (length == 7 && code <= 0x17) {
+                return 256 + code;
+            }
+            if (length == 8 && code >= 0x30 && code <= 0xBF) {
+                return code - 0x30;
+            }
+            if (length == 8 && code >= 0xC0 && code <= 0xC7) {
+                return 280 + (code - 0xC0);
+            }
+            if (length == 9 && code >= 0x190) {
+                return 144 + (code - 0x190);
+            }
+        }
+        return -1;
+    }
+
+    uint32_t readLE(size_t at) const {
+        return (uint32_t)in[at] | ((uint32_t)in[at + 1] << 8) |
+               ((uint32_t)in[at + 2] << 16) | ((uint32_t)in[at + 3] << 24);
+    }
+};
+
+static std::vector<uint8_t> compressAll(const std::vector<uint8_t>& raw, size_t readSize,
+                                        size_t inputStep = 1000000) {
+    MemorySource source(raw, inputStep);
+    GzipSource gzip(source, raw.size());
+    TEST_ASSERT_TRUE(gzip.begin());
+
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> buffer(readSize);
+    size_t n;
+    while ((n = gzip.read(buffer.data(), buffer.size())) > 0) {
+        out.insert(out.end(), buffer.begin(), buffer.begin() + n);
+    }
+    TEST_ASSERT_FALSE(gzip.hasFailed());
+    TEST_ASSERT_EQUAL(raw.size(), gzip.getInputBytes());
+    TEST_ASSERT_EQUAL(out.size(), gzip.getOutputBytes());
+    return out;
+}
+
+static void assertRoundTrip(const std::vector<uint8_t>& raw, const std::vector<uint8_t>& gz) {
+    std::vector<uint8_t> restored;
+    FixedInflater inflater(gz);
+    TEST_ASSERT_TRUE(inflater.run(restored));
+    TEST_ASSERT_EQUAL(raw.size(), restored.size());
+    TEST_ASSERT_TRUE(restored == raw);
+}
+
+void setUp(void) {
+    testFS.clear();
+    BufferPool::getInstance().end();
+}
+
+void tearDown(void) {
+    testFS.clear();
+}
+
+// CRC-32 matches the standard check value
+void test_crc32_check_value() {
+    const char* text = "123456789";
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, Crc32::compute(0, (const uint8_t*)text, 9));
+
+    Crc32 crc;
+    crc.update((const uint8_t*)text, 4);
+    crc.update((const uint8_t*)text + 4, 5);
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, crc.getValue());
+}
+
+// Empty, tiny, repetitive and random inputs all decode back exactly
+void test_gzip_round_trip_shapes() {
+    std::vector<uint8_t> empty;
+    std::vector<uint8_t> gz = compressAll(empty, 4096);
+    TEST_ASSERT_EQUAL(20, gz.size());  // Header, empty block, trailer
+    assertRoundTrip(empty, gz);
+
+    std::vector<uint8_t> one(1, 0xC3);
+    assertRoundTrip(one, compressAll(one, 4096));
+
+    std::vector<uint8_t> run(100000, 'a');
+    gz = compressAll(run, 4096);
+    TEST_ASSERT_TRUE(gz.size() < 2000);
+    assertRoundTrip(run, gz);
+
+    std::vector<uint8_t> noise(50000);
+    srand(7);
+    for (size_t i = 0; i < noise.size(); i++) {
+        noise[i] = rand() & 0xFF;
+    }
+    gz = compressAll(noise, 4096);
+    TEST_ASSERT_TRUE(gz.size() < noise.size() * 107 / 100);  // Fixed codes cost at most 9 bits/byte
+    assertRoundTrip(noise, gz);
+}
+
+// Output does not depend on how input arrives or output is drained
+void test_gzip_independent_of_slicing() {
+    std::vector<uint8_t> raw = makeEdf(0, 4);
+    std::vector<uint8_t> whole = compressAll(raw, 65536);
+    std::vector<uint8_t> sliced = compressAll(raw, 7, 333);
+    TEST_ASSERT_TRUE(whole == sliced);
+    assertRoundTrip(raw, whole);
+}
+
+// The pipeline streams a gzip source to its end without knowing its size
+void test_gzip_through_pipeline() {
+    std::vector<uint8_t> raw = makeEdf(0, 10);
+    testFS.addFile("/DATALOG/20241101/20241101_220000_BRP.edf", raw);
+
+    fs::File file = testFS.open("/DATALOG/20241101/20241101_220000_BRP.edf", FILE_READ);
+    FileUploadSource fileSource(file);
+    GzipSource gzip(fileSource, raw.size());
+    TEST_ASSERT_TRUE(gzip.begin());
+
+    UploadPipeline pipeline(4096, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+    CollectingSink sink;
+    unsigned long bytesTransferred = 0;
+    TEST_ASSERT_TRUE(pipeline.run(gzip, UploadPipeline::STREAM_TO_END, sink, bytesTransferred));
+    file.close();
+
+    TEST_ASSERT_FALSE(gzip.hasFailed());
+    TEST_ASSERT_EQUAL(sink.data.size(), bytesTransferred);
+    TEST_ASSERT_TRUE(bytesTransferred < raw.size());
+    TEST_ASSERT_EQUAL_UINT32(Crc32::compute(0, raw.data(), raw.size()), gzip.getInputCrc());
+    assertRoundTrip(raw, sink.data);
+}
+
+// Input that ends early fails the stream instead of producing a short file
+void test_gzip_short_input_fails() {
+    std::vector<uint8_t> raw(3000, 'x');
+    MemorySource source(raw);
+    GzipSource gzip(source, 5000);
+    TEST_ASSERT_TRUE(gzip.begin());
+
+    UploadPipeline pipeline(1024, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+    CollectingSink sink;
+    unsigned long bytesTransferred = 0;
+    pipeline.run(gzip, UploadPipeline::STREAM_TO_END, sink, bytesTransferred);
+    TEST_ASSERT_TRUE(gzip.hasFailed());
+
+    GzipSource unstarted(source, 10);
+    uint8_t buffer[16];
+    TEST_ASSERT_EQUAL(0, unstarted.read(buffer, sizeof(buffer)));
+    TEST_ASSERT_TRUE(unstarted.hasFailed());
+}
+
+// Benchmark: ratio and compression speed on synthetic night files
+void test_benchmark_edf_compression() {
+    struct Sample {
+        const char* name;
+        int kind;
+        int minutes;
+    };
+    const Sample samples[] = {
+        {"BRP (flow+pressure)", 0, 60},
+        {"PLD (trends)", 1, 480},
+        {"SAD (oximetry)", 2, 480},
+        {"EVE (annotations)", 3, 480},
+    };
+
+    printf("\n[Benchmark] Gzip window %u bytes, chain %d\n",
+           (unsigned)GzipSource::WINDOW_SIZE, GZIP_MAX_CHAIN);
+    printf("%-22s %10s %10s %7s %9s\n", "file", "raw", "gzip", "ratio", "MB/s");
+
+    size_t totalRaw = 0;
+    size_t totalGz = 0;
+    for (const Sample& sample : samples) {
+        std::vector<uint8_t> raw = makeEdf(sample.kind, sample.minutes);
+
+        clock_t start = clock();
+        std::vector<uint8_t> gz = compressAll(raw, 16384);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        assertRoundTrip(raw, gz);
+        TEST_ASSERT_TRUE(gz.size() < raw.size());
+
+        printf("%-22s %10u %10u %6.1f%% %9.1f\n", sample.name, (unsigned)raw.size(),
+               (unsigned)gz.size(), 100.0 * gz.size() / raw.size(),
+               seconds > 0 ? raw.size() / seconds / 1e6 : 0.0);
+        totalRaw += raw.size();
+        totalGz += gz.size();
+    }
+    printf("%-22s %10u %10u %6.1f%%\n", "total", (unsigned)totalRaw, (unsigned)totalGz,
+           100.0 * totalGz / totalRaw);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_gzip_round_trip_shapes);
+    RUN_TEST(test_gzip_independent_of_slicing);
+    RUN_TEST(test_gzip_through_pipeline);
+    RUN_TEST(test_gzip_short_input_fails);
+    RUN_TEST(test_benchmark_edf_compression);
+
+    return UNITY_END();
+}
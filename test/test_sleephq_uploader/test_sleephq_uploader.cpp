@@ -0,0 +1,340 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockMD5.h"
+#include "MockLogger.h"
+#include "MockPreferences.h"
+#include "MockClient.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+#include "../mocks/ArduinoJson.h"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+#ifndef ENABLE_SLEEPHQ_UPLOAD
+#define ENABLE_SLEEPHQ_UPLOAD
+#endif
+
+// Include the SleepHQ uploader and its HTTP connection
+#include "SleepHQUploader.h"
+#include "../../src/Config.cpp"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+#include "../../src/UploadBackend.cpp"
+#include "../../src/HttpConnection.cpp"
+#include "../../src/SleepHQUploader.cpp"
+#include "MockStreams.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+/**
+ * In-memory SleepHQ API behind the Client interface
+ * Implements the token, team, import and file endpoints the uploader uses.
+ */
+class FakeSleepHQ : public Client {
+public:
+    struct Import {
+        std::map<std::string, std::string> files;  // path + name -> content
+        bool processed = false;
+    };
+
+    std::map<int, Import> imports;
+    std::vector<std::string> requests;  // "METHOD path" log
+    std::string clientSecret;
+    int tokenCount;
+    int connects;
+    int failFilePosts;  // File POSTs answered with 500 (counting down)
+    bool open;
+
+    FakeSleepHQ() : clientSecret("secret"), tokenCount(0), connects(0), failFilePosts(0), open(false),
+                    outPos(0), nextImport(100) {}
+
+    int connect(const char* host, uint16_t port) override {
+        open = true;
+        connects++;
+        in.clear();
+        out.clear();
+        outPos = 0;
+        return 1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!open) {
+            return 0;
+        }
+        in.append((const char*)buf, size);
+        while (processRequest()) {
+        }
+        return size;
+    }
+
+    int available() override { return (int)(out.size() - outPos); }
+
+    int read(uint8_t* buf, size_t size) override {
+        size_t n = out.size() - outPos;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(buf, out.data() + outPos, n);
+        outPos += n;
+        return (int)n;
+    }
+
+    void stop() override {
+        open = false;
+        out.clear();
+        outPos = 0;
+    }
+
+    uint8_t connected() override { return open || outPos < out.size(); }
+
+    int count(const std::string& request) const {
+        int n = 0;
+        for (const std::string& r : requests) {
+            n += r == request ? 1 : 0;
+        }
+        return n;
+    }
+
+    std::string currentToken() const { return "token" + std::to_string(tokenCount); }
+
+private:
+    std::string in;
+    std::string out;
+    size_t outPos;
+    int nextImport;
+
+    static std::string header(const std::string& head, const char* name) {
+        std::string lower = head;
+        for (char& c : lower) c = tolower(c);
+        std::string key = std::string("\r\n") + name + ":";
+        size_t pos = lower.find(key);
+        if (pos == std::string::npos) {
+            return "";
+        }
+        size_t start = head.find_first_not_of(' ', pos + key.length());
+        return head.substr(start, head.find("\r\n", start) - start);
+    }
+
+    bool processRequest() {
+        size_t headEnd = in.find("\r\n\r\n");
+        if (headEnd == std::string::npos) {
+            return false;
+        }
+        std::string head = in.substr(0, headEnd + 2);
+        size_t length = strtoul(header(head, "content-length").c_str(), nullptr, 10);
+        if (in.size() < headEnd + 4 + length) {
+            return false;
+        }
+        std::string body = in.substr(headEnd + 4, length);
+        in.erase(0, headEnd + 4 + length);
+
+        std::string method = head.substr(0, head.find(' '));
+        size_t pathStart = method.length() + 1;
+        std::string path = head.substr(pathStart, head.find(' ', pathStart) - pathStart);
+        requests.push_back(method + " " + path);
+        handle(method, path, head, body);
+        return true;
+    }
+
+    void respond(int status, const std::string& body = "") {
+        out += "HTTP/1.1 " + std::to_string(status) + " X\r\nContent-Type: application/json\r\n" +
+               "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+
+    // Form fields of a multipart body
+    static std::map<std::string, std::string> parseMultipart(const std::string& head, const std::string& body) {
+        std::map<std::string, std::string> fields;
+        std::string type = header(head, "content-type");
+        std::string delimiter = "--" + type.substr(type.find("boundary=") + 9);
+        size_t pos = body.find(delimiter);
+        while (pos != std::string::npos && body.compare(pos + delimiter.size(), 2, "--") != 0) {
+            size_t partHead = pos + delimiter.size() + 2;
+            size_t partBody = body.find("\r\n\r\n", partHead) + 4;
+            size_t next = body.find("\r\n" + delimiter, partBody);
+            size_t nameStart = body.find("name=\"", partHead) + 6;
+            std::string name = body.substr(nameStart, body.find('"', nameStart) - nameStart);
+            fields[name] = body.substr(partBody, next - partBody);
+            pos = next == std::string::npos ? next : next + 2;
+        }
+        return fields;
+    }
+
+    void handle(const std::string& method, const std::string& path, const std::string& head,
+                const std::string& body) {
+        if (method == "POST" && path == "/oauth/token") {
+            if (body.find("grant_type=client_credentials") == std::string::npos ||
+                body.find("client_id=cpap") == std::string::npos ||
+                body.find("client_secret=" + clientSecret) == std::string::npos) {
+                respond(401, "{\"error\":\"invalid_client\"}");
+                return;
+            }
+            tokenCount++;
+            respond(200, "{\"access_token\":\"" + currentToken() +
+                         "\",\"token_type\":\"Bearer\",\"expires_in\":7200,\"scope\":\"read write\"}");
+            return;
+        }
+        if (header(head, "authorization") != "Bearer " + currentToken()) {
+            respond(401, "{\"error\":\"invalid_token\"}");
+            return;
+        }
+
+        int id = 0;
+        if (method == "GET" && path == "/api/v1/me") {
+            // JSON:API document; ids elsewhere in it must not be taken
+            respond(200, "{\"meta\":{\"current_team_id\":0},\"data\":{\"id\":\"7\",\"type\":\"user\","
+                         "\"attributes\":{\"name\":\"cpap\",\"current_team_id\":42}}}");
+        } else if (method == "POST" && path == "/api/v1/teams/42/imports") {
+            id = nextImport++;
+            imports[id];
+            respond(201, "{\"data\":{\"type\":\"import\",\"relationships\":{\"team\":{\"data\":"
+                         "{\"id\":\"42\",\"type\":\"team\"}}},\"id\":" + std::to_string(id) + "}}");
+        } else if (method == "POST" && sscanf(path.c_str(), "/api/v1/imports/%d/files", &id) == 1 &&
+                   path.find("/files") != std::string::npos) {
+            if (imports.count(id) == 0 || imports[id].processed) {
+                respond(404);
+                return;
+            }
+            if (failFilePosts > 0) {
+                failFilePosts--;
+                respond(500);
+                return;
+            }
+            std::map<std::string, std::string> fields = parseMultipart(head, body);
+            if (fields["content_hash"] != md5Hex(fields["file"] + fields["name"])) {
+                respond(422, "{\"errors\":\"content_hash\"}");
+                return;
+            }
+            imports[id].files[fields["path"] + fields["name"]] = fields["file"];
+            respond(201, "{\"data\":{\"type\":\"file\"}}");
+        } else if (method == "POST" && sscanf(path.c_str(), "/api/v1/imports/%d/process_files", &id) == 1) {
+            if (imports.count(id) == 0) {
+                respond(404);
+                return;
+            }
+            imports[id].processed = true;
+            respond(201, "{\"data\":{\"type\":\"import\"}}");
+        } else {
+            respond(404);
+        }
+    }
+};
+
+BACKEND_TEST_FIXTURE(FakeSleepHQ, SleepHQUploader, "", "cpap", "secret")
+
+// Wrong client secret: token request refused, nothing else is tried
+void test_authentication_failure() {
+    server->clientSecret = "other";
+    TEST_ASSERT_FALSE(uploader->ensureConnected());
+    TEST_ASSERT_FALSE(uploader->isConnected());
+    TEST_ASSERT_EQUAL(1, server->requests.size());
+    TEST_ASSERT_EQUAL(0, server->count("GET /api/v1/me"));
+}
+
+// A night's files go into one import, processed once, over one connection
+void test_folder_uploaded_as_one_import() {
+    std::vector<std::string> contents;
+    for (int i = 0; i < 3; i++) {
+        contents.push_back(makeContent(30000 + i * 777, i));
+        testFS.addFile(String("/DATALOG/20240101/file") + String(i) + ".edf", contents[i]);
+    }
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    for (int i = 0; i < 3; i++) {
+        unsigned long sent = 0;
+        String path = String("/DATALOG/20240101/file") + String(i) + ".edf";
+        TEST_ASSERT_TRUE(uploader->upload(path, path, testFS, sent));
+        TEST_ASSERT_EQUAL(contents[i].size(), sent);
+        TEST_ASSERT_EQUAL_STRING(md5Hex(contents[i]).c_str(), uploader->getLastChecksum().c_str());
+    }
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+
+    TEST_ASSERT_EQUAL(1, server->imports.size());
+    FakeSleepHQ::Import& import = server->imports.begin()->second;
+    TEST_ASSERT_TRUE(import.processed);
+    TEST_ASSERT_EQUAL(3, import.files.size());
+    TEST_ASSERT_TRUE(import.files["/DATALOG/20240101/file1.edf"] == contents[1]);
+    TEST_ASSERT_EQUAL(1, server->connects);
+    TEST_ASSERT_EQUAL(1, server->tokenCount);
+
+    // Next night opens a new import on the same connection
+    testFS.addFile("/DATALOG/20240102/file0.edf", contents[0]);
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240102/file0.edf"));
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(2, server->imports.size());
+    TEST_ASSERT_EQUAL(2, uploader->getImportCount());
+    TEST_ASSERT_EQUAL(1, server->connects);
+
+    // Nothing uploaded since: nothing to process
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(2, server->count("POST /api/v1/imports/100/process_files") +
+                         server->count("POST /api/v1/imports/101/process_files"));
+}
+
+// The access token is renewed before it expires, on the same connection
+void test_token_renewed_before_expiry() {
+    testFS.addFile("/Identification.tgt", makeContent(500, 1));
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_TRUE(uploadFile("/Identification.tgt"));
+    TEST_ASSERT_EQUAL(1, server->tokenCount);
+
+    MockTimeState::advanceMillis(7150UL * 1000UL);
+    TEST_ASSERT_TRUE(uploadFile("/Identification.tgt"));
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(2, server->tokenCount);
+    TEST_ASSERT_EQUAL(1, server->connects);
+    TEST_ASSERT_TRUE(server->imports.begin()->second.processed);
+}
+
+// A failed file drops the import: the retried batch starts a new one
+void test_failed_file_starts_new_import() {
+    testFS.addFile("/DATALOG/20240101/a.edf", makeContent(1000, 1));
+    testFS.addFile("/DATALOG/20240101/b.edf", makeContent(2000, 2));
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/a.edf"));
+    server->failFilePosts = 1;
+    TEST_ASSERT_FALSE(uploadFile("/DATALOG/20240101/b.edf"));
+    TEST_ASSERT_EQUAL_STRING("", uploader->getLastChecksum().c_str());
+
+    // Nothing left to process for the abandoned import
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_FALSE(server->imports[100].processed);
+
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/a.edf"));
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/b.edf"));
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_TRUE(server->imports[101].processed);
+    TEST_ASSERT_EQUAL(2, server->imports[101].files.size());
+}
+
+// A connection the server dropped between files is reopened transparently
+void test_reconnect_after_server_close() {
+    testFS.addFile("/STR.edf", makeContent(4000, 3));
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    server->stop();
+    TEST_ASSERT_TRUE(uploadFile("/STR.edf"));
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(2, server->connects);
+    TEST_ASSERT_TRUE(server->imports[100].processed);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_authentication_failure);
+    RUN_TEST(test_folder_uploaded_as_one_import);
+    RUN_TEST(test_token_renewed_before_expiry);
+    RUN_TEST(test_failed_file_starts_new_import);
+    RUN_TEST(test_reconnect_after_server_close);
+
+    return UNITY_END();
+}
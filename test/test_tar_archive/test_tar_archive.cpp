@@ -0,0 +1,251 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+// Include the TarArchiveSource implementation (streamed through the pipeline)
+#include "TarArchiveSource.h"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+#include "../../src/TarArchiveSource.cpp"
+
+#include <string>
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+// Sink that keeps the whole stream
+class CollectingSink : public UploadSink {
+public:
+    std::vector<uint8_t> data;
+    bool write(const uint8_t* chunk, size_t len) override {
+        data.insert(data.end(), chunk, chunk + len);
+        return true;
+    }
+};
+
+static std::vector<uint8_t> makeContent(size_t size, uint8_t seed) {
+    std::vector<uint8_t> content(size);
+    for (size_t i = 0; i < size; i++) {
+        content[i] = (uint8_t)(seed + i * 7);
+    }
+    return content;
+}
+
+static unsigned long parseOctal(const uint8_t* field, size_t width) {
+    unsigned long value = 0;
+    for (size_t i = 0; i < width && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+// Minimal ustar reader: returns name -> content, fails the test on bad headers
+static std::map<std::string, std::vector<uint8_t>> parseTar(const std::vector<uint8_t>& tar) {
+    std::map<std::string, std::vector<uint8_t>> entries;
+    size_t pos = 0;
+    while (pos + 512 <= tar.size()) {
+        const uint8_t* header = tar.data() + pos;
+        bool zero = true;
+        for (int i = 0; i < 512; i++) {
+            if (header[i] != 0) {
+                zero = false;
+                break;
+            }
+        }
+        if (zero) {
+            break;  // End of archive
+        }
+
+        TEST_ASSERT_EQUAL(0, memcmp(header + 257, "ustar", 6));
+        TEST_ASSERT_EQUAL('0', header[156]);
+
+        unsigned long checksum = 0;
+        for (int i = 0; i < 512; i++) {
+            checksum += (i >= 148 && i < 156) ? ' ' : header[i];
+        }
+        TEST_ASSERT_EQUAL(checksum, parseOctal(header + 148, 8));
+
+        std::string name((const char*)header);
+        unsigned long size = parseOctal(header + 124, 12);
+        pos += 512;
+        TEST_ASSERT_TRUE(pos + size <= tar.size());
+        entries[name] = std::vector<uint8_t>(tar.begin() + pos, tar.begin() + pos + size);
+        pos += (size + 511) / 512 * 512;
+    }
+
+    // Two zero blocks close the archive and nothing follows them
+    TEST_ASSERT_EQUAL(tar.size(), pos + 1024);
+    return entries;
+}
+
+void setUp(void) {
+    testFS.clear();
+    BufferPool::getInstance().end();
+}
+
+void tearDown(void) {
+    testFS.clear();
+}
+
+// Headers follow the ustar layout with a valid checksum
+void test_tar_header_format() {
+    uint8_t block[TarArchiveSource::BLOCK_SIZE];
+    TEST_ASSERT_TRUE(TarArchiveSource::formatHeader(block, "20241101/BRP.edf", 1234, 1700000000));
+
+    TEST_ASSERT_EQUAL_STRING("20241101/BRP.edf", (const char*)block);
+    TEST_ASSERT_EQUAL_STRING("0000644", (const char*)block + 100);
+    TEST_ASSERT_EQUAL(1234, parseOctal(block + 124, 12));
+    TEST_ASSERT_EQUAL(1700000000UL, parseOctal(block + 136, 12));
+    TEST_ASSERT_EQUAL(0, block[154]);
+    TEST_ASSERT_EQUAL(' ', block[155]);
+
+    std::string longName(TarArchiveSource::MAX_NAME_LENGTH + 1, 'x');
+    TEST_ASSERT_FALSE(TarArchiveSource::formatHeader(block, longName.c_str(), 0, 0));
+}
+
+// A folder streams as one archive holding every file unchanged
+void test_tar_stream_round_trip() {
+    std::vector<uint8_t> brp = makeContent(70000, 1);   // Not a multiple of 512
+    std::vector<uint8_t> eve = makeContent(1024, 2);    // Exact multiple
+    std::vector<uint8_t> csl = makeContent(1, 3);
+    testFS.addFile("/DATALOG/20241101/20241101_220000_BRP.edf", brp);
+    testFS.addFile("/DATALOG/20241101/20241101_220000_EVE.edf", eve);
+    testFS.addFile("/DATALOG/20241101/20241101_220000_CSL.edf", csl);
+    testFS.setLastWrite("/DATALOG/20241101/20241101_220000_BRP.edf", 1700000000);
+
+    TarArchiveSource archive(testFS, "/DATALOG/20241101", "20241101");
+    TEST_ASSERT_TRUE(archive.addFile("20241101_220000_BRP.edf"));
+    TEST_ASSERT_TRUE(archive.addFile("20241101_220000_EVE.edf"));
+    TEST_ASSERT_TRUE(archive.addFile("20241101_220000_CSL.edf"));
+    TEST_ASSERT_EQUAL(3, archive.getFileCount());
+    TEST_ASSERT_EQUAL(71025, archive.getDataBytes());
+
+    // 3 headers + data padded to blocks (70144 + 1024 + 512) + 2 end blocks
+    size_t expectedSize = 3 * 512 + 70144 + 1024 + 512 + 1024;
+    TEST_ASSERT_EQUAL(expectedSize, archive.getArchiveSize());
+
+    UploadPipeline pipeline(4096, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+    CollectingSink sink;
+    unsigned long bytesTransferred = 0;
+    TEST_ASSERT_TRUE(pipeline.run(archive, archive.getArchiveSize(), sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(expectedSize, bytesTransferred);
+    TEST_ASSERT_FALSE(archive.hasFailed());
+
+    std::map<std::string, std::vector<uint8_t>> entries = parseTar(sink.data);
+    TEST_ASSERT_EQUAL(3, entries.size());
+    TEST_ASSERT_TRUE(entries["20241101/20241101_220000_BRP.edf"] == brp);
+    TEST_ASSERT_TRUE(entries["20241101/20241101_220000_EVE.edf"] == eve);
+    TEST_ASSERT_TRUE(entries["20241101/20241101_220000_CSL.edf"] == csl);
+}
+
+// Output does not depend on how the reader slices its buffers
+void test_tar_stream_small_reads() {
+    testFS.addFile("/DATALOG/20241102/A.edf", makeContent(600, 4));
+    testFS.addFile("/DATALOG/20241102/B.edf", makeContent(0, 5));
+
+    TarArchiveSource whole(testFS, "/DATALOG/20241102", "20241102");
+    TarArchiveSource sliced(testFS, "/DATALOG/20241102", "20241102");
+    TEST_ASSERT_TRUE(whole.addFile("A.edf") && whole.addFile("B.edf"));
+    TEST_ASSERT_TRUE(sliced.addFile("A.edf") && sliced.addFile("B.edf"));
+
+    std::vector<uint8_t> expected(whole.getArchiveSize());
+    TEST_ASSERT_EQUAL(expected.size(), whole.read(expected.data(), expected.size()));
+    TEST_ASSERT_EQUAL(0, whole.read(expected.data(), 1));  // End of stream
+
+    std::vector<uint8_t> actual;
+    uint8_t piece[37];
+    size_t n;
+    while ((n = sliced.read(piece, sizeof(piece))) > 0) {
+        actual.insert(actual.end(), piece, piece + n);
+    }
+    TEST_ASSERT_TRUE(actual == expected);
+    TEST_ASSERT_EQUAL(2, parseTar(actual).size());
+}
+
+// Size computed from the file sizes alone matches the streamed archive
+void test_tar_size_from_file_sizes() {
+    std::vector<unsigned long> sizes;
+    TEST_ASSERT_EQUAL(1024, TarArchiveSource::archiveSizeFor(sizes));
+    sizes.push_back(512);
+    sizes.push_back(513);
+    TEST_ASSERT_EQUAL(1024 + 512 + 512 + 512 + 1024, TarArchiveSource::archiveSizeFor(sizes));
+}
+
+// A file that shrank after it was added fails the stream
+void test_tar_shrunk_file_fails() {
+    testFS.addFile("/DATALOG/20241103/BRP.edf", makeContent(2000, 6));
+    TarArchiveSource archive(testFS, "/DATALOG/20241103", "20241103");
+    TEST_ASSERT_TRUE(archive.addFile("BRP.edf"));
+
+    testFS.addFile("/DATALOG/20241103/BRP.edf", makeContent(100, 6));
+
+    UploadPipeline pipeline(1024, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+    CollectingSink sink;
+    unsigned long bytesTransferred = 0;
+    TEST_ASSERT_FALSE(pipeline.run(archive, archive.getArchiveSize(), sink, bytesTransferred));
+    TEST_ASSERT_TRUE(archive.hasFailed());
+}
+
+// Sizes and times from a directory scan give the same archive, and the
+// files are only opened when their data is streamed
+void test_tar_add_scanned_file() {
+    std::vector<uint8_t> brp = makeContent(3000, 7);
+    testFS.addFile("/DATALOG/20241105/BRP.edf", brp);
+    testFS.setLastWrite("/DATALOG/20241105/BRP.edf", 1700000000);
+
+    TarArchiveSource opened(testFS, "/DATALOG/20241105", "20241105");
+    TEST_ASSERT_TRUE(opened.addFile("BRP.edf"));
+
+    testFS.resetDirectoryCounters();
+    TarArchiveSource scanned(testFS, "/DATALOG/20241105", "20241105");
+    TEST_ASSERT_TRUE(scanned.addFile("BRP.edf", 3000, 1700000000));
+    TEST_ASSERT_EQUAL(0, testFS.getOpenCount("/DATALOG/20241105/BRP.edf"));
+    TEST_ASSERT_EQUAL(opened.getArchiveSize(), scanned.getArchiveSize());
+
+    std::vector<uint8_t> expected(opened.getArchiveSize());
+    std::vector<uint8_t> actual(scanned.getArchiveSize());
+    TEST_ASSERT_EQUAL(expected.size(), opened.read(expected.data(), expected.size()));
+    testFS.resetDirectoryCounters();
+    TEST_ASSERT_EQUAL(actual.size(), scanned.read(actual.data(), actual.size()));
+    TEST_ASSERT_TRUE(actual == expected);
+    TEST_ASSERT_EQUAL(1, testFS.getOpenCount("/DATALOG/20241105/BRP.edf"));
+
+    std::string longName(TarArchiveSource::MAX_NAME_LENGTH, 'z');
+    TEST_ASSERT_FALSE(scanned.addFile(String(longName.c_str()), 10, 0));
+}
+
+// Missing files and over-long names are refused up front
+void test_tar_add_file_errors() {
+    TarArchiveSource archive(testFS, "/DATALOG/20241104", "20241104");
+    TEST_ASSERT_FALSE(archive.addFile("missing.edf"));
+
+    std::string longName(TarArchiveSource::MAX_NAME_LENGTH, 'y');
+    testFS.addFile(String("/DATALOG/20241104/") + String(longName.c_str()), "data");
+    TEST_ASSERT_FALSE(archive.addFile(String(longName.c_str())));
+    TEST_ASSERT_EQUAL(0, archive.getFileCount());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_tar_header_format);
+    RUN_TEST(test_tar_stream_round_trip);
+    RUN_TEST(test_tar_stream_small_reads);
+    RUN_TEST(test_tar_size_from_file_sizes);
+    RUN_TEST(test_tar_shrunk_file_fails);
+    RUN_TEST(test_tar_add_scanned_file);
+    RUN_TEST(test_tar_add_file_errors);
+
+    return UNITY_END();
+}
@@ -0,0 +1,404 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockMD5.h"
+#include "MockLogger.h"
+#include "MockPreferences.h"
+#include "MockClient.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+#include "../mocks/ArduinoJson.h"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+#ifndef ENABLE_TCP_UPLOAD
+#define ENABLE_TCP_UPLOAD
+#endif
+
+// Include the TCP uploader and what it streams through
+#include "TCPUploader.h"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Crc32.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+#include "../../src/UploadBackend.cpp"
+#include "../../src/TCPUploader.cpp"
+#include "MockStreams.h"
+
+#include <map>
+#include <string>
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+static uint64_t readLE(const std::string& data, size_t pos, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | (uint8_t)data[pos + i];
+    }
+    return value;
+}
+
+static void appendLE(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += (char)(value >> (8 * i));
+    }
+}
+
+/**
+ * In-memory receiver behind the Client interface
+ * Parses the hello and file frames like tools/tcp_receiver and answers
+ * with acks. With holdAcks the acks only become readable once the client
+ * waits for them (available() polled repeatedly without a write),
+ * so files pile up unacknowledged the way they do on a real link.
+ */
+class FakeReceiver : public Client {
+public:
+    std::map<std::string, std::string> files;  // Stored files by path
+    std::map<std::string, uint64_t> sizes;     // Announced size by path
+    std::string token;
+    std::string corruptPath;  // Data of this file is damaged in transit
+    bool holdAcks;
+    int connects;
+    size_t framesReceived;
+    size_t maxUnacked;        // Peak frames received but not acked to the client
+    bool open;
+
+    FakeReceiver() : token("secret"), holdAcks(false), connects(0), framesReceived(0), maxUnacked(0),
+                     open(false), helloDone(false), polls(0), outPos(0) {}
+
+    int connect(const char* host, uint16_t port) override {
+        open = true;
+        connects++;
+        helloDone = false;
+        in.clear();
+        held.clear();
+        out.clear();
+        outPos = 0;
+        return 1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!open) {
+            return 0;
+        }
+        polls = 0;
+        in.append((const char*)buf, size);
+        while (process()) {
+        }
+        return size;
+    }
+
+    int available() override {
+        if (++polls > 2 && !held.empty()) {
+            out += held;
+            held.clear();
+        }
+        return (int)(out.size() - outPos);
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        size_t n = out.size() - outPos;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(buf, out.data() + outPos, n);
+        outPos += n;
+        return (int)n;
+    }
+
+    void stop() override {
+        open = false;
+        held.clear();
+        out.clear();
+        outPos = 0;
+    }
+
+    uint8_t connected() override { return open || outPos < out.size(); }
+
+private:
+    std::string in;
+    std::string held;
+    std::string out;
+    bool helloDone;
+    int polls;        // available() calls since the last write
+    size_t outPos;
+
+    size_t pendingAcks() const { return held.size() / 14; }
+
+    bool process() {
+        if (!helloDone) {
+            if (in.size() < 7 || in.size() < 7 + readLE(in, 5, 2)) {
+                return false;
+            }
+            size_t length = readLE(in, 5, 2);
+            bool accepted = in.compare(0, 4, "CPAP") == 0 && in[4] == 1 && in.substr(7, length) == token;
+            out += std::string("CPAP\x01", 5) + (char)(accepted ? 0 : 1);
+            in.erase(0, 7 + length);
+            helloDone = true;
+            if (!accepted) {
+                open = false;
+            }
+            return true;
+        }
+
+        // 'F' u32 seq, u16 path length, path, u64 size, chunks, u32 0, u32 crc
+        if (in.size() < 7 || in.size() < 7 + readLE(in, 5, 2) + 8) {
+            return false;
+        }
+        TEST_ASSERT_EQUAL('F', in[0]);
+        uint32_t seq = (uint32_t)readLE(in, 1, 4);
+        size_t pathLength = readLE(in, 5, 2);
+        std::string path = in.substr(7, pathLength);
+        uint64_t size = readLE(in, 7 + pathLength, 8);
+        size_t pos = 15 + pathLength;
+        std::string data;
+        for (;;) {
+            if (in.size() < pos + 4) {
+                return false;
+            }
+            size_t chunk = readLE(in, pos, 4);
+            pos += 4;
+            if (chunk == 0) {
+                break;
+            }
+            if (in.size() < pos + chunk) {
+                return false;
+            }
+            data += in.substr(pos, chunk);
+            pos += chunk;
+        }
+        if (in.size() < pos + 4) {
+            return false;
+        }
+        uint32_t crc = (uint32_t)readLE(in, pos, 4);
+        in.erase(0, pos + 4);
+
+        if (path == corruptPath && !data.empty()) {
+            data[0] ^= 0x55;
+        }
+        uint8_t status = 0;
+        if (Crc32::compute(0, (const uint8_t*)data.data(), data.size()) != crc) {
+            status = 1;
+        } else if (size != ~(uint64_t)0 && size != data.size()) {
+            status = 3;
+        } else {
+            files[path] = data;
+            sizes[path] = size;
+        }
+        framesReceived++;
+
+        std::string ack("A");
+        appendLE(ack, seq, 4);
+        appendLE(ack, status, 1);
+        appendLE(ack, status == 0 ? data.size() : 0, 8);
+        if (holdAcks) {
+            held += ack;
+            maxUnacked = std::max(maxUnacked, pendingAcks());
+        } else {
+            out += ack;
+        }
+        return true;
+    }
+};
+
+/**
+ * UploadSource over a string, ending the stream itself
+ */
+class StringSource : public UploadSource {
+public:
+    explicit StringSource(const std::string& data) : data(data), pos(0) {}
+
+    size_t read(uint8_t* buffer, size_t len) override {
+        size_t n = std::min(len, data.size() - pos);
+        memcpy(buffer, data.data() + pos, n);
+        pos += n;
+        return n;
+    }
+
+private:
+    std::string data;
+    size_t pos;
+};
+
+BACKEND_TEST_FIXTURE(FakeReceiver, TCPUploader, "tcp://nas.local:9000", "secret")
+
+// host[:port] with optional tcp:// prefix; anything else is rejected
+void test_endpoint_parsing() {
+    TEST_ASSERT_EQUAL_STRING("nas.local", uploader->getHost().c_str());
+    TEST_ASSERT_EQUAL(9000, uploader->getPort());
+
+    TCPUploader plain("192.168.1.20", "");
+    TEST_ASSERT_EQUAL_STRING("192.168.1.20", plain.getHost().c_str());
+    TEST_ASSERT_EQUAL(TCP_DEFAULT_PORT, plain.getPort());
+
+    TCPUploader url("http://nas.local/share", "");
+    url.setClient(server);
+    TEST_ASSERT_FALSE(url.ensureConnected());
+    TEST_ASSERT_EQUAL(0, server->connects);
+}
+
+// Wrong token: the receiver refuses the session
+void test_bad_token_rejected() {
+    server->token = "other";
+    TEST_ASSERT_FALSE(uploader->ensureConnected());
+    TEST_ASSERT_FALSE(uploader->isConnected());
+    TEST_ASSERT_EQUAL(1, server->connects);
+}
+
+// Files go out back to back and their acks are collected at the commit
+void test_files_pipelined_over_one_connection() {
+    server->holdAcks = true;
+    std::string contents[3];
+    for (int i = 0; i < 3; i++) {
+        contents[i] = makeContent(20000 + i * 12345, i);
+        testFS.addFile(String("/DATALOG/20240101/file") + String(i) + ".edf", contents[i]);
+    }
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    for (int i = 0; i < 3; i++) {
+        unsigned long sent = 0;
+        String path = String("/DATALOG/20240101/file") + String(i) + ".edf";
+        TEST_ASSERT_TRUE(uploader->upload(path, path, testFS, sent));
+        TEST_ASSERT_EQUAL(contents[i].size(), sent);
+        TEST_ASSERT_EQUAL_STRING(md5Hex(contents[i]).c_str(), uploader->getLastChecksum().c_str());
+    }
+    TEST_ASSERT_EQUAL(3, uploader->getUnackedCount());
+    TEST_ASSERT_EQUAL(3, server->maxUnacked);
+
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(0, uploader->getUnackedCount());
+    TEST_ASSERT_EQUAL(3, uploader->getFileCount());
+    TEST_ASSERT_TRUE(server->files["/DATALOG/20240101/file2.edf"] == contents[2]);
+    TEST_ASSERT_EQUAL(contents[2].size(), server->sizes["/DATALOG/20240101/file2.edf"]);
+    TEST_ASSERT_EQUAL(1, server->connects);
+
+    // Nothing sent since: nothing to wait for
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+}
+
+// No more than TCP_UPLOAD_WINDOW files wait for their ack
+void test_window_bounds_unacked_files() {
+    server->holdAcks = true;
+    testFS.addFile("/DATALOG/20240101/BRP.edf", makeContent(3000, 1));
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    for (int i = 0; i < TCP_UPLOAD_WINDOW + 3; i++) {
+        TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/BRP.edf"));
+    }
+    TEST_ASSERT_EQUAL(TCP_UPLOAD_WINDOW, uploader->getMaxUnacked());
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(TCP_UPLOAD_WINDOW + 3, server->framesReceived);
+    TEST_ASSERT_EQUAL(TCP_UPLOAD_WINDOW + 3, uploader->getFileCount());
+}
+
+// A file damaged in transit fails the batch; the retry succeeds
+void test_crc_mismatch_fails_batch() {
+    server->holdAcks = true;
+    testFS.addFile("/DATALOG/20240101/a.edf", makeContent(5000, 1));
+    testFS.addFile("/DATALOG/20240101/b.edf", makeContent(6000, 2));
+    server->corruptPath = "/DATALOG/20240101/a.edf";
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/a.edf"));
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/b.edf"));
+    TEST_ASSERT_FALSE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(0, server->files.count("/DATALOG/20240101/a.edf"));
+    TEST_ASSERT_FALSE(uploader->isConnected());
+
+    server->corruptPath = "";
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/a.edf"));
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/b.edf"));
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(2, server->connects);
+    TEST_ASSERT_EQUAL(2, server->files.size());
+}
+
+// A nack already received stops the batch at the next file
+void test_nack_stops_batch_early() {
+    testFS.addFile("/DATALOG/20240101/a.edf", makeContent(5000, 1));
+    testFS.addFile("/DATALOG/20240101/b.edf", makeContent(6000, 2));
+    server->corruptPath = "/DATALOG/20240101/a.edf";
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_FALSE(uploadFile("/DATALOG/20240101/a.edf"));
+    TEST_ASSERT_FALSE(uploader->isConnected());
+    TEST_ASSERT_EQUAL(1, server->framesReceived);
+}
+
+// Files in flight on a connection that dropped are not reported as uploaded
+void test_connection_loss_fails_batch() {
+    server->holdAcks = true;
+    testFS.addFile("/DATALOG/20240101/a.edf", makeContent(5000, 1));
+    testFS.addFile("/DATALOG/20240101/b.edf", makeContent(6000, 2));
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/a.edf"));
+    server->stop();
+
+    // FileUploader reconnects before each file; the batch already lost one
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_FALSE(uploadFile("/DATALOG/20240101/b.edf"));
+    TEST_ASSERT_FALSE(uploader->commitBatch());
+    TEST_ASSERT_EQUAL(2, server->connects);
+
+    // The retried batch starts clean
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    TEST_ASSERT_TRUE(uploadFile("/DATALOG/20240101/a.edf"));
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+}
+
+// Generated streams of unknown length are chunked and acked before returning
+void test_stream_of_unknown_length() {
+    std::string content = makeContent(70000, 4);
+    StringSource source(content);
+    unsigned long sent = 0;
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    server->holdAcks = true;
+    TEST_ASSERT_TRUE(uploader->uploadStream(source, UploadPipeline::STREAM_TO_END, "/DATALOG/20240101.tar", sent));
+    TEST_ASSERT_EQUAL(content.size(), sent);
+    TEST_ASSERT_EQUAL(0, uploader->getUnackedCount());
+    TEST_ASSERT_TRUE(server->files["/DATALOG/20240101.tar"] == content);
+    TEST_ASSERT_TRUE(server->sizes["/DATALOG/20240101.tar"] == ~(uint64_t)0);
+}
+
+// Data pushed by the caller (one SD read shared with a mirror endpoint)
+void test_pushed_file() {
+    std::string content = makeContent(40000, 5);
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+
+    UploadSink* sink = uploader->beginFile("/SETTINGS/CurrentSettings.json", content.size());
+    TEST_ASSERT_NOT_NULL(sink);
+    TEST_ASSERT_NULL(uploader->beginFile("/other", 10));
+    TEST_ASSERT_TRUE(sink->write((const uint8_t*)content.data(), 25000));
+    TEST_ASSERT_TRUE(sink->write((const uint8_t*)content.data() + 25000, content.size() - 25000));
+    TEST_ASSERT_TRUE(uploader->finishFile(true));
+    TEST_ASSERT_TRUE(uploader->commitBatch());
+    TEST_ASSERT_TRUE(server->files["/SETTINGS/CurrentSettings.json"] == content);
+
+    // An abandoned file cannot be ended cleanly: the connection goes
+    sink = uploader->beginFile("/SETTINGS/CurrentSettings.json", content.size());
+    TEST_ASSERT_TRUE(sink->write((const uint8_t*)content.data(), 1000));
+    TEST_ASSERT_FALSE(uploader->finishFile(false));
+    TEST_ASSERT_FALSE(uploader->isConnected());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_endpoint_parsing);
+    RUN_TEST(test_bad_token_rejected);
+    RUN_TEST(test_files_pipelined_over_one_connection);
+    RUN_TEST(test_window_bounds_unacked_files);
+    RUN_TEST(test_crc_mismatch_fails_batch);
+    RUN_TEST(test_nack_stops_batch_early);
+    RUN_TEST(test_connection_loss_fails_batch);
+    RUN_TEST(test_stream_of_unknown_length);
+    RUN_TEST(test_pushed_file);
+
+    return UNITY_END();
+}
@@ -168,6 +168,22 @@ void test_can_upload_file() {
 }
 
 // Test transmission rate averaging over multiple uploads
+// Test bytes estimate for the remaining budget (used for partial uploads)
+void test_estimate_bytes_in_remaining_budget() {
+    TimeBudgetManager manager;
+    
+    MockTimeState::setMillis(0);
+    manager.startSession(5);  // 5 seconds at default 40 KB/s
+    
+    TEST_ASSERT_EQUAL(5 * 40960, manager.estimateBytesInRemainingBudget());
+    
+    MockTimeState::advanceMillis(2500);  // 2.5 seconds remaining
+    TEST_ASSERT_EQUAL(2 * 40960 + 20480, manager.estimateBytesInRemainingBudget());
+    
+    MockTimeState::advanceMillis(5000);  // Budget exhausted
+    TEST_ASSERT_EQUAL(0, manager.estimateBytesInRemainingBudget());
+}
+
 void test_transmission_rate_single_upload() {
     TimeBudgetManager manager;
     
@@ -275,6 +291,39 @@ void test_record_upload_zero_time() {
     TEST_ASSERT_EQUAL(1000, estimatedTime);  // Default 40 KB/s
 }
 
+void test_compressed_rate_defaults_to_link_rate() {
+    TimeBudgetManager manager;
+    
+    MockTimeState::setMillis(0);
+    manager.startSession(10);
+    
+    // Nothing compressed yet: no gain assumed
+    manager.recordUpload(512 * 1024, 1000);
+    TEST_ASSERT_EQUAL(manager.getTransmissionRate(), manager.getCompressedRate());
+    TEST_ASSERT_EQUAL(1000, manager.estimateCompressedUploadTimeMs(512 * 1024));
+}
+
+void test_compressed_rate_learned_separately() {
+    TimeBudgetManager manager;
+    
+    MockTimeState::setMillis(0);
+    manager.startSession(3);
+    
+    // Link: 100 KB/s. Compressed: 300 KB of raw data per second
+    manager.recordUpload(100 * 1024, 1000);
+    manager.recordCompressedUpload(300 * 1024, 1000);
+    manager.recordCompressedUpload(600 * 1024, 2000);
+    manager.recordCompressedUpload(300 * 1024, 0);  // Ignored
+    
+    TEST_ASSERT_EQUAL(100 * 1024, manager.getTransmissionRate());
+    TEST_ASSERT_EQUAL(300 * 1024, manager.getCompressedRate());
+    
+    // A 600 KB file takes 6 s raw but 2 s compressed: only the latter fits 3 s
+    TEST_ASSERT_FALSE(manager.canUploadFile(600 * 1024));
+    TEST_ASSERT_TRUE(manager.canUploadCompressed(600 * 1024));
+    TEST_ASSERT_EQUAL(2000, manager.estimateCompressedUploadTimeMs(600 * 1024));
+}
+
 // Test retry multiplier application
 void test_retry_multiplier_basic() {
     TimeBudgetManager manager;
@@ -565,6 +614,7 @@ int main(int argc, char **argv) {
     RUN_TEST(test_upload_time_estimation_default_rate);
     RUN_TEST(test_upload_time_estimation_various_sizes);
     RUN_TEST(test_can_upload_file);
+    RUN_TEST(test_estimate_bytes_in_remaining_budget);
     
     // Transmission rate averaging tests
     RUN_TEST(test_transmission_rate_single_upload);
@@ -572,6 +622,8 @@ int main(int argc, char **argv) {
     RUN_TEST(test_transmission_rate_history_limit);
     RUN_TEST(test_transmission_rate_varying_speeds);
     RUN_TEST(test_record_upload_zero_time);
+    RUN_TEST(test_compressed_rate_defaults_to_link_rate);
+    RUN_TEST(test_compressed_rate_learned_separately);
     
     // Retry multiplier tests
     RUN_TEST(test_retry_multiplier_basic);
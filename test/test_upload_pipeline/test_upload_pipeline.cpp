@@ -0,0 +1,280 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockLogger.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+// Include the UploadPipeline implementation
+#include "UploadPipeline.h"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+// Fake sink that records every chunk and how far the reader ran ahead of it
+class RecordingSink : public UploadSink {
+public:
+    std::vector<uint8_t> received;
+    std::vector<size_t> chunkSizes;
+    fs::File* source;
+    size_t maxReadAhead;
+    int failAfterWrites;  // -1 = never fail
+
+    RecordingSink(fs::File* src = nullptr)
+        : source(src), maxReadAhead(0), failAfterWrites(-1) {}
+
+    bool write(const uint8_t* data, size_t len) override {
+        if (failAfterWrites >= 0 && (int)chunkSizes.size() >= failAfterWrites) {
+            return false;
+        }
+
+        // Bytes read from SD that have not yet reached the sink (including this chunk)
+        if (source) {
+            size_t readAhead = source->position() - received.size();
+            if (readAhead > maxReadAhead) {
+                maxReadAhead = readAhead;
+            }
+        }
+
+        received.insert(received.end(), data, data + len);
+        chunkSizes.push_back(len);
+        return true;
+    }
+};
+
+static std::vector<uint8_t> makePattern(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)((i * 31 + i / 251) & 0xFF);
+    }
+    return data;
+}
+
+void setUp(void) {
+    testFS.clear();
+    MockTimeState::reset();
+}
+
+void tearDown(void) {
+    testFS.clear();
+}
+
+// Data must arrive at the sink complete and in file order
+void test_pipeline_preserves_order() {
+    std::vector<uint8_t> content = makePattern(10 * 1024 + 123);
+    testFS.addFile("/DATALOG/20241101/BRP.edf", content);
+
+    UploadPipeline pipeline(1024, 3);
+    TEST_ASSERT_TRUE(pipeline.begin());
+
+    fs::File file = testFS.open("/DATALOG/20241101/BRP.edf", FILE_READ);
+    RecordingSink sink(&file);
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_TRUE(pipeline.run(file, content.size(), sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(content.size(), bytesTransferred);
+    TEST_ASSERT_EQUAL(content.size(), sink.received.size());
+    TEST_ASSERT_TRUE(sink.received == content);
+
+    // 10 full chunks plus the 123-byte tail
+    TEST_ASSERT_EQUAL(11, sink.chunkSizes.size());
+    TEST_ASSERT_EQUAL(1024, sink.chunkSizes[0]);
+    TEST_ASSERT_EQUAL(123, sink.chunkSizes[10]);
+
+    file.close();
+}
+
+// Reader must never get more than bufferCount buffers ahead of the sink
+void test_pipeline_backpressure_limits_read_ahead() {
+    std::vector<uint8_t> content = makePattern(64 * 1024);
+    testFS.addFile("/STR.edf", content);
+
+    UploadPipeline pipeline(4096, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+
+    fs::File file = testFS.open("/STR.edf", FILE_READ);
+    RecordingSink sink(&file);
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_TRUE(pipeline.run(file, content.size(), sink, bytesTransferred));
+    TEST_ASSERT_TRUE(sink.received == content);
+
+    TEST_ASSERT_TRUE(sink.maxReadAhead <= 2 * 4096);
+    TEST_ASSERT_EQUAL(2, pipeline.getMaxBuffersInFlight());
+    TEST_ASSERT_GREATER_THAN(0, pipeline.getReaderStalls());
+
+    file.close();
+}
+
+// A file smaller than one buffer goes through as a single chunk
+void test_pipeline_small_file_single_chunk() {
+    testFS.addFile("/Identification.json", "{\"serial\":\"123\"}");
+
+    UploadPipeline pipeline(1024, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+
+    fs::File file = testFS.open("/Identification.json", FILE_READ);
+    RecordingSink sink(&file);
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_TRUE(pipeline.run(file, file.size(), sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(16, bytesTransferred);
+    TEST_ASSERT_EQUAL(1, sink.chunkSizes.size());
+    TEST_ASSERT_EQUAL(0, pipeline.getReaderStalls());
+
+    file.close();
+}
+
+// Only the requested number of bytes is read, even if the file is longer
+void test_pipeline_reads_requested_length_only() {
+    std::vector<uint8_t> content = makePattern(5000);
+    testFS.addFile("/STR.edf", content);
+
+    UploadPipeline pipeline(1024, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+
+    fs::File file = testFS.open("/STR.edf", FILE_READ);
+    RecordingSink sink(&file);
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_TRUE(pipeline.run(file, 3000, sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(3000, bytesTransferred);
+    TEST_ASSERT_EQUAL(3000, file.position());
+    TEST_ASSERT_TRUE(std::equal(sink.received.begin(), sink.received.end(), content.begin()));
+
+    file.close();
+}
+
+// Sink failure aborts the transfer and reports only accepted bytes
+void test_pipeline_sink_failure_aborts() {
+    std::vector<uint8_t> content = makePattern(8 * 1024);
+    testFS.addFile("/DATALOG/20241101/PLD.edf", content);
+
+    UploadPipeline pipeline(1024, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+
+    fs::File file = testFS.open("/DATALOG/20241101/PLD.edf", FILE_READ);
+    RecordingSink sink(&file);
+    sink.failAfterWrites = 3;
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_FALSE(pipeline.run(file, content.size(), sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(3 * 1024, bytesTransferred);
+    TEST_ASSERT_EQUAL(3 * 1024, sink.received.size());
+
+    file.close();
+}
+
+// Source shorter than expected is reported as a read error
+void test_pipeline_short_read_fails() {
+    std::vector<uint8_t> content = makePattern(2500);
+    testFS.addFile("/STR.edf", content);
+
+    UploadPipeline pipeline(1024, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+
+    fs::File file = testFS.open("/STR.edf", FILE_READ);
+    RecordingSink sink(&file);
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_FALSE(pipeline.run(file, 4096, sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(2500, bytesTransferred);
+    TEST_ASSERT_TRUE(sink.received == content);
+
+    file.close();
+}
+
+// run() without allocated buffers must fail safely
+void test_pipeline_requires_begin() {
+    testFS.addFile("/STR.edf", "data");
+
+    UploadPipeline pipeline(1024, 2);
+    fs::File file = testFS.open("/STR.edf", FILE_READ);
+    RecordingSink sink;
+    unsigned long bytesTransferred = 123;
+
+    TEST_ASSERT_FALSE(pipeline.run(file, 4, sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(0, bytesTransferred);
+    TEST_ASSERT_EQUAL(0, sink.received.size());
+
+    file.close();
+}
+
+// Buffer count is clamped to the supported range
+void test_pipeline_buffer_count_clamped() {
+    UploadPipeline tooFew(1024, 0);
+    TEST_ASSERT_EQUAL(1, tooFew.getBufferCount());
+
+    UploadPipeline tooMany(1024, 100);
+    TEST_ASSERT_EQUAL(UploadPipeline::MAX_BUFFERS, tooMany.getBufferCount());
+}
+
+// Single-buffer ring degrades to strict read-then-write
+void test_pipeline_single_buffer() {
+    std::vector<uint8_t> content = makePattern(3000);
+    testFS.addFile("/STR.edf", content);
+
+    UploadPipeline pipeline(1000, 1);
+    TEST_ASSERT_TRUE(pipeline.begin());
+
+    fs::File file = testFS.open("/STR.edf", FILE_READ);
+    RecordingSink sink(&file);
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_TRUE(pipeline.run(file, content.size(), sink, bytesTransferred));
+    TEST_ASSERT_TRUE(sink.received == content);
+    TEST_ASSERT_TRUE(sink.maxReadAhead <= 1000);
+    TEST_ASSERT_EQUAL(1, pipeline.getMaxBuffersInFlight());
+
+    file.close();
+}
+
+// The inline digest matches hashing the whole file in one pass
+void test_pipeline_inline_digest() {
+    std::vector<uint8_t> content = makePattern(5 * 1000 + 7);
+    testFS.addFile("/SETTINGS/CurrentSettings.json", content);
+
+    Md5Digest reference;
+    reference.update(content.data(), content.size());
+    String expected = reference.finishHex();
+
+    UploadPipeline pipeline(1000, 2);
+    TEST_ASSERT_TRUE(pipeline.begin());
+    Md5Digest digest;
+    pipeline.setDigest(&digest);
+
+    fs::File file = testFS.open("/SETTINGS/CurrentSettings.json", FILE_READ);
+    RecordingSink sink;
+    unsigned long bytesTransferred = 0;
+
+    TEST_ASSERT_TRUE(pipeline.run(file, content.size(), sink, bytesTransferred));
+    TEST_ASSERT_EQUAL(content.size(), digest.getBytes());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), digest.finishHex().c_str());
+
+    file.close();
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pipeline_preserves_order);
+    RUN_TEST(test_pipeline_backpressure_limits_read_ahead);
+    RUN_TEST(test_pipeline_small_file_single_chunk);
+    RUN_TEST(test_pipeline_reads_requested_length_only);
+    RUN_TEST(test_pipeline_sink_failure_aborts);
+    RUN_TEST(test_pipeline_short_read_fails);
+    RUN_TEST(test_pipeline_requires_begin);
+    RUN_TEST(test_pipeline_buffer_count_clamped);
+    RUN_TEST(test_pipeline_single_buffer);
+    RUN_TEST(test_pipeline_inline_digest);
+
+    return UNITY_END();
+}
@@ -16,11 +16,38 @@
 
 // Include the UploadStateManager implementation
 #include "UploadStateManager.h"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/Crc32.cpp"
 #include "../../src/UploadStateManager.cpp"
 
+#include <ctime>
+#include <cstdlib>
+#include <new>
+#include <set>
+
 // Global mock filesystem for tests
 MockFS testFS;
 
+// Heap accounting for the folder tracking benchmark
+static size_t allocatedBytes = 0;
+static bool countAllocations = false;
+
+void* operator new(size_t size) {
+    if (countAllocations) {
+        allocatedBytes += size;
+    }
+    void* ptr = malloc(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
 void setUp(void) {
     // Reset filesystem before each test
     testFS.clear();
@@ -159,7 +186,7 @@ void test_load_state_file_large_with_many_folders() {
     TEST_ASSERT_TRUE(manager.isFolderCompleted("20240499"));
 }
 
-// Test state file saving to JSON
+// Test state file saving
 void test_save_state_file_success() {
     UploadStateManager manager;
     
@@ -179,7 +206,7 @@ void test_save_state_file_success() {
     bool result = manager.save(testFS);
     
     TEST_ASSERT_TRUE(result);
-    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.json"));
+    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.bin"));
     
     // Verify saved content by loading it again
     UploadStateManager manager2;
@@ -200,7 +227,7 @@ void test_save_state_file_empty_state() {
     bool result = manager.save(testFS);
     
     TEST_ASSERT_TRUE(result);
-    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.json"));
+    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.bin"));
 }
 
 void test_save_state_file_overwrite() {
@@ -245,7 +272,7 @@ void test_save_state_file_large_with_many_folders() {
     bool result = manager.save(testFS);
     
     TEST_ASSERT_TRUE(result);
-    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.json"));
+    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.bin"));
     
     // Verify saved content by loading it again
     UploadStateManager manager2;
@@ -373,6 +400,91 @@ void test_mark_file_uploaded() {
     // by checking that the state file contains the file
 }
 
+// Unchanged size and timestamp skip the file without reading it
+void test_stat_unchanged_skips_file() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    testFS.addFile("/SETTINGS/CurrentSettings.json", "{\"mode\":1}");
+    testFS.setLastWrite("/SETTINGS/CurrentSettings.json", 1700000000);
+    TEST_ASSERT_TRUE(manager.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.json"));
+    
+    // The recorded checksum is not re-verified while the stat matches
+    manager.markFileUploaded("/SETTINGS/CurrentSettings.json", "inline_checksum", 10, 1700000000);
+    TEST_ASSERT_FALSE(manager.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.json"));
+}
+
+// A new timestamp or size marks the file changed
+void test_stat_change_detected() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    testFS.addFile("/SETTINGS/CurrentSettings.crc", "ABCD");
+    testFS.setLastWrite("/SETTINGS/CurrentSettings.crc", 1700000000);
+    manager.markFileUploaded("/SETTINGS/CurrentSettings.crc", "c1", 4, 1700000000);
+    TEST_ASSERT_FALSE(manager.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.crc"));
+    
+    // Rewritten in place with the same size
+    testFS.setLastWrite("/SETTINGS/CurrentSettings.crc", 1700003600);
+    TEST_ASSERT_TRUE(manager.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.crc"));
+    
+    // Same timestamp, different size
+    testFS.addFile("/SETTINGS/CurrentSettings.crc", "ABCDEF");
+    testFS.setLastWrite("/SETTINGS/CurrentSettings.crc", 1700000000);
+    TEST_ASSERT_TRUE(manager.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.crc"));
+}
+
+// Without a timestamp the check falls back to the content checksum
+void test_stat_missing_timestamp_uses_checksum() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    testFS.addFile("/Identification.json", "{\"serial\":\"123\"}");
+    String checksum = manager.calculateChecksum(testFS, "/Identification.json");
+    TEST_ASSERT_EQUAL(32, checksum.length());
+    
+    manager.markFileUploaded("/Identification.json", checksum, 16, 0);
+    TEST_ASSERT_FALSE(manager.hasFileChangedQuick(testFS, "/Identification.json"));
+    
+    testFS.addFile("/Identification.json", "{\"serial\":\"456\"}");
+    TEST_ASSERT_TRUE(manager.hasFileChangedQuick(testFS, "/Identification.json"));
+}
+
+// A checksum from an older state file is verified once, then the stat is adopted
+void test_stat_adopted_for_legacy_checksum() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    testFS.addFile("/Identification.tgt", "device target");
+    testFS.setLastWrite("/Identification.tgt", 1700000000);
+    manager.markFileUploaded("/Identification.tgt",
+                             manager.calculateChecksum(testFS, "/Identification.tgt"));
+    
+    TEST_ASSERT_FALSE(manager.hasFileChangedQuick(testFS, "/Identification.tgt"));
+    
+    // Now the stat alone decides: a stale checksum is not consulted
+    manager.markFileUploaded("/Identification.tgt", "stale", 13, 1700000000);
+    TEST_ASSERT_FALSE(manager.hasFileChangedQuick(testFS, "/Identification.tgt"));
+}
+
+// Stat records survive save and load
+void test_stat_persistence() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    testFS.addFile("/SETTINGS/CurrentSettings.json", "{\"mode\":2}");
+    testFS.setLastWrite("/SETTINGS/CurrentSettings.json", 1700000000);
+    manager.markFileUploaded("/SETTINGS/CurrentSettings.json", "checksum", 10, 1700000000);
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    
+    UploadStateManager manager2;
+    manager2.begin(testFS);
+    TEST_ASSERT_FALSE(manager2.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.json"));
+    
+    testFS.setLastWrite("/SETTINGS/CurrentSettings.json", 1700000001);
+    TEST_ASSERT_TRUE(manager2.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.json"));
+}
+
 // Test folder completion tracking
 void test_folder_completion_basic() {
     UploadStateManager manager;
@@ -575,6 +687,238 @@ void test_timestamp_persistence() {
     TEST_ASSERT_EQUAL(1699876800, manager2.getLastUploadTimestamp());
 }
 
+static std::vector<uint8_t> makeEdfContent(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)(i * 7 + seed);
+    }
+    return data;
+}
+
+// Test a growing file is detected as an append after its length is recorded
+void test_append_detects_growth() {
+    std::vector<uint8_t> content = makeEdfContent(10000, 1);
+    testFS.addFile("/STR.edf", content);
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    unsigned long offset = 99;
+    
+    // Never uploaded - whole file
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_REPLACED, manager.checkAppend(testFS, "/STR.edf", 10000, offset));
+    TEST_ASSERT_EQUAL(0, offset);
+    
+    manager.recordUploadedLength(testFS, "/STR.edf", 10000);
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_UNCHANGED, manager.checkAppend(testFS, "/STR.edf", 10000, offset));
+    
+    // Grow the file, prefix untouched
+    std::vector<uint8_t> grown = content;
+    grown.resize(12500, 0x55);
+    testFS.addFile("/STR.edf", grown);
+    
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_GROWN, manager.checkAppend(testFS, "/STR.edf", 12500, offset));
+    TEST_ASSERT_EQUAL(10000, offset);
+}
+
+// Test a rewrite inside the tail window forces a full upload
+void test_append_detects_rewrite() {
+    std::vector<uint8_t> content = makeEdfContent(10000, 1);
+    testFS.addFile("/STR.edf", content);
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.recordUploadedLength(testFS, "/STR.edf", 10000);
+    
+    std::vector<uint8_t> rewritten = content;
+    rewritten[9990] ^= 0xFF;
+    rewritten.resize(11000, 0);
+    testFS.addFile("/STR.edf", rewritten);
+    
+    unsigned long offset = 99;
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_REPLACED, manager.checkAppend(testFS, "/STR.edf", 11000, offset));
+    TEST_ASSERT_EQUAL(0, offset);
+}
+
+// Test a file shorter than the recorded length is treated as replaced
+void test_append_detects_shrink() {
+    testFS.addFile("/STR.edf", makeEdfContent(10000, 1));
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.recordUploadedLength(testFS, "/STR.edf", 10000);
+    
+    testFS.addFile("/STR.edf", makeEdfContent(6000, 1));
+    unsigned long offset = 0;
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_REPLACED, manager.checkAppend(testFS, "/STR.edf", 6000, offset));
+}
+
+// Test append records survive save/load
+void test_append_persistence() {
+    testFS.addFile("/STR.edf", makeEdfContent(10000, 3));
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.recordUploadedLength(testFS, "/STR.edf", 8000);
+    manager.save(testFS);
+    
+    UploadStateManager manager2;
+    manager2.begin(testFS);
+    unsigned long offset = 0;
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_GROWN, manager2.checkAppend(testFS, "/STR.edf", 10000, offset));
+    TEST_ASSERT_EQUAL(8000, offset);
+}
+
+// Test completing a DATALOG folder drops the append records of its files
+void test_append_records_pruned_on_folder_completion() {
+    testFS.addFile("/DATALOG/20241101/BRP.edf", makeEdfContent(5000, 2));
+    testFS.addFile("/STR.edf", makeEdfContent(5000, 4));
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.recordUploadedLength(testFS, "/DATALOG/20241101/BRP.edf", 5000);
+    manager.recordUploadedLength(testFS, "/STR.edf", 5000);
+    
+    manager.markFolderCompleted("20241101");
+    
+    unsigned long offset = 0;
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_REPLACED,
+                      manager.checkAppend(testFS, "/DATALOG/20241101/BRP.edf", 5000, offset));
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_UNCHANGED,
+                      manager.checkAppend(testFS, "/STR.edf", 5000, offset));
+}
+
+// Test resume offset is returned only for a matching path and size
+void test_checkpoint_resume_offset() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    TEST_ASSERT_FALSE(manager.hasUploadCheckpoint());
+    TEST_ASSERT_EQUAL(0, manager.getResumeOffset("/DATALOG/20241101/BRP.edf", 1000000));
+    
+    manager.setUploadCheckpoint("/DATALOG/20241101/BRP.edf", 1000000, 393216);
+    TEST_ASSERT_TRUE(manager.hasUploadCheckpoint());
+    TEST_ASSERT_EQUAL(393216, manager.getResumeOffset("/DATALOG/20241101/BRP.edf", 1000000));
+    
+    // Different file or changed size must start from zero
+    TEST_ASSERT_EQUAL(0, manager.getResumeOffset("/DATALOG/20241101/PLD.edf", 1000000));
+    TEST_ASSERT_EQUAL(0, manager.getResumeOffset("/DATALOG/20241101/BRP.edf", 1200000));
+    
+    manager.clearUploadCheckpoint();
+    TEST_ASSERT_FALSE(manager.hasUploadCheckpoint());
+    TEST_ASSERT_EQUAL(0, manager.getResumeOffset("/DATALOG/20241101/BRP.edf", 1000000));
+}
+
+// Test checkpoint survives save/load
+void test_checkpoint_persistence() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.setUploadCheckpoint("/DATALOG/20241101/PLD.edf", 2097152, 1048576);
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    
+    UploadStateManager manager2;
+    manager2.begin(testFS);
+    TEST_ASSERT_TRUE(manager2.hasUploadCheckpoint());
+    TEST_ASSERT_EQUAL_STRING("/DATALOG/20241101/PLD.edf", manager2.getCheckpointPath().c_str());
+    TEST_ASSERT_EQUAL(1048576, manager2.getResumeOffset("/DATALOG/20241101/PLD.edf", 2097152));
+}
+
+// Test state files without checkpoint fields load with no checkpoint
+void test_checkpoint_missing_in_old_state_file() {
+    std::string stateJson = R"({
+        "version": 1,
+        "last_upload_timestamp": 1699876800,
+        "file_checksums": {},
+        "completed_datalog_folders": ["20241101"],
+        "current_retry_folder": "",
+        "current_retry_count": 0
+    })";
+    testFS.addFile("/.upload_state.json", stateJson);
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    TEST_ASSERT_TRUE(manager.isFolderCompleted("20241101"));
+    TEST_ASSERT_FALSE(manager.hasUploadCheckpoint());
+}
+
+// Test reset clears memory and removes the state file
+void test_reset_clears_state() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    manager.markFolderCompleted("20241101");
+    manager.markFolderPending("20241102", 1699876800);
+    manager.setCurrentRetryFolder("20241103");
+    manager.incrementCurrentRetryCount();
+    manager.markFileUploaded("/STR.edf", "abc123");
+    manager.setLastUploadTimestamp(1699876800);
+    manager.setUploadCheckpoint("/DATALOG/20241103/BRP.edf", 4096, 1024);
+    manager.save(testFS);
+    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.bin"));
+    
+    TEST_ASSERT_TRUE(manager.reset(testFS));
+    
+    TEST_ASSERT_FALSE(testFS.exists("/.upload_state.bin"));
+    TEST_ASSERT_FALSE(manager.isFolderCompleted("20241101"));
+    TEST_ASSERT_EQUAL(0, manager.getPendingFoldersCount());
+    TEST_ASSERT_EQUAL(0, manager.getCurrentRetryCount());
+    TEST_ASSERT_EQUAL_STRING("", manager.getCurrentRetryFolder().c_str());
+    TEST_ASSERT_EQUAL(0, manager.getLastUploadTimestamp());
+    TEST_ASSERT_FALSE(manager.hasUploadCheckpoint());
+    
+    // A fresh manager must also start empty
+    UploadStateManager manager2;
+    manager2.begin(testFS);
+    TEST_ASSERT_EQUAL(0, manager2.getCompletedFoldersCount());
+}
+
+// Test reset succeeds when no state file exists
+void test_reset_without_state_file() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    TEST_ASSERT_TRUE(manager.reset(testFS));
+    TEST_ASSERT_FALSE(testFS.exists("/.upload_state.bin"));
+}
+
+// A lost or reset state asks for a remote reconcile until it is cleared
+void test_reconcile_pending_after_lost_state() {
+    UploadStateManager manager;
+    manager.begin(testFS);  // No state file
+    TEST_ASSERT_TRUE(manager.isReconcilePending());
+    
+    manager.setReconcilePending(false);
+    manager.markFolderCompleted("20241101");
+    manager.save(testFS);
+    
+    UploadStateManager manager2;
+    manager2.begin(testFS);
+    TEST_ASSERT_FALSE(manager2.isReconcilePending());
+    
+    TEST_ASSERT_TRUE(manager2.reset(testFS));
+    TEST_ASSERT_TRUE(manager2.isReconcilePending());
+}
+
+// An unfinished reconcile survives save and load
+void test_reconcile_pending_persistence() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.markFolderCompleted("20241101");
+    manager.save(testFS);
+    
+    UploadStateManager manager2;
+    manager2.begin(testFS);
+    TEST_ASSERT_TRUE(manager2.isReconcilePending());
+    TEST_ASSERT_TRUE(manager2.isFolderCompleted("20241101"));
+    
+    // State files written before the flag existed load as reconciled
+    testFS.remove("/.upload_state.bin");
+    testFS.addFile("/.upload_state.json",
+                   "{\"version\":1,\"last_upload_timestamp\":0,\"completed_datalog_folders\":[\"20241101\"]}");
+    UploadStateManager manager3;
+    manager3.begin(testFS);
+    TEST_ASSERT_FALSE(manager3.isReconcilePending());
+}
+
 // **Feature: empty-folder-handling, Property 1: Pending folder creation with valid time**
 void test_pending_folder_creation_with_valid_time() {
     UploadStateManager manager;
@@ -857,6 +1201,329 @@ void test_multiple_pending_folders_scan_update() {
     TEST_ASSERT_EQUAL(0, manager.getPendingFoldersCount());
 }
 
+// Folder names are kept as packed dates: sorted, deduplicated, and
+// written back to the state file unchanged
+void test_packed_folder_records() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    
+    manager.markFolderCompleted("20240103");
+    manager.markFolderCompleted("20231231");
+    manager.markFolderCompleted("20240101");
+    manager.markFolderCompleted("20240101");
+    manager.markFolderCompleted("SETTINGS");   // Not a DATALOG folder name
+    manager.markFolderPending("2024010", 1699876800);
+    TEST_ASSERT_EQUAL(3, manager.getCompletedFoldersCount());
+    TEST_ASSERT_EQUAL(0, manager.getPendingFoldersCount());
+    TEST_ASSERT_TRUE(manager.isFolderCompleted("20231231"));
+    TEST_ASSERT_FALSE(manager.isFolderCompleted("20240102"));
+    TEST_ASSERT_FALSE(manager.isFolderCompleted("SETTINGS"));
+    
+    manager.markFolderPending("20240105", 1699876800);
+    manager.markFolderPending("20240104", 1699963200);
+    manager.markFolderPending("20240105", 1700049600);  // Updates the timestamp
+    TEST_ASSERT_EQUAL(2, manager.getPendingFoldersCount());
+    TEST_ASSERT_TRUE(manager.shouldPromotePendingToCompleted("20240104", 1699963200 + 7 * 86400));
+    TEST_ASSERT_FALSE(manager.shouldPromotePendingToCompleted("20240105", 1699876800 + 7 * 86400));
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    
+    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.bin"));
+    TEST_ASSERT_FALSE(testFS.exists("/.upload_state.json"));
+    
+    UploadStateManager loaded;
+    TEST_ASSERT_TRUE(loaded.begin(testFS));
+    TEST_ASSERT_EQUAL(3, loaded.getCompletedFoldersCount());
+    TEST_ASSERT_TRUE(loaded.isFolderCompleted("20240103"));
+    TEST_ASSERT_TRUE(loaded.isPendingFolder("20240105"));
+    TEST_ASSERT_FALSE(loaded.shouldPromotePendingToCompleted("20240105", 1699876800 + 7 * 86400));
+    
+    loaded.promotePendingToCompleted("20240104");
+    TEST_ASSERT_TRUE(loaded.isFolderCompleted("20240104"));
+    TEST_ASSERT_EQUAL(4, loaded.getCompletedFoldersCount());
+}
+
+// Every kind of record survives a rewrite of the binary state file
+void test_binary_state_round_trip() {
+    testFS.addFile("/STR.edf", makeEdfContent(10000, 4));
+    testFS.addFile("/SETTINGS/CurrentSettings.json", "{\"mode\":2}");
+    testFS.setLastWrite("/SETTINGS/CurrentSettings.json", 1700000000);
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.setReconcilePending(false);
+    manager.setLastUploadTimestamp(1699876800);
+    manager.markFileUploaded("/SETTINGS/CurrentSettings.json", "0123456789abcdef0123456789abcdef", 10, 1700000000);
+    manager.recordUploadedLength(testFS, "/STR.edf", 8000);
+    manager.markFolderCompleted("20241101");
+    manager.markFolderPending("20241102", 1699963200);
+    manager.setCurrentRetryFolder("20241103");
+    manager.incrementCurrentRetryCount();
+    manager.setUploadCheckpoint("/DATALOG/20241103/BRP.edf", 4096, 1024);
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    
+    // Header, session, checkpoint, two folders, one file and one append record
+    std::vector<uint8_t> content = testFS.getFileContent("/.upload_state.bin");
+    TEST_ASSERT_EQUAL(16 + 16 + 112 + 2 * 16 + 112 + 112, content.size());
+    TEST_ASSERT_TRUE(memcmp(content.data(), "USTB", 4) == 0);
+    
+    UploadStateManager loaded;
+    loaded.begin(testFS);
+    TEST_ASSERT_FALSE(loaded.isReconcilePending());
+    TEST_ASSERT_EQUAL(1699876800, loaded.getLastUploadTimestamp());
+    TEST_ASSERT_FALSE(loaded.hasFileChangedQuick(testFS, "/SETTINGS/CurrentSettings.json"));
+    unsigned long offset = 0;
+    TEST_ASSERT_EQUAL(UploadStateManager::APPEND_GROWN, loaded.checkAppend(testFS, "/STR.edf", 10000, offset));
+    TEST_ASSERT_EQUAL(8000, offset);
+    TEST_ASSERT_TRUE(loaded.isFolderCompleted("20241101"));
+    TEST_ASSERT_TRUE(loaded.isPendingFolder("20241102"));
+    TEST_ASSERT_TRUE(loaded.shouldPromotePendingToCompleted("20241102", 1699963200 + 7 * 86400));
+    TEST_ASSERT_EQUAL_STRING("20241103", loaded.getCurrentRetryFolder().c_str());
+    TEST_ASSERT_EQUAL(1, loaded.getCurrentRetryCount());
+    TEST_ASSERT_EQUAL(1024, loaded.getResumeOffset("/DATALOG/20241103/BRP.edf", 4096));
+}
+
+// A JSON state file of earlier firmware is converted once at begin()
+void test_json_state_migrated() {
+    testFS.addFile("/SRT.edf", std::string(100, 's'));
+    testFS.setLastWrite("/SRT.edf", 1700000000);
+    testFS.addFile("/.upload_state.json", R"({
+        "version": 1,
+        "last_upload_timestamp": 1699876800,
+        "file_checksums": {"/SRT.edf": "def456"},
+        "file_stats": {"/SRT.edf": "100:1700000000"},
+        "completed_datalog_folders": ["20241101"],
+        "pending_datalog_folders": {"20241102": 1699963200},
+        "current_retry_folder": "20241103",
+        "current_retry_count": 2
+    })");
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    TEST_ASSERT_TRUE(testFS.exists("/.upload_state.bin"));
+    TEST_ASSERT_FALSE(testFS.exists("/.upload_state.json"));
+    
+    UploadStateManager loaded;
+    loaded.begin(testFS);
+    TEST_ASSERT_FALSE(loaded.isReconcilePending());
+    TEST_ASSERT_EQUAL(1699876800, loaded.getLastUploadTimestamp());
+    TEST_ASSERT_FALSE(loaded.hasFileChangedQuick(testFS, "/SRT.edf"));
+    TEST_ASSERT_TRUE(loaded.isFolderCompleted("20241101"));
+    TEST_ASSERT_TRUE(loaded.isPendingFolder("20241102"));
+    TEST_ASSERT_EQUAL_STRING("20241103", loaded.getCurrentRetryFolder().c_str());
+    TEST_ASSERT_EQUAL(2, loaded.getCurrentRetryCount());
+}
+
+// A save writes only the records of what changed since the last one
+void test_save_appends_changed_records() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    for (int i = 0; i < 100; i++) {
+        manager.markFileUploaded("/DATALOG/20241101/file" + String(i) + ".edf", "abc123");
+    }
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    size_t size = testFS.getFileContent("/.upload_state.bin").size();
+    
+    // Nothing changed: the file is not even opened
+    testFS.resetDirectoryCounters();
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    TEST_ASSERT_EQUAL(0, testFS.getOpenCount("/.upload_state.bin"));
+    
+    manager.markFileUploaded("/SRT.edf", "def456");
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    TEST_ASSERT_EQUAL(size + 112, testFS.getFileContent("/.upload_state.bin").size());
+    
+    manager.setLastUploadTimestamp(1699876800);
+    manager.markFolderCompleted("20241101");
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    TEST_ASSERT_EQUAL(size + 112 + 16 + 16, testFS.getFileContent("/.upload_state.bin").size());
+    
+    UploadStateManager loaded;
+    loaded.begin(testFS);
+    TEST_ASSERT_EQUAL(1699876800, loaded.getLastUploadTimestamp());
+    TEST_ASSERT_TRUE(loaded.isFolderCompleted("20241101"));
+}
+
+// A save cut short keeps the records before it; the next save rewrites the file
+void test_torn_state_file_recovered() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.markFolderCompleted("20241101");
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    manager.markFolderCompleted("20241102");
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    std::vector<uint8_t> content = testFS.getFileContent("/.upload_state.bin");
+    
+    // Last record half written
+    testFS.addFile("/.upload_state.bin", std::vector<uint8_t>(content.begin(), content.end() - 8));
+    UploadStateManager torn;
+    torn.begin(testFS);
+    TEST_ASSERT_TRUE(torn.isFolderCompleted("20241101"));
+    TEST_ASSERT_FALSE(torn.isFolderCompleted("20241102"));
+    
+    torn.markFolderCompleted("20241103");
+    TEST_ASSERT_TRUE(torn.save(testFS));
+    UploadStateManager rewritten;
+    rewritten.begin(testFS);
+    TEST_ASSERT_TRUE(rewritten.isFolderCompleted("20241101"));
+    TEST_ASSERT_TRUE(rewritten.isFolderCompleted("20241103"));
+    TEST_ASSERT_EQUAL(16 + 16 + 112 + 2 * 16, testFS.getFileContent("/.upload_state.bin").size());
+    
+    // Bad CRC in the last record
+    content[content.size() - 1] ^= 0x01;
+    testFS.addFile("/.upload_state.bin", content);
+    UploadStateManager corrupted;
+    corrupted.begin(testFS);
+    TEST_ASSERT_TRUE(corrupted.isFolderCompleted("20241101"));
+    TEST_ASSERT_FALSE(corrupted.isFolderCompleted("20241102"));
+    
+    // Bad header: nothing is trusted
+    content[0] = 'X';
+    testFS.addFile("/.upload_state.bin", content);
+    UploadStateManager unknown;
+    unknown.begin(testFS);
+    TEST_ASSERT_EQUAL(0, unknown.getCompletedFoldersCount());
+    TEST_ASSERT_TRUE(unknown.isReconcilePending());
+}
+
+// Superseded records are dropped before they outnumber the live ones
+void test_state_file_compacted() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.markFolderCompleted("20241101");
+    size_t largest = 0;
+    for (unsigned long i = 1; i <= 2000; i++) {
+        manager.setLastUploadTimestamp(1699876800 + i);
+        TEST_ASSERT_TRUE(manager.save(testFS));
+        largest = std::max(largest, testFS.getFileContent("/.upload_state.bin").size());
+    }
+    // Three live records: session, checkpoint, folder
+    TEST_ASSERT_TRUE(largest <= 16 + 112 + (2 * 3 + UPLOAD_STATE_COMPACT_SLACK + 1) * 16);
+    
+    UploadStateManager loaded;
+    loaded.begin(testFS);
+    TEST_ASSERT_EQUAL(1699876800 + 2000, loaded.getLastUploadTimestamp());
+    TEST_ASSERT_TRUE(loaded.isFolderCompleted("20241101"));
+}
+
+// No size limit on load: a state far past the old 64KB JSON cap
+void test_large_state_file_loads() {
+    const int files = 1000;
+    UploadStateManager manager;
+    manager.begin(testFS);
+    for (int i = 0; i < files; i++) {
+        String path = "/DATALOG/2024" + String(1000 + i) + "/20241101_220000_BRP.edf";
+        manager.markFileUploaded(path, "0123456789abcdef0123456789abcdef", 4096, 1700000000 + i);
+    }
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    TEST_ASSERT_TRUE(testFS.getFileContent("/.upload_state.bin").size() > 64 * 1024);
+    
+    String last = "/DATALOG/2024" + String(1000 + files - 1) + "/20241101_220000_BRP.edf";
+    testFS.addFile(last, std::string(4096, 'x'));
+    testFS.setLastWrite(last, 1700000000 + files - 1);
+    UploadStateManager loaded;
+    loaded.begin(testFS);
+    TEST_ASSERT_FALSE(loaded.hasFileChangedQuick(testFS, last));
+}
+
+// Dates wider than YYYYMMDD are not folder names, on input or in the state file
+void test_folder_date_out_of_range() {
+    UploadStateManager manager;
+    manager.begin(testFS);
+    manager.markFolderCompleted("99999999");
+    TEST_ASSERT_EQUAL(0, manager.getCompletedFoldersCount());
+    manager.markFolderCompleted("99991231");
+    manager.setCurrentRetryFolder("20241103");
+    TEST_ASSERT_TRUE(manager.save(testFS));
+    
+    // Hand-edited records: a folder and a retry folder of 10 digits
+    std::vector<uint8_t> content = testFS.getFileContent("/.upload_state.bin");
+    uint8_t record[16] = {0};
+    record[0] = RECORD_FOLDER;
+    record[1] = FOLDER_COMPLETED;
+    putLE32(record + 4, 4000000000UL);
+    putLE32(record + 12, Crc32::compute(0, record, 12));
+    content.insert(content.end(), record, record + 16);
+    memcpy(record, content.data() + 16, 16);  // Session record, written first
+    putLE32(record + 8, 1234567890UL);
+    putLE32(record + 12, Crc32::compute(0, record, 12));
+    content.insert(content.end(), record, record + 16);
+    testFS.addFile("/.upload_state.bin", content);
+    
+    UploadStateManager loaded;
+    loaded.begin(testFS);
+    TEST_ASSERT_EQUAL(1, loaded.getCompletedFoldersCount());
+    TEST_ASSERT_TRUE(loaded.isFolderCompleted("99991231"));
+    TEST_ASSERT_EQUAL_STRING("", loaded.getCurrentRetryFolder().c_str());
+}
+
+// Ten years of nightly folders: lookup speed and heap against std::set<String>
+void test_benchmark_folder_tracking() {
+    const int nights = 3653;
+    const int rounds = 20;
+    std::vector<String> names;
+    for (int year = 2014; (int)names.size() < nights; year++) {
+        for (int month = 1; month <= 12 && (int)names.size() < nights; month++) {
+            for (int day = 1; day <= 30 && (int)names.size() < nights; day++) {
+                char name[9];
+                snprintf(name, sizeof(name), "%04d%02d%02d", year, month, day);
+                names.push_back(String(name));
+            }
+        }
+    }
+    
+    // Previous representation: a tree node and a String per folder
+    allocatedBytes = 0;
+    countAllocations = true;
+    std::set<String>* tree = new std::set<String>(names.begin(), names.end());
+    countAllocations = false;
+    size_t treeBytes = allocatedBytes;
+    
+    UploadStateManager manager;
+    manager.begin(testFS);
+    allocatedBytes = 0;
+    countAllocations = true;
+    for (const String& name : names) {
+        manager.markFolderCompleted(name);
+    }
+    countAllocations = false;
+    size_t packedBytes = manager.getFolderMemoryUsage();
+    TEST_ASSERT_EQUAL(nights, manager.getCompletedFoldersCount());
+    TEST_ASSERT_TRUE(packedBytes >= nights * sizeof(uint32_t));
+    TEST_ASSERT_TRUE(packedBytes <= 2 * nights * sizeof(uint32_t));
+    TEST_ASSERT_TRUE(packedBytes < treeBytes);
+    
+    int found = 0;
+    clock_t start = clock();
+    for (int r = 0; r < rounds; r++) {
+        for (const String& name : names) {
+            found += tree->find(name) != tree->end() ? 1 : 0;
+        }
+    }
+    double treeSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    TEST_ASSERT_EQUAL(nights * rounds, found);
+    
+    found = 0;
+    start = clock();
+    for (int r = 0; r < rounds; r++) {
+        for (const String& name : names) {
+            found += manager.isFolderCompleted(name) ? 1 : 0;
+        }
+    }
+    double packedSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    TEST_ASSERT_EQUAL(nights * rounds, found);
+    TEST_ASSERT_FALSE(manager.isFolderCompleted("20240231"));
+    delete tree;
+    
+    double lookups = (double)nights * rounds;
+    printf("\n[Benchmark] Completed DATALOG folders, %d nights (10 years), %d lookups\n",
+           nights, (int)lookups);
+    printf("%-18s %12s %14s %14s\n", "container", "heap bytes", "bytes/folder", "ns/lookup");
+    printf("%-18s %12zu %14.1f %14.1f\n", "std::set<String>", treeBytes,
+           (double)treeBytes / nights, treeSeconds * 1e9 / lookups);
+    printf("%-18s %12zu %14.1f %14.1f\n", "packed vector", packedBytes,
+           (double)packedBytes / nights, packedSeconds * 1e9 / lookups);
+}
+
 int main(int argc, char **argv) {
     UNITY_BEGIN();
     
@@ -885,6 +1552,13 @@ int main(int argc, char **argv) {
     RUN_TEST(test_file_change_detection_with_change);
     RUN_TEST(test_mark_file_uploaded);
     
+    // Stat-based change detection tests
+    RUN_TEST(test_stat_unchanged_skips_file);
+    RUN_TEST(test_stat_change_detected);
+    RUN_TEST(test_stat_missing_timestamp_uses_checksum);
+    RUN_TEST(test_stat_adopted_for_legacy_checksum);
+    RUN_TEST(test_stat_persistence);
+    
     // Folder completion tests
     RUN_TEST(test_folder_completion_basic);
     RUN_TEST(test_folder_completion_multiple_folders);
@@ -904,6 +1578,24 @@ int main(int argc, char **argv) {
     RUN_TEST(test_timestamp_set_and_get);
     RUN_TEST(test_timestamp_persistence);
     
+    // Append-only tracking tests
+    RUN_TEST(test_append_detects_growth);
+    RUN_TEST(test_append_detects_rewrite);
+    RUN_TEST(test_append_detects_shrink);
+    RUN_TEST(test_append_persistence);
+    RUN_TEST(test_append_records_pruned_on_folder_completion);
+    
+    // Resume checkpoint tests
+    RUN_TEST(test_checkpoint_resume_offset);
+    RUN_TEST(test_checkpoint_persistence);
+    RUN_TEST(test_checkpoint_missing_in_old_state_file);
+    
+    // Reset tests
+    RUN_TEST(test_reset_clears_state);
+    RUN_TEST(test_reset_without_state_file);
+    RUN_TEST(test_reconcile_pending_after_lost_state);
+    RUN_TEST(test_reconcile_pending_persistence);
+    
     // Pending folder tests
     RUN_TEST(test_pending_folder_creation_with_valid_time);
     RUN_TEST(test_timeout_calculation_correctness);
@@ -915,6 +1607,15 @@ int main(int argc, char **argv) {
     RUN_TEST(test_pending_state_persistence_round_trip);
     RUN_TEST(test_backward_compatibility_missing_pending_field);
     RUN_TEST(test_incomplete_folders_count_with_pending);
+    RUN_TEST(test_packed_folder_records);
+    RUN_TEST(test_folder_date_out_of_range);
+    RUN_TEST(test_binary_state_round_trip);
+    RUN_TEST(test_json_state_migrated);
+    RUN_TEST(test_save_appends_changed_records);
+    RUN_TEST(test_torn_state_file_recovered);
+    RUN_TEST(test_state_file_compacted);
+    RUN_TEST(test_large_state_file_loads);
+    RUN_TEST(test_benchmark_folder_tracking);
     
     return UNITY_END();
 }
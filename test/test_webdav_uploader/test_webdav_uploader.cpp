@@ -0,0 +1,714 @@
+#include <unity.h>
+#include "Arduino.h"
+#include "MockTime.h"
+#include "MockFS.h"
+#include "MockMD5.h"
+#include "MockLogger.h"
+#include "MockPreferences.h"
+#include "MockClient.h"
+
+// Include mock implementations
+#include "../mocks/Arduino.cpp"
+#include "../mocks/ArduinoJson.h"
+
+// Prevent real Logger.h from being included (we're using MockLogger)
+#define LOGGER_H
+
+#ifndef ENABLE_WEBDAV_UPLOAD
+#define ENABLE_WEBDAV_UPLOAD
+#endif
+
+// Include the WebDAV uploader and its HTTP connection
+#include "WebDAVUploader.h"
+#include "../../src/Config.cpp"
+#include "../../src/BufferPool.cpp"
+#include "../../src/Md5Digest.cpp"
+#include "../../src/UploadPipeline.cpp"
+#include "../../src/UploadBackend.cpp"
+#include "../../src/HttpConnection.cpp"
+#include "../../src/WebDAVUploader.cpp"
+#include "MockStreams.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Global mock filesystem for tests
+MockFS testFS;
+
+/**
+ * In-memory WebDAV server behind the Client interface
+ * Parses the requests written to it and queues the responses for reading.
+ */
+class FakeDavServer : public Client {
+public:
+    // Which partial-write method the server implements
+    enum Dialect { PLAIN, APACHE, SABRE, NEXTCLOUD };
+
+    Dialect dialect;
+    std::string root;                          // Endpoint collection
+    std::string uploadsRoot;                   // Nextcloud uploads collection
+    std::map<std::string, std::string> files;  // Path below the root -> content
+    std::set<std::string> dirs;                // Collections below the root
+    std::vector<std::string> requests;         // "METHOD path" log
+    std::string expectedAuth;
+    int connects;
+    bool closeAfterResponse;  // Answer with Connection: close
+    int writesBeforeDrop;     // PUT/PATCH requests accepted before the link fails (-1 = never)
+    bool refuseConnections;
+    bool open;
+
+    FakeDavServer()
+        : dialect(PLAIN), root("/dav"), uploadsRoot("/remote.php/dav/uploads/user"), connects(0),
+          closeAfterResponse(false), writesBeforeDrop(-1), refuseConnections(false), open(false), outPos(0) {
+        dirs.insert("@up");
+        expectedAuth = "Basic " + std::string(HttpConnection::base64Encode("user:secret").c_str());
+    }
+
+    int connect(const char* host, uint16_t port) override {
+        if (refuseConnections) {
+            return 0;
+        }
+        open = true;
+        connects++;
+        in.clear();
+        out.clear();
+        outPos = 0;
+        return 1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!open) {
+            return 0;
+        }
+        if (halfClosed) {
+            halfClosed = false;
+            open = false;
+            return size;
+        }
+        in.append((const char*)buf, size);
+        while (processRequest()) {
+        }
+        return size;
+    }
+
+    int available() override { return (int)(out.size() - outPos); }
+
+    int read(uint8_t* buf, size_t size) override {
+        size_t n = out.size() - outPos;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(buf, out.data() + outPos, n);
+        outPos += n;
+        if (outPos == out.size() && pendingClose) {
+            open = false;
+        }
+        return (int)n;
+    }
+
+    void stop() override {
+        open = false;
+        out.clear();
+        outPos = 0;
+    }
+
+    uint8_t connected() override { return open || outPos < out.size(); }
+
+    // Server closes the idle keep-alive connection; the client only
+    // notices when its next request gets no response
+    void dropConnection() {
+        halfClosed = true;
+    }
+
+    // Requests with this method, not counting the resume probe
+    int count(const std::string& method) const {
+        int n = 0;
+        for (const std::string& r : requests) {
+            if (r.compare(0, method.length() + 1, method + " ") == 0 &&
+                r.find(".cpap_resume_probe") == std::string::npos) {
+                n++;
+            }
+        }
+        return n;
+    }
+
+private:
+    std::string in;
+    std::string out;
+    size_t outPos;
+    bool pendingClose = false;
+    bool halfClosed = false;
+
+    static std::string header(const std::string& head, const char* name) {
+        std::string lower = head;
+        for (char& c : lower) c = tolower(c);
+        std::string key = std::string("\r\n") + name + ":";
+        size_t pos = lower.find(key);
+        if (pos == std::string::npos) {
+            return "";
+        }
+        size_t start = head.find_first_not_of(' ', pos + key.length());
+        return head.substr(start, head.find("\r\n", start) - start);
+    }
+
+    // Parse one complete request from the input, if there is one
+    bool processRequest() {
+        size_t headEnd = in.find("\r\n\r\n");
+        if (headEnd == std::string::npos) {
+            return false;
+        }
+        std::string head = in.substr(0, headEnd + 2);
+        std::string body;
+        size_t consumed;
+        if (header(head, "transfer-encoding") == "chunked") {
+            size_t pos = headEnd + 4;
+            while (true) {
+                size_t lineEnd = in.find("\r\n", pos);
+                if (lineEnd == std::string::npos) {
+                    return false;
+                }
+                size_t size = strtoul(in.substr(pos, lineEnd - pos).c_str(), nullptr, 16);
+                if (in.size() < lineEnd + 2 + size + 2) {
+                    return false;
+                }
+                if (size == 0) {
+                    consumed = lineEnd + 4;
+                    break;
+                }
+                body += in.substr(lineEnd + 2, size);
+                pos = lineEnd + 2 + size + 2;
+            }
+        } else {
+            size_t length = strtoul(header(head, "content-length").c_str(), nullptr, 10);
+            if (in.size() < headEnd + 4 + length) {
+                return false;
+            }
+            body = in.substr(headEnd + 4, length);
+            consumed = headEnd + 4 + length;
+        }
+        in.erase(0, consumed);
+
+        std::string method = head.substr(0, head.find(' '));
+        size_t pathStart = method.length() + 1;
+        std::string rawPath = head.substr(pathStart, head.find(' ', pathStart) - pathStart);
+        std::string path = PropfindParser::percentDecode(rawPath);
+        requests.push_back(method + " " + path);
+        handle(method, path, head, body);
+        return true;
+    }
+
+    void respond(int status, const char* reason, const std::string& body = "", bool chunked = false,
+                 const std::string& headers = "") {
+        out += "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n" + headers;
+        if (closeAfterResponse) {
+            out += "Connection: close\r\n";
+            pendingClose = true;
+        }
+        if (chunked) {
+            out += "Transfer-Encoding: chunked\r\n\r\n";
+            for (size_t pos = 0; pos < body.size(); pos += 100) {
+                std::string part = body.substr(pos, 100);
+                char size[16];
+                snprintf(size, sizeof(size), "%zx\r\n", part.size());
+                out += size + part + "\r\n";
+            }
+            out += "0\r\n\r\n";
+        } else {
+            out += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        }
+    }
+
+    static std::string parentOf(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos || slash == 0 ? "" : path.substr(0, slash);
+    }
+
+    bool collectionExists(const std::string& path) {
+        return path.empty() || dirs.count(path) > 0;
+    }
+
+    // Server path -> key: below the root ("/DATALOG/x") or, for Nextcloud,
+    // below the uploads collection ("@up/<transfer>/<piece>")
+    bool toKey(const std::string& fullPath, std::string& key) {
+        std::string path = fullPath;
+        while (path.size() > 1 && path[path.size() - 1] == '/') {
+            path.erase(path.size() - 1);
+        }
+        if (dialect == NEXTCLOUD && path.compare(0, uploadsRoot.size(), uploadsRoot) == 0) {
+            key = "@up" + path.substr(uploadsRoot.size());
+            return true;
+        }
+        if (path.compare(0, root.size(), root) != 0) {
+            return false;
+        }
+        key = path.substr(root.size());
+        return true;
+    }
+
+    std::string serverPath(const std::string& key) {
+        return key.compare(0, 3, "@up") == 0 ? uploadsRoot + key.substr(3) : root + key;
+    }
+
+    // Write data at offset into an existing file; false if that leaves a gap
+    bool writeAt(const std::string& key, size_t offset, const std::string& data) {
+        std::string& content = files[key];
+        if (offset > content.size()) {
+            return false;
+        }
+        if (content.size() < offset + data.size()) {
+            content.resize(offset + data.size());
+        }
+        content.replace(offset, data.size(), data);
+        return true;
+    }
+
+    void removeTree(const std::string& key) {
+        files.erase(key);
+        dirs.erase(key);
+        for (auto it = files.begin(); it != files.end();) {
+            it = it->first.compare(0, key.size() + 1, key + "/") == 0 ? files.erase(it) : std::next(it);
+        }
+        for (auto it = dirs.begin(); it != dirs.end();) {
+            it = it->compare(0, key.size() + 1, key + "/") == 0 ? dirs.erase(it) : std::next(it);
+        }
+    }
+
+    void handle(const std::string& method, const std::string& fullPath, const std::string& head,
+                const std::string& body) {
+        if (header(head, "authorization") != expectedAuth) {
+            respond(401, "Unauthorized");
+            return;
+        }
+        std::string path;
+        if (!toKey(fullPath, path)) {
+            respond(404, "Not Found");
+            return;
+        }
+        bool write = (method == "PUT" || method == "PATCH") && path != "/.cpap_resume_probe";
+        if (write && writesBeforeDrop >= 0 && writesBeforeDrop-- == 0) {
+            // Link lost: the request never arrives and the server stays unreachable
+            open = false;
+            refuseConnections = true;
+            return;
+        }
+
+        if (method == "OPTIONS") {
+            respond(200, "OK", "", false,
+                    dialect == SABRE ? "DAV: 1, 2, sabredav-partialupdate\r\n" : "DAV: 1, 2\r\n");
+        } else if (method == "MKCOL") {
+            if (collectionExists(path) || files.count(path)) {
+                respond(405, "Method Not Allowed");
+            } else if (!collectionExists(parentOf(path))) {
+                respond(409, "Conflict");
+            } else {
+                dirs.insert(path);
+                respond(201, "Created");
+            }
+        } else if (method == "PUT") {
+            if (!collectionExists(parentOf(path))) {
+                respond(409, "Conflict");
+                return;
+            }
+            std::string range = header(head, "content-range");
+            bool existed = files.count(path) > 0;
+            if (range.empty() || dialect == PLAIN) {
+                files[path] = body;  // Plain servers ignore Content-Range
+            } else if (dialect != APACHE) {
+                respond(400, "Bad Request");
+                return;
+            } else if (!writeAt(path, strtoul(range.c_str() + 6, nullptr, 10), body)) {
+                respond(416, "Range Not Satisfiable");
+                return;
+            }
+            existed ? respond(204, "No Content") : respond(201, "Created");
+        } else if (method == "PATCH") {
+            std::string range = header(head, "x-update-range");
+            if (dialect != SABRE || header(head, "content-type") != "application/x-sabredav-partialupdate") {
+                respond(405, "Method Not Allowed");
+            } else if (files.count(path) == 0) {
+                respond(404, "Not Found");
+            } else if (!writeAt(path, strtoul(range.c_str() + 6, nullptr, 10), body)) {
+                respond(416, "Range Not Satisfiable");
+            } else {
+                respond(204, "No Content");
+            }
+        } else if (method == "GET") {
+            files.count(path) ? respond(200, "OK", files[path]) : respond(404, "Not Found");
+        } else if (method == "DELETE") {
+            if (files.count(path) == 0 && dirs.count(path) == 0) {
+                respond(404, "Not Found");
+                return;
+            }
+            removeTree(path);
+            respond(204, "No Content");
+        } else if (method == "MOVE") {
+            // Nextcloud chunked upload: <transfer>/.file assembles the pieces
+            std::string transfer = parentOf(path);
+            std::string destination;
+            std::string url = header(head, "destination");
+            size_t slash = url.find('/', url.find("://") + 3);
+            if (dialect != NEXTCLOUD || path.compare(0, 4, "@up/") != 0 || !collectionExists(transfer) ||
+                !toKey(PropfindParser::percentDecode(url.substr(slash)), destination)) {
+                respond(405, "Method Not Allowed");
+                return;
+            }
+            std::string content;
+            for (const auto& file : files) {
+                if (parentOf(file.first) == transfer) {
+                    content += file.second;  // std::map: name (offset) order
+                }
+            }
+            if (std::to_string(content.size()) != header(head, "oc-total-length")) {
+                respond(400, "Bad Request");
+                return;
+            }
+            bool existed = files.count(destination) > 0;
+            files[destination] = content;
+            removeTree(transfer);
+            existed ? respond(204, "No Content") : respond(201, "Created");
+        } else if (method == "PROPFIND") {
+            if (!collectionExists(path)) {
+                respond(404, "Not Found");
+                return;
+            }
+            std::string xml = "<?xml version=\"1.0\"?><D:multistatus xmlns:D=\"DAV:\">";
+            xml += entry(serverPath(path) + "/", true, 0);
+            if (header(head, "depth") == "1") {
+                std::string prefix = path + "/";
+                for (const std::string& dir : dirs) {
+                    if (dir.compare(0, prefix.size(), prefix) == 0 && dir.find('/', prefix.size()) == std::string::npos) {
+                        xml += entry(encode(serverPath(dir)) + "/", true, 0);
+                    }
+                }
+                for (const auto& file : files) {
+                    if (file.first.compare(0, prefix.size(), prefix) == 0 &&
+                        file.first.find('/', prefix.size()) == std::string::npos) {
+                        xml += entry(encode(serverPath(file.first)), false, file.second.size());
+                    }
+                }
+            }
+            xml += "</D:multistatus>";
+            respond(207, "Multi-Status", xml, true);
+        } else {
+            respond(405, "Method Not Allowed");
+        }
+    }
+
+    static std::string encode(const std::string& path) {
+        return HttpConnection::encodePath(path.c_str()).c_str();
+    }
+
+    static std::string entry(const std::string& href, bool collection, size_t size) {
+        std::string xml = "<D:response><D:href>" + href + "</D:href><D:propstat><D:prop>";
+        if (collection) {
+            xml += "<D:resourcetype><D:collection/></D:resourcetype>";
+        } else {
+            xml += "<D:resourcetype/><D:getcontentlength>" + std::to_string(size) + "</D:getcontentlength>";
+        }
+        return xml + "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>";
+    }
+};
+
+BACKEND_TEST_FIXTURE(FakeDavServer, WebDAVUploader, "http://nas.local:8080/dav/", "user", "secret")
+
+// Endpoint URLs split into scheme, host, port and base path
+void test_http_url_parsing() {
+    HttpConnection http;
+    TEST_ASSERT_TRUE(http.setUrl("https://cloud.example.com/remote.php/dav/files/john/"));
+    TEST_ASSERT_TRUE(http.isSecure());
+    TEST_ASSERT_EQUAL(443, http.getPort());
+    TEST_ASSERT_EQUAL_STRING("cloud.example.com", http.getHost().c_str());
+    TEST_ASSERT_EQUAL_STRING("/remote.php/dav/files/john", http.getBasePath().c_str());
+
+    TEST_ASSERT_TRUE(http.setUrl("http://192.168.1.5:8080"));
+    TEST_ASSERT_FALSE(http.isSecure());
+    TEST_ASSERT_EQUAL(8080, http.getPort());
+    TEST_ASSERT_EQUAL_STRING("", http.getBasePath().c_str());
+
+    TEST_ASSERT_FALSE(http.setUrl("//server/share"));
+    TEST_ASSERT_FALSE(http.setUrl("http://:80/dav"));
+
+    TEST_ASSERT_EQUAL_STRING("/DATALOG/a%20b%23.edf", HttpConnection::encodePath("/DATALOG/a b#.edf").c_str());
+    TEST_ASSERT_EQUAL_STRING("dXNlcjpzZWNyZXQ=", HttpConnection::base64Encode("user:secret").c_str());
+}
+
+// Files of one folder go over one connection with one MKCOL per new directory
+void test_put_streams_files_over_one_connection() {
+    std::vector<std::string> contents;
+    for (int i = 0; i < 3; i++) {
+        contents.push_back(makeContent(40000 + i * 1000, i));
+        testFS.addFile(String("/DATALOG/20240101/file") + String(i) + ".edf", contents[i]);
+    }
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    for (int i = 0; i < 3; i++) {
+        String path = String("/DATALOG/20240101/file") + String(i) + ".edf";
+        unsigned long sent = 0;
+        TEST_ASSERT_TRUE(uploader->upload(path, path, testFS, sent));
+        TEST_ASSERT_EQUAL(contents[i].size(), sent);
+        TEST_ASSERT_EQUAL(32, uploader->getLastChecksum().length());
+        TEST_ASSERT_TRUE(server->files[path.c_str()] == contents[i]);
+    }
+
+    TEST_ASSERT_EQUAL(1, server->connects);
+    TEST_ASSERT_EQUAL(2, server->count("MKCOL"));
+    TEST_ASSERT_EQUAL(3, server->count("PUT"));
+    TEST_ASSERT_EQUAL(4, uploader->getDirCacheHits());
+    TEST_ASSERT_EQUAL(2, uploader->getDirCacheMisses());
+}
+
+// Wrong credentials fail the connect check
+void test_authentication_failure() {
+    server->expectedAuth = "Basic nope";
+    TEST_ASSERT_FALSE(uploader->ensureConnected());
+    TEST_ASSERT_FALSE(uploader->isConnected());
+    TEST_ASSERT_EQUAL(1, server->count("PROPFIND"));
+}
+
+// PROPFIND Depth:1 lists file sizes and subdirectories; missing = empty
+void test_propfind_listing() {
+    server->dirs.insert("/DATALOG");
+    server->dirs.insert("/DATALOG/20240101");
+    server->dirs.insert("/DATALOG/20240102");
+    server->files["/DATALOG/20240101.tar"] = makeContent(2048, 1);
+    server->files["/DATALOG/20240101/BRP file.edf"] = makeContent(1234, 2);
+
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    std::map<String, unsigned long> files;
+    std::set<String> subdirs;
+    TEST_ASSERT_TRUE(uploader->listDirectory("/DATALOG", files, &subdirs));
+    TEST_ASSERT_EQUAL(1, files.size());
+    TEST_ASSERT_EQUAL(2048, files[String("20240101.tar")]);
+    TEST_ASSERT_EQUAL(2, subdirs.size());
+    TEST_ASSERT_EQUAL(1, subdirs.count(String("20240102")));
+
+    TEST_ASSERT_TRUE(uploader->listDirectory("/DATALOG/20240101", files));
+    TEST_ASSERT_EQUAL(1, files.size());
+    TEST_ASSERT_EQUAL(1234, files[String("BRP file.edf")]);
+
+    TEST_ASSERT_TRUE(uploader->listDirectory("/DATALOG/20991231", files));
+    TEST_ASSERT_TRUE(files.empty());
+
+    // Listed directories need no MKCOL afterwards
+    testFS.addFile("/DATALOG/20240102/x.edf", makeContent(100, 3));
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240102/x.edf", "/DATALOG/20240102/x.edf", testFS, sent));
+    TEST_ASSERT_EQUAL(0, server->count("MKCOL"));
+    TEST_ASSERT_EQUAL(1, server->connects);
+}
+
+// Generated streams of unknown length go out with chunked encoding
+void test_chunked_stream_upload() {
+    std::string data = makeContent(70000, 9);
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+
+    MemorySource source(data);
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->uploadStream(source, UploadPipeline::STREAM_TO_END,
+                                            "/DATALOG/20240101.tar.gz", sent));
+    TEST_ASSERT_EQUAL(data.size(), sent);
+    TEST_ASSERT_TRUE(server->files["/DATALOG/20240101.tar.gz"] == data);
+}
+
+// A keep-alive connection the server dropped is reopened and the PUT retried
+void test_reconnect_after_server_close() {
+    testFS.addFile("/STR.edf", makeContent(5000, 4));
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+
+    server->dropConnection();
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/STR.edf", "/STR.edf", testFS, sent));
+    TEST_ASSERT_EQUAL(2, server->connects);
+    TEST_ASSERT_EQUAL(1, server->count("PUT"));
+
+    // Servers that close after every response get a fresh connection per request
+    server->closeAfterResponse = true;
+    TEST_ASSERT_TRUE(uploader->upload("/STR.edf", "/STR.edf", testFS, sent));
+    TEST_ASSERT_TRUE(uploader->upload("/STR.edf", "/STR.edf", testFS, sent));
+    TEST_ASSERT_EQUAL(3, server->connects);
+    TEST_ASSERT_TRUE(server->files["/STR.edf"] == makeContent(5000, 4));
+}
+
+// A collection removed on the server is recreated when the PUT reports 409
+void test_conflict_recreates_directories() {
+    testFS.addFile("/SETTINGS/a.json", std::string("{}"));
+    testFS.addFile("/SETTINGS/b.json", std::string("{\"x\":1}"));
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/SETTINGS/a.json", "/SETTINGS/a.json", testFS, sent));
+    server->dirs.clear();
+    server->files.clear();
+    TEST_ASSERT_TRUE(uploader->upload("/SETTINGS/b.json", "/SETTINGS/b.json", testFS, sent));
+    TEST_ASSERT_EQUAL(2, server->count("MKCOL"));
+    TEST_ASSERT_TRUE(server->files["/SETTINGS/b.json"] == "{\"x\":1}");
+}
+
+static WebDAVUploader* connectTo(FakeDavServer::Dialect dialect) {
+    server->dialect = dialect;
+    if (dialect == FakeDavServer::NEXTCLOUD) {
+        server->root = "/remote.php/dav/files/user";
+        delete uploader;
+        uploader = new WebDAVUploader("https://cloud.local/remote.php/dav/files/user/", "user", "secret");
+        uploader->setClient(server);
+    }
+    TEST_ASSERT_TRUE(uploader->ensureConnected());
+    return uploader;
+}
+
+// The partial-write method is detected once and the probe file removed
+void test_resume_method_probe() {
+    const FakeDavServer::Dialect dialects[] = {FakeDavServer::PLAIN, FakeDavServer::APACHE,
+                                               FakeDavServer::SABRE, FakeDavServer::NEXTCLOUD};
+    const WebDAVUploader::ResumeMethod expected[] = {
+        WebDAVUploader::RESUME_NONE, WebDAVUploader::RESUME_CONTENT_RANGE,
+        WebDAVUploader::RESUME_PATCH, WebDAVUploader::RESUME_CHUNKED_UPLOAD};
+    for (int i = 0; i < 4; i++) {
+        tearDown();
+        setUp();
+        connectTo(dialects[i]);
+        TEST_ASSERT_EQUAL(expected[i], uploader->getResumeMethod());
+        TEST_ASSERT_TRUE(uploader->supportsResume());
+        TEST_ASSERT_EQUAL(i == 1 || i == 2, uploader->supportsAppend());
+        TEST_ASSERT_EQUAL(0, server->files.count("/.cpap_resume_probe"));
+
+        uploader->end();
+        size_t requests = server->requests.size();
+        TEST_ASSERT_TRUE(uploader->ensureConnected());
+        TEST_ASSERT_EQUAL(requests + 1, server->requests.size());  // PROPFIND only
+    }
+}
+
+// A lost link keeps the acknowledged pieces; the next call continues there
+void test_content_range_resume_after_link_loss() {
+    connectTo(FakeDavServer::APACHE);
+    std::string content = makeContent(1300000, 5);
+    testFS.addFile("/DATALOG/20240101/BRP.edf", content);
+
+    server->writesBeforeDrop = 2;
+    unsigned long sent = 0;
+    TEST_ASSERT_FALSE(uploader->upload("/DATALOG/20240101/BRP.edf", "/DATALOG/20240101/BRP.edf",
+                                       testFS, sent));
+    TEST_ASSERT_EQUAL(2 * WEBDAV_RESUME_PIECE_SIZE, sent);
+
+    server->refuseConnections = false;
+    server->writesBeforeDrop = -1;
+    int puts = server->count("PUT");
+    unsigned long rest = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240101/BRP.edf", "/DATALOG/20240101/BRP.edf",
+                                      testFS, rest, sent));
+    TEST_ASSERT_EQUAL(content.size() - sent, rest);
+    TEST_ASSERT_EQUAL(puts + 1, server->count("PUT"));
+    TEST_ASSERT_TRUE(server->files["/DATALOG/20240101/BRP.edf"] == content);
+}
+
+// Budget-limited slices and header patches go out as partial updates
+void test_patch_slices_and_header_refresh() {
+    connectTo(FakeDavServer::SABRE);
+    std::string content = makeContent(900000, 6);
+    testFS.addFile("/STR.edf", content);
+
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/STR.edf", "/STR.edf", testFS, sent, 0, 600000));
+    TEST_ASSERT_EQUAL(600000, sent);
+    TEST_ASSERT_EQUAL(0, uploader->getLastChecksum().length());  // Not the whole file
+    TEST_ASSERT_EQUAL(600000, server->files["/STR.edf"].size());
+    TEST_ASSERT_TRUE(uploader->upload("/STR.edf", "/STR.edf", testFS, sent, 600000));
+    TEST_ASSERT_EQUAL(300000, sent);
+    TEST_ASSERT_TRUE(server->files["/STR.edf"] == content);
+    TEST_ASSERT_EQUAL(2, server->count("PATCH"));
+
+    // Header rewritten in place on the card: only that range is sent
+    content.replace(0, 256, std::string(256, 'H'));
+    testFS.addFile("/STR.edf", content);
+    TEST_ASSERT_TRUE(uploader->patchRange("/STR.edf", "/STR.edf", testFS, 0, 256));
+    TEST_ASSERT_TRUE(server->files["/STR.edf"] == content);
+    TEST_ASSERT_EQUAL(3, server->count("PATCH"));
+}
+
+// Nextcloud pieces wait in an upload collection until the last one is in
+void test_nextcloud_chunked_upload() {
+    connectTo(FakeDavServer::NEXTCLOUD);
+    std::string content = makeContent(1200000, 7);
+    testFS.addFile("/DATALOG/20240101/BRP.edf", content);
+
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240101/BRP.edf", "/DATALOG/20240101/BRP.edf",
+                                      testFS, sent, 0, 700000));
+    TEST_ASSERT_EQUAL(700000, sent);
+    TEST_ASSERT_EQUAL(0, server->files.count("/DATALOG/20240101/BRP.edf"));
+    TEST_ASSERT_EQUAL(0, server->count("MOVE"));
+
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240101/BRP.edf", "/DATALOG/20240101/BRP.edf",
+                                      testFS, sent, 700000));
+    TEST_ASSERT_EQUAL(500000, sent);
+    TEST_ASSERT_EQUAL(1, server->count("MOVE"));
+    TEST_ASSERT_TRUE(server->files["/DATALOG/20240101/BRP.edf"] == content);
+    for (const auto& file : server->files) {
+        TEST_ASSERT_TRUE(file.first.compare(0, 3, "@up") != 0);  // Upload collection gone
+    }
+
+    // Small files need no upload collection
+    int mkcols = server->count("MKCOL");
+    testFS.addFile("/DATALOG/20240101/EVE.edf", makeContent(3000, 8));
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240101/EVE.edf", "/DATALOG/20240101/EVE.edf",
+                                      testFS, sent));
+    TEST_ASSERT_EQUAL(mkcols, server->count("MKCOL"));
+    TEST_ASSERT_EQUAL(1, server->count("MOVE"));
+}
+
+// A server that lost the checkpointed prefix gets it again, up to the same end
+void test_resume_starts_over_when_server_lost_data() {
+    connectTo(FakeDavServer::APACHE);
+    std::string content = makeContent(1500000, 9);
+    testFS.addFile("/DATALOG/20240102/PLD.edf", content);
+
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240102/PLD.edf", "/DATALOG/20240102/PLD.edf",
+                                      testFS, sent, 0, 500000));
+    server->files["/DATALOG/20240102/PLD.edf"].resize(100);
+
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240102/PLD.edf", "/DATALOG/20240102/PLD.edf",
+                                      testFS, sent, 500000, 500000));
+    TEST_ASSERT_EQUAL(500000, sent);
+    TEST_ASSERT_TRUE(server->files["/DATALOG/20240102/PLD.edf"] == content.substr(0, 1000000));
+}
+
+// Resume support is known before connecting; a server without partial
+// writes gets the whole file for a slice or a checkpoint
+void test_whole_file_without_partial_writes() {
+    TEST_ASSERT_TRUE(uploader->supportsResume());
+    TEST_ASSERT_FALSE(uploader->supportsAppend());
+    TEST_ASSERT_EQUAL(0, server->requests.size());
+
+    connectTo(FakeDavServer::PLAIN);
+    std::string content = makeContent(900000, 10);
+    testFS.addFile("/DATALOG/20240103/BRP.edf", content);
+    unsigned long sent = 0;
+    TEST_ASSERT_TRUE(uploader->upload("/DATALOG/20240103/BRP.edf", "/DATALOG/20240103/BRP.edf",
+                                      testFS, sent, 300000, 200000));
+    TEST_ASSERT_EQUAL(content.size(), sent);
+    TEST_ASSERT_TRUE(server->files["/DATALOG/20240103/BRP.edf"] == content);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_http_url_parsing);
+    RUN_TEST(test_put_streams_files_over_one_connection);
+    RUN_TEST(test_authentication_failure);
+    RUN_TEST(test_propfind_listing);
+    RUN_TEST(test_chunked_stream_upload);
+    RUN_TEST(test_reconnect_after_server_close);
+    RUN_TEST(test_conflict_recreates_directories);
+    RUN_TEST(test_resume_method_probe);
+    RUN_TEST(test_content_range_resume_after_link_loss);
+    RUN_TEST(test_patch_slices_and_header_refresh);
+    RUN_TEST(test_nextcloud_chunked_upload);
+    RUN_TEST(test_resume_starts_over_when_server_lost_data);
+    RUN_TEST(test_whole_file_without_partial_writes);
+
+    return UNITY_END();
+}
@@ -0,0 +1,114 @@
+"""
+edz - Decoder for the firmware's EDF signal codec (.edz files)
+
+With "COMPRESSION_CODEC": "EDF" the device codes EDF signal files with
+EdfCodec (src/EdfCodec.cpp) instead of gzip. Stream layout, integers
+little endian:
+
+  "EDZ1"  u32 raw size  u32 header length H  u16 signal count N
+  N x { u8 mode, u16 samples per record }
+  H header bytes, verbatim
+  complete data records, coded signal by signal
+  remaining bytes (partial record), verbatim
+  u32 CRC-32 of the raw file
+
+Mode 0 signals are stored as is. Mode 1 signals are a series of varint
+tokens v: an even v is one sample equal to its prediction plus
+unzigzag(v >> 1); an odd v is (v >> 1) + 2 samples equal to their
+predictions. The prediction is the previous sample, or the line through
+the last two once that has had the smaller recent error. Decoding must
+follow EdfCodec::predict() and EdfCodec::advance() exactly.
+"""
+
+import struct
+import zlib
+
+MAGIC = b"EDZ1"
+MODE_RAW = 0
+MODE_DELTA = 1
+
+
+def _unzigzag(value):
+    return -((value + 1) >> 1) if value & 1 else value >> 1
+
+
+def _int16(value):
+    return ((value + 0x8000) & 0xFFFF) - 0x8000
+
+
+def decode(data):
+    """Return the raw file bytes; raises ValueError on a damaged stream"""
+    if len(data) < 14 or data[:4] != MAGIC:
+        raise ValueError("not an EDZ1 stream")
+    raw_size, header_length, count = struct.unpack_from("<IIH", data, 4)
+    pos = 14
+
+    signals = []
+    for _ in range(count):
+        if pos + 3 > len(data):
+            raise ValueError("truncated signal table")
+        mode, samples = struct.unpack_from("<BH", data, pos)
+        pos += 3
+        if mode > MODE_DELTA:
+            raise ValueError("unknown signal mode %d" % mode)
+        signals.append((mode, samples))
+    record_bytes = sum(2 * samples for _, samples in signals)
+    if header_length > raw_size or pos + header_length > len(data) or (count and not record_bytes):
+        raise ValueError("bad header length")
+
+    out = bytearray(data[pos:pos + header_length])
+    pos += header_length
+    records = (raw_size - header_length) // record_bytes if count else 0
+
+    # Predictor state per signal: previous, previous2, cost1, cost2
+    state = [[0, 0, 0, 0] for _ in signals]
+    pack = struct.Struct("<h").pack
+    try:
+        for _ in range(records):
+            for (mode, samples), s in zip(signals, state):
+                if mode == MODE_RAW:
+                    out += data[pos:pos + 2 * samples]
+                    pos += 2 * samples
+                    continue
+                done = 0
+                while done < samples:
+                    token = 0
+                    shift = 0
+                    while True:
+                        byte = data[pos]
+                        pos += 1
+                        token |= (byte & 0x7F) << shift
+                        if not byte & 0x80:
+                            break
+                        shift += 7
+                        if shift >= 35:
+                            raise ValueError("bad varint")
+                    if token & 1:
+                        repeat, error = (token >> 1) + 2, 0
+                    else:
+                        repeat, error = 1, _unzigzag(token >> 1)
+                    if done + repeat > samples:
+                        raise ValueError("run crosses a signal block")
+                    previous, previous2, cost1, cost2 = s
+                    for _ in range(repeat):
+                        line = 2 * previous - previous2
+                        sample = _int16((line if cost2 < cost1 else previous) + error)
+                        out += pack(sample)
+                        cost1 = cost1 - (cost1 >> 4) + abs(sample - previous)
+                        cost2 = cost2 - (cost2 >> 4) + abs(sample - line)
+                        previous2, previous = previous, sample
+                    s[:] = previous, previous2, cost1, cost2
+                    done += repeat
+    except IndexError:
+        raise ValueError("truncated data records")
+    if len(data) - pos < 4 or len(out) > raw_size:
+        raise ValueError("truncated stream")
+
+    tail = raw_size - len(out)
+    if pos + tail + 4 != len(data):
+        raise ValueError("size mismatch")
+    out += data[pos:pos + tail]
+    pos += tail
+    if struct.unpack_from("<I", data, pos)[0] != zlib.crc32(out) & 0xFFFFFFFF:
+        raise ValueError("CRC mismatch")
+    return bytes(out)
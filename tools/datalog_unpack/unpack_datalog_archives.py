@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+unpack_datalog_archives - Restore DATALOG folders from archive-mode uploads
+
+With DATALOG_ARCHIVE enabled the firmware uploads each night folder as one
+tar file, DATALOG/<YYYYMMDD>.tar (or .tar.gz with COMPRESS_UPLOADS), holding
+<YYYYMMDD>/<file> entries. With COMPRESS_UPLOADS alone each file arrives as
+DATALOG/<YYYYMMDD>/<file>.gz, or <file>.edz with COMPRESSION_CODEC "EDF".
+This tool extracts every archive next to itself and decompresses every .gz
+and .edz file in place, so the share has the same layout as a plain
+per-file upload, which is what OSCAR and SleepHQ expect.
+
+Usage:
+  unpack_datalog_archives.py <DATALOG dir> [--keep] [--dry-run]
+
+Archives and compressed files are deleted after a successful extract unless
+--keep is given. A plain file newer than its .gz/.edz (the device fell back to an
+uncompressed upload later) is kept as it is.
+Entries that would escape the target folder are refused. Run it from cron
+or by hand after uploads; re-running is safe.
+"""
+
+import argparse
+import gzip
+import os
+import shutil
+import sys
+import tarfile
+import zlib
+
+import edz
+
+
+def safe_members(archive, folder):
+    """Yield regular-file members that stay inside <folder>/"""
+    for member in archive.getmembers():
+        name = os.path.normpath(member.name)
+        if not member.isfile() or os.path.dirname(name) != folder:
+            raise ValueError("unexpected entry %r" % member.name)
+        yield member
+
+
+ARCHIVE_SUFFIXES = (".tar.gz", ".tar")
+
+
+def archive_folder(name):
+    """Folder name of an archive file name, or None"""
+    for suffix in ARCHIVE_SUFFIXES:
+        if name.endswith(suffix) and not name.startswith("."):
+            return name[:-len(suffix)]
+    return None
+
+
+def unpack(datalog_dir, archive_name, keep, dry_run):
+    folder = archive_folder(archive_name)
+    path = os.path.join(datalog_dir, archive_name)
+
+    with tarfile.open(path, "r:*") as archive:
+        members = list(safe_members(archive, folder))
+        print("%s: %d files -> %s/" % (archive_name, len(members), folder))
+        if dry_run:
+            return
+        os.makedirs(os.path.join(datalog_dir, folder), exist_ok=True)
+        for member in members:
+            target = os.path.join(datalog_dir, member.name)
+            source = archive.extractfile(member)
+            with open(target + ".part", "wb") as out:
+                out.write(source.read())
+            os.replace(target + ".part", target)
+            if member.mtime > 0:
+                os.utime(target, (member.mtime, member.mtime))
+
+    if not keep:
+        os.remove(path)
+
+
+COMPRESSED_SUFFIXES = (".gz", ".edz")
+
+
+def decompress(path, keep, dry_run):
+    """Replace <file>.gz or <file>.edz with <file> unless a newer plain copy exists"""
+    target = os.path.splitext(path)[0]
+    if os.path.exists(target) and os.path.getmtime(target) > os.path.getmtime(path):
+        print("%s: older than %s, discarded" % (path, os.path.basename(target)))
+    else:
+        print("%s -> %s" % (path, os.path.basename(target)))
+        if dry_run:
+            return
+        if path.endswith(".edz"):
+            with open(path, "rb") as source:
+                data = edz.decode(source.read())
+            with open(target + ".part", "wb") as out:
+                out.write(data)
+        else:
+            with gzip.open(path, "rb") as source, open(target + ".part", "wb") as out:
+                shutil.copyfileobj(source, out)
+        os.replace(target + ".part", target)
+    if not keep and not dry_run:
+        os.remove(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Extract DATALOG archives and compressed files in place")
+    parser.add_argument("datalog_dir", help="DATALOG directory on the share")
+    parser.add_argument("--keep", action="store_true", help="keep archives after extracting")
+    parser.add_argument("--dry-run", action="store_true", help="list archives without extracting")
+    args = parser.parse_args()
+
+    archives = sorted(name for name in os.listdir(args.datalog_dir)
+                      if archive_folder(name) is not None)
+    failures = 0
+    for name in archives:
+        try:
+            unpack(args.datalog_dir, name, args.keep, args.dry_run)
+        except (tarfile.TarError, ValueError, OSError) as error:
+            print("%s: FAILED (%s)" % (name, error), file=sys.stderr)
+            failures += 1
+
+    # Compressed single files, after archives so a .tar.gz is not touched here
+    compressed = []
+    for folder in sorted(os.listdir(args.datalog_dir)):
+        folder_path = os.path.join(args.datalog_dir, folder)
+        if os.path.isdir(folder_path):
+            compressed += [os.path.join(folder_path, name) for name in sorted(os.listdir(folder_path))
+                           if name.endswith(COMPRESSED_SUFFIXES) and not name.startswith(".")]
+    for path in compressed:
+        try:
+            decompress(path, args.keep, args.dry_run)
+        except (OSError, EOFError, ValueError, zlib.error) as error:
+            print("%s: FAILED (%s)" % (path, error), file=sys.stderr)
+            failures += 1
+
+    if not archives and not compressed:
+        print("Nothing to unpack in %s" % args.datalog_dir)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+sleephq_mock - Local HTTPS stand-in for the SleepHQ import API
+
+Implements the endpoints SleepHQUploader (src/SleepHQUploader.cpp) uses:
+
+  POST /oauth/token                         client credentials -> access token
+  GET  /api/v1/me                           current_team_id
+  POST /api/v1/teams/<team>/imports         new import
+  POST /api/v1/imports/<id>/files           one multipart file per request
+  POST /api/v1/imports/<id>/process_files   close the import
+
+Each file's content_hash field must be the MD5 of the file data followed by
+its name, as the real service checks. Files are stored under
+<dir>/<import id>/<path>/<name>; a processed import gets a PROCESSED marker.
+
+Usage:
+  sleephq_mock.py [--port 8443] [--dir received] [--client-id cpap]
+                  [--client-secret secret] [--http]
+
+A self-signed certificate (sleephq_mock.pem) is generated with openssl on
+first run. Connections are HTTP/1.1 keep-alive; every new TLS connection is
+logged, so one per upload session is expected.
+"""
+
+import argparse
+import email.parser
+import email.policy
+import hashlib
+import http.server
+import json
+import os
+import re
+import secrets
+import ssl
+import subprocess
+import sys
+import time
+import urllib.parse
+
+TEAM_ID = 1
+TOKEN_LIFETIME = 7200
+
+
+class State:
+    def __init__(self, args):
+        self.args = args
+        self.tokens = {}  # token -> expiry time
+        self.imports = {}  # id -> {"files": n, "processed": bool}
+        self.next_import = 1
+        self.connections = 0
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    state = None
+
+    def setup(self):
+        super().setup()
+        Handler.state.connections += 1
+        self.log_message("connection %d opened", Handler.state.connections)
+
+    def send_json(self, status, document):
+        body = json.dumps(document).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        return self.rfile.read(length)
+
+    def authorized(self):
+        auth = self.headers.get("Authorization", "")
+        expiry = Handler.state.tokens.get(auth[len("Bearer "):]) if auth.startswith("Bearer ") else None
+        if expiry is None or expiry < time.time():
+            self.send_json(401, {"error": "invalid_token"})
+            return False
+        return True
+
+    def do_GET(self):
+        if not self.authorized():
+            return
+        if self.path == "/api/v1/me":
+            self.send_json(200, {"data": {"id": "1", "type": "user",
+                                          "attributes": {"current_team_id": TEAM_ID}}})
+        else:
+            self.send_json(404, {"error": "not found"})
+
+    def do_POST(self):
+        body = self.read_body()
+        if self.path == "/oauth/token":
+            return self.token(body)
+        if not self.authorized():
+            return
+        if self.path == "/api/v1/teams/%d/imports" % TEAM_ID:
+            import_id = Handler.state.next_import
+            Handler.state.next_import += 1
+            Handler.state.imports[import_id] = {"files": 0, "processed": False}
+            self.log_message("import %d created", import_id)
+            return self.send_json(201, {"data": {"id": import_id, "type": "import"}})
+        match = re.fullmatch(r"/api/v1/imports/(\d+)/(files|process_files)", self.path)
+        if not match or int(match.group(1)) not in Handler.state.imports:
+            return self.send_json(404, {"error": "not found"})
+        import_id = int(match.group(1))
+        record = Handler.state.imports[import_id]
+        if record["processed"]:
+            return self.send_json(422, {"error": "import already processed"})
+        if match.group(2) == "process_files":
+            record["processed"] = True
+            folder = os.path.join(Handler.state.args.dir, str(import_id))
+            os.makedirs(folder, exist_ok=True)
+            open(os.path.join(folder, "PROCESSED"), "w").close()
+            self.log_message("import %d processed (%d files)", import_id, record["files"])
+            return self.send_json(201, {"data": {"id": import_id, "type": "import"}})
+        self.add_file(import_id, record, body)
+
+    def token(self, body):
+        form = urllib.parse.parse_qs(body.decode())
+        args = Handler.state.args
+        if (form.get("grant_type") != ["client_credentials"] or form.get("client_id") != [args.client_id]
+                or form.get("client_secret") != [args.client_secret]):
+            return self.send_json(401, {"error": "invalid_client"})
+        token = secrets.token_hex(16)
+        Handler.state.tokens[token] = time.time() + TOKEN_LIFETIME
+        self.send_json(200, {"access_token": token, "token_type": "Bearer",
+                             "expires_in": TOKEN_LIFETIME, "scope": "read write"})
+
+    def add_file(self, import_id, record, body):
+        head = "Content-Type: %s\r\n\r\n" % self.headers.get("Content-Type", "")
+        message = email.parser.BytesParser(policy=email.policy.HTTP).parsebytes(head.encode() + body)
+        fields = {}
+        for part in message.iter_parts():
+            fields[part.get_param("name", header="content-disposition")] = part.get_payload(decode=True)
+        data = fields.get("file")
+        name = (fields.get("name") or b"").decode()
+        path = (fields.get("path") or b"/").decode()
+        if data is None or not name or "/" in name or ".." in path.split("/"):
+            return self.send_json(422, {"error": "name, path and file are required"})
+        expected = hashlib.md5(data + name.encode()).hexdigest()
+        if (fields.get("content_hash") or b"").decode() != expected:
+            return self.send_json(422, {"error": "content_hash mismatch"})
+
+        folder = os.path.join(Handler.state.args.dir, str(import_id), path.strip("/"))
+        os.makedirs(folder, exist_ok=True)
+        with open(os.path.join(folder, name), "wb") as out:
+            out.write(data)
+        record["files"] += 1
+        self.log_message("import %d: %s%s (%d bytes)", import_id, path, name, len(data))
+        self.send_json(201, {"data": {"type": "file", "attributes": {"name": name, "path": path}}})
+
+
+def ensure_certificate(path):
+    if os.path.exists(path):
+        return
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "3650",
+                    "-subj", "/CN=sleephq-mock", "-keyout", path, "-out", path],
+                   check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local mock of the SleepHQ import API")
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--dir", default="received", help="where uploaded files are stored")
+    parser.add_argument("--client-id", default="cpap")
+    parser.add_argument("--client-secret", default="secret")
+    parser.add_argument("--http", action="store_true", help="plain HTTP instead of HTTPS")
+    args = parser.parse_args()
+
+    Handler.state = State(args)
+    server = http.server.ThreadingHTTPServer(("", args.port), Handler)
+    if not args.http:
+        cert = os.path.join(os.path.dirname(os.path.abspath(__file__)), "sleephq_mock.pem")
+        ensure_certificate(cert)
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(cert)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    print("SleepHQ mock on %s://0.0.0.0:%d, files in %s/" % ("http" if args.http else "https", args.port, args.dir))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,227 @@
+/**
+ * smb_window_bench - Measure SMB upload throughput vs. async write window
+ *
+ * Host-side benchmark for the SMB_WRITE_WINDOW setting. Uploads a synthetic
+ * file to an SMB share with the same scheme the firmware uses (fixed-size
+ * chunks, up to N smb2_pwrite_async requests in flight, issued in offset
+ * order) and prints KB/s for each window size.
+ *
+ * Window 1 uses synchronous smb2_write, matching the firmware default.
+ *
+ * Usage:
+ *   smb_window_bench smb://[user@]server/share/path [size_mb] [chunk_kb] [windows...]
+ *
+ * Defaults: 8 MB file, 16 KB chunks (UPLOAD_PIPELINE_BUFFER_SIZE), windows 1 2 4 8.
+ * The password is taken from the SMB_PASS environment variable.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+extern "C" {
+#include <smb2/smb2.h>
+#include <smb2/libsmb2.h>
+}
+
+#define MAX_WINDOW 64
+#define REPLY_TIMEOUT_MS 30000
+
+struct Slot {
+    uint64_t offset;
+    uint32_t length;
+    bool busy;
+};
+
+struct WindowState {
+    Slot slots[MAX_WINDOW];
+    int inFlight;
+    bool failed;
+};
+
+static WindowState* g_state = nullptr;
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void writeCallback(struct smb2_context* smb2, int status, void* commandData, void* privateData) {
+    Slot* slot = static_cast<Slot*>(privateData);
+    if (status < 0 || (uint32_t)status != slot->length) {
+        fprintf(stderr, "write at offset %llu failed: %s\n",
+                (unsigned long long)slot->offset, smb2_get_error(smb2));
+        g_state->failed = true;
+    }
+    slot->busy = false;
+    g_state->inFlight--;
+}
+
+static bool serviceOnce(struct smb2_context* smb2) {
+    struct pollfd pfd;
+    pfd.fd = smb2_get_fd(smb2);
+    pfd.events = smb2_which_events(smb2);
+    pfd.revents = 0;
+
+    int rc = poll(&pfd, 1, REPLY_TIMEOUT_MS);
+    if (rc <= 0) {
+        fprintf(stderr, "poll: %s\n", rc == 0 ? "timeout" : strerror(errno));
+        return false;
+    }
+    if (smb2_service(smb2, pfd.revents) < 0) {
+        fprintf(stderr, "smb2_service: %s\n", smb2_get_error(smb2));
+        return false;
+    }
+    return true;
+}
+
+static bool uploadSync(struct smb2_context* smb2, struct smb2fh* fh,
+                       const std::vector<uint8_t>& data, size_t chunk) {
+    for (size_t off = 0; off < data.size(); off += chunk) {
+        size_t len = data.size() - off < chunk ? data.size() - off : chunk;
+        if (smb2_write(smb2, fh, &data[off], len) != (int)len) {
+            fprintf(stderr, "smb2_write: %s\n", smb2_get_error(smb2));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool uploadAsync(struct smb2_context* smb2, struct smb2fh* fh,
+                        const std::vector<uint8_t>& data, size_t chunk, int window) {
+    WindowState state;
+    memset(&state, 0, sizeof(state));
+    g_state = &state;
+
+    uint64_t offset = 0;
+    while (offset < data.size() && !state.failed) {
+        while (state.inFlight >= window && !state.failed) {
+            if (!serviceOnce(smb2)) {
+                return false;
+            }
+        }
+        if (state.failed) {
+            break;
+        }
+
+        Slot* slot = nullptr;
+        for (int i = 0; i < window; i++) {
+            if (!state.slots[i].busy) {
+                slot = &state.slots[i];
+                break;
+            }
+        }
+
+        size_t len = data.size() - offset < chunk ? data.size() - offset : chunk;
+        slot->offset = offset;
+        slot->length = len;
+        slot->busy = true;
+        if (smb2_pwrite_async(smb2, fh, &data[offset], len, offset, writeCallback, slot) < 0) {
+            fprintf(stderr, "smb2_pwrite_async: %s\n", smb2_get_error(smb2));
+            slot->busy = false;
+            state.failed = true;
+            break;
+        }
+        state.inFlight++;
+        offset += len;
+    }
+
+    // Drain outstanding replies before the slots go out of scope
+    while (state.inFlight > 0) {
+        if (!serviceOnce(smb2)) {
+            return false;
+        }
+    }
+    g_state = nullptr;
+    return !state.failed;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s smb://[user@]server/share/path [size_mb] [chunk_kb] [windows...]\n", argv[0]);
+        return 2;
+    }
+
+    size_t sizeMb = argc > 2 ? atoi(argv[2]) : 8;
+    size_t chunk = (argc > 3 ? atoi(argv[3]) : 16) * 1024;
+    std::vector<int> windows;
+    for (int i = 4; i < argc; i++) {
+        int w = atoi(argv[i]);
+        if (w >= 1 && w <= MAX_WINDOW) {
+            windows.push_back(w);
+        }
+    }
+    if (windows.empty()) {
+        windows = {1, 2, 4, 8};
+    }
+
+    struct smb2_context* smb2 = smb2_init_context();
+    if (smb2 == nullptr) {
+        fprintf(stderr, "failed to init context\n");
+        return 1;
+    }
+
+    struct smb2_url* url = smb2_parse_url(smb2, argv[1]);
+    if (url == nullptr || url->path == nullptr) {
+        fprintf(stderr, "bad URL: %s\n", smb2_get_error(smb2));
+        return 1;
+    }
+
+    smb2_set_security_mode(smb2, SMB2_NEGOTIATE_SIGNING_ENABLED);
+    if (getenv("SMB_PASS")) {
+        smb2_set_password(smb2, getenv("SMB_PASS"));
+    }
+    if (smb2_connect_share(smb2, url->server, url->share, url->user) < 0) {
+        fprintf(stderr, "connect failed: %s\n", smb2_get_error(smb2));
+        return 1;
+    }
+
+    // Synthetic EDF-sized payload (pseudo-random so compression on the
+    // server or link cannot flatter the numbers)
+    std::vector<uint8_t> data(sizeMb * 1024 * 1024);
+    uint32_t seed = 0x12345678;
+    for (size_t i = 0; i < data.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 24;
+    }
+
+    printf("file: %zu MB, chunk: %zu KB, server max write: %u bytes\n",
+           sizeMb, chunk / 1024, smb2_get_max_write_size(smb2));
+    printf("%8s %12s %10s\n", "window", "KB/s", "seconds");
+
+    int exitCode = 0;
+    for (size_t w = 0; w < windows.size(); w++) {
+        struct smb2fh* fh = smb2_open(smb2, url->path, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fh == nullptr) {
+            fprintf(stderr, "open %s failed: %s\n", url->path, smb2_get_error(smb2));
+            exitCode = 1;
+            break;
+        }
+
+        double start = nowSeconds();
+        bool ok = windows[w] == 1 ? uploadSync(smb2, fh, data, chunk)
+                                  : uploadAsync(smb2, fh, data, chunk, windows[w]);
+        double elapsed = nowSeconds() - start;
+        smb2_close(smb2, fh);
+
+        if (!ok) {
+            printf("%8d %12s %10s\n", windows[w], "FAILED", "-");
+            exitCode = 1;
+            break;
+        }
+        printf("%8d %12.1f %10.2f\n", windows[w], (data.size() / 1024.0) / elapsed, elapsed);
+    }
+
+    smb2_unlink(smb2, url->path);
+    smb2_disconnect_share(smb2);
+    smb2_destroy_url(url);
+    smb2_destroy_context(smb2);
+    return exitCode;
+}
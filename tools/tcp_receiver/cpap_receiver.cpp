@@ -0,0 +1,451 @@
+/**
+ * cpap_receiver - Receiver daemon for the firmware's TCP upload backend
+ *
+ * Listens for the framed protocol spoken by TCPUploader (ENDPOINT_TYPE
+ * "TCP") and writes the uploaded files below a root directory. Each file
+ * is written to "<name>.part", checked against the CRC-32 trailer and then
+ * renamed into place, so a file only appears once it arrived whole.
+ *
+ * Protocol (all integers little-endian):
+ *   hello   C->S  "CPAP" u8 version, u16 token length, token
+ *           S->C  "CPAP" u8 version, u8 status (0 ok, 1 bad token)
+ *   file    C->S  'F' u32 seq, u16 path length, path, u64 size (~0 = unknown)
+ *                 { u32 length, data }... u32 0, u32 crc32 of the data
+ *   ack     S->C  'A' u32 seq, u8 status, u64 bytes written
+ *                 status: 0 ok, 1 CRC mismatch, 2 write error, 3 bad path/size
+ *
+ * Usage:
+ *   cpap_receiver --root DIR [--port N] [--token T] [--fsync] [--once]
+ *
+ * The token can also be given in the CPAP_TOKEN environment variable.
+ * Each connection is served by a child process.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define PROTOCOL_VERSION 1
+#define DEFAULT_PORT 7878
+#define MAX_CHUNK (1024 * 1024)
+#define IDLE_TIMEOUT_S 120
+
+enum AckStatus { ACK_OK = 0, ACK_CRC_MISMATCH = 1, ACK_WRITE_ERROR = 2, ACK_BAD_REQUEST = 3 };
+
+static std::string rootDir;
+static std::string token;
+static bool syncFiles = false;
+
+// --- CRC-32 (IEEE 802.3, same as zlib crc32()) ---
+
+static uint32_t crcTable[256];
+
+static void initCrc() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crcTable[i] = c;
+    }
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// --- Buffered socket reader ---
+
+class Connection {
+public:
+    explicit Connection(int fd) : fd(fd), pos(0), len(0) {}
+
+    // False on EOF, error or idle timeout
+    bool read(void* out, size_t n) {
+        uint8_t* dst = (uint8_t*)out;
+        while (n > 0) {
+            if (pos == len && !fill()) {
+                return false;
+            }
+            size_t take = len - pos < n ? len - pos : n;
+            memcpy(dst, buffer + pos, take);
+            pos += take;
+            dst += take;
+            n -= take;
+        }
+        return true;
+    }
+
+    bool readLE(uint64_t& value, int bytes) {
+        uint8_t raw[8];
+        if (!read(raw, bytes)) {
+            return false;
+        }
+        value = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            value = (value << 8) | raw[i];
+        }
+        return true;
+    }
+
+    bool write(const std::string& data) {
+        size_t off = 0;
+        while (off < data.size()) {
+            ssize_t n = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            off += n;
+        }
+        return true;
+    }
+
+private:
+    bool fill() {
+        for (;;) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                pos = 0;
+                len = n;
+                return true;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+    }
+
+    int fd;
+    uint8_t buffer[64 * 1024];
+    size_t pos;
+    size_t len;
+};
+
+static void putLE(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += (char)(value >> (8 * i));
+    }
+}
+
+static void logMessage(const char* format, ...) __attribute__((format(printf, 1, 2)));
+static void logMessage(const char* format, ...) {
+    char stamp[32];
+    time_t now = time(nullptr);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    printf("%s [%d] ", stamp, (int)getpid());
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+    fflush(stdout);
+}
+
+// Relative path below the root, or empty if the path could escape it
+static std::string safePath(const std::string& path) {
+    std::string clean;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        std::string part = path.substr(start, end - start);
+        if (part == "." || part == ".." || part.find('\\') != std::string::npos ||
+            part.find('\0') != std::string::npos) {
+            return "";
+        }
+        if (!part.empty()) {
+            if (!clean.empty()) {
+                clean += '/';
+            }
+            clean += part;
+        }
+        start = end + 1;
+    }
+    return clean;
+}
+
+static bool makeParents(const std::string& path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        std::string dir = path.substr(0, slash);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Receive one file frame (after the 'F' byte) and answer with its ack
+ *
+ * @return false if the connection is unusable
+ */
+static bool receiveFile(Connection& conn, uint64_t& totalBytes) {
+    uint64_t seq, pathLen, size;
+    if (!conn.readLE(seq, 4) || !conn.readLE(pathLen, 2)) {
+        return false;
+    }
+    std::string path(pathLen, '\0');
+    if (!conn.read(&path[0], pathLen) || !conn.readLE(size, 8)) {
+        return false;
+    }
+
+    std::string relative = safePath(path);
+    int status = relative.empty() ? ACK_BAD_REQUEST : ACK_OK;
+    std::string target = rootDir + "/" + relative;
+    std::string partial = target + ".part";
+    int fd = -1;
+    if (status == ACK_OK) {
+        if (!makeParents(target) ||
+            (fd = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+            logMessage("Cannot create %s: %s", partial.c_str(), strerror(errno));
+            status = ACK_WRITE_ERROR;
+        }
+    }
+
+    auto abandon = [&]() {
+        if (fd >= 0) {
+            close(fd);
+            unlink(partial.c_str());
+            fd = -1;
+        }
+    };
+
+    // The frame is read to its end even after an error, so the stream
+    // stays in sync for the next file
+    std::vector<uint8_t> chunk;
+    uint64_t received = 0;
+    uint32_t crc = 0;
+    for (;;) {
+        uint64_t chunkLen;
+        if (!conn.readLE(chunkLen, 4)) {
+            abandon();
+            return false;
+        }
+        if (chunkLen == 0) {
+            break;
+        }
+        if (chunkLen > MAX_CHUNK) {
+            logMessage("Chunk of %llu bytes exceeds the limit, dropping connection", (unsigned long long)chunkLen);
+            abandon();
+            return false;
+        }
+        chunk.resize(chunkLen);
+        if (!conn.read(chunk.data(), chunkLen)) {
+            abandon();
+            return false;
+        }
+        crc = updateCrc(crc, chunk.data(), chunkLen);
+        received += chunkLen;
+        if (fd >= 0 && ::write(fd, chunk.data(), chunkLen) != (ssize_t)chunkLen) {
+            logMessage("Write to %s failed: %s", partial.c_str(), strerror(errno));
+            status = ACK_WRITE_ERROR;
+            close(fd);
+            fd = -1;
+        }
+    }
+    uint64_t expectedCrc;
+    if (!conn.readLE(expectedCrc, 4)) {
+        abandon();
+        return false;
+    }
+
+    if (status == ACK_OK && crc != (uint32_t)expectedCrc) {
+        status = ACK_CRC_MISMATCH;
+    }
+    if (status == ACK_OK && size != ~(uint64_t)0 && received != size) {
+        status = ACK_BAD_REQUEST;
+    }
+    if (fd >= 0) {
+        if (status == ACK_OK && syncFiles && fsync(fd) != 0) {
+            status = ACK_WRITE_ERROR;
+        }
+        if (close(fd) != 0 && status == ACK_OK) {
+            status = ACK_WRITE_ERROR;
+        }
+        if (status == ACK_OK && rename(partial.c_str(), target.c_str()) != 0) {
+            logMessage("Cannot rename %s: %s", partial.c_str(), strerror(errno));
+            status = ACK_WRITE_ERROR;
+        }
+        if (status != ACK_OK) {
+            unlink(partial.c_str());
+        }
+    }
+
+    if (status == ACK_OK) {
+        totalBytes += received;
+    } else {
+        logMessage("Refused %s (#%llu): status %d", path.c_str(), (unsigned long long)seq, status);
+    }
+
+    std::string ack("A");
+    putLE(ack, seq, 4);
+    putLE(ack, status, 1);
+    putLE(ack, status == ACK_OK ? received : 0, 8);
+    return conn.write(ack);
+}
+
+static void serve(int fd, const char* peer) {
+    Connection conn(fd);
+
+    char magic[4];
+    uint8_t version;
+    uint64_t tokenLen;
+    if (!conn.read(magic, 4) || memcmp(magic, "CPAP", 4) != 0 || !conn.read(&version, 1) ||
+        !conn.readLE(tokenLen, 2)) {
+        logMessage("%s: not a CPAP uploader", peer);
+        return;
+    }
+    std::string offered(tokenLen, '\0');
+    if (!conn.read(&offered[0], tokenLen)) {
+        return;
+    }
+
+    std::string reply("CPAP");
+    putLE(reply, PROTOCOL_VERSION, 1);
+    bool accepted = version == PROTOCOL_VERSION && offered == token;
+    putLE(reply, accepted ? 0 : 1, 1);
+    conn.write(reply);
+    if (!accepted) {
+        logMessage("%s: rejected (%s)", peer, version != PROTOCOL_VERSION ? "protocol version" : "token");
+        return;
+    }
+    logMessage("%s: connected", peer);
+
+    struct timeval start, stop;
+    gettimeofday(&start, nullptr);
+    unsigned long files = 0;
+    uint64_t bytes = 0;
+    uint8_t type;
+    while (conn.read(&type, 1)) {
+        if (type != 'F') {
+            logMessage("%s: unknown frame type 0x%02x, dropping connection", peer, type);
+            break;
+        }
+        if (!receiveFile(conn, bytes)) {
+            break;
+        }
+        files++;
+    }
+    gettimeofday(&stop, nullptr);
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1e6;
+    logMessage("%s: closed after %lu files, %llu bytes (%.1f KB/s)", peer, files, (unsigned long long)bytes,
+         seconds > 0 ? bytes / 1024.0 / seconds : 0.0);
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: cpap_receiver --root DIR [--port N] [--token T] [--fsync] [--once]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    int port = DEFAULT_PORT;
+    bool once = false;
+    const char* envToken = getenv("CPAP_TOKEN");
+    if (envToken) {
+        token = envToken;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--root" && i + 1 < argc) {
+            rootDir = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (arg == "--token" && i + 1 < argc) {
+            token = argv[++i];
+        } else if (arg == "--fsync") {
+            syncFiles = true;
+        } else if (arg == "--once") {
+            once = true;
+        } else {
+            usage();
+        }
+    }
+    while (rootDir.size() > 1 && rootDir[rootDir.size() - 1] == '/') {
+        rootDir.erase(rootDir.size() - 1);
+    }
+    struct stat st;
+    if (rootDir.empty() || stat(rootDir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || port <= 0 ||
+        port > 65535) {
+        usage();
+    }
+    initCrc();
+    signal(SIGCHLD, SIG_IGN);   // No zombies from connection handlers
+
+    int server = socket(AF_INET6, SOCK_STREAM, 0);
+    int on = 1, off = 0;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(server, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (server < 0 || bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 4) != 0) {
+        perror("cpap_receiver: listen");
+        return 1;
+    }
+    logMessage("Listening on port %d, writing to %s", port, rootDir.c_str());
+
+    for (;;) {
+        struct sockaddr_in6 peerAddr;
+        socklen_t peerLen = sizeof(peerAddr);
+        int fd = accept(server, (struct sockaddr*)&peerAddr, &peerLen);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("cpap_receiver: accept");
+            return 1;
+        }
+        char peer[INET6_ADDRSTRLEN] = "?";
+        inet_ntop(AF_INET6, &peerAddr.sin6_addr, peer, sizeof(peer));
+
+        // A device that loses Wi-Fi mid-transfer never closes its end
+        struct timeval idle = {IDLE_TIMEOUT_S, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        if (once) {
+            close(server);
+            serve(fd, peer);
+            close(fd);
+            return 0;
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            close(server);
+            serve(fd, peer);
+            close(fd);
+            _exit(0);
+        }
+        if (child < 0) {
+            perror("cpap_receiver: fork");
+        }
+        close(fd);
+    }
+}